@@ -1,12 +1,50 @@
 #version 450
 
+// Shading mode, set per pipeline variant (see PipelineShading in src/pipelines.h)
+layout(constant_id = 0) const uint SHADING_MODE = 0;
+
+// Size of the texture array (see TextureTable in src/texture_table.h)
+layout(constant_id = 2) const uint TEXTURE_CAPACITY = 1;
+
+// Surface of every mesh subset (see Material in src/main.c)
+struct Material {
+    vec4 baseColor;
+    uint texture;   // slot in the texture array
+    uint padding[3];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Materials {
+    Material materials[];
+};
+
+// Every texture of the scene; materials pick theirs by slot
+layout(set = 1, binding = 0) uniform sampler2D textures[TEXTURE_CAPACITY];
+
 // Input from vertex shader
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in vec2 fragTexCoord;
+layout(location = 3) flat in uint fragMaterial;
 
 // Output color
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    // Output the interpolated color from vertex shader
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    if (SHADING_MODE == 1) {
+        // Normals mapped from [-1, 1] to [0, 1]
+        outColor = vec4(normalize(fragNormal) * 0.5 + 0.5, 1.0);
+    } else if (SHADING_MODE == 2) {
+        // Checkerboard over the texture coordinates
+        vec2 cell = floor(fragTexCoord * 8.0);
+        float checker = mod(cell.x + cell.y, 2.0);
+        outColor = vec4(mix(vec3(0.15), vec3(0.9, 0.6, 0.2), checker) * fragColor, 1.0);
+    } else {
+        // Lit material; every fragment of a draw has the same material, so
+        // the index is dynamically uniform and needs no nonuniformEXT. OBJ
+        // texture coordinates start at the bottom row, images at the top.
+        Material material = materials[fragMaterial];
+        vec2 uv = vec2(fragTexCoord.x, 1.0 - fragTexCoord.y);
+        vec4 texel = texture(textures[min(material.texture, TEXTURE_CAPACITY - 1u)], uv);
+        outColor = vec4(fragColor, 1.0) * material.baseColor * texel;
+    }
+}
@@ -1,26 +1,75 @@
 #version 450
 
-// Vertex positions for a triangle (in normalized device coordinates)
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),   // Bottom vertex
-    vec2(0.5, 0.5),    // Top right vertex
-    vec2(-0.5, 0.5)    // Top left vertex
-);
-
-// Colors for each vertex
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0), // Red
-    vec3(0.0, 1.0, 0.0), // Green
-    vec3(0.0, 0.0, 1.0)  // Blue
-);
+// Vertex layout of the mesh (see VertexFormat in src/mesh.h)
+layout(constant_id = 1) const bool PACKED_VERTICES = false;
+
+// Shared by every draw of the frame (see FrameUniforms in src/main.c)
+layout(std140, set = 0, binding = 0) uniform Frame {
+    mat4 viewProjection;
+    vec4 lightDirection;  // xyz = unit vector towards the light
+} frame;
+
+// The instance index packs the object in its low bits and the material in
+// the others (see DRAW_OBJECT_BITS in src/main.c)
+const uint OBJECT_BITS = 20u;
+
+// Model matrix of every object this frame; draws pick theirs through the
+// instance index
+layout(std430, set = 0, binding = 1) readonly buffer Transforms {
+    mat4 models[];
+};
+
+// How the draws decode the vertex buffer (see DrawPushConstants in src/main.c)
+layout(push_constant) uniform DrawConstants {
+    vec4 positionMin;     // packed positions decode as positionMin + unorm * positionExtent
+    vec4 positionExtent;
+} draw;
+
+// Vertex attributes (see Vertex and PackedVertex in src/mesh.h); packed
+// positions arrive as UNORM, normals as the octahedral SNORM pair in xy
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
 
 // Output variables to fragment shader
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragTexCoord;
+layout(location = 3) flat out uint fragMaterial;
+
+// The depth prepass and the shading pass must write bit-identical depth
+invariant gl_Position;
+
+// Unfolds the octahedral projection written by meshPackVertices
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main() {
-    // Set vertex position using built-in vertex index
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    vec3 position = inPosition;
+    vec3 normal = inNormal;
+    if (PACKED_VERTICES) {
+        position = draw.positionMin.xyz + inPosition * draw.positionExtent.xyz;
+        normal = octahedralDecode(inNormal.xy);
+    }
+    
+    // Place the model in its cell, then apply the view; the projection flips
+    // Y and reverses depth, so nearer points get greater depth
+    mat4 model = models[uint(gl_InstanceIndex) & ((1u << OBJECT_BITS) - 1u)];
+    gl_Position = frame.viewProjection * (model * vec4(position, 1.0));
+    
+    // Objects are only turned, moved and uniformly scaled, so the model
+    // matrix turns normals too
+    normal = normalize(mat3(model) * normal);
     
-    // Pass color to fragment shader
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    // Simple directional light so faces stay distinguishable
+    float light = max(dot(normal, frame.lightDirection.xyz), 0.0);
+    fragColor = vec3(0.2 + 0.8 * light);
+    fragNormal = normal;
+    fragTexCoord = inTexCoord;
+    fragMaterial = uint(gl_InstanceIndex) >> OBJECT_BITS;
+}
@@ -0,0 +1,554 @@
+#include "bc_encoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Least-squares passes after the principal axis fit; each one re-fits the
+// endpoints to the indices the previous one picked
+#define BC_REFINE_PASSES 2
+
+// Entries of the linear to sRGB table used while filtering mips
+#define BC_LINEAR_STEPS 4096
+
+// Position of each BC1 index between endpoint 0 and endpoint 1, in thirds
+static const int bc1Thirds[4] = {0, 3, 1, 2};
+
+// BC7 4-bit index weights, in 64ths towards endpoint 1
+static const int bc7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+uint32_t bcBlockBytes(BcFormat format) {
+    return format == BC_FORMAT_BC1 ? 8 : 16;
+}
+
+size_t bcLevelSize(BcFormat format, uint32_t width, uint32_t height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * bcBlockBytes(format);
+}
+
+uint32_t bcMipLevels(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while (width >> levels || height >> levels) {
+        levels++;
+    }
+    return levels;
+}
+
+BcFormat bcChooseFormat(const Image* image) {
+    size_t count = (size_t)image->width * image->height;
+    for (size_t i = 0; i < count; i++) {
+        if (image->pixels[i * 4 + 3] != 255) {
+            return BC_FORMAT_BC3;
+        }
+    }
+    return BC_FORMAT_BC1;
+}
+
+// Texels of the block at (blockX, blockY); edge blocks repeat the last row and column
+static void loadBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY,
+                      uint8_t block[16][4]) {
+    for (uint32_t y = 0; y < 4; y++) {
+        uint32_t sourceY = blockY * 4 + y < height ? blockY * 4 + y : height - 1;
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t sourceX = blockX * 4 + x < width ? blockX * 4 + x : width - 1;
+            memcpy(block[y * 4 + x], pixels + ((size_t)sourceY * width + sourceX) * 4, 4);
+        }
+    }
+}
+
+// Extremes of the block along its principal axis, found by power iteration
+// on the covariance of the first channels
+static void fitEndpoints(const uint8_t block[16][4], int channels, float endpoint0[4], float endpoint1[4]) {
+    float mean[4] = {0};
+    float low[4] = {255, 255, 255, 255};
+    float high[4] = {0};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < channels; c++) {
+            mean[c] += block[i][c] / 16.0f;
+            low[c] = block[i][c] < low[c] ? block[i][c] : low[c];
+            high[c] = block[i][c] > high[c] ? block[i][c] : high[c];
+        }
+    }
+
+    float covariance[4][4] = {{0}};
+    for (int i = 0; i < 16; i++) {
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++) {
+                covariance[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+            }
+        }
+    }
+
+    // Start along the bounding box diagonal, which is usually close already
+    float axis[4] = {0};
+    for (int c = 0; c < channels; c++) {
+        axis[c] = high[c] - low[c];
+    }
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {0};
+        float length = 0.0f;
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f) {
+            break;
+        }
+        length = 1.0f / sqrtf(length);
+        for (int c = 0; c < channels; c++) {
+            axis[c] = next[c] * length;
+        }
+    }
+
+    float minimum = 0.0f;
+    float maximum = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++) {
+            t += (block[i][c] - mean[c]) * axis[c];
+        }
+        minimum = t < minimum ? t : minimum;
+        maximum = t > maximum ? t : maximum;
+    }
+    for (int c = 0; c < 4; c++) {
+        endpoint0[c] = c < channels ? mean[c] + axis[c] * minimum : 255.0f;
+        endpoint1[c] = c < channels ? mean[c] + axis[c] * maximum : 255.0f;
+    }
+}
+
+// Endpoints minimizing the squared error of the block for fixed positions t
+// between them; false when the positions don't determine both
+static bool refineEndpoints(const uint8_t block[16][4], int channels, const float t[16], float endpoint0[4],
+                            float endpoint1[4]) {
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float towards0[4] = {0};
+    float towards1[4] = {0};
+    for (int i = 0; i < 16; i++) {
+        float s = 1.0f - t[i];
+        a += s * s;
+        b += s * t[i];
+        c += t[i] * t[i];
+        for (int k = 0; k < channels; k++) {
+            towards0[k] += s * block[i][k];
+            towards1[k] += t[i] * block[i][k];
+        }
+    }
+
+    float determinant = a * c - b * b;
+    if (fabsf(determinant) < 1e-6f) {
+        return false;
+    }
+    for (int k = 0; k < channels; k++) {
+        float value0 = (c * towards0[k] - b * towards1[k]) / determinant;
+        float value1 = (a * towards1[k] - b * towards0[k]) / determinant;
+        endpoint0[k] = value0 < 0.0f ? 0.0f : value0 > 255.0f ? 255.0f : value0;
+        endpoint1[k] = value1 < 0.0f ? 0.0f : value1 > 255.0f ? 255.0f : value1;
+    }
+    return true;
+}
+
+static inline int quantize(float value, int maximum) {
+    int q = (int)(value * maximum / 255.0f + 0.5f);
+    return q < 0 ? 0 : q > maximum ? maximum : q;
+}
+
+static inline uint16_t pack565(const float color[4]) {
+    return (uint16_t)(quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 | quantize(color[2], 31));
+}
+
+static void unpack565(uint16_t packed, int color[3]) {
+    int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+// Picks the nearest of the four colors for every texel; returns the total squared error
+static uint32_t bc1Indices(const uint8_t block[16][4], uint16_t packed0, uint16_t packed1, uint8_t indices[16]) {
+    int palette[4][3];
+    unpack565(packed0, palette[0]);
+    unpack565(packed1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t total = 0;
+    for (int i = 0; i < 16; i++) {
+        uint32_t best = UINT32_MAX;
+        for (int p = 0; p < 4; p++) {
+            uint32_t error = 0;
+            for (int c = 0; c < 3; c++) {
+                int d = block[i][c] - palette[p][c];
+                error += (uint32_t)(d * d);
+            }
+            if (error < best) {
+                best = error;
+                indices[i] = (uint8_t)p;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+// Four-color BC1 block; BC3 reuses it for its color half
+static void encodeColorBlock(const uint8_t block[16][4], uint8_t* out) {
+    float endpoint0[4], endpoint1[4];
+    fitEndpoints(block, 3, endpoint0, endpoint1);
+
+    uint16_t best0 = pack565(endpoint0);
+    uint16_t best1 = pack565(endpoint1);
+    uint8_t bestIndices[16];
+    uint32_t bestError = bc1Indices(block, best0, best1, bestIndices);
+
+    for (int pass = 0; pass < BC_REFINE_PASSES && bestError > 0; pass++) {
+        float t[16];
+        for (int i = 0; i < 16; i++) {
+            t[i] = bc1Thirds[bestIndices[i]] / 3.0f;
+        }
+        if (!refineEndpoints(block, 3, t, endpoint0, endpoint1)) {
+            break;
+        }
+
+        uint16_t packed0 = pack565(endpoint0);
+        uint16_t packed1 = pack565(endpoint1);
+        uint8_t indices[16];
+        uint32_t error = bc1Indices(block, packed0, packed1, indices);
+        if (error >= bestError) {
+            break;
+        }
+        best0 = packed0;
+        best1 = packed1;
+        bestError = error;
+        memcpy(bestIndices, indices, sizeof(indices));
+    }
+
+    // color0 > color1 selects four colors; swapping exchanges 0 with 1 and 2 with 3
+    if (best0 < best1) {
+        uint16_t swap = best0;
+        best0 = best1;
+        best1 = swap;
+        for (int i = 0; i < 16; i++) {
+            bestIndices[i] ^= 1;
+        }
+    } else if (best0 == best1) {
+        memset(bestIndices, 0, sizeof(bestIndices));
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++) {
+        bits |= (uint32_t)bestIndices[i] << (i * 2);
+    }
+    out[0] = (uint8_t)best0;
+    out[1] = (uint8_t)(best0 >> 8);
+    out[2] = (uint8_t)best1;
+    out[3] = (uint8_t)(best1 >> 8);
+    memcpy(out + 4, &bits, 4);
+}
+
+// Nearest palette entry per texel for a BC4 palette; returns the squared error
+static uint32_t alphaIndices(const uint8_t block[16][4], const int palette[8], uint8_t indices[16]) {
+    uint32_t total = 0;
+    for (int i = 0; i < 16; i++) {
+        uint32_t best = UINT32_MAX;
+        for (int p = 0; p < 8; p++) {
+            int d = block[i][3] - palette[p];
+            if ((uint32_t)(d * d) < best) {
+                best = (uint32_t)(d * d);
+                indices[i] = (uint8_t)p;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+// BC4 alpha block: tries eight interpolated values between the extremes and
+// six between the extremes other than 0 and 255, which the six-value mode
+// stores exactly
+static void encodeAlphaBlock(const uint8_t block[16][4], uint8_t* out) {
+    int low = 255, high = 0;
+    int innerLow = 255, innerHigh = 0;
+    for (int i = 0; i < 16; i++) {
+        int alpha = block[i][3];
+        low = alpha < low ? alpha : low;
+        high = alpha > high ? alpha : high;
+        if (alpha != 0 && alpha != 255) {
+            innerLow = alpha < innerLow ? alpha : innerLow;
+            innerHigh = alpha > innerHigh ? alpha : innerHigh;
+        }
+    }
+    if (innerLow > innerHigh) {
+        innerLow = innerHigh = 0;
+    }
+
+    // alpha0 > alpha1 selects eight values
+    int eight[8] = {high, low};
+    for (int i = 2; i < 8; i++) {
+        eight[i] = ((8 - i) * high + (i - 1) * low) / 7;
+    }
+    int six[8] = {innerLow, innerHigh};
+    for (int i = 2; i < 6; i++) {
+        six[i] = ((6 - i) * innerLow + (i - 1) * innerHigh) / 5;
+    }
+    six[6] = 0;
+    six[7] = 255;
+
+    uint8_t indices[16];
+    uint8_t sixIndices[16];
+    uint32_t error = alphaIndices(block, eight, indices);
+    uint32_t sixError = high > low ? alphaIndices(block, six, sixIndices) : UINT32_MAX;
+    if (high == low) {
+        // Equal endpoints fall into the six-value mode, where index 0 is alpha0
+        out[0] = out[1] = (uint8_t)high;
+        memset(indices, 0, sizeof(indices));
+    } else if (sixError < error) {
+        out[0] = (uint8_t)innerLow;
+        out[1] = (uint8_t)innerHigh;
+        memcpy(indices, sixIndices, sizeof(indices));
+    } else {
+        out[0] = (uint8_t)high;
+        out[1] = (uint8_t)low;
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; i++) {
+        bits |= (uint64_t)indices[i] << (i * 3);
+    }
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (uint8_t)(bits >> (i * 8));
+    }
+}
+
+// Endpoint of a BC7 mode 6 block: seven bits per channel and a shared low bit
+typedef struct {
+    int value[4];       // 7-bit channels
+    int parity;         // the p-bit
+} Bc7Endpoint;
+
+static Bc7Endpoint quantizeBc7(const float color[4]) {
+    Bc7Endpoint best = {{0}, 0};
+    float bestError = INFINITY;
+    for (int parity = 0; parity < 2; parity++) {
+        Bc7Endpoint candidate = {{0}, parity};
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            int q = (int)((color[c] - parity) / 2.0f + 0.5f);
+            candidate.value[c] = q < 0 ? 0 : q > 127 ? 127 : q;
+            float d = color[c] - (float)(candidate.value[c] << 1 | parity);
+            error += d * d;
+        }
+        if (error < bestError) {
+            bestError = error;
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+static uint32_t bc7Indices(const uint8_t block[16][4], const Bc7Endpoint* endpoint0, const Bc7Endpoint* endpoint1,
+                           uint8_t indices[16]) {
+    int palette[16][4];
+    for (int c = 0; c < 4; c++) {
+        int value0 = endpoint0->value[c] << 1 | endpoint0->parity;
+        int value1 = endpoint1->value[c] << 1 | endpoint1->parity;
+        for (int p = 0; p < 16; p++) {
+            palette[p][c] = ((64 - bc7Weights[p]) * value0 + bc7Weights[p] * value1 + 32) >> 6;
+        }
+    }
+
+    uint32_t total = 0;
+    for (int i = 0; i < 16; i++) {
+        uint32_t best = UINT32_MAX;
+        for (int p = 0; p < 16; p++) {
+            uint32_t error = 0;
+            for (int c = 0; c < 4; c++) {
+                int d = block[i][c] - palette[p][c];
+                error += (uint32_t)(d * d);
+            }
+            if (error < best) {
+                best = error;
+                indices[i] = (uint8_t)p;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+static void putBits(uint8_t* out, uint32_t* position, uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, (*position)++) {
+        out[*position / 8] |= (uint8_t)(((value >> i) & 1) << (*position % 8));
+    }
+}
+
+// BC7 mode 6: one RGBA subset with sixteen interpolation steps, which covers
+// both opaque and translucent texels without partition search
+static void encodeBc7Block(const uint8_t block[16][4], uint8_t* out) {
+    float color0[4], color1[4];
+    fitEndpoints(block, 4, color0, color1);
+
+    Bc7Endpoint best0 = quantizeBc7(color0);
+    Bc7Endpoint best1 = quantizeBc7(color1);
+    uint8_t bestIndices[16];
+    uint32_t bestError = bc7Indices(block, &best0, &best1, bestIndices);
+
+    for (int pass = 0; pass < BC_REFINE_PASSES && bestError > 0; pass++) {
+        float t[16];
+        for (int i = 0; i < 16; i++) {
+            t[i] = bc7Weights[bestIndices[i]] / 64.0f;
+        }
+        if (!refineEndpoints(block, 4, t, color0, color1)) {
+            break;
+        }
+
+        Bc7Endpoint endpoint0 = quantizeBc7(color0);
+        Bc7Endpoint endpoint1 = quantizeBc7(color1);
+        uint8_t indices[16];
+        uint32_t error = bc7Indices(block, &endpoint0, &endpoint1, indices);
+        if (error >= bestError) {
+            break;
+        }
+        best0 = endpoint0;
+        best1 = endpoint1;
+        bestError = error;
+        memcpy(bestIndices, indices, sizeof(indices));
+    }
+
+    // The first texel's index drops its top bit, so it must be below 8; the
+    // weights are symmetric, so swapping the endpoints mirrors every index
+    if (bestIndices[0] >= 8) {
+        Bc7Endpoint swap = best0;
+        best0 = best1;
+        best1 = swap;
+        for (int i = 0; i < 16; i++) {
+            bestIndices[i] = (uint8_t)(15 - bestIndices[i]);
+        }
+    }
+
+    memset(out, 0, 16);
+    uint32_t position = 0;
+    putBits(out, &position, 1u << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        putBits(out, &position, (uint32_t)best0.value[c], 7);
+        putBits(out, &position, (uint32_t)best1.value[c], 7);
+    }
+    putBits(out, &position, (uint32_t)best0.parity, 1);
+    putBits(out, &position, (uint32_t)best1.parity, 1);
+    putBits(out, &position, bestIndices[0], 3);
+    for (int i = 1; i < 16; i++) {
+        putBits(out, &position, bestIndices[i], 4);
+    }
+}
+
+static void encodeLevel(BcFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t* out) {
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+            uint8_t block[16][4];
+            loadBlock(pixels, width, height, blockX, blockY, block);
+            if (format == BC_FORMAT_BC1) {
+                encodeColorBlock(block, out);
+            } else if (format == BC_FORMAT_BC3) {
+                encodeAlphaBlock(block, out);
+                encodeColorBlock(block, out + 8);
+            } else {
+                encodeBc7Block(block, out);
+            }
+            out += bcBlockBytes(format);
+        }
+    }
+}
+
+// sRGB conversions for filtering in linear space
+typedef struct {
+    float toLinear[256];
+    uint8_t toSrgb[BC_LINEAR_STEPS];
+} SrgbTables;
+
+static void buildSrgbTables(SrgbTables* tables) {
+    for (int i = 0; i < 256; i++) {
+        float c = i / 255.0f;
+        tables->toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < BC_LINEAR_STEPS; i++) {
+        float c = i / (float)(BC_LINEAR_STEPS - 1);
+        float srgb = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+        tables->toSrgb[i] = (uint8_t)(srgb * 255.0f + 0.5f);
+    }
+}
+
+// Box-filters the level below: color averaged as linear light, alpha as is
+static uint8_t* halveLevel(const SrgbTables* tables, const uint8_t* pixels, uint32_t width, uint32_t height,
+                           uint32_t halfWidth, uint32_t halfHeight) {
+    uint8_t* half = malloc((size_t)halfWidth * halfHeight * 4);
+    for (uint32_t y = 0; y < halfHeight; y++) {
+        uint32_t rows[2] = {y * 2, y * 2 + 1 < height ? y * 2 + 1 : height - 1};
+        for (uint32_t x = 0; x < halfWidth; x++) {
+            uint32_t columns[2] = {x * 2, x * 2 + 1 < width ? x * 2 + 1 : width - 1};
+            float sum[4] = {0};
+            for (int j = 0; j < 4; j++) {
+                const uint8_t* texel = pixels + ((size_t)rows[j / 2] * width + columns[j % 2]) * 4;
+                for (int c = 0; c < 3; c++) {
+                    sum[c] += tables->toLinear[texel[c]];
+                }
+                sum[3] += texel[3];
+            }
+
+            uint8_t* out = half + ((size_t)y * halfWidth + x) * 4;
+            for (int c = 0; c < 3; c++) {
+                out[c] = tables->toSrgb[(int)(sum[c] * 0.25f * (BC_LINEAR_STEPS - 1) + 0.5f)];
+            }
+            out[3] = (uint8_t)(sum[3] * 0.25f + 0.5f);
+        }
+    }
+    return half;
+}
+
+void bcEncodeImage(const Image* image, BcFormat format, BcImage* encoded) {
+    memset(encoded, 0, sizeof(*encoded));
+    encoded->format = format;
+    encoded->width = image->width;
+    encoded->height = image->height;
+    encoded->mipLevels = bcMipLevels(image->width, image->height);
+    for (uint32_t level = 0; level < encoded->mipLevels; level++) {
+        uint32_t width = image->width >> level ? image->width >> level : 1;
+        uint32_t height = image->height >> level ? image->height >> level : 1;
+        encoded->size += bcLevelSize(format, width, height);
+    }
+    encoded->data = malloc(encoded->size);
+
+    SrgbTables tables;
+    buildSrgbTables(&tables);
+
+    const uint8_t* pixels = image->pixels;
+    uint32_t width = image->width;
+    uint32_t height = image->height;
+    uint8_t* out = encoded->data;
+    for (uint32_t level = 0; level < encoded->mipLevels; level++) {
+        if (level > 0) {
+            uint32_t halfWidth = width > 1 ? width / 2 : 1;
+            uint32_t halfHeight = height > 1 ? height / 2 : 1;
+            uint8_t* half = halveLevel(&tables, pixels, width, height, halfWidth, halfHeight);
+            if (pixels != image->pixels) {
+                free((void*)pixels);
+            }
+            pixels = half;
+            width = halfWidth;
+            height = halfHeight;
+        }
+        encodeLevel(format, pixels, width, height, out);
+        out += bcLevelSize(format, width, height);
+    }
+    if (pixels != image->pixels) {
+        free((void*)pixels);
+    }
+}
+
+void bcImageFree(BcImage* encoded) {
+    free(encoded->data);
+    memset(encoded, 0, sizeof(*encoded));
+}
@@ -0,0 +1,43 @@
+#ifndef SCOP_BC_ENCODER_H
+#define SCOP_BC_ENCODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "image_loader.h"
+
+typedef enum {
+    BC_FORMAT_BC1,      // RGB, 8 bytes per 4x4 block
+    BC_FORMAT_BC3,      // BC1 color plus BC4 alpha, 16 bytes per block
+    BC_FORMAT_BC7,      // RGBA in mode 6 only, 16 bytes per block
+    BC_FORMAT_COUNT
+} BcFormat;
+
+// Full mip chain of block-compressed sRGB texels, level 0 first, the levels
+// packed back to back
+typedef struct {
+    BcFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint8_t* data;
+    size_t size;
+} BcImage;
+
+uint32_t bcBlockBytes(BcFormat format);
+
+// Bytes of one level of the given size; edges round up to whole blocks
+size_t bcLevelSize(BcFormat format, uint32_t width, uint32_t height);
+
+// Levels of a full chain down to 1x1
+uint32_t bcMipLevels(uint32_t width, uint32_t height);
+
+// BC3 when any texel is translucent, BC1 otherwise
+BcFormat bcChooseFormat(const Image* image);
+
+// Builds the mip chain of an sRGB image, filtering in linear space, and
+// encodes every level. Slow on large images: meant for worker threads.
+void bcEncodeImage(const Image* image, BcFormat format, BcImage* encoded);
+void bcImageFree(BcImage* encoded);
+
+#endif
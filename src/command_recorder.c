@@ -0,0 +1,135 @@
+#include "command_recorder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void commandRecorderInit(CommandRecorder* recorder, VkDevice device, uint32_t queueFamily, JobSystem* jobs,
+                         uint32_t frameCount) {
+    memset(recorder, 0, sizeof(*recorder));
+    recorder->device = device;
+    recorder->jobs = jobs;
+    recorder->threadCount = jobs->threadCount + 1;
+    recorder->frameCount = frameCount;
+    recorder->pools = calloc((size_t)frameCount * recorder->threadCount, sizeof(RecorderThreadPool));
+    recorder->recordJobs = calloc(recorder->threadCount, sizeof(RecordJob));
+    recorder->recorded = calloc(recorder->threadCount, sizeof(VkCommandBuffer));
+
+    // Transient: buffers are re-recorded every frame and reset with their pool
+    VkCommandPoolCreateInfo poolInfo = {0};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+
+    for (uint32_t i = 0; i < frameCount * recorder->threadCount; i++) {
+        if (vkCreateCommandPool(device, &poolInfo, NULL, &recorder->pools[i].pool) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create command pool!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void commandRecorderShutdown(CommandRecorder* recorder) {
+    for (uint32_t i = 0; i < recorder->frameCount * recorder->threadCount; i++) {
+        vkDestroyCommandPool(recorder->device, recorder->pools[i].pool, NULL);
+        free(recorder->pools[i].buffers);
+    }
+    free(recorder->pools);
+    free(recorder->recordJobs);
+    free(recorder->recorded);
+    memset(recorder, 0, sizeof(*recorder));
+}
+
+void commandRecorderBeginFrame(CommandRecorder* recorder, uint32_t frame) {
+    recorder->frame = frame;
+    for (uint32_t i = 0; i < recorder->threadCount; i++) {
+        RecorderThreadPool* threadPool = &recorder->pools[frame * recorder->threadCount + i];
+        if (threadPool->used > 0) {
+            vkResetCommandPool(recorder->device, threadPool->pool, 0);
+            threadPool->used = 0;
+        }
+    }
+}
+
+// Hands out the next secondary buffer of the calling thread's pool
+static VkCommandBuffer acquireBuffer(CommandRecorder* recorder, uint32_t threadIndex) {
+    RecorderThreadPool* threadPool = &recorder->pools[recorder->frame * recorder->threadCount + threadIndex];
+
+    if (threadPool->used == threadPool->capacity) {
+        uint32_t newCapacity = threadPool->capacity ? threadPool->capacity * 2 : 2;
+        threadPool->buffers = realloc(threadPool->buffers, newCapacity * sizeof(VkCommandBuffer));
+
+        VkCommandBufferAllocateInfo allocInfo = {0};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = threadPool->pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = newCapacity - threadPool->capacity;
+
+        if (vkAllocateCommandBuffers(recorder->device, &allocInfo, threadPool->buffers + threadPool->capacity) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to allocate secondary command buffers!\n");
+            exit(EXIT_FAILURE);
+        }
+        threadPool->capacity = newCapacity;
+    }
+
+    return threadPool->buffers[threadPool->used++];
+}
+
+static void recordJob(void* data, uint32_t threadIndex) {
+    RecordJob* job = data;
+    job->commandBuffer = acquireBuffer(job->recorder, threadIndex);
+
+    VkCommandBufferBeginInfo beginInfo = {0};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = job->inheritance;
+
+    if (vkBeginCommandBuffer(job->commandBuffer, &beginInfo) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to begin recording secondary command buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    job->function(job->commandBuffer, job->first, job->count, job->data);
+
+    if (vkEndCommandBuffer(job->commandBuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to record secondary command buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+uint32_t commandRecorderRecord(CommandRecorder* recorder, const VkCommandBufferInheritanceInfo* inheritance,
+                               uint32_t itemCount, uint32_t maxJobs, RecordFunction function, void* data,
+                               const VkCommandBuffer** commandBuffers) {
+    uint32_t jobCount = (itemCount + COMMAND_RECORDER_MIN_ITEMS_PER_JOB - 1) / COMMAND_RECORDER_MIN_ITEMS_PER_JOB;
+    uint32_t jobLimit = maxJobs > 0 && maxJobs < recorder->threadCount ? maxJobs : recorder->threadCount;
+    jobCount = jobCount < jobLimit ? jobCount : jobLimit;
+    jobCount = jobCount > 0 ? jobCount : 1;
+
+    // Even split; the first itemCount % jobCount jobs take one extra item
+    JobCounter counter = {0};
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < jobCount; i++) {
+        RecordJob* job = &recorder->recordJobs[i];
+        job->recorder = recorder;
+        job->function = function;
+        job->data = data;
+        job->inheritance = inheritance;
+        job->first = first;
+        job->count = itemCount / jobCount + (i < itemCount % jobCount ? 1 : 0);
+        job->commandBuffer = VK_NULL_HANDLE;
+        first += job->count;
+
+        // The last chunk is recorded here while the workers handle the rest
+        if (i + 1 < jobCount) {
+            jobSystemSubmit(recorder->jobs, recordJob, job, &counter);
+        }
+    }
+    recordJob(&recorder->recordJobs[jobCount - 1], recorder->jobs->threadCount);
+    jobSystemWait(recorder->jobs, &counter);
+
+    for (uint32_t i = 0; i < jobCount; i++) {
+        recorder->recorded[i] = recorder->recordJobs[i].commandBuffer;
+    }
+    *commandBuffers = recorder->recorded;
+    return jobCount;
+}
@@ -0,0 +1,66 @@
+#ifndef SCOP_COMMAND_RECORDER_H
+#define SCOP_COMMAND_RECORDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <vulkan/vulkan.h>
+
+#include "job_system.h"
+
+// Frames the recorder keeps pools for
+#define COMMAND_RECORDER_MAX_FRAMES 4
+
+// Fewer items than this per job costs more in scheduling than it saves
+#define COMMAND_RECORDER_MIN_ITEMS_PER_JOB 64
+
+// Records items [first, first + count) into a secondary command buffer that
+// is already begun inside the render pass
+typedef void (*RecordFunction)(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, void* data);
+
+// Secondary command buffers of one thread in one frame
+typedef struct {
+    VkCommandPool pool;
+    VkCommandBuffer* buffers;
+    uint32_t used;
+    uint32_t capacity;
+} RecorderThreadPool;
+
+typedef struct {
+    struct CommandRecorder* recorder;
+    RecordFunction function;
+    void* data;
+    const VkCommandBufferInheritanceInfo* inheritance;
+    uint32_t first;
+    uint32_t count;
+    VkCommandBuffer commandBuffer;      // output
+} RecordJob;
+
+// Splits draw recording across the job system. Every thread has its own
+// command pool per frame, so workers never share a pool and a frame's pools
+// are reset in one call once its frame has finished.
+typedef struct CommandRecorder {
+    VkDevice device;
+    JobSystem* jobs;
+    uint32_t threadCount;               // workers plus the waiting thread
+    uint32_t frameCount;
+    RecorderThreadPool* pools;          // [frame * threadCount + thread]
+    uint32_t frame;
+    RecordJob* recordJobs;              // one per thread
+    VkCommandBuffer* recorded;          // secondaries of the last commandRecorderRecord
+} CommandRecorder;
+
+void commandRecorderInit(CommandRecorder* recorder, VkDevice device, uint32_t queueFamily, JobSystem* jobs,
+                         uint32_t frameCount);
+void commandRecorderShutdown(CommandRecorder* recorder);
+
+// Resets every pool of the frame; its previous submission must be complete
+void commandRecorderBeginFrame(CommandRecorder* recorder, uint32_t frame);
+
+// Records itemCount items on up to maxJobs jobs (0 = one per thread) and
+// points commandBuffers at the secondaries, in item order. Returns their
+// count, at most the thread count; they stay valid until the next call.
+uint32_t commandRecorderRecord(CommandRecorder* recorder, const VkCommandBufferInheritanceInfo* inheritance,
+                               uint32_t itemCount, uint32_t maxJobs, RecordFunction function, void* data,
+                               const VkCommandBuffer** commandBuffers);
+
+#endif
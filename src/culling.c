@@ -0,0 +1,289 @@
+#include "culling.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mat4.h"
+
+const char* cullingModeName(CullingMode mode) {
+    static const char* names[] = {
+        "GPU, draw indirect count", "GPU, fixed-count draw indirect", "CPU"
+    };
+    return names[mode];
+}
+
+static bool createComputePipeline(CullingContext* culling, VkPipelineCache cache, VkShaderModule shader,
+                                  VkPipeline* pipeline) {
+    VkComputePipelineCreateInfo pipelineInfo = {0};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = culling->pipelineLayout;
+    pipelineInfo.basePipelineIndex = -1;
+
+    return vkCreateComputePipelines(culling->device, cache, 1, &pipelineInfo, NULL, pipeline) == VK_SUCCESS;
+}
+
+static void createPipeline(CullingContext* culling, VkPipelineCache cache, VkShaderModule shader) {
+    // Objects, clusters, levels of detail and this frame's model matrices in,
+    // draw commands and their counts out
+    VkDescriptorSetLayoutBinding bindings[6] = {{0}};
+    for (uint32_t i = 0; i < 6; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i == 5 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+                                            : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {0};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = 6;
+    setLayoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(culling->device, &setLayoutInfo, NULL, &culling->setLayout) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create culling descriptor set layout!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkPushConstantRange pushConstantRange = {0};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullingConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &culling->setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(culling->device, &pipelineLayoutInfo, NULL, &culling->pipelineLayout) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create culling pipeline layout!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!createComputePipeline(culling, cache, shader, &culling->pipeline)) {
+        fprintf(stderr, "Failed to create culling pipeline!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void createFrames(CullingContext* culling, VkBuffer objectBuffer, VkBuffer transformBuffer,
+                         VkBuffer clusterBuffer) {
+    VkDescriptorPoolSize poolSizes[2] = {{0}};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = 5 * culling->frameCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[1].descriptorCount = culling->frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {0};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = culling->frameCount;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+
+    if (vkCreateDescriptorPool(culling->device, &poolInfo, NULL, &culling->descriptorPool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create culling descriptor pool!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkDeviceSize drawSize = (VkDeviceSize)culling->objectCount * culling->clusterCount *
+                            sizeof(VkDrawIndexedIndirectCommand);
+    for (uint32_t i = 0; i < culling->frameCount; i++) {
+        CullingFrame* frame = &culling->frames[i];
+        gpuCreateBuffer(culling->allocator, drawSize,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->drawBuffer, &frame->drawAllocation);
+        gpuCreateBuffer(culling->allocator, sizeof(CullingStats),
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->countBuffer, &frame->countAllocation);
+
+        VkDescriptorSetAllocateInfo allocInfo = {0};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = culling->descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &culling->setLayout;
+
+        if (vkAllocateDescriptorSets(culling->device, &allocInfo, &frame->descriptorSet) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to allocate culling descriptor set!\n");
+            exit(EXIT_FAILURE);
+        }
+
+        VkDescriptorBufferInfo bufferInfos[6] = {{0}};
+        bufferInfos[0].buffer = objectBuffer;
+        bufferInfos[0].range = VK_WHOLE_SIZE;
+        bufferInfos[1].buffer = clusterBuffer;
+        bufferInfos[1].range = VK_WHOLE_SIZE;
+        bufferInfos[2].buffer = frame->drawBuffer;
+        bufferInfos[2].range = VK_WHOLE_SIZE;
+        bufferInfos[3].buffer = frame->countBuffer;
+        bufferInfos[3].range = VK_WHOLE_SIZE;
+        bufferInfos[4].buffer = culling->lodBuffer;
+        bufferInfos[4].range = VK_WHOLE_SIZE;
+        bufferInfos[5].buffer = transformBuffer;
+        bufferInfos[5].range = (VkDeviceSize)culling->objectCount * sizeof(Mat4);
+
+        VkWriteDescriptorSet writes[6] = {{0}};
+        for (uint32_t binding = 0; binding < 6; binding++) {
+            writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[binding].dstSet = frame->descriptorSet;
+            writes[binding].dstBinding = binding;
+            writes[binding].descriptorCount = 1;
+            writes[binding].descriptorType = binding == 5 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+                                                          : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[binding].pBufferInfo = &bufferInfos[binding];
+        }
+        vkUpdateDescriptorSets(culling->device, 6, writes, 0, NULL);
+    }
+
+    gpuCreateBuffer(culling->allocator, culling->frameCount * sizeof(CullingStats), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    &culling->readbackBuffer, &culling->readbackAllocation);
+    memset(culling->readbackAllocation.mapped, 0, culling->frameCount * sizeof(CullingStats));
+}
+
+void cullingInit(CullingContext* culling, GpuAllocator* allocator, VkDevice device, VkPipelineCache cache,
+                 VkShaderModule shader, CullingMode mode, VkBuffer objectBuffer, uint32_t objectCount,
+                 VkBuffer transformBuffer, VkBuffer clusterBuffer, uint32_t clusterCount, const CullingLod* lods,
+                 uint32_t lodCount, uint32_t frameCount) {
+    memset(culling, 0, sizeof(*culling));
+    culling->device = device;
+    culling->allocator = allocator;
+    culling->mode = mode;
+    culling->objectCount = objectCount;
+    culling->clusterCount = clusterCount;
+    culling->frameCount = frameCount < CULLING_MAX_FRAMES ? frameCount : CULLING_MAX_FRAMES;
+
+    if (mode == CULLING_MODE_CPU) {
+        return;
+    }
+    if ((uint64_t)objectCount * clusterCount > CULLING_MAX_DRAWS) {
+        fprintf(stderr, "Failed to fit %u objects of %u clusters into the culling draw buffers!\n", objectCount,
+                clusterCount);
+        exit(EXIT_FAILURE);
+    }
+
+    if (mode == CULLING_MODE_INDIRECT_COUNT) {
+        culling->drawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+            device, "vkCmdDrawIndexedIndirectCountKHR");
+        if (!culling->drawIndexedIndirectCount) {
+            fprintf(stderr, "Failed to load vkCmdDrawIndexedIndirectCountKHR!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // A handful of levels, written once; host memory is fine
+    gpuCreateBuffer(allocator, lodCount * sizeof(CullingLod), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    &culling->lodBuffer, &culling->lodAllocation);
+    memcpy(culling->lodAllocation.mapped, lods, lodCount * sizeof(CullingLod));
+
+    createPipeline(culling, cache, shader);
+    createFrames(culling, objectBuffer, transformBuffer, clusterBuffer);
+}
+
+void cullingShutdown(CullingContext* culling) {
+    if (culling->mode != CULLING_MODE_CPU) {
+        for (uint32_t i = 0; i < culling->frameCount; i++) {
+            gpuDestroyBuffer(culling->allocator, culling->frames[i].drawBuffer, &culling->frames[i].drawAllocation);
+            gpuDestroyBuffer(culling->allocator, culling->frames[i].countBuffer, &culling->frames[i].countAllocation);
+        }
+        gpuDestroyBuffer(culling->allocator, culling->readbackBuffer, &culling->readbackAllocation);
+        gpuDestroyBuffer(culling->allocator, culling->lodBuffer, &culling->lodAllocation);
+        vkDestroyDescriptorPool(culling->device, culling->descriptorPool, NULL);
+        vkDestroyPipeline(culling->device, culling->pipeline, NULL);
+        vkDestroyPipelineLayout(culling->device, culling->pipelineLayout, NULL);
+        vkDestroyDescriptorSetLayout(culling->device, culling->setLayout, NULL);
+    }
+    memset(culling, 0, sizeof(*culling));
+}
+
+VkPipeline cullingReplaceShader(CullingContext* culling, VkPipelineCache cache, VkShaderModule shader) {
+    VkPipeline pipeline;
+    if (!createComputePipeline(culling, cache, shader, &pipeline)) {
+        fprintf(stderr, "Failed to create culling pipeline, keeping the running one\n");
+        return VK_NULL_HANDLE;
+    }
+
+    VkPipeline replaced = culling->pipeline;
+    culling->pipeline = pipeline;
+    return replaced;
+}
+
+void cullingRecord(CullingContext* culling, VkCommandBuffer commandBuffer, uint32_t slot,
+                   const CullingConstants* constants, uint32_t transformOffset) {
+    CullingFrame* frame = &culling->frames[slot];
+
+    // The shader appends visible draws after an atomic on the count; a
+    // fixed-count draw also reads the slots behind them, which must be empty
+    vkCmdFillBuffer(commandBuffer, frame->countBuffer, 0, sizeof(CullingStats), 0);
+    if (culling->mode == CULLING_MODE_INDIRECT) {
+        vkCmdFillBuffer(commandBuffer, frame->drawBuffer, 0, VK_WHOLE_SIZE, 0);
+    }
+
+    VkMemoryBarrier clearToCull = {0};
+    clearToCull.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearToCull.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearToCull.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &clearToCull, 0, NULL, 0, NULL);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling->pipelineLayout, 0, 1,
+                            &frame->descriptorSet, 1, &transformOffset);
+    vkCmdPushConstants(commandBuffer, culling->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(*constants), constants);
+    // At most CULLING_MAX_DRAWS / CULLING_WORKGROUP_SIZE workgroups
+    uint32_t clusters = culling->objectCount * culling->clusterCount;
+    vkCmdDispatch(commandBuffer, (clusters + CULLING_WORKGROUP_SIZE - 1) / CULLING_WORKGROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier cullToDraw = {0};
+    cullToDraw.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullToDraw.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullToDraw.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         1, &cullToDraw, 0, NULL, 0, NULL);
+
+    // Keep the counts for the frame report
+    VkBufferCopy region = {0};
+    region.dstOffset = slot * sizeof(CullingStats);
+    region.size = sizeof(CullingStats);
+    vkCmdCopyBuffer(commandBuffer, frame->countBuffer, culling->readbackBuffer, 1, &region);
+
+    VkMemoryBarrier copyToHost = {0};
+    copyToHost.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    copyToHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    copyToHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         1, &copyToHost, 0, NULL, 0, NULL);
+}
+
+void cullingDraw(CullingContext* culling, VkCommandBuffer commandBuffer, uint32_t slot) {
+    CullingFrame* frame = &culling->frames[slot];
+    if (culling->mode == CULLING_MODE_INDIRECT_COUNT) {
+        culling->drawIndexedIndirectCount(commandBuffer, frame->drawBuffer, 0, frame->countBuffer,
+                                          offsetof(CullingStats, drawCount),
+                                          culling->objectCount * culling->clusterCount,
+                                          sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+        vkCmdDrawIndexedIndirect(commandBuffer, frame->drawBuffer, 0, culling->objectCount * culling->clusterCount,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+CullingStats cullingGetStats(const CullingContext* culling, uint32_t slot) {
+    CullingStats stats = {0};
+    const CullingStats* readback = culling->readbackAllocation.mapped;
+    if (readback) {
+        stats = readback[slot];
+    }
+    return stats;
+}
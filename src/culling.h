@@ -0,0 +1,124 @@
+#ifndef SCOP_CULLING_H
+#define SCOP_CULLING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <vulkan/vulkan.h>
+
+#include "gpu_allocator.h"
+
+// Frame slots the culling context keeps draw buffers for
+#define CULLING_MAX_FRAMES 4
+
+// local_size_x of shaders/cull.comp
+#define CULLING_WORKGROUP_SIZE 64
+
+// Most clusters (objects times clusters per object) culled per frame; the
+// draw buffers hold one command per cluster. Also keeps the one-dimensional
+// dispatch within the 65535 workgroups maxComputeWorkGroupCount[0] always
+// allows; scenes past it are culled on the CPU.
+#define CULLING_MAX_DRAWS (1u << 21)
+
+// How culled draws reach the GPU, best first
+typedef enum {
+    CULLING_MODE_INDIRECT_COUNT,    // compacted draws, vkCmdDrawIndexedIndirectCountKHR
+    CULLING_MODE_INDIRECT,          // compacted draws behind empty ones, fixed-count vkCmdDrawIndexedIndirect
+    CULLING_MODE_CPU                // clusters tested and draws recorded on the CPU
+} CullingMode;
+
+// Push constants of shaders/cull.comp
+typedef struct {
+    float planes[6][4];         // frustum planes, normalized with normals pointing inside
+    float viewDirection[4];     // xyz = unit vector towards the viewer, w = 1 enables cone culling
+    uint32_t objectCount;
+    uint32_t clusterCount;      // clusters per object of the level with the most
+    float lodScale;             // level errors times object scale times this must stay within 1
+    uint32_t lodCount;          // levels to choose from, 1 draws full detail
+} CullingConstants;
+
+// One level of detail's run of clusters, laid out as the std430 LodLevel of
+// shaders/cull.comp
+typedef struct {
+    uint32_t firstCluster;
+    uint32_t clusterCount;
+    float error;                // model units the level may be off by
+    uint32_t padding;
+} CullingLod;
+
+// Written by the culling pass, read back per frame slot
+typedef struct {
+    uint32_t drawCount;         // clusters that survived
+    uint32_t triangleCount;     // triangles they hold
+} CullingStats;
+
+typedef struct {
+    VkBuffer drawBuffer;            // one VkDrawIndexedIndirectCommand per cluster
+    GpuAllocation drawAllocation;
+    VkBuffer countBuffer;           // CullingStats of the last dispatch
+    GpuAllocation countAllocation;
+    VkDescriptorSet descriptorSet;
+} CullingFrame;
+
+// Culls every cluster of every object in a compute pass, against the view
+// frustum and, through its normal cone, as back-facing, then draws the
+// survivors with a single indirect call, so recording costs the same for
+// any number of objects or clusters. Every object first picks its level of
+// detail, whose clusters are a run of the cluster buffer; a whole level is
+// one cluster when it isn't split into meshlets. Every frame slot has its own draw and count
+// buffers; the counts are copied to host memory and read back without
+// waiting once the slot's frame has finished.
+typedef struct {
+    VkDevice device;
+    GpuAllocator* allocator;
+    CullingMode mode;
+    PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount;
+    uint32_t objectCount;
+    uint32_t clusterCount;
+    uint32_t frameCount;
+
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+    VkDescriptorPool descriptorPool;
+    CullingFrame frames[CULLING_MAX_FRAMES];
+
+    VkBuffer lodBuffer;             // CullingLod of every level
+    GpuAllocation lodAllocation;
+    VkBuffer readbackBuffer;        // CullingStats of every frame slot
+    GpuAllocation readbackAllocation;
+} CullingContext;
+
+// Creates the compute pipeline from shader and the per-slot buffers reading
+// objectBuffer, transformBuffer and clusterBuffer (the SceneObject, model
+// matrix and Cluster arrays of shaders/cull.comp); clusterCount is the most
+// clusters an object draws at any level. The model matrices are found at a dynamic offset
+// into transformBuffer given to every cullingRecord. Does nothing beyond
+// recording the mode for CULLING_MODE_CPU.
+void cullingInit(CullingContext* culling, GpuAllocator* allocator, VkDevice device, VkPipelineCache cache,
+                 VkShaderModule shader, CullingMode mode, VkBuffer objectBuffer, uint32_t objectCount,
+                 VkBuffer transformBuffer, VkBuffer clusterBuffer, uint32_t clusterCount, const CullingLod* lods,
+                 uint32_t lodCount, uint32_t frameCount);
+void cullingShutdown(CullingContext* culling);
+
+// Swaps in a compute pipeline built from a new shader and returns the one it
+// replaced, which frames already submitted may still be using; returns
+// VK_NULL_HANDLE and keeps the running pipeline when creation fails. GPU
+// culling modes only.
+VkPipeline cullingReplaceShader(CullingContext* culling, VkPipelineCache cache, VkShaderModule shader);
+
+// Records the culling pass of the slot with the model matrices at
+// transformOffset; must be outside a render pass and after the object buffer
+// is owned by the graphics queue
+void cullingRecord(CullingContext* culling, VkCommandBuffer commandBuffer, uint32_t slot,
+                   const CullingConstants* constants, uint32_t transformOffset);
+
+// Records the indirect draw of the slot's visible clusters; the pipeline,
+// descriptor sets and mesh buffers must already be bound
+void cullingDraw(CullingContext* culling, VkCommandBuffer commandBuffer, uint32_t slot);
+
+// Counts of the last culling pass of the slot, whose frame must be complete
+CullingStats cullingGetStats(const CullingContext* culling, uint32_t slot);
+
+const char* cullingModeName(CullingMode mode);
+
+#endif
@@ -0,0 +1,203 @@
+#include "frame_scheduler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+// Waits for every submitted value in turn and timestamps it
+static void* completionThread(void* data) {
+    FrameScheduler* scheduler = data;
+
+    pthread_mutex_lock(&scheduler->mutex);
+    while (true) {
+        while (!scheduler->stopping && scheduler->completed == scheduler->submitted) {
+            pthread_cond_wait(&scheduler->submittedChanged, &scheduler->mutex);
+        }
+        if (scheduler->completed == scheduler->submitted) {
+            break;
+        }
+        uint64_t value = scheduler->completed + 1;
+        pthread_mutex_unlock(&scheduler->mutex);
+
+        // Only values already submitted are waited for, so this returns
+        VkSemaphoreWaitInfo waitInfo = {0};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &scheduler->timeline;
+        waitInfo.pValues = &value;
+        vkWaitSemaphores(scheduler->device, &waitInfo, UINT64_MAX);
+        double now = getTimeMs();
+
+        pthread_mutex_lock(&scheduler->mutex);
+        scheduler->valueCompletedMs[value % FRAME_SCHEDULER_MAX_FRAMES] = now;
+        scheduler->completed = value;
+        pthread_cond_broadcast(&scheduler->completedChanged);
+    }
+    pthread_mutex_unlock(&scheduler->mutex);
+    return NULL;
+}
+
+void frameSchedulerInit(FrameScheduler* scheduler, VkDevice device, uint32_t framesInFlight, FramePacing pacing) {
+    memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->device = device;
+    scheduler->pacing = pacing;
+    scheduler->framesInFlight = framesInFlight < 1 ? 1
+                              : framesInFlight > FRAME_SCHEDULER_MAX_FRAMES ? FRAME_SCHEDULER_MAX_FRAMES
+                              : framesInFlight;
+
+    VkSemaphoreTypeCreateInfo typeInfo = {0};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo timelineInfo = {0};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timelineInfo.pNext = &typeInfo;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {0};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    if (vkCreateSemaphore(device, &timelineInfo, NULL, &scheduler->timeline) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create frame timeline semaphore!\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < scheduler->framesInFlight; i++) {
+        if (vkCreateSemaphore(device, &semaphoreInfo, NULL, &scheduler->imageAvailable[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, NULL, &scheduler->renderFinished[i]) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create synchronization objects for a frame!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pthread_mutex_init(&scheduler->mutex, NULL);
+    pthread_cond_init(&scheduler->submittedChanged, NULL);
+    pthread_cond_init(&scheduler->completedChanged, NULL);
+    if (pthread_create(&scheduler->thread, NULL, completionThread, scheduler) != 0) {
+        fprintf(stderr, "Failed to start frame completion thread!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void frameSchedulerShutdown(FrameScheduler* scheduler) {
+    pthread_mutex_lock(&scheduler->mutex);
+    scheduler->stopping = true;
+    pthread_cond_signal(&scheduler->submittedChanged);
+    pthread_mutex_unlock(&scheduler->mutex);
+    pthread_join(scheduler->thread, NULL);
+
+    pthread_cond_destroy(&scheduler->completedChanged);
+    pthread_cond_destroy(&scheduler->submittedChanged);
+    pthread_mutex_destroy(&scheduler->mutex);
+
+    for (uint32_t i = 0; i < scheduler->framesInFlight; i++) {
+        vkDestroySemaphore(scheduler->device, scheduler->imageAvailable[i], NULL);
+        vkDestroySemaphore(scheduler->device, scheduler->renderFinished[i], NULL);
+    }
+    vkDestroySemaphore(scheduler->device, scheduler->timeline, NULL);
+}
+
+uint32_t frameSchedulerAcquire(FrameScheduler* scheduler) {
+    if (scheduler->acquired) {
+        return scheduler->slot;
+    }
+
+    frameSchedulerWaitValue(scheduler, scheduler->slotValues[scheduler->slot]);
+    scheduler->acquired = true;
+    return scheduler->slot;
+}
+
+uint64_t frameSchedulerLastSubmitted(const FrameScheduler* scheduler) {
+    // Only the render loop submits, so reading without the lock is fine
+    return scheduler->submitted;
+}
+
+uint64_t frameSchedulerCompletedValue(const FrameScheduler* scheduler) {
+    uint64_t value = 0;
+    if (vkGetSemaphoreCounterValue(scheduler->device, scheduler->timeline, &value) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to read the frame timeline!\n");
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+void frameSchedulerWaitValue(FrameScheduler* scheduler, uint64_t value) {
+    if (value == 0) {
+        return;
+    }
+
+    double start = getTimeMs();
+    VkSemaphoreWaitInfo waitInfo = {0};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &scheduler->timeline;
+    waitInfo.pValues = &value;
+    if (vkWaitSemaphores(scheduler->device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to wait for a frame slot!\n");
+        exit(EXIT_FAILURE);
+    }
+    scheduler->waitMs += getTimeMs() - start;
+}
+
+void frameSchedulerSetLimit(FrameScheduler* scheduler, double framesPerSecond) {
+    scheduler->limitIntervalMs = framesPerSecond > 0.0 ? 1000.0 / framesPerSecond : 0.0;
+    scheduler->nextFrameMs = 0.0;
+}
+
+void frameSchedulerThrottle(FrameScheduler* scheduler) {
+    if (scheduler->limitIntervalMs <= 0.0) {
+        return;
+    }
+
+    // Frames start on a fixed cadence; one that is a whole period late
+    // restarts it instead of letting a burst of frames catch up
+    double now = getTimeMs();
+    if (scheduler->nextFrameMs == 0.0 || now - scheduler->nextFrameMs > scheduler->limitIntervalMs) {
+        scheduler->nextFrameMs = now;
+    }
+    sleepUntilMs(scheduler->nextFrameMs);
+    scheduler->nextFrameMs += scheduler->limitIntervalMs;
+}
+
+void frameSchedulerSampleInput(FrameScheduler* scheduler) {
+    scheduler->inputMs = getTimeMs();
+}
+
+uint64_t frameSchedulerSignalValue(const FrameScheduler* scheduler) {
+    return scheduler->submitted + 1;
+}
+
+void frameSchedulerSubmitted(FrameScheduler* scheduler) {
+    pthread_mutex_lock(&scheduler->mutex);
+    uint64_t value = scheduler->submitted + 1;
+    scheduler->valueInputMs[value % FRAME_SCHEDULER_MAX_FRAMES] = scheduler->inputMs;
+    scheduler->submitted = value;
+    pthread_cond_signal(&scheduler->submittedChanged);
+    pthread_mutex_unlock(&scheduler->mutex);
+
+    scheduler->slotValues[scheduler->slot] = value;
+    scheduler->slot = (scheduler->slot + 1) % scheduler->framesInFlight;
+    scheduler->acquired = false;
+}
+
+FrameTiming frameSchedulerTiming(FrameScheduler* scheduler, uint32_t slot) {
+    FrameTiming timing = {0};
+    uint64_t value = scheduler->slotValues[slot];
+    if (value == 0) {
+        return timing;
+    }
+
+    pthread_mutex_lock(&scheduler->mutex);
+    while (scheduler->completed < value) {
+        pthread_cond_wait(&scheduler->completedChanged, &scheduler->mutex);
+    }
+    timing.inputMs = scheduler->valueInputMs[value % FRAME_SCHEDULER_MAX_FRAMES];
+    timing.completedMs = scheduler->valueCompletedMs[value % FRAME_SCHEDULER_MAX_FRAMES];
+    pthread_mutex_unlock(&scheduler->mutex);
+    return timing;
+}
+
+const char* framePacingName(FramePacing pacing) {
+    return pacing == FRAME_PACING_LATENCY ? "latency" : "throughput";
+}
@@ -0,0 +1,102 @@
+#ifndef SCOP_FRAME_SCHEDULER_H
+#define SCOP_FRAME_SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <vulkan/vulkan.h>
+
+// Deepest frame queue the scheduler supports; per-slot arrays elsewhere are
+// sized for it too
+#define FRAME_SCHEDULER_MAX_FRAMES 4
+
+// Where the wait for a free frame slot happens relative to input sampling
+typedef enum {
+    FRAME_PACING_THROUGHPUT,    // sample input, then wait: the GPU queue stays full
+    FRAME_PACING_LATENCY        // wait, then sample input: input is as fresh as the queue allows
+} FramePacing;
+
+// When the frame last submitted from a slot sampled input and when the GPU
+// finished it, in getTimeMs time
+typedef struct {
+    double inputMs;
+    double completedMs;
+} FrameTiming;
+
+// Paces frames on one timeline semaphore: submit N signals value N, and a
+// slot is free again once the value of its last submit is reached. The
+// binary semaphores the swapchain needs stay per slot. A completion thread
+// timestamps every value as it is reached, so the time from input to GPU
+// completion is measured without the render loop ever waiting for it.
+typedef struct {
+    VkDevice device;
+    VkSemaphore timeline;
+    VkSemaphore imageAvailable[FRAME_SCHEDULER_MAX_FRAMES];    // signalled by vkAcquireNextImageKHR
+    VkSemaphore renderFinished[FRAME_SCHEDULER_MAX_FRAMES];    // waited on by vkQueuePresentKHR
+    FramePacing pacing;
+    uint32_t framesInFlight;
+    uint32_t slot;              // slot of the frame being prepared
+    bool acquired;              // the slot was waited for and not submitted yet
+    uint64_t slotValues[FRAME_SCHEDULER_MAX_FRAMES];   // value of each slot's last submit, 0 = none
+    double inputMs;             // input sample of the frame being prepared
+    double waitMs;              // total time blocked on the timeline
+    double limitIntervalMs;     // frame limiter period, 0 = uncapped
+    double nextFrameMs;         // when the limiter lets the next frame start
+
+    // Shared with the completion thread; inputMs and completedMs are indexed
+    // by value % FRAME_SCHEDULER_MAX_FRAMES
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t submittedChanged;
+    pthread_cond_t completedChanged;
+    uint64_t submitted;
+    uint64_t completed;
+    double valueInputMs[FRAME_SCHEDULER_MAX_FRAMES];
+    double valueCompletedMs[FRAME_SCHEDULER_MAX_FRAMES];
+    bool stopping;
+} FrameScheduler;
+
+// framesInFlight is clamped to [1, FRAME_SCHEDULER_MAX_FRAMES]
+void frameSchedulerInit(FrameScheduler* scheduler, VkDevice device, uint32_t framesInFlight, FramePacing pacing);
+
+// The device must be idle
+void frameSchedulerShutdown(FrameScheduler* scheduler);
+
+// Caps the frame rate for frameSchedulerThrottle; 0 removes the cap
+void frameSchedulerSetLimit(FrameScheduler* scheduler, double framesPerSecond);
+
+// Sleeps until the limiter lets the next frame start, before input is
+// sampled so the wait doesn't age it. Returns at once when uncapped.
+void frameSchedulerThrottle(FrameScheduler* scheduler);
+
+// Blocks until the next slot's last frame is finished and returns the slot.
+// Calling it again before the submit returns the same slot without waiting.
+uint32_t frameSchedulerAcquire(FrameScheduler* scheduler);
+
+// Records the moment input is sampled for the frame being prepared
+void frameSchedulerSampleInput(FrameScheduler* scheduler);
+
+// Timeline value of the newest submit; whatever the frames so far used is
+// free once it is reached
+uint64_t frameSchedulerLastSubmitted(const FrameScheduler* scheduler);
+
+// Newest value the GPU has reached, without blocking
+uint64_t frameSchedulerCompletedValue(const FrameScheduler* scheduler);
+
+// Blocks until the GPU reaches value, adding the time to waitMs
+void frameSchedulerWaitValue(FrameScheduler* scheduler, uint64_t value);
+
+// Timeline value the submit of the acquired slot must signal
+uint64_t frameSchedulerSignalValue(const FrameScheduler* scheduler);
+
+// Call once the acquired slot's work was submitted; moves on to the next slot
+void frameSchedulerSubmitted(FrameScheduler* scheduler);
+
+// Timing of the frame last submitted from slot, which must be finished;
+// waits for the completion thread to timestamp it. Both times are 0 when the
+// slot never submitted.
+FrameTiming frameSchedulerTiming(FrameScheduler* scheduler, uint32_t slot);
+
+const char* framePacingName(FramePacing pacing);
+
+#endif
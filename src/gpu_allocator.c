@@ -0,0 +1,518 @@
+#include "gpu_allocator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GPU_NO_RANGE UINT32_MAX
+#define GPU_TLSF_SMALL_LOG2 8
+
+static inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static inline uint32_t highestBit(uint64_t value) {
+    return 63u - (uint32_t)__builtin_clzll(value);
+}
+
+// Maps a range size to its free list
+static void tlsfMapping(VkDeviceSize size, uint32_t* fl, uint32_t* sl) {
+    if (size < GPU_TLSF_SMALL_SIZE) {
+        *fl = 0;
+        *sl = (uint32_t)(size / (GPU_TLSF_SMALL_SIZE / GPU_TLSF_SL_COUNT));
+    } else {
+        uint32_t bit = highestBit(size);
+        *fl = bit - GPU_TLSF_SMALL_LOG2 + 1;
+        *sl = (uint32_t)(size >> (bit - GPU_TLSF_SL_LOG2)) ^ GPU_TLSF_SL_COUNT;
+    }
+}
+
+// Rounds the request up first so every range in the resulting list fits it
+static void tlsfMappingSearch(VkDeviceSize size, uint32_t* fl, uint32_t* sl) {
+    if (size < GPU_TLSF_SMALL_SIZE) {
+        size += GPU_TLSF_SMALL_SIZE / GPU_TLSF_SL_COUNT - 1;
+    } else {
+        size += ((VkDeviceSize)1 << (highestBit(size) - GPU_TLSF_SL_LOG2)) - 1;
+    }
+    tlsfMapping(size, fl, sl);
+}
+
+static uint32_t newRange(GpuMemoryBlock* block) {
+    if (block->unusedRanges != GPU_NO_RANGE) {
+        uint32_t index = block->unusedRanges;
+        block->unusedRanges = block->ranges[index].nextFree;
+        return index;
+    }
+
+    if (block->rangeCount == block->rangeCapacity) {
+        block->rangeCapacity = block->rangeCapacity ? block->rangeCapacity * 2 : 16;
+        block->ranges = realloc(block->ranges, block->rangeCapacity * sizeof(GpuRange));
+    }
+    return block->rangeCount++;
+}
+
+static void releaseRange(GpuMemoryBlock* block, uint32_t index) {
+    block->ranges[index].size = 0;
+    block->ranges[index].free = false;
+    block->ranges[index].nextFree = block->unusedRanges;
+    block->unusedRanges = index;
+}
+
+static void insertFree(GpuMemoryBlock* block, uint32_t index) {
+    GpuRange* range = &block->ranges[index];
+    uint32_t fl, sl;
+    tlsfMapping(range->size, &fl, &sl);
+
+    uint32_t head = block->freeHeads[fl][sl];
+    range->free = true;
+    range->prevFree = GPU_NO_RANGE;
+    range->nextFree = head;
+    if (head != GPU_NO_RANGE) {
+        block->ranges[head].prevFree = index;
+    }
+
+    block->freeHeads[fl][sl] = index;
+    block->firstLevelBitmap |= 1u << fl;
+    block->secondLevelBitmap[fl] |= 1u << sl;
+}
+
+static void removeFree(GpuMemoryBlock* block, uint32_t index) {
+    GpuRange* range = &block->ranges[index];
+    uint32_t fl, sl;
+    tlsfMapping(range->size, &fl, &sl);
+
+    if (range->prevFree != GPU_NO_RANGE) {
+        block->ranges[range->prevFree].nextFree = range->nextFree;
+    } else {
+        block->freeHeads[fl][sl] = range->nextFree;
+    }
+    if (range->nextFree != GPU_NO_RANGE) {
+        block->ranges[range->nextFree].prevFree = range->prevFree;
+    }
+
+    if (block->freeHeads[fl][sl] == GPU_NO_RANGE) {
+        block->secondLevelBitmap[fl] &= ~(1u << sl);
+        if (block->secondLevelBitmap[fl] == 0) {
+            block->firstLevelBitmap &= ~(1u << fl);
+        }
+    }
+    range->free = false;
+}
+
+static uint32_t findFreeRange(const GpuMemoryBlock* block, VkDeviceSize size) {
+    uint32_t fl, sl;
+    tlsfMappingSearch(size, &fl, &sl);
+    if (fl >= GPU_TLSF_FL_COUNT) {
+        return GPU_NO_RANGE;
+    }
+
+    uint32_t secondLevel = block->secondLevelBitmap[fl] & (~0u << sl);
+    if (secondLevel == 0) {
+        uint32_t firstLevel = fl + 1 < GPU_TLSF_FL_COUNT ? block->firstLevelBitmap & (~0u << (fl + 1)) : 0;
+        if (firstLevel == 0) {
+            return GPU_NO_RANGE;
+        }
+        fl = (uint32_t)__builtin_ctz(firstLevel);
+        secondLevel = block->secondLevelBitmap[fl];
+    }
+
+    sl = (uint32_t)__builtin_ctz(secondLevel);
+    return block->freeHeads[fl][sl];
+}
+
+// Carves an aligned range out of a block; ranges never have free neighbours,
+// so split-off padding and tail become free ranges of their own
+static uint32_t blockAllocate(GpuMemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment) {
+    uint32_t index = findFreeRange(block, size + alignment - 1);
+    if (index == GPU_NO_RANGE) {
+        return GPU_NO_RANGE;
+    }
+    removeFree(block, index);
+
+    VkDeviceSize offset = block->ranges[index].offset;
+    VkDeviceSize padding = alignUp(offset, alignment) - offset;
+
+    if (padding > 0) {
+        uint32_t front = newRange(block);
+        GpuRange* range = &block->ranges[index];
+        block->ranges[front].offset = range->offset;
+        block->ranges[front].size = padding;
+        block->ranges[front].prevPhysical = range->prevPhysical;
+        block->ranges[front].nextPhysical = index;
+        if (range->prevPhysical != GPU_NO_RANGE) {
+            block->ranges[range->prevPhysical].nextPhysical = front;
+        }
+        range->offset += padding;
+        range->size -= padding;
+        range->prevPhysical = front;
+        insertFree(block, front);
+    }
+
+    if (block->ranges[index].size > size) {
+        uint32_t back = newRange(block);
+        GpuRange* range = &block->ranges[index];
+        block->ranges[back].offset = range->offset + size;
+        block->ranges[back].size = range->size - size;
+        block->ranges[back].prevPhysical = index;
+        block->ranges[back].nextPhysical = range->nextPhysical;
+        if (range->nextPhysical != GPU_NO_RANGE) {
+            block->ranges[range->nextPhysical].prevPhysical = back;
+        }
+        range->size = size;
+        range->nextPhysical = back;
+        insertFree(block, back);
+    }
+
+    block->used += size;
+    block->allocationCount++;
+    return index;
+}
+
+static void blockFree(GpuMemoryBlock* block, uint32_t index) {
+    block->used -= block->ranges[index].size;
+    block->allocationCount--;
+
+    // Coalesce with free neighbours so the block never holds two adjacent free ranges
+    uint32_t prev = block->ranges[index].prevPhysical;
+    if (prev != GPU_NO_RANGE && block->ranges[prev].free) {
+        removeFree(block, prev);
+        block->ranges[prev].size += block->ranges[index].size;
+        block->ranges[prev].nextPhysical = block->ranges[index].nextPhysical;
+        if (block->ranges[index].nextPhysical != GPU_NO_RANGE) {
+            block->ranges[block->ranges[index].nextPhysical].prevPhysical = prev;
+        }
+        releaseRange(block, index);
+        index = prev;
+    }
+
+    uint32_t next = block->ranges[index].nextPhysical;
+    if (next != GPU_NO_RANGE && block->ranges[next].free) {
+        removeFree(block, next);
+        block->ranges[index].size += block->ranges[next].size;
+        block->ranges[index].nextPhysical = block->ranges[next].nextPhysical;
+        if (block->ranges[next].nextPhysical != GPU_NO_RANGE) {
+            block->ranges[block->ranges[next].nextPhysical].prevPhysical = index;
+        }
+        releaseRange(block, next);
+    }
+
+    insertFree(block, index);
+}
+
+static GpuMemoryBlock* createBlock(GpuAllocator* allocator, uint32_t memoryType, VkDeviceSize size, bool dedicated) {
+    if (allocator->deviceAllocationCount >= allocator->maxDeviceAllocations) {
+        return NULL;
+    }
+
+    VkMemoryAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(allocator->device, &allocInfo, NULL, &memory) != VK_SUCCESS) {
+        return NULL;
+    }
+
+    GpuMemoryBlock* block = calloc(1, sizeof(GpuMemoryBlock));
+    block->memory = memory;
+    block->size = size;
+    block->memoryType = memoryType;
+    block->dedicated = dedicated;
+    block->unusedRanges = GPU_NO_RANGE;
+    memset(block->freeHeads, 0xFF, sizeof(block->freeHeads));
+
+    // Host-visible blocks stay mapped; allocations just offset into the mapping
+    VkMemoryPropertyFlags flags = allocator->memoryProperties.memoryTypes[memoryType].propertyFlags;
+    if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+        vkMapMemory(allocator->device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+        block->mapped = NULL;
+    }
+
+    uint32_t index = newRange(block);
+    block->ranges[index].offset = 0;
+    block->ranges[index].size = size;
+    block->ranges[index].prevPhysical = GPU_NO_RANGE;
+    block->ranges[index].nextPhysical = GPU_NO_RANGE;
+    if (dedicated) {
+        block->used = size;
+        block->allocationCount = 1;
+    } else {
+        insertFree(block, index);
+    }
+
+    allocator->deviceAllocationCount++;
+    return block;
+}
+
+static void destroyBlock(GpuAllocator* allocator, GpuMemoryBlock* block) {
+    if (block->mapped) {
+        vkUnmapMemory(allocator->device, block->memory);
+    }
+    vkFreeMemory(allocator->device, block->memory, NULL);
+    allocator->deviceAllocationCount--;
+    free(block->ranges);
+    free(block);
+}
+
+static void poolAddBlock(GpuMemoryPool* pool, GpuMemoryBlock* block) {
+    if (pool->blockCount == pool->blockCapacity) {
+        pool->blockCapacity = pool->blockCapacity ? pool->blockCapacity * 2 : 4;
+        pool->blocks = realloc(pool->blocks, pool->blockCapacity * sizeof(GpuMemoryBlock*));
+    }
+    pool->blocks[pool->blockCount++] = block;
+}
+
+static void poolRemoveBlock(GpuMemoryPool* pool, GpuMemoryBlock* block) {
+    for (uint32_t i = 0; i < pool->blockCount; i++) {
+        if (pool->blocks[i] == block) {
+            pool->blocks[i] = pool->blocks[--pool->blockCount];
+            return;
+        }
+    }
+}
+
+static bool allocateFromType(GpuAllocator* allocator, uint32_t memoryType, VkDeviceSize size, VkDeviceSize alignment,
+                             GpuAllocation* allocation) {
+    GpuMemoryPool* pool = &allocator->pools[memoryType];
+    GpuMemoryBlock* block = NULL;
+    uint32_t range = GPU_NO_RANGE;
+
+    if (size > pool->blockSize / 2) {
+        // Large resources would waste most of a shared block
+        block = createBlock(allocator, memoryType, size, true);
+        if (!block) {
+            return false;
+        }
+        poolAddBlock(pool, block);
+        range = 0;
+    } else {
+        for (uint32_t i = 0; i < pool->blockCount && range == GPU_NO_RANGE; i++) {
+            if (!pool->blocks[i]->dedicated) {
+                block = pool->blocks[i];
+                range = blockAllocate(block, size, alignment);
+            }
+        }
+
+        if (range == GPU_NO_RANGE) {
+            block = createBlock(allocator, memoryType, pool->blockSize, false);
+            if (!block) {
+                return false;
+            }
+            poolAddBlock(pool, block);
+            range = blockAllocate(block, size, alignment);
+            if (range == GPU_NO_RANGE) {
+                return false;
+            }
+        }
+    }
+
+    allocation->memory = block->memory;
+    allocation->offset = block->ranges[range].offset;
+    allocation->size = block->ranges[range].size;
+    allocation->mapped = block->mapped ? (char*)block->mapped + allocation->offset : NULL;
+    allocation->block = block;
+    allocation->range = range;
+    return true;
+}
+
+void gpuAllocatorInit(GpuAllocator* allocator, VkPhysicalDevice physicalDevice, VkDevice device) {
+    memset(allocator, 0, sizeof(*allocator));
+    allocator->device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &allocator->memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    allocator->bufferImageGranularity = properties.limits.bufferImageGranularity;
+    allocator->maxDeviceAllocations = properties.limits.maxMemoryAllocationCount;
+
+    for (uint32_t i = 0; i < allocator->memoryProperties.memoryTypeCount; i++) {
+        uint32_t heap = allocator->memoryProperties.memoryTypes[i].heapIndex;
+        VkDeviceSize heapSize = allocator->memoryProperties.memoryHeaps[heap].size;
+
+        // Small heaps (integrated GPUs, host-visible VRAM windows) get smaller blocks
+        allocator->pools[i].blockSize = heapSize / 8 < GPU_BLOCK_SIZE ? heapSize / 8 : GPU_BLOCK_SIZE;
+    }
+
+    pthread_mutex_init(&allocator->mutex, NULL);
+}
+
+void gpuAllocatorShutdown(GpuAllocator* allocator) {
+    GpuAllocatorStats stats;
+    gpuAllocatorGetStats(allocator, &stats);
+    if (stats.allocationCount > 0) {
+        fprintf(stderr, "Leaked %u GPU allocations (%llu bytes)!\n", stats.allocationCount,
+                (unsigned long long)stats.bytesUsed);
+    }
+
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+        GpuMemoryPool* pool = &allocator->pools[i];
+        for (uint32_t j = 0; j < pool->blockCount; j++) {
+            destroyBlock(allocator, pool->blocks[j]);
+        }
+        free(pool->blocks);
+    }
+
+    pthread_mutex_destroy(&allocator->mutex);
+    memset(allocator, 0, sizeof(*allocator));
+}
+
+bool gpuAllocate(GpuAllocator* allocator, const VkMemoryRequirements* requirements, VkMemoryPropertyFlags required,
+                 VkMemoryPropertyFlags preferred, bool optimalImage, GpuAllocation* allocation) {
+    VkDeviceSize size = requirements->size;
+    VkDeviceSize alignment = requirements->alignment ? requirements->alignment : 1;
+
+    // Optimal-tiling images own whole granularity pages so linear neighbours never alias them
+    if (optimalImage && allocator->bufferImageGranularity > alignment) {
+        alignment = allocator->bufferImageGranularity;
+    }
+    if (optimalImage) {
+        size = alignUp(size, allocator->bufferImageGranularity);
+    }
+
+    pthread_mutex_lock(&allocator->mutex);
+
+    // First pass wants the preferred flags too; the second settles for the required ones.
+    // Every matching type is tried so a full heap falls back to the next one.
+    for (int pass = 0; pass < 2; pass++) {
+        VkMemoryPropertyFlags wanted = pass == 0 ? required | preferred : required;
+        if (pass == 1 && (required | preferred) == required) {
+            break;
+        }
+
+        for (uint32_t i = 0; i < allocator->memoryProperties.memoryTypeCount; i++) {
+            VkMemoryPropertyFlags flags = allocator->memoryProperties.memoryTypes[i].propertyFlags;
+            if ((requirements->memoryTypeBits & (1u << i)) && (flags & wanted) == wanted &&
+                allocateFromType(allocator, i, size, alignment, allocation)) {
+                pthread_mutex_unlock(&allocator->mutex);
+                return true;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&allocator->mutex);
+    return false;
+}
+
+void gpuFree(GpuAllocator* allocator, GpuAllocation* allocation) {
+    GpuMemoryBlock* block = allocation->block;
+    if (!block) {
+        return;
+    }
+
+    pthread_mutex_lock(&allocator->mutex);
+
+    GpuMemoryPool* pool = &allocator->pools[block->memoryType];
+    if (block->dedicated) {
+        poolRemoveBlock(pool, block);
+        destroyBlock(allocator, block);
+    } else {
+        blockFree(block, allocation->range);
+
+        // Keep one empty block per type around to avoid allocation churn
+        if (block->allocationCount == 0) {
+            uint32_t sharedBlocks = 0;
+            for (uint32_t i = 0; i < pool->blockCount; i++) {
+                sharedBlocks += pool->blocks[i]->dedicated ? 0 : 1;
+            }
+            if (sharedBlocks > 1) {
+                poolRemoveBlock(pool, block);
+                destroyBlock(allocator, block);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&allocator->mutex);
+    memset(allocation, 0, sizeof(*allocation));
+}
+
+void gpuCreateBuffer(GpuAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage,
+                     VkMemoryPropertyFlags properties, VkBuffer* buffer, GpuAllocation* allocation) {
+    VkBufferCreateInfo bufferInfo = {0};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(allocator->device, &bufferInfo, NULL, buffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(allocator->device, *buffer, &memRequirements);
+
+    if (!gpuAllocate(allocator, &memRequirements, properties, 0, false, allocation)) {
+        fprintf(stderr, "Failed to allocate buffer memory!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    vkBindBufferMemory(allocator->device, *buffer, allocation->memory, allocation->offset);
+}
+
+void gpuCreateImage(GpuAllocator* allocator, const VkImageCreateInfo* imageInfo, VkMemoryPropertyFlags properties,
+                    VkImage* image, GpuAllocation* allocation) {
+    if (vkCreateImage(allocator->device, imageInfo, NULL, image) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create image!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(allocator->device, *image, &memRequirements);
+
+    if (!gpuAllocate(allocator, &memRequirements, properties, 0, imageInfo->tiling == VK_IMAGE_TILING_OPTIMAL,
+                     allocation)) {
+        fprintf(stderr, "Failed to allocate image memory!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    vkBindImageMemory(allocator->device, *image, allocation->memory, allocation->offset);
+}
+
+void gpuDestroyBuffer(GpuAllocator* allocator, VkBuffer buffer, GpuAllocation* allocation) {
+    vkDestroyBuffer(allocator->device, buffer, NULL);
+    gpuFree(allocator, allocation);
+}
+
+void gpuDestroyImage(GpuAllocator* allocator, VkImage image, GpuAllocation* allocation) {
+    vkDestroyImage(allocator->device, image, NULL);
+    gpuFree(allocator, allocation);
+}
+
+void gpuAllocatorGetStats(GpuAllocator* allocator, GpuAllocatorStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    pthread_mutex_lock(&allocator->mutex);
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+        const GpuMemoryPool* pool = &allocator->pools[i];
+        for (uint32_t j = 0; j < pool->blockCount; j++) {
+            const GpuMemoryBlock* block = pool->blocks[j];
+            VkDeviceSize largest = 0;
+            for (uint32_t k = 0; k < block->rangeCount; k++) {
+                if (block->ranges[k].free && block->ranges[k].size > largest) {
+                    largest = block->ranges[k].size;
+                }
+            }
+
+            stats->blockCount++;
+            stats->allocationCount += block->allocationCount;
+            stats->bytesReserved += block->size;
+            stats->bytesUsed += block->used;
+            stats->bytesFragmented += block->size - block->used - largest;
+            if (largest > stats->largestFreeRange) {
+                stats->largestFreeRange = largest;
+            }
+        }
+    }
+    pthread_mutex_unlock(&allocator->mutex);
+}
+
+void gpuAllocatorPrintStats(GpuAllocator* allocator) {
+    GpuAllocatorStats stats;
+    gpuAllocatorGetStats(allocator, &stats);
+
+    double mb = 1024.0 * 1024.0;
+    printf("GPU memory: %u allocations in %u blocks, %.1f MB reserved, %.1f MB used, %.1f MB fragmented "
+           "(largest free range %.1f MB)\n", stats.allocationCount, stats.blockCount, stats.bytesReserved / mb,
+           stats.bytesUsed / mb, stats.bytesFragmented / mb, stats.largestFreeRange / mb);
+}
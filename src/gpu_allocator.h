@@ -0,0 +1,111 @@
+#ifndef SCOP_GPU_ALLOCATOR_H
+#define SCOP_GPU_ALLOCATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <vulkan/vulkan.h>
+
+// Size of the VkDeviceMemory blocks ranges are carved from (smaller on small heaps)
+#define GPU_BLOCK_SIZE (64ull * 1024ull * 1024ull)
+
+// TLSF layout: the first level splits by power of two, the second level into
+// GPU_TLSF_SL_COUNT linear steps; ranges under GPU_TLSF_SMALL_SIZE share level 0
+#define GPU_TLSF_SL_LOG2 4
+#define GPU_TLSF_SL_COUNT (1u << GPU_TLSF_SL_LOG2)
+#define GPU_TLSF_SMALL_SIZE 256u
+#define GPU_TLSF_FL_COUNT 32
+
+// Range of a block, linked to its physical neighbours and, when free, into a
+// TLSF free list. Links are indices into the block's range array.
+typedef struct {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t prevPhysical;
+    uint32_t nextPhysical;
+    uint32_t prevFree;
+    uint32_t nextFree;      // also chains unused range slots
+    bool free;
+} GpuRange;
+
+typedef struct {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint32_t memoryType;
+    void* mapped;           // whole block mapped once when host-visible
+    bool dedicated;         // holds a single resource too big to share a block
+
+    GpuRange* ranges;
+    uint32_t rangeCount;
+    uint32_t rangeCapacity;
+    uint32_t unusedRanges;
+
+    uint32_t firstLevelBitmap;
+    uint32_t secondLevelBitmap[GPU_TLSF_FL_COUNT];
+    uint32_t freeHeads[GPU_TLSF_FL_COUNT][GPU_TLSF_SL_COUNT];
+
+    VkDeviceSize used;
+    uint32_t allocationCount;
+} GpuMemoryBlock;
+
+// All blocks of one memory type
+typedef struct {
+    GpuMemoryBlock** blocks;
+    uint32_t blockCount;
+    uint32_t blockCapacity;
+    VkDeviceSize blockSize;
+} GpuMemoryPool;
+
+// Sub-range handed out to a buffer or image
+typedef struct {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void* mapped;           // NULL unless the memory is host-visible
+    GpuMemoryBlock* block;
+    uint32_t range;
+} GpuAllocation;
+
+typedef struct {
+    uint32_t blockCount;
+    uint32_t allocationCount;
+    VkDeviceSize bytesReserved;     // total VkDeviceMemory allocated
+    VkDeviceSize bytesUsed;         // handed out to resources, alignment padding included
+    VkDeviceSize bytesFragmented;   // free bytes outside the largest free range of each block
+    VkDeviceSize largestFreeRange;
+} GpuAllocatorStats;
+
+typedef struct {
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize bufferImageGranularity;
+    GpuMemoryPool pools[VK_MAX_MEMORY_TYPES];
+    uint32_t deviceAllocationCount;     // live vkAllocateMemory calls
+    uint32_t maxDeviceAllocations;      // maxMemoryAllocationCount of the device
+    pthread_mutex_t mutex;
+} GpuAllocator;
+
+void gpuAllocatorInit(GpuAllocator* allocator, VkPhysicalDevice physicalDevice, VkDevice device);
+void gpuAllocatorShutdown(GpuAllocator* allocator);
+
+// Picks a memory type with all required flags, favouring ones that also have
+// the preferred flags, and hands out an aligned range. Returns false when no
+// heap can satisfy the request.
+bool gpuAllocate(GpuAllocator* allocator, const VkMemoryRequirements* requirements, VkMemoryPropertyFlags required,
+                 VkMemoryPropertyFlags preferred, bool optimalImage, GpuAllocation* allocation);
+void gpuFree(GpuAllocator* allocator, GpuAllocation* allocation);
+
+// Create a resource and bind it to a fresh sub-allocation; exit on failure
+void gpuCreateBuffer(GpuAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage,
+                     VkMemoryPropertyFlags properties, VkBuffer* buffer, GpuAllocation* allocation);
+void gpuCreateImage(GpuAllocator* allocator, const VkImageCreateInfo* imageInfo, VkMemoryPropertyFlags properties,
+                    VkImage* image, GpuAllocation* allocation);
+
+// Destroy the resource and return its range
+void gpuDestroyBuffer(GpuAllocator* allocator, VkBuffer buffer, GpuAllocation* allocation);
+void gpuDestroyImage(GpuAllocator* allocator, VkImage image, GpuAllocation* allocation);
+
+void gpuAllocatorGetStats(GpuAllocator* allocator, GpuAllocatorStats* stats);
+void gpuAllocatorPrintStats(GpuAllocator* allocator);
+
+#endif
@@ -0,0 +1,374 @@
+#include "image_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Whole file, mapped read-only; every read is bounds-checked against size
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+} ImageFile;
+
+static inline uint32_t readU16(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static inline uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static bool allocatePixels(Image* image, uint32_t width, uint32_t height) {
+    if (width == 0 || height == 0 || width > IMAGE_MAX_DIMENSION || height > IMAGE_MAX_DIMENSION) {
+        return false;
+    }
+
+    image->width = width;
+    image->height = height;
+    image->pixels = malloc((size_t)width * height * 4);
+    return image->pixels != NULL;
+}
+
+// Turns bottom-up rows the right way round
+static void flipRows(Image* image) {
+    size_t rowSize = (size_t)image->width * 4;
+    uint8_t* row = malloc(rowSize);
+    for (uint32_t y = 0; y < image->height / 2; y++) {
+        uint8_t* top = image->pixels + y * rowSize;
+        uint8_t* bottom = image->pixels + (image->height - 1 - y) * rowSize;
+        memcpy(row, top, rowSize);
+        memcpy(top, bottom, rowSize);
+        memcpy(bottom, row, rowSize);
+    }
+    free(row);
+}
+
+// TGA pixels are stored BGR(A), or as one gray byte
+static inline void storeTgaPixel(uint8_t* out, const uint8_t* in, uint32_t bytesPerPixel, bool alpha) {
+    if (bytesPerPixel == 1) {
+        out[0] = out[1] = out[2] = in[0];
+        out[3] = 255;
+    } else {
+        out[0] = in[2];
+        out[1] = in[1];
+        out[2] = in[0];
+        out[3] = bytesPerPixel == 4 && alpha ? in[3] : 255;
+    }
+}
+
+static bool loadTga(const ImageFile* file, Image* image) {
+    const uint8_t* header = file->data;
+    if (file->size < 18) {
+        return false;
+    }
+
+    // Color-mapped images are refused; a true-color image may still carry an unused map
+    uint32_t imageType = header[2];
+    uint32_t bitsPerPixel = header[16];
+    bool grayscale = imageType == 3 || imageType == 11;
+    bool rle = imageType == 10 || imageType == 11;
+    if (header[1] > 1 || (imageType != 2 && imageType != 3 && imageType != 10 && imageType != 11) ||
+        (grayscale && bitsPerPixel != 8) || (!grayscale && bitsPerPixel != 24 && bitsPerPixel != 32)) {
+        return false;
+    }
+
+    size_t offset = 18 + header[0];
+    if (header[1] == 1) {
+        offset += (size_t)readU16(header + 5) * ((header[7] + 7) / 8);
+    }
+    if (!allocatePixels(image, readU16(header + 12), readU16(header + 14))) {
+        return false;
+    }
+
+    // Descriptor: low 4 bits count alpha bits, bit 5 puts the origin at the top
+    uint32_t bytesPerPixel = bitsPerPixel / 8;
+    bool alpha = (header[17] & 0x0f) != 0;
+    size_t pixelCount = (size_t)image->width * image->height;
+    const uint8_t* p = file->data + offset;
+    const uint8_t* end = file->data + file->size;
+    uint8_t* out = image->pixels;
+
+    if (!rle) {
+        if (offset > file->size || (size_t)(end - p) / bytesPerPixel < pixelCount) {
+            imageFree(image);
+            return false;
+        }
+        for (size_t i = 0; i < pixelCount; i++, p += bytesPerPixel) {
+            storeTgaPixel(out + i * 4, p, bytesPerPixel, alpha);
+        }
+    } else {
+        // Packets: a run repeats one pixel, a raw packet lists them; either may cross rows
+        size_t i = 0;
+        while (i < pixelCount) {
+            if (p >= end) {
+                imageFree(image);
+                return false;
+            }
+            uint32_t packet = *p++;
+            size_t count = (packet & 0x7f) + 1;
+            bool run = (packet & 0x80) != 0;
+            size_t needed = run ? bytesPerPixel : count * bytesPerPixel;
+            if (count > pixelCount - i || (size_t)(end - p) < needed) {
+                imageFree(image);
+                return false;
+            }
+            for (size_t j = 0; j < count; j++, i++) {
+                storeTgaPixel(out + i * 4, run ? p : p + j * bytesPerPixel, bytesPerPixel, alpha);
+            }
+            p += needed;
+        }
+    }
+
+    if ((header[17] & 0x20) == 0) {
+        flipRows(image);
+    }
+    return true;
+}
+
+// Skips whitespace and comments of a PPM header and reads one number
+static bool readPpmNumber(const ImageFile* file, size_t* offset, uint32_t* value) {
+    size_t i = *offset;
+    while (i < file->size) {
+        uint8_t c = file->data[i];
+        if (c == '#') {
+            while (i < file->size && file->data[i] != '\n') {
+                i++;
+            }
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            i++;
+        } else {
+            break;
+        }
+    }
+
+    uint64_t number = 0;
+    size_t digits = 0;
+    while (i < file->size && file->data[i] >= '0' && file->data[i] <= '9' && number <= UINT32_MAX) {
+        number = number * 10 + (file->data[i++] - '0');
+        digits++;
+    }
+    *offset = i;
+    *value = (uint32_t)number;
+    return digits > 0 && number <= UINT32_MAX;
+}
+
+static bool loadPpm(const ImageFile* file, Image* image) {
+    // P2/P5 are gray, P3/P6 RGB; P2/P3 list samples as text
+    char kind = (char)file->data[1];
+    uint32_t channels = kind == '2' || kind == '5' ? 1 : 3;
+    bool ascii = kind == '2' || kind == '3';
+
+    size_t offset = 2;
+    uint32_t width, height, maxValue;
+    if (!readPpmNumber(file, &offset, &width) || !readPpmNumber(file, &offset, &height) ||
+        !readPpmNumber(file, &offset, &maxValue) || maxValue == 0 || maxValue > 65535) {
+        return false;
+    }
+    if (!allocatePixels(image, width, height)) {
+        return false;
+    }
+
+    // A single whitespace byte separates the header from binary samples
+    offset++;
+    uint32_t sampleSize = maxValue > 255 ? 2 : 1;
+    size_t sampleCount = (size_t)width * height * channels;
+    if (!ascii && (offset > file->size || (file->size - offset) / sampleSize < sampleCount)) {
+        imageFree(image);
+        return false;
+    }
+
+    for (size_t i = 0; i < sampleCount; i++) {
+        uint32_t sample;
+        if (ascii) {
+            if (!readPpmNumber(file, &offset, &sample)) {
+                imageFree(image);
+                return false;
+            }
+        } else if (sampleSize == 2) {
+            sample = (uint32_t)file->data[offset] << 8 | file->data[offset + 1];
+            offset += 2;
+        } else {
+            sample = file->data[offset++];
+        }
+
+        uint8_t value = (uint8_t)((sample > maxValue ? maxValue : sample) * 255 / maxValue);
+        uint8_t* out = image->pixels + (i / channels) * 4;
+        if (channels == 1) {
+            out[0] = out[1] = out[2] = value;
+        } else {
+            out[i % 3] = value;
+        }
+        out[3] = 255;
+    }
+    return true;
+}
+
+// Position and width of a BMP channel mask, so any layout scales to 8 bits
+typedef struct {
+    uint32_t mask;
+    uint32_t shift;
+    uint32_t max;
+} BmpChannel;
+
+static BmpChannel bmpChannel(uint32_t mask) {
+    BmpChannel channel = {mask, 0, 0};
+    if (mask != 0) {
+        while (((mask >> channel.shift) & 1) == 0) {
+            channel.shift++;
+        }
+        channel.max = mask >> channel.shift;
+    }
+    return channel;
+}
+
+static inline uint8_t bmpExtract(const BmpChannel* channel, uint32_t pixel, uint8_t fallback) {
+    if (channel->mask == 0) {
+        return fallback;
+    }
+    return (uint8_t)((uint64_t)((pixel & channel->mask) >> channel->shift) * 255 / channel->max);
+}
+
+static bool loadBmp(const ImageFile* file, Image* image) {
+    const uint8_t* data = file->data;
+    if (file->size < 54) {
+        return false;
+    }
+
+    // Only BITMAPINFOHEADER and its successors; negative heights are stored top-down
+    uint32_t pixelOffset = readU32(data + 10);
+    uint32_t headerSize = readU32(data + 14);
+    int32_t width = (int32_t)readU32(data + 18);
+    int32_t height = (int32_t)readU32(data + 22);
+    uint32_t bitsPerPixel = readU16(data + 28);
+    uint32_t compression = readU32(data + 30);
+    bool topDown = height < 0;
+    if (headerSize < 40 || width <= 0 || height == 0 || height == INT32_MIN) {
+        return false;
+    }
+    if (topDown) {
+        height = -height;
+    }
+
+    // Bit fields follow a 40-byte header, and sit at the same place in larger ones
+    BmpChannel red, green, blue, alpha;
+    if (compression == 3 || compression == 6) {
+        if (file->size < 66 + (compression == 6 || headerSize >= 56 ? 4u : 0u)) {
+            return false;
+        }
+        red = bmpChannel(readU32(data + 54));
+        green = bmpChannel(readU32(data + 58));
+        blue = bmpChannel(readU32(data + 62));
+        alpha = bmpChannel(compression == 6 || headerSize >= 56 ? readU32(data + 66) : 0);
+    } else if (compression == 0 && bitsPerPixel == 16) {
+        red = bmpChannel(0x7c00);
+        green = bmpChannel(0x03e0);
+        blue = bmpChannel(0x001f);
+        alpha = bmpChannel(0);
+    } else if (compression == 0) {
+        // 32-bit BI_RGB leaves the fourth byte undefined, so it is not alpha
+        red = bmpChannel(0x00ff0000);
+        green = bmpChannel(0x0000ff00);
+        blue = bmpChannel(0x000000ff);
+        alpha = bmpChannel(0);
+    } else {
+        return false;
+    }
+    if ((bitsPerPixel != 8 && bitsPerPixel != 16 && bitsPerPixel != 24 && bitsPerPixel != 32) ||
+        (bitsPerPixel == 8 && compression != 0) || (bitsPerPixel == 24 && compression != 0)) {
+        return false;
+    }
+
+    // 8-bit pixels index a palette of BGRX entries right after the header
+    const uint8_t* palette = data + 14 + headerSize;
+    uint32_t paletteSize = 0;
+    if (bitsPerPixel == 8) {
+        paletteSize = readU32(data + 46);
+        paletteSize = paletteSize == 0 || paletteSize > 256 ? 256 : paletteSize;
+        if (14 + (size_t)headerSize + paletteSize * 4 > file->size) {
+            return false;
+        }
+    }
+
+    // Rows are padded to 4 bytes
+    size_t rowSize = (((size_t)width * bitsPerPixel + 31) / 32) * 4;
+    if (pixelOffset > file->size || (file->size - pixelOffset) / rowSize < (size_t)height) {
+        return false;
+    }
+    if (!allocatePixels(image, (uint32_t)width, (uint32_t)height)) {
+        return false;
+    }
+
+    for (int32_t y = 0; y < height; y++) {
+        const uint8_t* row = data + pixelOffset + (size_t)(topDown ? y : height - 1 - y) * rowSize;
+        uint8_t* out = image->pixels + (size_t)y * width * 4;
+        for (int32_t x = 0; x < width; x++, out += 4) {
+            if (bitsPerPixel == 8) {
+                uint32_t index = row[x] < paletteSize ? row[x] : 0;
+                out[0] = palette[index * 4 + 2];
+                out[1] = palette[index * 4 + 1];
+                out[2] = palette[index * 4];
+                out[3] = 255;
+                continue;
+            }
+
+            uint32_t pixel;
+            if (bitsPerPixel == 16) {
+                pixel = readU16(row + x * 2);
+            } else if (bitsPerPixel == 24) {
+                pixel = (uint32_t)row[x * 3] | (uint32_t)row[x * 3 + 1] << 8 | (uint32_t)row[x * 3 + 2] << 16;
+            } else {
+                pixel = readU32(row + x * 4);
+            }
+            out[0] = bmpExtract(&red, pixel, 0);
+            out[1] = bmpExtract(&green, pixel, 0);
+            out[2] = bmpExtract(&blue, pixel, 0);
+            out[3] = bmpExtract(&alpha, pixel, 255);
+        }
+    }
+    return true;
+}
+
+bool imageLoad(const char* path, Image* image) {
+    memset(image, 0, sizeof(*image));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 2) {
+        close(fd);
+        return false;
+    }
+
+    ImageFile file = {0};
+    file.size = (size_t)st.st_size;
+    file.data = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file.data == MAP_FAILED) {
+        return false;
+    }
+
+    // BMP and PPM start with a signature; TGA has none, so it is tried last
+    bool loaded;
+    if (file.data[0] == 'B' && file.data[1] == 'M') {
+        loaded = loadBmp(&file, image);
+    } else if (file.data[0] == 'P' && file.data[1] >= '2' && file.data[1] <= '6' && file.data[1] != '4') {
+        loaded = loadPpm(&file, image);
+    } else {
+        loaded = loadTga(&file, image);
+    }
+
+    munmap((void*)file.data, file.size);
+    return loaded;
+}
+
+void imageFree(Image* image) {
+    free(image->pixels);
+    memset(image, 0, sizeof(*image));
+}
@@ -0,0 +1,23 @@
+#ifndef SCOP_IMAGE_LOADER_H
+#define SCOP_IMAGE_LOADER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Larger images are refused; every Vulkan device samples 4096, most 16384
+#define IMAGE_MAX_DIMENSION 16384
+
+// Decoded image, 4 bytes per pixel (RGBA), rows from the top down
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint8_t* pixels;
+} Image;
+
+// Decodes a TGA (uncompressed or RLE, true-color or grayscale), PPM/PGM
+// (P2, P3, P5, P6) or BMP (8, 24 or 32 bits, uncompressed) file. The format
+// is told by content, not by extension. Safe to call from any thread.
+bool imageLoad(const char* path, Image* image);
+void imageFree(Image* image);
+
+#endif
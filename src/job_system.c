@@ -0,0 +1,167 @@
+#include "job_system.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    JobSystem* jobs;
+    uint32_t index;
+} WorkerInfo;
+
+// Must be called with the mutex held; returns false when the queue is empty
+static bool popJob(JobSystem* jobs, Job* job) {
+    if (jobs->queueCount == 0) {
+        return false;
+    }
+
+    *job = jobs->queue[jobs->queueHead];
+    jobs->queueHead = (jobs->queueHead + 1) % jobs->queueCapacity;
+    jobs->queueCount--;
+    return true;
+}
+
+// Like popJob but only takes jobs of one counter, so a waiter never gets
+// stuck running someone else's long job. Must be called with the mutex held.
+static bool popJobOf(JobSystem* jobs, const JobCounter* counter, Job* job) {
+    for (size_t i = 0; i < jobs->queueCount; i++) {
+        size_t slot = (jobs->queueHead + i) % jobs->queueCapacity;
+        if (jobs->queue[slot].counter != counter) {
+            continue;
+        }
+
+        *job = jobs->queue[slot];
+        // Close the gap, keeping the remaining jobs in FIFO order
+        for (size_t j = i + 1; j < jobs->queueCount; j++) {
+            size_t next = (jobs->queueHead + j) % jobs->queueCapacity;
+            jobs->queue[slot] = jobs->queue[next];
+            slot = next;
+        }
+        jobs->queueCount--;
+        return true;
+    }
+    return false;
+}
+
+// Runs a job outside the lock and retires it from its counter
+static void runJob(JobSystem* jobs, const Job* job, uint32_t threadIndex) {
+    pthread_mutex_unlock(&jobs->mutex);
+    job->function(job->data, threadIndex);
+    pthread_mutex_lock(&jobs->mutex);
+
+    if (job->counter && --job->counter->pending == 0) {
+        pthread_cond_broadcast(&jobs->jobFinished);
+    }
+}
+
+static void* workerMain(void* arg) {
+    WorkerInfo info = *(WorkerInfo*)arg;
+    JobSystem* jobs = info.jobs;
+    free(arg);
+
+    pthread_mutex_lock(&jobs->mutex);
+    while (true) {
+        Job job;
+        if (popJob(jobs, &job)) {
+            runJob(jobs, &job, info.index);
+        } else if (jobs->stopping) {
+            break;
+        } else {
+            pthread_cond_wait(&jobs->jobAvailable, &jobs->mutex);
+        }
+    }
+    pthread_mutex_unlock(&jobs->mutex);
+
+    return NULL;
+}
+
+void jobSystemInit(JobSystem* jobs, uint32_t threadCount) {
+    jobs->threadCount = threadCount;
+    jobs->queueCapacity = 64;
+    jobs->queueHead = 0;
+    jobs->queueCount = 0;
+    jobs->queue = malloc(jobs->queueCapacity * sizeof(Job));
+    jobs->threads = threadCount ? malloc(threadCount * sizeof(pthread_t)) : NULL;
+    jobs->stopping = false;
+
+    pthread_mutex_init(&jobs->mutex, NULL);
+    pthread_cond_init(&jobs->jobAvailable, NULL);
+    pthread_cond_init(&jobs->jobFinished, NULL);
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+        WorkerInfo* info = malloc(sizeof(WorkerInfo));
+        info->jobs = jobs;
+        info->index = i;
+        if (pthread_create(&jobs->threads[i], NULL, workerMain, info) != 0) {
+            fprintf(stderr, "Failed to create worker thread!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void jobSystemShutdown(JobSystem* jobs) {
+    pthread_mutex_lock(&jobs->mutex);
+    jobs->stopping = true;
+    pthread_cond_broadcast(&jobs->jobAvailable);
+    pthread_mutex_unlock(&jobs->mutex);
+
+    for (uint32_t i = 0; i < jobs->threadCount; i++) {
+        pthread_join(jobs->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&jobs->jobFinished);
+    pthread_cond_destroy(&jobs->jobAvailable);
+    pthread_mutex_destroy(&jobs->mutex);
+    free(jobs->threads);
+    free(jobs->queue);
+    jobs->threads = NULL;
+    jobs->queue = NULL;
+    jobs->threadCount = 0;
+}
+
+void jobSystemSubmit(JobSystem* jobs, JobFunction function, void* data, JobCounter* counter) {
+    pthread_mutex_lock(&jobs->mutex);
+
+    if (jobs->queueCount == jobs->queueCapacity) {
+        // Grow the ring buffer, unwrapping it so the head starts at 0
+        size_t newCapacity = jobs->queueCapacity * 2;
+        Job* grown = malloc(newCapacity * sizeof(Job));
+        for (size_t i = 0; i < jobs->queueCount; i++) {
+            grown[i] = jobs->queue[(jobs->queueHead + i) % jobs->queueCapacity];
+        }
+        free(jobs->queue);
+        jobs->queue = grown;
+        jobs->queueCapacity = newCapacity;
+        jobs->queueHead = 0;
+    }
+
+    Job* job = &jobs->queue[(jobs->queueHead + jobs->queueCount) % jobs->queueCapacity];
+    job->function = function;
+    job->data = data;
+    job->counter = counter;
+    jobs->queueCount++;
+    if (counter) {
+        counter->pending++;
+    }
+
+    pthread_cond_signal(&jobs->jobAvailable);
+    pthread_mutex_unlock(&jobs->mutex);
+}
+
+void jobSystemWait(JobSystem* jobs, JobCounter* counter) {
+    pthread_mutex_lock(&jobs->mutex);
+    while (counter->pending > 0) {
+        Job job;
+        if (popJobOf(jobs, counter, &job)) {
+            runJob(jobs, &job, jobs->threadCount);
+        } else {
+            pthread_cond_wait(&jobs->jobFinished, &jobs->mutex);
+        }
+    }
+    pthread_mutex_unlock(&jobs->mutex);
+}
+
+uint32_t jobSystemDefaultThreadCount(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 1 ? (uint32_t)(cpus - 1) : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef SCOP_JOB_SYSTEM_H
+#define SCOP_JOB_SYSTEM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Job entry point. threadIndex is in [0, threadCount]: workers use
+// 0..threadCount-1 and a thread helping out in jobSystemWait uses threadCount,
+// so per-thread resources can be indexed without locking.
+typedef void (*JobFunction)(void* data, uint32_t threadIndex);
+
+// Tracks a group of jobs so callers can wait for just that group
+typedef struct {
+    uint32_t pending;
+} JobCounter;
+
+typedef struct {
+    JobFunction function;
+    void* data;
+    JobCounter* counter;
+} Job;
+
+// Fixed pool of worker threads pulling from a shared FIFO queue
+typedef struct {
+    pthread_t* threads;
+    uint32_t threadCount;
+    Job* queue;
+    size_t queueCapacity;
+    size_t queueHead;
+    size_t queueCount;
+    pthread_mutex_t mutex;
+    pthread_cond_t jobAvailable;
+    pthread_cond_t jobFinished;
+    bool stopping;
+} JobSystem;
+
+// Starts threadCount workers (0 is valid: jobs then run inside jobSystemWait)
+void jobSystemInit(JobSystem* jobs, uint32_t threadCount);
+void jobSystemShutdown(JobSystem* jobs);
+
+void jobSystemSubmit(JobSystem* jobs, JobFunction function, void* data, JobCounter* counter);
+
+// Blocks until every job of the counter has finished, running the counter's
+// queued jobs meanwhile (other jobs are left to the workers)
+void jobSystemWait(JobSystem* jobs, JobCounter* counter);
+
+// Worker count that keeps every online CPU busy alongside the calling thread
+uint32_t jobSystemDefaultThreadCount(void);
+
+#endif
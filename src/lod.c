@@ -0,0 +1,448 @@
+#include "lod.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+// Boundary edges get planes this much heavier than faces, so open borders
+// don't shrink away
+#define LOD_BOUNDARY_WEIGHT 10.0
+
+// Collapses may turn a triangle by at most this much (cosine of the angle
+// between its normals before and after)
+#define LOD_MIN_NORMAL_COSINE 0.25
+
+#define NO_VERTEX UINT32_MAX
+
+// Symmetric 4x4 matrix summing squared plane distances, upper triangle
+// stored row by row; weight is the area the planes came from
+typedef struct {
+    double a[10];
+    double weight;
+} Quadric;
+
+typedef struct {
+    float cost;
+    uint32_t from;
+    uint32_t to;
+} Collapse;
+
+// Everything the collapse passes share. Vertices with the same position are
+// welded to the first of them, and the edge collapses run on those; the
+// triangles still reference the original vertices so normals and texture
+// coordinates survive.
+typedef struct {
+    const Mesh* mesh;
+    uint32_t* weld;         // vertex -> first vertex with its position
+    uint32_t* nextInGroup;  // other vertices welded to the same one
+    uint32_t* remap;        // welded vertex -> welded vertex it collapsed into
+    Quadric* quadrics;      // per welded vertex
+    uint32_t* indices;      // current triangles
+    uint32_t* subsets;      // mesh subset of every current triangle
+    uint32_t triangleCount;
+    float error;            // largest collapse error so far
+} Simplifier;
+
+static void quadricAddPlane(Quadric* q, const double n[3], double d, double weight) {
+    double p[4] = {n[0], n[1], n[2], d};
+    int k = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int j = i; j < 4; j++) {
+            q->a[k++] += weight * p[i] * p[j];
+        }
+    }
+    q->weight += weight;
+}
+
+static void quadricAdd(Quadric* q, const Quadric* other) {
+    for (int i = 0; i < 10; i++) {
+        q->a[i] += other->a[i];
+    }
+    q->weight += other->weight;
+}
+
+// Mean squared distance of p to the quadric's planes
+static double quadricError(const Quadric* q, const float p[3]) {
+    double x = p[0], y = p[1], z = p[2];
+    const double* a = q->a;
+    double e = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x +
+               a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y +
+               a[7] * z * z + 2.0 * a[8] * z + a[9];
+    return q->weight > 0.0 && e > 0.0 ? e / q->weight : 0.0;
+}
+
+static void cross(const double a[3], const double b[3], double out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void triangleNormal(const float* a, const float* b, const float* c, double n[3]) {
+    double e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    cross(e1, e2, n);
+}
+
+static const float* position(const Simplifier* s, uint32_t vertex) {
+    return s->mesh->vertices[vertex].position;
+}
+
+static void weldPositions(Simplifier* s) {
+    uint32_t vertexCount = s->mesh->vertexCount;
+    size_t tableSize = 1;
+    while (tableSize < (size_t)vertexCount * 2) {
+        tableSize *= 2;
+    }
+    uint32_t* table = malloc(tableSize * sizeof(uint32_t));
+    memset(table, 0xff, tableSize * sizeof(uint32_t));
+
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        s->nextInGroup[v] = NO_VERTEX;
+        size_t slot = hashBytes(position(s, v), sizeof(float) * 3, 0) & (tableSize - 1);
+        while (table[slot] != NO_VERTEX && memcmp(position(s, table[slot]), position(s, v), sizeof(float) * 3) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == NO_VERTEX) {
+            table[slot] = v;
+            s->weld[v] = v;
+        } else {
+            uint32_t first = table[slot];
+            s->weld[v] = first;
+            s->nextInGroup[v] = s->nextInGroup[first];
+            s->nextInGroup[first] = v;
+        }
+    }
+    free(table);
+}
+
+// Triangles around every welded vertex, as offsets into a flat list
+static void buildAdjacency(const Simplifier* s, uint32_t* offsets, uint32_t* triangles) {
+    uint32_t vertexCount = s->mesh->vertexCount;
+    memset(offsets, 0, (vertexCount + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < s->triangleCount * 3; i++) {
+        offsets[s->weld[s->indices[i]] + 1]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+
+    uint32_t* fill = malloc(vertexCount * sizeof(uint32_t));
+    memcpy(fill, offsets, vertexCount * sizeof(uint32_t));
+    for (uint32_t i = 0; i < s->triangleCount * 3; i++) {
+        triangles[fill[s->weld[s->indices[i]]]++] = i / 3;
+    }
+    free(fill);
+}
+
+static bool triangleHasVertex(const Simplifier* s, uint32_t triangle, uint32_t welded) {
+    const uint32_t* corners = &s->indices[triangle * 3];
+    return s->weld[corners[0]] == welded || s->weld[corners[1]] == welded || s->weld[corners[2]] == welded;
+}
+
+// Face planes weighted by area, plus planes standing on open edges
+static void initQuadrics(Simplifier* s, const uint32_t* offsets, const uint32_t* adjacency) {
+    for (uint32_t t = 0; t < s->triangleCount; t++) {
+        const uint32_t* corners = &s->indices[t * 3];
+        double n[3];
+        triangleNormal(position(s, corners[0]), position(s, corners[1]), position(s, corners[2]), n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            n[k] /= length;
+        }
+
+        const float* p0 = position(s, corners[0]);
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        for (int k = 0; k < 3; k++) {
+            quadricAddPlane(&s->quadrics[s->weld[corners[k]]], n, d, 0.5 * length);
+        }
+
+        // An edge is open when no other triangle around one end has the other
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = s->weld[corners[k]];
+            uint32_t b = s->weld[corners[(k + 1) % 3]];
+            uint32_t shared = 0;
+            for (uint32_t i = offsets[a]; i < offsets[a + 1]; i++) {
+                shared += triangleHasVertex(s, adjacency[i], b);
+            }
+            if (shared != 1) {
+                continue;
+            }
+
+            const float* pa = position(s, corners[k]);
+            const float* pb = position(s, corners[(k + 1) % 3]);
+            double edge[3] = {pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2]};
+            double edgeLengthSquared = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+            double side[3];
+            cross(edge, n, side);
+            double sideLength = sqrt(side[0] * side[0] + side[1] * side[1] + side[2] * side[2]);
+            if (sideLength == 0.0) {
+                continue;
+            }
+            for (int j = 0; j < 3; j++) {
+                side[j] /= sideLength;
+            }
+            double sideD = -(side[0] * pa[0] + side[1] * pa[1] + side[2] * pa[2]);
+            quadricAddPlane(&s->quadrics[a], side, sideD, LOD_BOUNDARY_WEIGHT * edgeLengthSquared);
+            quadricAddPlane(&s->quadrics[b], side, sideD, LOD_BOUNDARY_WEIGHT * edgeLengthSquared);
+        }
+    }
+}
+
+// Radix sort by cost; costs are never negative, so their bits order like
+// the floats do
+static void sortCollapses(Collapse* collapses, uint32_t count) {
+    Collapse* scratch = malloc((size_t)count * sizeof(Collapse));
+    Collapse* source = collapses;
+    Collapse* target = scratch;
+    for (int shift = 0; shift < 32; shift += 11) {
+        uint32_t histogram[2048] = {0};
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t key;
+            memcpy(&key, &source[i].cost, sizeof(key));
+            histogram[(key >> shift) & 2047]++;
+        }
+        uint32_t sum = 0;
+        for (uint32_t bucket = 0; bucket < 2048; bucket++) {
+            uint32_t size = histogram[bucket];
+            histogram[bucket] = sum;
+            sum += size;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t key;
+            memcpy(&key, &source[i].cost, sizeof(key));
+            target[histogram[(key >> shift) & 2047]++] = source[i];
+        }
+        Collapse* swap = source;
+        source = target;
+        target = swap;
+    }
+
+    // Three passes leave the result in the scratch buffer
+    memcpy(collapses, source, (size_t)count * sizeof(Collapse));
+    free(scratch);
+}
+
+// Whether moving from onto to keeps every surviving triangle around from
+// facing roughly the same way
+static bool collapseKeepsOrientation(const Simplifier* s, const uint32_t* offsets, const uint32_t* adjacency,
+                                     uint32_t from, uint32_t to, uint32_t* removed) {
+    *removed = 0;
+    for (uint32_t i = offsets[from]; i < offsets[from + 1]; i++) {
+        uint32_t triangle = adjacency[i];
+        if (triangleHasVertex(s, triangle, to)) {
+            (*removed)++;
+            continue;
+        }
+
+        const float* before[3];
+        const float* after[3];
+        for (int k = 0; k < 3; k++) {
+            uint32_t corner = s->indices[triangle * 3 + k];
+            before[k] = position(s, corner);
+            after[k] = s->weld[corner] == from ? position(s, to) : before[k];
+        }
+        double n0[3], n1[3];
+        triangleNormal(before[0], before[1], before[2], n0);
+        triangleNormal(after[0], after[1], after[2], n1);
+        double dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+        double lengths = sqrt((n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]) *
+                              (n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]));
+        if (dot < LOD_MIN_NORMAL_COSINE * lengths) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Vertex at the welded position whose attributes best match vertex
+static uint32_t closestInGroup(const Simplifier* s, uint32_t welded, uint32_t vertex) {
+    const Vertex* v = &s->mesh->vertices[vertex];
+    uint32_t best = welded;
+    float bestScore = -INFINITY;
+    for (uint32_t u = welded; u != NO_VERTEX; u = s->nextInGroup[u]) {
+        const Vertex* candidate = &s->mesh->vertices[u];
+        float du = candidate->texCoord[0] - v->texCoord[0];
+        float dv = candidate->texCoord[1] - v->texCoord[1];
+        float score = candidate->normal[0] * v->normal[0] + candidate->normal[1] * v->normal[1] +
+                      candidate->normal[2] * v->normal[2] - du * du - dv * dv;
+        if (score > bestScore) {
+            bestScore = score;
+            best = u;
+        }
+    }
+    return best;
+}
+
+// Collapses the cheapest edges, at most one per vertex, until roughly enough
+// triangles are gone, then rewrites the triangles. Returns the collapses made.
+static uint32_t collapsePass(Simplifier* s, uint32_t targetTriangles) {
+    uint32_t vertexCount = s->mesh->vertexCount;
+    uint32_t* offsets = malloc((vertexCount + 1) * sizeof(uint32_t));
+    uint32_t* adjacency = malloc((size_t)s->triangleCount * 3 * sizeof(uint32_t));
+    buildAdjacency(s, offsets, adjacency);
+
+    // Each edge moves whichever end is cheaper onto the other. Interior
+    // edges show up once per direction; only one of them is kept.
+    Collapse* collapses = malloc((size_t)s->triangleCount * 3 * sizeof(Collapse));
+    uint32_t candidateCount = 0;
+    for (uint32_t i = 0; i < s->triangleCount * 3; i++) {
+        uint32_t a = s->weld[s->indices[i]];
+        uint32_t b = s->weld[s->indices[i - i % 3 + (i + 1) % 3]];
+        if (a > b) {
+            continue;
+        }
+        Quadric q = s->quadrics[a];
+        quadricAdd(&q, &s->quadrics[b]);
+        double costAB = quadricError(&q, position(s, b));
+        double costBA = quadricError(&q, position(s, a));
+
+        Collapse* c = &collapses[candidateCount++];
+        c->cost = (float)(costAB <= costBA ? costAB : costBA);
+        c->from = costAB <= costBA ? a : b;
+        c->to = costAB <= costBA ? b : a;
+    }
+    sortCollapses(collapses, candidateCount);
+
+    uint8_t* locked = calloc(vertexCount, 1);
+    uint32_t goal = s->triangleCount - targetTriangles;
+    uint32_t removedTotal = 0;
+    uint32_t collapseCount = 0;
+    for (uint32_t i = 0; i < candidateCount && removedTotal < goal; i++) {
+        const Collapse* c = &collapses[i];
+        uint32_t removed;
+        if (locked[c->from] || locked[c->to] ||
+            !collapseKeepsOrientation(s, offsets, adjacency, c->from, c->to, &removed)) {
+            continue;
+        }
+
+        s->remap[c->from] = c->to;
+        quadricAdd(&s->quadrics[c->to], &s->quadrics[c->from]);
+        locked[c->from] = 1;
+        locked[c->to] = 1;
+        removedTotal += removed;
+        collapseCount++;
+
+        float error = sqrtf(c->cost);
+        s->error = error > s->error ? error : s->error;
+    }
+
+    // Move collapsed corners and drop the triangles that lost their area
+    uint32_t kept = 0;
+    for (uint32_t t = 0; t < s->triangleCount; t++) {
+        uint32_t corners[3];
+        for (int k = 0; k < 3; k++) {
+            uint32_t vertex = s->indices[t * 3 + k];
+            uint32_t welded = s->weld[vertex];
+            corners[k] = s->remap[welded] != welded ? closestInGroup(s, s->remap[welded], vertex) : vertex;
+        }
+        uint32_t w0 = s->weld[corners[0]], w1 = s->weld[corners[1]], w2 = s->weld[corners[2]];
+        if (w0 == w1 || w1 == w2 || w0 == w2) {
+            continue;
+        }
+        memcpy(&s->indices[kept * 3], corners, sizeof(corners));
+        s->subsets[kept] = s->subsets[t];
+        kept++;
+    }
+    s->triangleCount = kept;
+
+    free(locked);
+    free(collapses);
+    free(adjacency);
+    free(offsets);
+    return collapseCount;
+}
+
+void lodBuild(const Mesh* mesh, uint32_t maxLevels, LodChain* chain) {
+    memset(chain, 0, sizeof(*chain));
+    chain->levels[0].indexCount = mesh->indexCount;
+    chain->levelCount = 1;
+    chain->subsetCount = mesh->subsetCount;
+    chain->subsetIndexCounts = calloc((size_t)LOD_MAX_LEVELS * mesh->subsetCount, sizeof(uint32_t));
+    for (uint32_t i = 0; i < mesh->subsetCount; i++) {
+        chain->subsetIndexCounts[i] = mesh->subsets[i].indexCount;
+    }
+    maxLevels = maxLevels < LOD_MAX_LEVELS ? maxLevels : LOD_MAX_LEVELS;
+    if (maxLevels < 2 || (uint32_t)(mesh->indexCount / 3 * LOD_REDUCTION) < LOD_MIN_TRIANGLES) {
+        return;
+    }
+
+    Simplifier s = {0};
+    s.mesh = mesh;
+    s.weld = malloc(mesh->vertexCount * sizeof(uint32_t));
+    s.nextInGroup = malloc(mesh->vertexCount * sizeof(uint32_t));
+    s.remap = malloc(mesh->vertexCount * sizeof(uint32_t));
+    s.quadrics = calloc(mesh->vertexCount, sizeof(Quadric));
+    s.indices = malloc(mesh->indexCount * sizeof(uint32_t));
+    s.subsets = malloc((mesh->indexCount / 3 + 1) * sizeof(uint32_t));
+    s.triangleCount = mesh->indexCount / 3;
+    memcpy(s.indices, mesh->indices, s.triangleCount * 3 * sizeof(uint32_t));
+    for (uint32_t i = 0; i < mesh->subsetCount; i++) {
+        uint32_t first = mesh->subsets[i].firstIndex / 3;
+        for (uint32_t t = first; t < first + mesh->subsets[i].indexCount / 3; t++) {
+            s.subsets[t] = i;
+        }
+    }
+    for (uint32_t v = 0; v < mesh->vertexCount; v++) {
+        s.remap[v] = v;
+    }
+    weldPositions(&s);
+
+    uint32_t* offsets = malloc((mesh->vertexCount + 1) * sizeof(uint32_t));
+    uint32_t* adjacency = malloc((size_t)s.triangleCount * 3 * sizeof(uint32_t));
+    buildAdjacency(&s, offsets, adjacency);
+    initQuadrics(&s, offsets, adjacency);
+    free(adjacency);
+    free(offsets);
+
+    uint32_t capacity = 0;
+    for (uint32_t level = 1; level < maxLevels; level++) {
+        uint32_t previous = s.triangleCount;
+        uint32_t target = (uint32_t)(previous * LOD_REDUCTION);
+        if (target < LOD_MIN_TRIANGLES) {
+            break;
+        }
+        while (s.triangleCount > target && collapsePass(&s, target) > 0) {
+        }
+
+        // Nearly stuck: what's left would flip triangles if collapsed
+        if (s.triangleCount > previous - previous / 10) {
+            break;
+        }
+
+        uint32_t indexCount = s.triangleCount * 3;
+        if (chain->indexCount + indexCount > capacity) {
+            capacity = (chain->indexCount + indexCount) * 2;
+            chain->indices = realloc(chain->indices, capacity * sizeof(uint32_t));
+        }
+        memcpy(chain->indices + chain->indexCount, s.indices, indexCount * sizeof(uint32_t));
+
+        // Collapses keep the triangles in order, so the subsets stay grouped
+        for (uint32_t t = 0; t < s.triangleCount; t++) {
+            chain->subsetIndexCounts[chain->levelCount * mesh->subsetCount + s.subsets[t]] += 3;
+        }
+
+        LodLevel* lod = &chain->levels[chain->levelCount++];
+        lod->firstIndex = mesh->indexCount + chain->indexCount;
+        lod->indexCount = indexCount;
+        lod->error = s.error;
+        chain->indexCount += indexCount;
+    }
+
+    free(s.subsets);
+    free(s.indices);
+    free(s.quadrics);
+    free(s.remap);
+    free(s.nextInGroup);
+    free(s.weld);
+}
+
+void lodFree(LodChain* chain) {
+    free(chain->indices);
+    free(chain->subsetIndexCounts);
+    memset(chain, 0, sizeof(*chain));
+}
@@ -0,0 +1,43 @@
+#ifndef SCOP_LOD_H
+#define SCOP_LOD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mesh.h"
+
+// Levels of detail, counting the full mesh as level 0
+#define LOD_MAX_LEVELS 6
+
+// Every level aims for this fraction of the previous level's triangles
+#define LOD_REDUCTION 0.5f
+
+// Levels stop once they would have fewer triangles than this
+#define LOD_MIN_TRIANGLES 64
+
+typedef struct {
+    uint32_t firstIndex;    // into the mesh's indices followed by LodChain.indices
+    uint32_t indexCount;
+    float error;            // how far the surface moved from the full mesh, in model units
+} LodLevel;
+
+// Simplified index buffers sharing the mesh's vertices, so every level draws
+// from the same vertex buffer. Level 0 is the mesh itself. Triangles keep
+// their material, and every level is grouped into the mesh's subsets, in
+// the same order.
+typedef struct {
+    LodLevel levels[LOD_MAX_LEVELS];
+    uint32_t levelCount;
+    uint32_t* indices;      // levels 1 and up, meant to follow the mesh's own indices
+    uint32_t indexCount;
+    uint32_t subsetCount;
+    uint32_t* subsetIndexCounts;    // [level * subsetCount + subset], each level's subsets starting at its firstIndex
+} LodChain;
+
+// Builds the chain by quadric error metric edge collapses, halving the
+// triangle count per level until maxLevels (at most LOD_MAX_LEVELS) or the
+// mesh stops shrinking
+void lodBuild(const Mesh* mesh, uint32_t maxLevels, LodChain* chain);
+void lodFree(LodChain* chain);
+
+#endif
@@ -3,16 +3,106 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "command_recorder.h"
+#include "culling.h"
+#include "frame_scheduler.h"
+#include "gpu_allocator.h"
+#include "job_system.h"
+#include "lod.h"
+#include "mat4.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+#include "mtl_loader.h"
+#include "obj_loader.h"
+#include "pipeline_cache.h"
+#include "pipelines.h"
+#include "profiler.h"
+#include "shader_watcher.h"
+#include "texture_loader.h"
+#include "texture_table.h"
+#include "uniform_ring.h"
+#include "upload.h"
+#include "util.h"
 
 // Window dimensions
 #define WIDTH 800
 #define HEIGHT 600
 
-// Maximum number of frames in flight
-#define MAX_FRAMES_IN_FLIGHT 2
+// Window title; profiler averages are appended to it
+#define WINDOW_TITLE "Vulkan Triangle"
+
+// GLSL sources watched by --watch-shaders and the compiler run on them;
+// the build points these at the source tree and the glslangValidator it used
+#ifndef SCOP_SHADER_DIRECTORY
+#define SCOP_SHADER_DIRECTORY "shaders"
+#endif
+#ifndef SCOP_GLSLANG_VALIDATOR
+#define SCOP_GLSLANG_VALIDATOR "glslangValidator"
+#endif
+
+// Frames in flight when --frames-in-flight is not given
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+
+// Replaced swapchains waiting on their frames and presents; past this, a
+// rebuild the current swapchain can do without is put off to a later frame
+#define MAX_RETIRED_SWAPCHAINS 8
+
+// Frames rendered by --headless when --frames is not given
+#define DEFAULT_HEADLESS_FRAMES 100
+
+// Offscreen color format; sRGB so dumped PPMs match what a window would show
+#define HEADLESS_FORMAT VK_FORMAT_R8G8B8A8_SRGB
+
+// Frame slot that holds no frame to report
+#define NO_FRAME UINT32_MAX
+
+// Objects drawn by --bench-record when --stress is not given
+#define DEFAULT_BENCHMARK_OBJECTS 10000
+
+// Frames rendered by --benchmark when --frames is not given
+#define DEFAULT_BENCHMARK_FRAMES 1000
+
+// Recordings timed per thread count by --bench-record
+#define BENCHMARK_RECORD_ITERATIONS 200
+
+// Stages reading uploaded data: vertex fetch, shader.vert and cull.comp, and
+// the blits that build texture mips from uploaded level 0
+#define SCENE_READ_STAGES (VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | \
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT)
+
+// Screen-space error in pixels a level of detail may add, unless --lod-error is given
+#define DEFAULT_LOD_ERROR 1.0f
+
+// Arrow keys pan by this fraction of the view, +/- zoom by this factor
+#define VIEW_PAN_STEP 0.1f
+#define VIEW_ZOOM_STEP 1.25f
+
+// Objects turn in place and stay within this distance of z = 0, the depth
+// range of the view
+#define SCENE_DEPTH 2.0f
+
+// Degrees per second R spins the objects at when --spin is not given
+#define DEFAULT_SPIN_SPEED 45.0f
+
+// Time a headless frame advances the spin by, so dumps don't depend on speed
+#define HEADLESS_FRAME_MS (1000.0 / 60.0)
+
+// Draws find their object and material through the instance index: the low
+// bits select the object's transform, the others the material (see
+// shader.vert and cull.comp)
+#define DRAW_OBJECT_BITS 20
+#define MAX_OBJECTS (1u << DRAW_OBJECT_BITS)
+#define MAX_MATERIALS (1u << (32 - DRAW_OBJECT_BITS))
 
 // Validation layers for debugging
 #ifdef NDEBUG
@@ -29,6 +119,99 @@ const char* deviceExtensions[] = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// Command-line options
+typedef struct {
+    const char* modelPath;
+    uint32_t threadCount;       // total loader threads, 0 = one per CPU
+    bool benchmarkLoader;       // measure OBJ parsing throughput and exit
+    bool disableMeshCache;      // always parse the OBJ and leave the cache alone
+    bool headless;              // render offscreen without a window or surface
+    uint32_t frameCount;        // exit after this many frames, 0 = run until closed
+    const char* dumpDirectory;  // write every reported frame as PPM here
+    const char* profileCsvPath;     // per-frame CPU spans and GPU scopes as CSV
+    const char* profileTracePath;   // the same as Chrome trace JSON
+    PipelineVariant pipelineVariant;    // initial shading and fill mode
+    uint32_t stressObjects;     // draw this many copies of the mesh in a grid
+    bool benchmarkRecording;    // time draw recording per thread count and exit
+    bool cpuCulling;            // cull and record draws on the CPU even when the GPU could
+    float zoom;                 // initial view zoom, 1 shows the whole scene
+    bool disableMeshlets;       // cull whole objects instead of their meshlets
+    bool disableLod;            // draw every object at full detail and skip simplification
+    float lodError;             // pixels of error a level of detail may add on screen
+    MeshOptimization optimization;  // triangle and vertex order applied after parsing
+    VertexFormat vertexFormat;      // layout the vertex buffer is uploaded in
+    uint32_t framesInFlight;    // frames the CPU may run ahead of the GPU, 1 to FRAME_SCHEDULER_MAX_FRAMES
+    FramePacing pacing;         // whether the wait for a frame slot comes before or after input
+    VkPresentModeKHR presentMode;   // VK_PRESENT_MODE_MAX_ENUM_KHR = mailbox when available, else FIFO
+    uint32_t swapchainImages;   // 0 = one more than the surface minimum
+    double fpsLimit;            // frame limiter target, 0 = uncapped
+    bool benchmark;             // uncapped run reporting frame time percentiles
+    bool disableDynamicRendering;   // draw through the render pass even when dynamic rendering is available
+    bool depthPrepass;          // lay down depth first so filled variants shade each pixel once
+    float spinSpeed;            // degrees per second every object turns about its vertical axis, 0 = still
+    bool disableBindless;       // give every frame its own small texture set even with descriptor indexing
+    TextureCompression textureCompression;  // block compression of textures through the texture cache
+    const char* shaderDirectory;    // recompile and reload shaders saved here, NULL = off
+} AppOptions;
+
+// Where the mesh came from, reported with the startup time
+typedef enum {
+    MESH_SOURCE_BUILTIN,
+    MESH_SOURCE_CACHE_HIT,
+    MESH_SOURCE_CACHE_MISS,
+    MESH_SOURCE_CACHE_OFF
+} MeshSource;
+
+// Objects of a replaced swapchain, kept until the frames drawn with them
+// have finished on the GPU and the presentation engine is done with its images
+typedef struct {
+    VkSwapchainKHR swapchain;
+    VkImageView* imageViews;
+    VkFramebuffer* framebuffers;
+    uint32_t imageCount;
+    VkImage depthImage;
+    VkImageView depthImageView;
+    GpuAllocation depthAllocation;
+    uint64_t retireValue;       // frame timeline value of the last frame that used them
+    uint64_t lastPresent;       // number of presents queued when it was replaced
+} RetiredSwapchain;
+
+// Fence signaled once the presentation engine is done with a present's image
+typedef struct {
+    VkFence fence;
+    VkSwapchainKHR swapchain;   // swapchain presented to, VK_NULL_HANDLE while the fence is free
+} PresentFence;
+
+// Optional device features found at device selection; each has a fallback
+typedef struct {
+    bool dynamicRendering;      // VK_KHR_dynamic_rendering, otherwise a render pass and framebuffers
+    bool dynamicFillMode;       // polygon and cull mode set while recording, so wireframes share pipelines
+    bool descriptorIndexing;    // update-after-bind texture array, otherwise a small texture set per frame
+    bool presentFences;         // VK_EXT_swapchain_maintenance1, otherwise presents are tracked through acquires
+} RenderFeatures;
+
+// Copy of the mesh in the scene, laid out as the std430 SceneObject of
+// cull.comp; its model matrix is rebuilt from this every frame
+typedef struct {
+    float position[4];          // where the mesh's center is placed
+    float scale;                // uniform scale mapping the bounds into a grid cell
+    float padding[3];
+} SceneObject;
+
+// Uniforms shared by every draw of a frame, laid out as the std140 Frame of
+// shader.vert
+typedef struct {
+    Mat4 viewProjection;
+    float lightDirection[4];    // xyz = unit vector towards the light
+} FrameUniforms;
+
+// Surface of one mesh subset, laid out as the std430 Material of shader.frag
+typedef struct {
+    float baseColor[4];
+    uint32_t texture;           // slot in the texture table, TEXTURE_TABLE_DEFAULT_SLOT for plain white
+    uint32_t padding[3];
+} Material;
+
 // Application structure
 typedef struct {
     GLFWwindow* window;
@@ -45,24 +228,154 @@ typedef struct {
     VkExtent2D swapchainExtent;
     VkImageView* swapchainImageViews;
     VkFramebuffer* swapchainFramebuffers;
-    VkRenderPass renderPass;
+    VkFormat depthFormat;
+    VkImage depthImage;                     // sized like the swapchain, shared by every frame in flight
+    VkImageView depthImageView;
+    GpuAllocation depthAllocation;
+    VkRenderPass renderPass;                // VK_NULL_HANDLE with dynamic rendering
+    RenderFeatures renderFeatures;
+    PFN_vkCmdBeginRenderingKHR cmdBeginRendering;
+    PFN_vkCmdEndRenderingKHR cmdEndRendering;
+    PFN_vkCmdSetPolygonModeEXT cmdSetPolygonMode;
+    PFN_vkCmdSetCullModeEXT cmdSetCullMode;
+    PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable;
+    PFN_vkCmdSetDepthCompareOpEXT cmdSetDepthCompareOp;
+    VkDescriptorSetLayout sceneSetLayout;
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    PipelineCache pipelineCache;
+    PipelineRegistry pipelines;
+    PipelineVariant pipelineVariant;        // variant drawn once it has compiled
+    VkPipeline currentPipeline;             // bound by this frame's secondaries
+    PipelineVariant drawnVariant;           // what currentPipeline draws, the default until the variant is ready
+    VkPhysicalDeviceFeatures enabledFeatures;
     VkCommandPool commandPool;
     VkCommandBuffer* commandBuffers;
-    VkSemaphore* imageAvailableSemaphores;
-    VkSemaphore* renderFinishedSemaphores;
-    VkFence* inFlightFences;
-    size_t currentFrame;
+    FrameScheduler frames;
+    GpuAllocation* offscreenAllocations;    // headless color targets
+    VkBuffer readbackBuffers[FRAME_SCHEDULER_MAX_FRAMES];
+    GpuAllocation readbackAllocations[FRAME_SCHEDULER_MAX_FRAMES];
+    Profiler profiler;
+    uint32_t frameNumber;                   // frames rendered with the mesh
+    uint32_t slotFrames[FRAME_SCHEDULER_MAX_FRAMES];
+    bool slotDrewScene[FRAME_SCHEDULER_MAX_FRAMES];
+    bool slotTexturesLoaded[FRAME_SCHEDULER_MAX_FRAMES];   // every texture was in the table or had failed
+    CullingStats slotStats[FRAME_SCHEDULER_MAX_FRAMES];   // clusters drawn by CPU culling
+    double* frameCpuMs;
+    double* frameInputToGpuMs;              // input sampled to frame finished on the GPU, before present
+    double* frameIntervalMs;                // between consecutive frames finishing on the GPU
+    double firstCompletedMs;                // reported frames finished between these two
+    double lastCompletedMs;
+    double* frameGpuMs;
+    double* frameCullMs;
+    double* frameMainPassMs;
+    double* framePrepassMs;                 // depth prepass and shading halves of the main pass, GPU culling only
+    double* frameShadingMs;
+    bool* frameTexturesLoaded;
+    CullingStats* frameStats;
+    CullingStats lastStats;                 // clusters drawn in the newest collected frame
+    uint32_t reportedFrames;
     bool framebufferResized;
+    bool swapchainChanged;      // present mode switched at runtime, rebuild the swapchain
+    VkPresentModeKHR presentModeRequest;    // chosen by options or P; kept across swapchain rebuilds
+    VkPresentModeKHR presentMode;           // what the current swapchain uses
+    RetiredSwapchain* retiredSwapchains;
+    uint32_t retiredSwapchainCount;
+    uint32_t retiredSwapchainCapacity;
+    bool surfaceMaintenance;                // instance has VK_EXT_surface_maintenance1, needed for present fences
+    PresentFence* presentFences;
+    uint32_t presentFenceCount;
+    uint32_t presentFenceCapacity;
+    uint64_t presentCount;                  // presents queued so far, across swapchains
+    uint64_t presentsReleased;              // presents the presentation engine is known to be done with
+    uint64_t* imagePresents;                // per swapchain image, the number of its last present, 0 if none
+    uint64_t slotAcquireValues[FRAME_SCHEDULER_MAX_FRAMES];     // frame that waited on the slot's acquire, 0 once seen
+    uint64_t slotAcquiredPresents[FRAME_SCHEDULER_MAX_FRAMES];  // last present of the image that acquire returned
+    uint32_t swapchainRebuilds;
+    uint32_t deferredRebuilds;              // optional rebuilds put off while too many swapchains were retired
+    double rebuildTotalMs;                  // render loop time spent rebuilding the swapchain
+    double rebuildMaxMs;
+    AppOptions options;
+    JobSystem jobs;
+    Mesh mesh;
+    MeshCacheMapping meshMapping;   // set when mesh points into a cache file
+    MeshSource meshSource;
+    double startTime;
+    bool firstFramePresented;
+    float meshCenter[3];
+    float meshScale;
+    PackedVertex* packedVertices;   // upload source in the packed format, released with the mesh
+    float positionMin[4];       // bounds the packed positions are quantized against
+    float positionExtent[4];
+    VkDeviceSize vertexBufferSize;
+    LodChain lods;              // simplified index buffers, released with the mesh
+    CullingLod lodLevels[LOD_MAX_LEVELS];   // clusters of every level
+    uint32_t lodCount;
+    bool lodEnabled;            // toggled with L
+    MeshletList clusters;       // every level's clusters, drawn and culled separately for every object
+    uint32_t clusterCount;      // clusters per object of the level that has the most, what culling covers
+    SceneObject* objects;
+    uint32_t objectCount;
+    Material* materials;        // one per mesh subset, copied into the uniform ring every frame
+    uint32_t materialCount;
+    uint32_t* materialTextures; // loader texture of each material, TEXTURE_LOADER_NONE without one
+    TextureLoader textureLoader;
+    bool reloadTextures;        // requested with T
+    ShaderWatcher shaderWatcher;
+    bool watchingShaders;
+    Mat4* transforms;           // model matrix of every object this frame, kept for CPU culling
+    UniformRing uniforms;       // per-frame FrameUniforms, transforms and materials
+    uint32_t uniformOffsets[3]; // dynamic offsets of this frame's FrameUniforms, transforms and materials
+    float spinAngle;            // radians the objects have turned
+    bool spinning;              // toggled with R
+    double lastSpinMs;
+    float viewPan[2];
+    float viewZoom;
+    float frustum[6][4];        // planes of the current view, see computeFrustum
+    CullingStats cpuStats;      // drawn by the current CPU-culled recording, updated atomically
+    CommandRecorder recorder;
+    CullingMode cullingMode;
+    const char* cullingFallback;    // why the GPU can't cull, NULL when it can
+    CullingContext culling;
+    GpuAllocator allocator;
+    UploadContext upload;
+    uint64_t sceneUploadTicket;
+    bool meshReady;             // mesh and object buffers uploaded and owned by the graphics queue
+    VkBuffer vertexBuffer;
+    GpuAllocation vertexAllocation;
+    VkBuffer indexBuffer;
+    GpuAllocation indexAllocation;
+    VkBuffer clusterBuffer;
+    GpuAllocation clusterAllocation;
+    VkBuffer objectBuffer;
+    GpuAllocation objectAllocation;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet sceneSet;
+    TextureTable textures;      // every texture the materials sample, descriptor set 1
+    VkDescriptorSet textureSet; // the texture table's set for this frame
+    uint32_t indexCount;
 } VulkanApp;
 
+// Bytes the materials take in each frame's uniform region. A descriptor
+// range can't be empty, so a mesh without subsets still gets one element.
+static inline VkDeviceSize materialRangeSize(const VulkanApp* app) {
+    return (VkDeviceSize)(app->materialCount ? app->materialCount : 1) * sizeof(Material);
+}
+
+// Push constants read by shader.vert: how the draws decode the bound vertex
+// buffer; the view and the objects' transforms come from the uniform ring
+typedef struct {
+    float positionMin[4];       // decodes packed positions, unused for float vertices
+    float positionExtent[4];
+} DrawPushConstants;
+
 // Queue family indices
 typedef struct {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    uint32_t transferFamily;    // transfer-only family, used for uploads when present
     bool hasGraphicsFamily;
     bool hasPresentFamily;
+    bool hasTransferFamily;
 } QueueFamilyIndices;
 
 // Swapchain support details
@@ -84,38 +397,126 @@ void pickPhysicalDevice(VulkanApp* app);
 void createLogicalDevice(VulkanApp* app);
 void createSurface(VulkanApp* app);
 void createSwapchain(VulkanApp* app);
+void createOffscreenTargets(VulkanApp* app);
 void createImageViews(VulkanApp* app);
+void createDepthResources(VulkanApp* app);
 void createRenderPass(VulkanApp* app);
+void createDescriptorSetLayout(VulkanApp* app);
+void createTextureTable(VulkanApp* app);
 void createGraphicsPipeline(VulkanApp* app);
 void createFramebuffers(VulkanApp* app);
 void createCommandPool(VulkanApp* app);
+void createCommandRecorder(VulkanApp* app);
+void createUploadContext(VulkanApp* app);
+void createUniformRing(VulkanApp* app);
+void createDescriptorSets(VulkanApp* app);
+void createCulling(VulkanApp* app);
+void createShaderWatcher(VulkanApp* app);
+void reloadShaders(VulkanApp* app);
+void reloadTextures(VulkanApp* app);
 void createCommandBuffers(VulkanApp* app);
 void createSyncObjects(VulkanApp* app);
+void createFrameReporting(VulkanApp* app);
+void collectFrame(VulkanApp* app, uint32_t slot);
+void printFrameSummary(VulkanApp* app);
+bool writePpm(const char* path, const uint8_t* rgba, uint32_t width, uint32_t height);
 void drawFrame(VulkanApp* app);
-void recreateSwapchain(VulkanApp* app);
+void beginMainPass(VulkanApp* app, VkCommandBuffer commandBuffer, uint32_t imageIndex, bool secondaries);
+void endMainPass(VulkanApp* app, VkCommandBuffer commandBuffer, uint32_t imageIndex);
+void describeMainPass(const VulkanApp* app, uint32_t imageIndex, VkCommandBufferInheritanceInfo* inheritance,
+                      VkCommandBufferInheritanceRenderingInfoKHR* rendering);
+bool recreateSwapchain(VulkanApp* app, bool required);
 void cleanupSwapchain(VulkanApp* app);
+void retireSwapchain(VulkanApp* app);
+void destroyRetiredSwapchains(VulkanApp* app, bool all);
+VkFence takePresentFence(VulkanApp* app);
+void updatePresentFences(VulkanApp* app);
+bool hasPendingPresents(const VulkanApp* app, VkSwapchainKHR swapchain);
+void destroyPresentFences(VulkanApp* app);
+bool parseArguments(AppOptions* options, int argc, char** argv);
+void benchmarkObjLoader(const AppOptions* options);
+void loadModel(VulkanApp* app);
+void releaseMesh(VulkanApp* app);
+void optimizeMesh(VulkanApp* app);
+void createMaterials(VulkanApp* app);
+void createScene(VulkanApp* app);
+void createLods(VulkanApp* app);
+void createClusters(VulkanApp* app);
+uint32_t createAllClusters(VulkanApp* app, bool meshlets);
+uint32_t createLevelClusters(VulkanApp* app, uint32_t level, bool meshlets);
+void createMeshBuffers(VulkanApp* app);
+void createSceneBuffers(VulkanApp* app);
+void computeFrustum(VulkanApp* app);
+void updateFrameUniforms(VulkanApp* app, uint32_t slot);
+bool sphereInFrustum(const float planes[6][4], const float center[3], float radius);
+float lodScale(const VulkanApp* app);
+uint32_t selectLod(const VulkanApp* app, const SceneObject* object, float scale);
+void bindScene(const VulkanApp* app, VkCommandBuffer commandBuffer, bool prepass);
+void recordObjectRange(VulkanApp* app, VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, bool prepass);
+void recordObjects(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, void* data);
+void recordPrepassObjects(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, void* data);
+void benchmarkRecording(VulkanApp* app);
 
 // Helper functions
 bool checkValidationLayerSupport();
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
-bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface);
+bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface, RenderFeatures* features);
+RenderFeatures queryRenderFeatures(VkPhysicalDevice device);
 bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+bool hasDeviceExtension(VkPhysicalDevice device, const char* extension);
+bool hasInstanceExtension(const char* extension);
 SwapchainSupportDetails querySwapchainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
+VkFormat chooseDepthFormat(VkPhysicalDevice device);
+const char* depthFormatName(VkFormat format);
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const VkSurfaceFormatKHR* formats, uint32_t formatCount);
-VkPresentModeKHR chooseSwapPresentMode(const VkPresentModeKHR* presentModes, uint32_t presentModeCount);
+VkPresentModeKHR chooseSwapPresentMode(const VkPresentModeKHR* presentModes, uint32_t presentModeCount,
+                                       VkPresentModeKHR requested);
+uint32_t chooseSwapImageCount(const VkSurfaceCapabilitiesKHR* capabilities, uint32_t requested);
+const char* presentModeName(VkPresentModeKHR presentMode);
 VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR* capabilities, GLFWwindow* window);
 VkShaderModule createShaderModule(VkDevice device, const char* filename);
+VkShaderModule createShaderModuleFromCode(VkDevice device, const uint32_t* code, size_t size);
 char* readFile(const char* filename, size_t* size);
 
 // GLFW callbacks
 static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
-int main() {
+int main(int argc, char** argv) {
     VulkanApp app = {0};
+    app.startTime = getTimeMs();
+    
+    if (!parseArguments(&app.options, argc, argv)) {
+        fprintf(stderr, "Usage: %s [--threads N] [--bench-obj] [--no-cache] [--headless] [--frames N] [--dump DIR] "
+                "[--profile-csv FILE] [--profile-trace FILE] [--shading lit|normals|uv] [--wireframe] [--stress N] "
+                "[--bench-record] [--cull gpu|cpu] [--zoom Z] [--no-meshlets] [--no-lod] [--lod-error PIXELS] "
+                "[--optimize none|cache|overdraw] [--vertex-format float|packed] [--frames-in-flight N] "
+                "[--pacing throughput|latency] [--present-mode immediate|mailbox|fifo|fifo-relaxed] "
+                "[--swapchain-images N] [--fps-limit FPS] [--benchmark] [--no-dynamic-rendering] [--depth-prepass] "
+                "[--spin DEGREES] [--no-bindless] [--texture-compression none|bc|bc7] [--watch-shaders] "
+                "[--shader-dir DIR] [model.obj]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
     
-    initWindow(&app);
+    if (app.options.benchmarkLoader) {
+        benchmarkObjLoader(&app.options);
+        return 0;
+    }
+    
+    app.presentModeRequest = app.options.presentMode;
+    app.presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+    jobSystemInit(&app.jobs, app.options.threadCount ? app.options.threadCount - 1 : jobSystemDefaultThreadCount());
+    textureLoaderInit(&app.textureLoader, &app.jobs, app.options.textureCompression);
+    loadModel(&app);
+    if (!app.options.headless) {
+        initWindow(&app);
+    }
     initVulkan(&app);
-    mainLoop(&app);
+    if (app.options.benchmarkRecording) {
+        benchmarkRecording(&app);
+    } else {
+        mainLoop(&app);
+    }
     cleanup(&app);
     
     return 0;
@@ -129,55 +530,156 @@ void initWindow(VulkanApp* app) {
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     
     // Create window
-    app->window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan Triangle", NULL, NULL);
+    app->window = glfwCreateWindow(WIDTH, HEIGHT, WINDOW_TITLE, NULL, NULL);
     glfwSetWindowUserPointer(app->window, app);
     glfwSetFramebufferSizeCallback(app->window, framebufferResizeCallback);
+    glfwSetKeyCallback(app->window, keyCallback);
 }
 
 void initVulkan(VulkanApp* app) {
     createInstance(app);
-    createSurface(app);
+    if (!app->options.headless) {
+        createSurface(app);
+    }
     pickPhysicalDevice(app);
     createLogicalDevice(app);
-    createSwapchain(app);
+    gpuAllocatorInit(&app->allocator, app->physicalDevice, app->device);
+    pipelineCacheInit(&app->pipelineCache, app->physicalDevice, app->device);
+    if (app->options.headless) {
+        createOffscreenTargets(app);
+    } else {
+        createSwapchain(app);
+    }
     createImageViews(app);
+    createDepthResources(app);
     createRenderPass(app);
+    createDescriptorSetLayout(app);
+    createTextureTable(app);
     createGraphicsPipeline(app);
     createFramebuffers(app);
     createCommandPool(app);
+    createCommandRecorder(app);
+    createUploadContext(app);
+    textureLoaderAttach(&app->textureLoader, &app->allocator, app->physicalDevice,
+                        app->enabledFeatures.textureCompressionBC, &app->upload, &app->textures);
+    createMeshBuffers(app);
+    createSceneBuffers(app);
+    createUniformRing(app);
+    createDescriptorSets(app);
+    createCulling(app);
     createCommandBuffers(app);
     createSyncObjects(app);
+    createFrameReporting(app);
+    createShaderWatcher(app);
 }
 
 void mainLoop(VulkanApp* app) {
-    while (!glfwWindowShouldClose(app->window)) {
-        glfwPollEvents();
+    uint32_t frameCount = app->options.frameCount;
+    
+    while (frameCount == 0 || app->frameNumber < frameCount) {
+        frameSchedulerThrottle(&app->frames);
+        
+        // Latency pacing blocks for a free slot first, so the input sampled
+        // next is as fresh as it can be when recording starts
+        if (app->frames.pacing == FRAME_PACING_LATENCY) {
+            frameSchedulerAcquire(&app->frames);
+        }
+        if (!app->options.headless) {
+            if (glfwWindowShouldClose(app->window)) {
+                break;
+            }
+            glfwPollEvents();
+        }
+        frameSchedulerSampleInput(&app->frames);
         drawFrame(app);
     }
     
     vkDeviceWaitIdle(app->device);
+    
+    // Report the frames still sitting in their slots, oldest first
+    for (uint32_t i = 0; i < app->frames.framesInFlight; i++) {
+        collectFrame(app, (app->frames.slot + i) % app->frames.framesInFlight);
+    }
+    if (frameCount > 0) {
+        printFrameSummary(app);
+    }
+    if (app->swapchainRebuilds > 0) {
+        printf("swapchain rebuilds: %u, render loop stalled %.3f ms on average, %.3f ms at most\n",
+               app->swapchainRebuilds, app->rebuildTotalMs / app->swapchainRebuilds, app->rebuildMaxMs);
+    }
+    if (app->deferredRebuilds > 0) {
+        printf("swapchain rebuilds put off for retiring swapchains: %u\n", app->deferredRebuilds);
+    }
 }
 
 void cleanup(VulkanApp* app) {
+    if (app->watchingShaders) {
+        shaderWatcherShutdown(&app->shaderWatcher);
+    }
+    destroyPresentFences(app);
+    destroyRetiredSwapchains(app, true);
+    free(app->retiredSwapchains);
     cleanupSwapchain(app);
     
     // Cleanup sync objects
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(app->device, app->renderFinishedSemaphores[i], NULL);
-        vkDestroySemaphore(app->device, app->imageAvailableSemaphores[i], NULL);
-        vkDestroyFence(app->device, app->inFlightFences[i], NULL);
-    }
-    free(app->imageAvailableSemaphores);
-    free(app->renderFinishedSemaphores);
-    free(app->inFlightFences);
+    frameSchedulerShutdown(&app->frames);
     
+    for (size_t i = 0; i < FRAME_SCHEDULER_MAX_FRAMES; i++) {
+        if (app->readbackBuffers[i] != VK_NULL_HANDLE) {
+            gpuDestroyBuffer(&app->allocator, app->readbackBuffers[i], &app->readbackAllocations[i]);
+        }
+    }
+    profilerShutdown(&app->profiler);
+    free(app->frameCpuMs);
+    free(app->frameGpuMs);
+    free(app->frameCullMs);
+    free(app->frameMainPassMs);
+    free(app->framePrepassMs);
+    free(app->frameShadingMs);
+    free(app->frameTexturesLoaded);
+    free(app->frameInputToGpuMs);
+    free(app->frameIntervalMs);
+    free(app->frameStats);
+    
+    textureLoaderShutdown(&app->textureLoader);
+    uploadShutdown(&app->upload);
+    releaseMesh(app);
+    
+    cullingShutdown(&app->culling);
+    vkDestroyDescriptorPool(app->device, app->descriptorPool, NULL);
+    textureTableShutdown(&app->textures);
+    uniformRingShutdown(&app->uniforms);
+    gpuDestroyBuffer(&app->allocator, app->objectBuffer, &app->objectAllocation);
+    gpuDestroyBuffer(&app->allocator, app->clusterBuffer, &app->clusterAllocation);
+    gpuDestroyBuffer(&app->allocator, app->indexBuffer, &app->indexAllocation);
+    gpuDestroyBuffer(&app->allocator, app->vertexBuffer, &app->vertexAllocation);
+    gpuAllocatorShutdown(&app->allocator);
+    
+    pipelineRegistryShutdown(&app->pipelines);
+    vkDestroyPipelineLayout(app->device, app->pipelineLayout, NULL);
+    vkDestroyDescriptorSetLayout(app->device, app->sceneSetLayout, NULL);
+    vkDestroyRenderPass(app->device, app->renderPass, NULL);
+    pipelineCacheShutdown(&app->pipelineCache);
+    
+    commandRecorderShutdown(&app->recorder);
     vkDestroyCommandPool(app->device, app->commandPool, NULL);
     vkDestroyDevice(app->device, NULL);
-    vkDestroySurfaceKHR(app->instance, app->surface, NULL);
+    if (app->surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(app->instance, app->surface, NULL);
+    }
     vkDestroyInstance(app->instance, NULL);
     
-    glfwDestroyWindow(app->window);
-    glfwTerminate();
+    if (app->window) {
+        glfwDestroyWindow(app->window);
+        glfwTerminate();
+    }
+    
+    jobSystemShutdown(&app->jobs);
+    free(app->objects);
+    free(app->transforms);
+    free(app->materials);
+    free(app->materialTextures);
+    meshletFree(&app->clusters);
 }
 
 void createInstance(VulkanApp* app) {
@@ -194,19 +696,35 @@ void createInstance(VulkanApp* app) {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_2;
     
     // Instance create info
     VkInstanceCreateInfo createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
     
-    // Get required extensions
+    // Get required extensions; headless runs need no surface extensions.
+    // Present fences need surface maintenance, enabled when there is one
     uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char** glfwExtensions = NULL;
+    if (!app->options.headless) {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    }
+    const char** extensions = malloc((glfwExtensionCount + 2) * sizeof(const char*));
+    uint32_t extensionCount = 0;
+    for (uint32_t i = 0; i < glfwExtensionCount; i++) {
+        extensions[extensionCount++] = glfwExtensions[i];
+    }
+    app->surfaceMaintenance = !app->options.headless &&
+                              hasInstanceExtension(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME) &&
+                              hasInstanceExtension(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+    if (app->surfaceMaintenance) {
+        extensions[extensionCount++] = VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME;
+        extensions[extensionCount++] = VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME;
+    }
     
-    createInfo.enabledExtensionCount = glfwExtensionCount;
-    createInfo.ppEnabledExtensionNames = glfwExtensions;
+    createInfo.enabledExtensionCount = extensionCount;
+    createInfo.ppEnabledExtensionNames = extensions;
     
     // Enable validation layers if needed
     if (enableValidationLayers) {
@@ -221,6 +739,7 @@ void createInstance(VulkanApp* app) {
         fprintf(stderr, "Failed to create instance!\n");
         exit(EXIT_FAILURE);
     }
+    free(extensions);
 }
 
 void createSurface(VulkanApp* app) {
@@ -244,8 +763,10 @@ void pickPhysicalDevice(VulkanApp* app) {
     
     app->physicalDevice = VK_NULL_HANDLE;
     for (uint32_t i = 0; i < deviceCount; i++) {
-        if (isDeviceSuitable(devices[i], app->surface)) {
+        RenderFeatures features;
+        if (isDeviceSuitable(devices[i], app->surface, &features)) {
             app->physicalDevice = devices[i];
+            app->renderFeatures = features;
             break;
         }
     }
@@ -256,15 +777,41 @@ void pickPhysicalDevice(VulkanApp* app) {
         fprintf(stderr, "Failed to find a suitable GPU!\n");
         exit(EXIT_FAILURE);
     }
+    
+    if (app->options.disableDynamicRendering) {
+        app->renderFeatures.dynamicRendering = false;
+    }
+    if (app->options.disableBindless) {
+        app->renderFeatures.descriptorIndexing = false;
+    }
+    if (!app->surfaceMaintenance) {
+        app->renderFeatures.presentFences = false;
+    }
+    app->depthFormat = chooseDepthFormat(app->physicalDevice);
+    printf("Rendering through %s, %s fill mode, %s reverse-Z depth%s\n",
+           app->renderFeatures.dynamicRendering ? "dynamic rendering" : "a render pass",
+           app->renderFeatures.dynamicFillMode ? "dynamic" : "per-pipeline", depthFormatName(app->depthFormat),
+           app->options.depthPrepass ? " with a prepass" : "");
+    if (!app->options.headless) {
+        printf("Old swapchains are destroyed once %s\n",
+               app->renderFeatures.presentFences ? "their present fences signal" : "newer frames have acquired");
+    }
 }
 
 void createLogicalDevice(VulkanApp* app) {
     QueueFamilyIndices indices = findQueueFamilies(app->physicalDevice, app->surface);
     
-    // Create queue create infos
-    VkDeviceQueueCreateInfo queueCreateInfos[2];
-    uint32_t uniqueQueueFamilies[] = {indices.graphicsFamily, indices.presentFamily};
-    uint32_t queueCreateInfoCount = (indices.graphicsFamily == indices.presentFamily) ? 1 : 2;
+    // Create queue create infos, one per distinct family
+    VkDeviceQueueCreateInfo queueCreateInfos[3];
+    uint32_t uniqueQueueFamilies[3];
+    uint32_t queueCreateInfoCount = 0;
+    uniqueQueueFamilies[queueCreateInfoCount++] = indices.graphicsFamily;
+    if (indices.presentFamily != indices.graphicsFamily) {
+        uniqueQueueFamilies[queueCreateInfoCount++] = indices.presentFamily;
+    }
+    if (indices.hasTransferFamily && indices.transferFamily != indices.presentFamily) {
+        uniqueQueueFamilies[queueCreateInfoCount++] = indices.transferFamily;
+    }
     
     float queuePriority = 1.0f;
     for (uint32_t i = 0; i < queueCreateInfoCount; i++) {
@@ -276,17 +823,101 @@ void createLogicalDevice(VulkanApp* app) {
         queueCreateInfos[i] = queueCreateInfo;
     }
     
-    // Device features
+    // GPU culling draws every cluster of every object from one indirect
+    // call, picking the object through firstInstance; the clusters are known
+    // by now, so the call's draw count is checked against the device's limit
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(app->physicalDevice, &supportedFeatures);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(app->physicalDevice, &properties);
+    uint64_t draws = (uint64_t)app->objectCount * app->clusterCount;
+    if (!supportedFeatures.multiDrawIndirect || !supportedFeatures.drawIndirectFirstInstance) {
+        app->cullingFallback = "no multiDrawIndirect or drawIndirectFirstInstance";
+    } else if (draws > CULLING_MAX_DRAWS) {
+        app->cullingFallback = "more clusters than the draw buffers hold";
+    } else if (draws > properties.limits.maxDrawIndirectCount) {
+        app->cullingFallback = "more clusters than maxDrawIndirectCount";
+    }
+    if (app->options.cpuCulling || app->cullingFallback) {
+        app->cullingMode = CULLING_MODE_CPU;
+    } else if (hasDeviceExtension(app->physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+        app->cullingMode = CULLING_MODE_INDIRECT_COUNT;
+    } else {
+        app->cullingMode = CULLING_MODE_INDIRECT;
+    }
+    
+    // Device features; wireframe pipelines need fillModeNonSolid
     VkPhysicalDeviceFeatures deviceFeatures = {0};
+    deviceFeatures.fillModeNonSolid = supportedFeatures.fillModeNonSolid;
+    deviceFeatures.multiDrawIndirect = app->cullingMode != CULLING_MODE_CPU;
+    deviceFeatures.drawIndirectFirstInstance = app->cullingMode != CULLING_MODE_CPU;
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    app->enabledFeatures = deviceFeatures;
+    
+    // Frame pacing runs on a timeline semaphore, core and mandatory since 1.2;
+    // the texture table needs descriptor indexing's update-after-bind array
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {0};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+    if (app->renderFeatures.descriptorIndexing) {
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+    }
+    
+    // Headless runs present nothing and need no swapchain
+    const char* extensions[6];
+    uint32_t extensionCount = 0;
+    if (!app->options.headless) {
+        extensions[extensionCount++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    }
+    if (app->cullingMode == CULLING_MODE_INDIRECT_COUNT) {
+        extensions[extensionCount++] = VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+    }
+    
+    // The optional rendering features isDeviceSuitable found
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {0};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+    if (app->renderFeatures.dynamicRendering) {
+        extensions[extensionCount++] = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+        dynamicRenderingFeatures.pNext = vulkan12Features.pNext;
+        vulkan12Features.pNext = &dynamicRenderingFeatures;
+    }
+    
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {0};
+    dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features = {0};
+    dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+    dynamicState3Features.extendedDynamicState3PolygonMode = VK_TRUE;
+    if (app->renderFeatures.dynamicFillMode) {
+        extensions[extensionCount++] = VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME;
+        extensions[extensionCount++] = VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME;
+        dynamicStateFeatures.pNext = &dynamicState3Features;
+        dynamicState3Features.pNext = vulkan12Features.pNext;
+        vulkan12Features.pNext = &dynamicStateFeatures;
+    }
+    
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenanceFeatures = {0};
+    swapchainMaintenanceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+    swapchainMaintenanceFeatures.swapchainMaintenance1 = VK_TRUE;
+    if (app->renderFeatures.presentFences) {
+        extensions[extensionCount++] = VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME;
+        swapchainMaintenanceFeatures.pNext = vulkan12Features.pNext;
+        vulkan12Features.pNext = &swapchainMaintenanceFeatures;
+    }
     
     // Device create info
     VkDeviceCreateInfo createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &vulkan12Features;
     createInfo.queueCreateInfoCount = queueCreateInfoCount;
     createInfo.pQueueCreateInfos = queueCreateInfos;
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = 1;
-    createInfo.ppEnabledExtensionNames = deviceExtensions;
+    createInfo.enabledExtensionCount = extensionCount;
+    createInfo.ppEnabledExtensionNames = extensions;
     
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = 1;
@@ -304,19 +935,40 @@ void createLogicalDevice(VulkanApp* app) {
     // Get queue handles
     vkGetDeviceQueue(app->device, indices.graphicsFamily, 0, &app->graphicsQueue);
     vkGetDeviceQueue(app->device, indices.presentFamily, 0, &app->presentQueue);
+    
+    // Extension commands aren't exported by the loader
+    if (app->renderFeatures.dynamicRendering) {
+        app->cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(app->device, "vkCmdBeginRenderingKHR");
+        app->cmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(app->device, "vkCmdEndRenderingKHR");
+    }
+    if (app->renderFeatures.dynamicFillMode) {
+        app->cmdSetPolygonMode = (PFN_vkCmdSetPolygonModeEXT)vkGetDeviceProcAddr(app->device, "vkCmdSetPolygonModeEXT");
+        app->cmdSetCullMode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(app->device, "vkCmdSetCullModeEXT");
+        app->cmdSetDepthWriteEnable = (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(
+            app->device, "vkCmdSetDepthWriteEnableEXT");
+        app->cmdSetDepthCompareOp = (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(
+            app->device, "vkCmdSetDepthCompareOpEXT");
+    }
 }
 
 void createSwapchain(VulkanApp* app) {
     SwapchainSupportDetails swapchainSupport = querySwapchainSupport(app->physicalDevice, app->surface);
     
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapchainSupport.formats, swapchainSupport.formatCount);
-    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapchainSupport.presentModes, swapchainSupport.presentModeCount);
+    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapchainSupport.presentModes, swapchainSupport.presentModeCount,
+                                                         app->presentModeRequest);
     VkExtent2D extent = chooseSwapExtent(&swapchainSupport.capabilities, app->window);
+    uint32_t imageCount = chooseSwapImageCount(&swapchainSupport.capabilities, app->options.swapchainImages);
     
-    uint32_t imageCount = swapchainSupport.capabilities.minImageCount + 1;
-    if (swapchainSupport.capabilities.maxImageCount > 0 && imageCount > swapchainSupport.capabilities.maxImageCount) {
-        imageCount = swapchainSupport.capabilities.maxImageCount;
+    // Rebuilds keep the choice; only report when it changes
+    if (presentMode != app->presentMode) {
+        if (app->presentModeRequest != VK_PRESENT_MODE_MAX_ENUM_KHR && presentMode != app->presentModeRequest) {
+            printf("Present mode %s is not supported, using %s\n", presentModeName(app->presentModeRequest),
+                   presentModeName(presentMode));
+        }
+        printf("Swapchain: %s, %u images requested\n", presentModeName(presentMode), imageCount);
     }
+    app->presentMode = presentMode;
     
     VkSwapchainCreateInfoKHR createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -345,7 +997,7 @@ void createSwapchain(VulkanApp* app) {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    createInfo.oldSwapchain = app->swapchain;   // the chain being replaced, if any
     
     if (vkCreateSwapchainKHR(app->device, &createInfo, NULL, &app->swapchain) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create swap chain!\n");
@@ -356,6 +1008,7 @@ void createSwapchain(VulkanApp* app) {
     vkGetSwapchainImagesKHR(app->device, app->swapchain, &app->swapchainImageCount, NULL);
     app->swapchainImages = malloc(app->swapchainImageCount * sizeof(VkImage));
     vkGetSwapchainImagesKHR(app->device, app->swapchain, &app->swapchainImageCount, app->swapchainImages);
+    app->imagePresents = calloc(app->swapchainImageCount, sizeof(uint64_t));
     
     app->swapchainImageFormat = surfaceFormat.format;
     app->swapchainExtent = extent;
@@ -365,6 +1018,36 @@ void createSwapchain(VulkanApp* app) {
     free(swapchainSupport.presentModes);
 }
 
+void createOffscreenTargets(VulkanApp* app) {
+    app->swapchainImageFormat = HEADLESS_FORMAT;
+    app->swapchainExtent.width = WIDTH;
+    app->swapchainExtent.height = HEIGHT;
+    app->swapchainImageCount = app->options.framesInFlight;
+    app->swapchainImages = malloc(app->swapchainImageCount * sizeof(VkImage));
+    app->offscreenAllocations = calloc(app->swapchainImageCount, sizeof(GpuAllocation));
+    
+    VkImageCreateInfo imageInfo = {0};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = app->swapchainImageFormat;
+    imageInfo.extent.width = app->swapchainExtent.width;
+    imageInfo.extent.height = app->swapchainExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    
+    // One target per frame slot stands in for the swapchain images
+    for (uint32_t i = 0; i < app->swapchainImageCount; i++) {
+        gpuCreateImage(&app->allocator, &imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                       &app->swapchainImages[i], &app->offscreenAllocations[i]);
+    }
+}
+
 void createImageViews(VulkanApp* app) {
     app->swapchainImageViews = malloc(app->swapchainImageCount * sizeof(VkImageView));
     
@@ -391,7 +1074,46 @@ void createImageViews(VulkanApp* app) {
     }
 }
 
+void createDepthResources(VulkanApp* app) {
+    // One image is enough: the frames in flight use it one after the other
+    VkImageCreateInfo imageInfo = {0};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = app->depthFormat;
+    imageInfo.extent.width = app->swapchainExtent.width;
+    imageInfo.extent.height = app->swapchainExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    gpuCreateImage(&app->allocator, &imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &app->depthImage,
+                   &app->depthAllocation);
+    
+    VkImageViewCreateInfo viewInfo = {0};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = app->depthImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = app->depthFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    
+    if (vkCreateImageView(app->device, &viewInfo, NULL, &app->depthImageView) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create depth image view!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
 void createRenderPass(VulkanApp* app) {
+    // Dynamic rendering names its attachments when the pass begins
+    if (app->renderFeatures.dynamicRendering) {
+        return;
+    }
+    
     VkAttachmentDescription colorAttachment = {0};
     colorAttachment.format = app->swapchainImageFormat;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -400,29 +1122,50 @@ void createRenderPass(VulkanApp* app) {
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // Headless frames are copied out instead of presented
+    colorAttachment.finalLayout = app->options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                                        : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    
+    // Depth only lives through the pass
+    VkAttachmentDescription depthAttachment = {0};
+    depthAttachment.format = app->depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     
     VkAttachmentReference colorAttachmentRef = {0};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     
+    VkAttachmentReference depthAttachmentRef = {0};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    
     VkSubpassDescription subpass = {0};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
     
+    // The depth image is shared, so the previous frame's depth writes must
+    // be done before this frame clears it
     VkSubpassDependency dependency = {0};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     
+    VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment};
     VkRenderPassCreateInfo renderPassInfo = {0};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = 2;
+    renderPassInfo.pAttachments = attachments;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
     renderPassInfo.dependencyCount = 1;
@@ -434,145 +1177,108 @@ void createRenderPass(VulkanApp* app) {
     }
 }
 
+void createDescriptorSetLayout(VulkanApp* app) {
+    // The frame's uniforms and every object's model matrix, read by
+    // shader.vert, and the materials read by shader.frag; all move through
+    // the uniform ring by dynamic offset. Textures are set 1, see createTextureTable.
+    VkDescriptorSetLayoutBinding bindings[3] = {{0}};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    bindings[2].descriptorCount = 1;
+    bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+    
+    if (vkCreateDescriptorSetLayout(app->device, &layoutInfo, NULL, &app->sceneSetLayout) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create descriptor set layout!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void createTextureTable(VulkanApp* app) {
+    // One array serves every material; the default texture is cleared on the
+    // graphics queue before anything else runs on it
+    QueueFamilyIndices indices = findQueueFamilies(app->physicalDevice, app->surface);
+    textureTableInit(&app->textures, &app->allocator, app->physicalDevice, app->graphicsQueue, indices.graphicsFamily,
+                     app->renderFeatures.descriptorIndexing,
+                     app->enabledFeatures.shaderSampledImageArrayDynamicIndexing, app->options.framesInFlight);
+    printf("Texture table: %u slots, %s\n", app->textures.capacity,
+           app->textures.bindless ? "bindless" : "one set per frame");
+}
+
 void createGraphicsPipeline(VulkanApp* app) {
-    // Load shaders
-    VkShaderModule vertShaderModule = createShaderModule(app->device, "vert.spv");
-    VkShaderModule fragShaderModule = createShaderModule(app->device, "frag.spv");
-    
-    // Vertex shader stage
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {0};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
-    
-    // Fragment shader stage
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo = {0};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
-    
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-    
-    // Vertex input (no vertex buffers since we hardcode vertices)
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {0};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 0;
-    vertexInputInfo.pVertexBindingDescriptions = NULL;
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
-    vertexInputInfo.pVertexAttributeDescriptions = NULL;
-    
-    // Input assembly
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {0};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssembly.primitiveRestartEnable = VK_FALSE;
-    
-    // Viewport and scissor
-    VkViewport viewport = {0};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) app->swapchainExtent.width;
-    viewport.height = (float) app->swapchainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    
-    VkRect2D scissor = {0};
-    scissor.offset.x = 0;
-    scissor.offset.y = 0;
-    scissor.extent = app->swapchainExtent;
-    
-    VkPipelineViewportStateCreateInfo viewportState = {0};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
-    
-    // Rasterizer
-    VkPipelineRasterizationStateCreateInfo rasterizer = {0};
-    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-    
-    // Multisampling
-    VkPipelineMultisampleStateCreateInfo multisampling = {0};
-    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    
-    // Color blending
-    VkPipelineColorBlendAttachmentState colorBlendAttachment = {0};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-    
-    VkPipelineColorBlendStateCreateInfo colorBlending = {0};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-    
     // Pipeline layout
+    VkPushConstantRange pushConstantRange = {0};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DrawPushConstants);
+    
+    VkDescriptorSetLayout setLayouts[2] = {app->sceneSetLayout, app->textures.setLayout};
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pSetLayouts = NULL;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = NULL;
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
     
     if (vkCreatePipelineLayout(app->device, &pipelineLayoutInfo, NULL, &app->pipelineLayout) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create pipeline layout!\n");
         exit(EXIT_FAILURE);
     }
     
-    // Graphics pipeline
-    VkGraphicsPipelineCreateInfo pipelineInfo = {0};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = NULL;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = NULL;
-    pipelineInfo.layout = app->pipelineLayout;
-    pipelineInfo.renderPass = app->renderPass;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineInfo.basePipelineIndex = -1;
-    
-    if (vkCreateGraphicsPipelines(app->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &app->graphicsPipeline) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create graphics pipeline!\n");
-        exit(EXIT_FAILURE);
-    }
-    
-    // Cleanup shader modules
-    vkDestroyShaderModule(app->device, fragShaderModule, NULL);
-    vkDestroyShaderModule(app->device, vertShaderModule, NULL);
+    // Every variant shares the layout and shaders; they differ in specialization and raster state
+    PipelineDescription description = {0};
+    description.renderPass = app->renderPass;
+    description.colorFormat = app->swapchainImageFormat;
+    description.depthFormat = app->depthFormat;
+    description.layout = app->pipelineLayout;
+    description.vertexShader = createShaderModule(app->device, "vert.spv");
+    description.fragmentShader = createShaderModule(app->device, "frag.spv");
+    description.wireframeSupported = app->enabledFeatures.fillModeNonSolid;
+    description.dynamicFillMode = app->renderFeatures.dynamicFillMode;
+    description.depthPrepass = app->options.depthPrepass;
+    description.vertexFormat = app->options.vertexFormat;
+    description.textureCapacity = app->textures.capacity;
+    
+    pipelineRegistryInit(&app->pipelines, app->device, app->pipelineCache.cache, &app->jobs, &description);
+    printf("Graphics pipeline created in %.2f ms (%s pipeline cache)\n", app->pipelines.entries[0].compileMs,
+           app->pipelineCache.warm ? "warm" : "cold");
+    
+    // Start compiling the requested variant; the default one is drawn meanwhile
+    app->pipelineVariant = app->options.pipelineVariant;
+    pipelineRegistryRequest(&app->pipelines, app->pipelineVariant);
 }
 
 void createFramebuffers(VulkanApp* app) {
+    // Dynamic rendering draws straight to the image views
+    if (app->renderFeatures.dynamicRendering) {
+        app->swapchainFramebuffers = NULL;
+        return;
+    }
+    
     app->swapchainFramebuffers = malloc(app->swapchainImageCount * sizeof(VkFramebuffer));
     
     for (uint32_t i = 0; i < app->swapchainImageCount; i++) {
         VkImageView attachments[] = {
-            app->swapchainImageViews[i]
+            app->swapchainImageViews[i],
+            app->depthImageView
         };
         
         VkFramebufferCreateInfo framebufferInfo = {0};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebufferInfo.renderPass = app->renderPass;
-        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.attachmentCount = 2;
         framebufferInfo.pAttachments = attachments;
         framebufferInfo.width = app->swapchainExtent.width;
         framebufferInfo.height = app->swapchainExtent.height;
@@ -599,14 +1305,187 @@ void createCommandPool(VulkanApp* app) {
     }
 }
 
+void createCommandRecorder(VulkanApp* app) {
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(app->physicalDevice, app->surface);
+    commandRecorderInit(&app->recorder, app->device, queueFamilyIndices.graphicsFamily, &app->jobs,
+                        app->options.framesInFlight);
+}
+
+void createUploadContext(VulkanApp* app) {
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(app->physicalDevice, app->surface);
+    uint32_t uploadFamily = queueFamilyIndices.hasTransferFamily ? queueFamilyIndices.transferFamily
+                                                                  : queueFamilyIndices.graphicsFamily;
+    
+    uploadInit(&app->upload, &app->allocator, app->device, uploadFamily, queueFamilyIndices.graphicsFamily);
+    printf("Uploads use %s queue family %u\n", queueFamilyIndices.hasTransferFamily ? "transfer" : "graphics",
+           uploadFamily);
+}
+
+void createUniformRing(VulkanApp* app) {
+    // Every frame writes its uniforms, one matrix per object and the materials
+    VkDeviceSize frameSize = sizeof(FrameUniforms) + (VkDeviceSize)app->objectCount * sizeof(Mat4) +
+                             materialRangeSize(app);
+    uniformRingInit(&app->uniforms, &app->allocator, app->physicalDevice, frameSize, 3, app->options.framesInFlight);
+    printf("Uniform ring: %u regions of %.1f KB\n", app->uniforms.frameCount, app->uniforms.regionSize / 1024.0);
+}
+
+void createDescriptorSets(VulkanApp* app) {
+    VkDescriptorPoolSize poolSizes[2] = {{0}};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = 1;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[1].descriptorCount = 2;
+    
+    VkDescriptorPoolCreateInfo poolInfo = {0};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    
+    if (vkCreateDescriptorPool(app->device, &poolInfo, NULL, &app->descriptorPool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create descriptor pool!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    VkDescriptorSetAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = app->descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &app->sceneSetLayout;
+    
+    if (vkAllocateDescriptorSets(app->device, &allocInfo, &app->sceneSet) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate descriptor set!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    // Written once; each frame only moves the dynamic offsets to its region
+    VkDescriptorBufferInfo bufferInfos[3] = {{0}};
+    bufferInfos[0].buffer = app->uniforms.buffer;
+    bufferInfos[0].range = sizeof(FrameUniforms);
+    bufferInfos[1].buffer = app->uniforms.buffer;
+    bufferInfos[1].range = (VkDeviceSize)app->objectCount * sizeof(Mat4);
+    bufferInfos[2].buffer = app->uniforms.buffer;
+    bufferInfos[2].range = materialRangeSize(app);
+    
+    VkWriteDescriptorSet writes[3] = {{0}};
+    for (uint32_t binding = 0; binding < 3; binding++) {
+        writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[binding].dstSet = app->sceneSet;
+        writes[binding].dstBinding = binding;
+        writes[binding].descriptorCount = 1;
+        writes[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+                                                      : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        writes[binding].pBufferInfo = &bufferInfos[binding];
+    }
+    vkUpdateDescriptorSets(app->device, 3, writes, 0, NULL);
+}
+
+void createCulling(VulkanApp* app) {
+    VkShaderModule shader = VK_NULL_HANDLE;
+    if (app->cullingMode != CULLING_MODE_CPU) {
+        shader = createShaderModule(app->device, "cull.spv");
+    }
+    cullingInit(&app->culling, &app->allocator, app->device, app->pipelineCache.cache, shader, app->cullingMode,
+                app->objectBuffer, app->objectCount, app->uniforms.buffer, app->clusterBuffer, app->clusterCount,
+                app->lodLevels, app->lodCount, app->options.framesInFlight);
+    if (shader != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(app->device, shader, NULL);
+    }
+    
+    if (app->cullingFallback && !app->options.cpuCulling) {
+        printf("Culling %u objects of %u clusters on the %s (%s)\n", app->objectCount, app->clusterCount,
+               cullingModeName(app->cullingMode), app->cullingFallback);
+    } else {
+        printf("Culling %u objects of %u clusters on the %s\n", app->objectCount, app->clusterCount,
+               cullingModeName(app->cullingMode));
+    }
+}
+
+void createShaderWatcher(VulkanApp* app) {
+    if (!app->options.shaderDirectory) {
+        return;
+    }
+    
+    // Without inotify the shaders built at startup simply stay
+    app->watchingShaders = shaderWatcherInit(&app->shaderWatcher, app->options.shaderDirectory,
+                                             SCOP_GLSLANG_VALIDATOR);
+    if (app->watchingShaders) {
+        printf("Watching %s for shader changes\n", app->options.shaderDirectory);
+    }
+}
+
+void reloadShaders(VulkanApp* app) {
+    // Modules of the shaders recompiled since the last frame
+    VkShaderModule modules[WATCHED_SHADER_COUNT] = {VK_NULL_HANDLE};
+    for (uint32_t i = 0; app->watchingShaders && i < WATCHED_SHADER_COUNT; i++) {
+        ShaderBinary binary;
+        if (shaderWatcherTake(&app->shaderWatcher, (WatchedShader)i, &binary)) {
+            modules[i] = createShaderModuleFromCode(app->device, binary.code, binary.size);
+            free(binary.code);
+            if (modules[i] == VK_NULL_HANDLE) {
+                fprintf(stderr, "The device rejected %s, keeping the running version\n",
+                        watchedShaderName((WatchedShader)i));
+            }
+        }
+    }
+    
+    // Frames already submitted keep the pipelines they were recorded with;
+    // the replaced ones go once the timeline passes the newest of them
+    uint64_t lastSubmitted = frameSchedulerLastSubmitted(&app->frames);
+    if (modules[WATCHED_SHADER_VERTEX] != VK_NULL_HANDLE || modules[WATCHED_SHADER_FRAGMENT] != VK_NULL_HANDLE) {
+        pipelineRegistryReload(&app->pipelines, modules[WATCHED_SHADER_VERTEX], modules[WATCHED_SHADER_FRAGMENT]);
+    }
+    
+    // A single small compute pipeline, rebuilt right away
+    if (modules[WATCHED_SHADER_CULL] != VK_NULL_HANDLE) {
+        if (app->culling.mode != CULLING_MODE_CPU) {
+            double start = getTimeMs();
+            VkPipeline replaced = cullingReplaceShader(&app->culling, app->pipelineCache.cache,
+                                                       modules[WATCHED_SHADER_CULL]);
+            if (replaced != VK_NULL_HANDLE) {
+                pipelineRegistryRetire(&app->pipelines, replaced, lastSubmitted);
+                printf("Shader reload: culling pipeline rebuilt in %.2f ms\n", getTimeMs() - start);
+            }
+        }
+        vkDestroyShaderModule(app->device, modules[WATCHED_SHADER_CULL], NULL);
+    }
+    
+    pipelineRegistryUpdate(&app->pipelines, lastSubmitted, frameSchedulerCompletedValue(&app->frames));
+}
+
+void reloadTextures(VulkanApp* app) {
+    // Frames already submitted may still sample the old slots, which the
+    // table recycles once the timeline passes the newest of them; textures
+    // still loading or encoding keep going and aren't reloaded
+    app->reloadTextures = false;
+    uint64_t lastSubmitted = frameSchedulerLastSubmitted(&app->frames);
+    uint32_t unloaded = 0;
+    for (uint32_t i = 0; i < app->textureLoader.count; i++) {
+        if (textureLoaderUnload(&app->textureLoader, i, lastSubmitted)) {
+            textureLoaderRequest(&app->textureLoader, app->textureLoader.textures[i]->path);
+            unloaded++;
+        }
+    }
+    
+    // Until they are back, their materials draw with the default texture
+    for (uint32_t i = 0; i < app->materialCount; i++) {
+        uint32_t slot;
+        if (app->materialTextures[i] != TEXTURE_LOADER_NONE &&
+            !textureLoaderSlot(&app->textureLoader, app->materialTextures[i], &slot)) {
+            app->materials[i].texture = TEXTURE_TABLE_DEFAULT_SLOT;
+        }
+    }
+    printf("Reloading %u textures\n", unloaded);
+}
+
 void createCommandBuffers(VulkanApp* app) {
-    app->commandBuffers = malloc(MAX_FRAMES_IN_FLIGHT * sizeof(VkCommandBuffer));
+    app->commandBuffers = malloc(app->options.framesInFlight * sizeof(VkCommandBuffer));
     
     VkCommandBufferAllocateInfo allocInfo = {0};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = app->commandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+    allocInfo.commandBufferCount = app->options.framesInFlight;
     
     if (vkAllocateCommandBuffers(app->device, &allocInfo, app->commandBuffers) != VK_SUCCESS) {
         fprintf(stderr, "Failed to allocate command buffers!\n");
@@ -615,116 +1494,326 @@ void createCommandBuffers(VulkanApp* app) {
 }
 
 void createSyncObjects(VulkanApp* app) {
-    app->imageAvailableSemaphores = malloc(MAX_FRAMES_IN_FLIGHT * sizeof(VkSemaphore));
-    app->renderFinishedSemaphores = malloc(MAX_FRAMES_IN_FLIGHT * sizeof(VkSemaphore));
-    app->inFlightFences = malloc(MAX_FRAMES_IN_FLIGHT * sizeof(VkFence));
+    // One timeline semaphore paces every frame slot, see frame_scheduler.h
+    frameSchedulerInit(&app->frames, app->device, app->options.framesInFlight, app->options.pacing);
+    frameSchedulerSetLimit(&app->frames, app->options.fpsLimit);
+}
+
+void createFrameReporting(VulkanApp* app) {
+    for (uint32_t i = 0; i < FRAME_SCHEDULER_MAX_FRAMES; i++) {
+        app->slotFrames[i] = NO_FRAME;
+    }
     
-    VkSemaphoreCreateInfo semaphoreInfo = {0};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    if (app->options.frameCount > 0) {
+        app->frameCpuMs = calloc(app->options.frameCount, sizeof(double));
+        app->frameGpuMs = calloc(app->options.frameCount, sizeof(double));
+        app->frameCullMs = calloc(app->options.frameCount, sizeof(double));
+        app->frameMainPassMs = calloc(app->options.frameCount, sizeof(double));
+        app->framePrepassMs = calloc(app->options.frameCount, sizeof(double));
+        app->frameShadingMs = calloc(app->options.frameCount, sizeof(double));
+        app->frameTexturesLoaded = calloc(app->options.frameCount, sizeof(bool));
+        app->frameInputToGpuMs = calloc(app->options.frameCount, sizeof(double));
+        app->frameIntervalMs = calloc(app->options.frameCount, sizeof(double));
+        app->frameStats = calloc(app->options.frameCount, sizeof(CullingStats));
+    }
     
-    VkFenceCreateInfo fenceInfo = {0};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    // CPU spans and GPU scopes of every frame, timed on the graphics queue
+    QueueFamilyIndices indices = findQueueFamilies(app->physicalDevice, app->surface);
+    profilerInit(&app->profiler, app->physicalDevice, app->device, indices.graphicsFamily,
+                 app->options.framesInFlight);
     
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(app->device, &semaphoreInfo, NULL, &app->imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(app->device, &semaphoreInfo, NULL, &app->renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(app->device, &fenceInfo, NULL, &app->inFlightFences[i]) != VK_SUCCESS) {
-            
-            fprintf(stderr, "Failed to create synchronization objects for a frame!\n");
+    if (app->options.profileCsvPath && !profilerOpenCsv(&app->profiler, app->options.profileCsvPath)) {
+        fprintf(stderr, "Failed to create profile CSV: %s\n", app->options.profileCsvPath);
+        exit(EXIT_FAILURE);
+    }
+    if (app->options.profileTracePath && !profilerOpenTrace(&app->profiler, app->options.profileTracePath)) {
+        fprintf(stderr, "Failed to create profile trace: %s\n", app->options.profileTracePath);
+        exit(EXIT_FAILURE);
+    }
+    
+    if (app->options.dumpDirectory) {
+        if (mkdir(app->options.dumpDirectory, 0755) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Failed to create dump directory: %s\n", app->options.dumpDirectory);
             exit(EXIT_FAILURE);
         }
+        
+        VkDeviceSize frameSize = (VkDeviceSize)app->swapchainExtent.width * app->swapchainExtent.height * 4;
+        for (uint32_t i = 0; i < app->options.framesInFlight; i++) {
+            gpuCreateBuffer(&app->allocator, frameSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &app->readbackBuffers[i], &app->readbackAllocations[i]);
+        }
     }
 }
 
 void drawFrame(VulkanApp* app) {
-    // Wait for the previous frame to finish
-    vkWaitForFences(app->device, 1, &app->inFlightFences[app->currentFrame], VK_TRUE, UINT64_MAX);
-    
-    // Acquire an image from the swap chain
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(app->device, app->swapchain, UINT64_MAX, 
-                                           app->imageAvailableSemaphores[app->currentFrame], VK_NULL_HANDLE, &imageIndex);
-    
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        recreateSwapchain(app);
-        return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        fprintf(stderr, "Failed to acquire swap chain image!\n");
-        exit(EXIT_FAILURE);
+    // Wait for the slot's previous frame to finish, unless latency pacing
+    // already did before sampling input
+    uint32_t slot = frameSchedulerAcquire(&app->frames);
+    destroyRetiredSwapchains(app, false);
+    reloadShaders(app);
+    
+    // The slot's last frame is complete: report it before its resources are reused
+    collectFrame(app, slot);
+    profilerBeginFrame(&app->profiler, slot);
+    commandRecorderBeginFrame(&app->recorder, slot);
+    
+    // Textures mipped by earlier frames join the table before this frame's
+    // materials are written; the rest keep decoding and uploading meanwhile
+    uint32_t textureSpan = profilerCpuBegin(&app->profiler, "textures");
+    if (app->reloadTextures) {
+        reloadTextures(app);
+    }
+    if (textureLoaderUpdate(&app->textureLoader)) {
+        for (uint32_t i = 0; i < app->materialCount; i++) {
+            if (app->materialTextures[i] != TEXTURE_LOADER_NONE) {
+                textureLoaderSlot(&app->textureLoader, app->materialTextures[i], &app->materials[i].texture);
+            }
+        }
+    }
+    app->slotTexturesLoaded[slot] = app->textureLoader.settled;
+    profilerCpuEnd(&app->profiler, textureSpan);
+    app->textureSet = textureTableBeginFrame(&app->textures, slot, frameSchedulerCompletedValue(&app->frames));
+    
+    // Acquire an image from the swap chain; headless frames own one offscreen image per slot
+    uint32_t imageIndex = slot;
+    VkResult result = VK_SUCCESS;
+    if (!app->options.headless) {
+        uint32_t acquireSpan = profilerCpuBegin(&app->profiler, "acquire");
+        result = vkAcquireNextImageKHR(app->device, app->swapchain, UINT64_MAX,
+                                       app->frames.imageAvailable[slot], VK_NULL_HANDLE, &imageIndex);
+        profilerCpuEnd(&app->profiler, acquireSpan);
+        
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateSwapchain(app, true);
+            return;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            fprintf(stderr, "Failed to acquire swap chain image!\n");
+            exit(EXIT_FAILURE);
+        }
+        
+        // The image's previous present is done with once this frame, which waits on the
+        // acquire semaphore, has finished; until then the acquire proves nothing
+        app->slotAcquireValues[slot] = frameSchedulerSignalValue(&app->frames);
+        app->slotAcquiredPresents[slot] = app->imagePresents[imageIndex];
     }
     
-    // Only reset the fence if we are submitting work
-    vkResetFences(app->device, 1, &app->inFlightFences[app->currentFrame]);
+    // Push pending uploads; never waits on the transfer queue
+    uint32_t flushSpan = profilerCpuBegin(&app->profiler, "upload");
+    uploadFlush(&app->upload);
+    profilerCpuEnd(&app->profiler, flushSpan);
     
     // Record command buffer
-    vkResetCommandBuffer(app->commandBuffers[app->currentFrame], 0);
+    uint32_t recordSpan = profilerCpuBegin(&app->profiler, "record");
+    vkResetCommandBuffer(app->commandBuffers[slot], 0);
     
     VkCommandBufferBeginInfo beginInfo = {0};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = 0;
     beginInfo.pInheritanceInfo = NULL;
     
-    if (vkBeginCommandBuffer(app->commandBuffers[app->currentFrame], &beginInfo) != VK_SUCCESS) {
+    if (vkBeginCommandBuffer(app->commandBuffers[slot], &beginInfo) != VK_SUCCESS) {
         fprintf(stderr, "Failed to begin recording command buffer!\n");
         exit(EXIT_FAILURE);
     }
     
-    // Begin render pass
-    VkRenderPassBeginInfo renderPassInfo = {0};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = app->renderPass;
-    renderPassInfo.framebuffer = app->swapchainFramebuffers[imageIndex];
-    renderPassInfo.renderArea.offset.x = 0;
-    renderPassInfo.renderArea.offset.y = 0;
-    renderPassInfo.renderArea.extent = app->swapchainExtent;
+    profilerRecordStart(&app->profiler, app->commandBuffers[slot]);
+    uint32_t frameScope = profilerGpuBegin(&app->profiler, app->commandBuffers[slot], "frame");
+    
+    // Take ownership of freshly uploaded data before the render pass
+    VkSemaphore waitSemaphores[1 + UPLOAD_MAX_BATCHES];
+    VkPipelineStageFlags waitStages[1 + UPLOAD_MAX_BATCHES];
+    uint32_t waitCount = 0;
+    if (!app->options.headless) {
+        waitSemaphores[waitCount] = app->frames.imageAvailable[slot];
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+    uint32_t acquireScope = profilerGpuBegin(&app->profiler, app->commandBuffers[slot], "upload acquire");
+    uint32_t uploadWaitCount = uploadAcquire(&app->upload, app->commandBuffers[slot], SCENE_READ_STAGES,
+                                             waitSemaphores + waitCount);
+    profilerGpuEnd(&app->profiler, app->commandBuffers[slot], acquireScope);
+    for (uint32_t i = 0; i < uploadWaitCount; i++) {
+        waitStages[waitCount++] = SCENE_READ_STAGES;
+    }
+    
+    // Mip chains of textures whose level 0 just arrived
+    uint32_t mipScope = profilerGpuBegin(&app->profiler, app->commandBuffers[slot], "texture mips");
+    textureLoaderRecord(&app->textureLoader, app->commandBuffers[slot]);
+    profilerGpuEnd(&app->profiler, app->commandBuffers[slot], mipScope);
+    
+    if (!app->meshReady && uploadIsReady(&app->upload, app->sceneUploadTicket)) {
+        // Everything is in the staging ring or on the GPU, the host copy can go
+        app->meshReady = true;
+        releaseMesh(app);
+        gpuAllocatorPrintStats(&app->allocator);
+    }
     
-    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+    // Resolved once so culling and every secondary agree on the variant;
+    // wireframes skip the depth prepass
+    app->currentPipeline = pipelineRegistryGet(&app->pipelines, app->pipelineVariant, &app->drawnVariant);
+    bool depthPrepass = app->options.depthPrepass && !app->drawnVariant.wireframe;
+    
+    // Cull against the view before the render pass draws the survivors
+    computeFrustum(app);
+    uint32_t uniformSpan = profilerCpuBegin(&app->profiler, "uniforms");
+    updateFrameUniforms(app, slot);
+    profilerCpuEnd(&app->profiler, uniformSpan);
+    bool gpuCulling = app->meshReady && app->culling.mode != CULLING_MODE_CPU;
+    if (gpuCulling) {
+        CullingConstants constants = {0};
+        memcpy(constants.planes, app->frustum, sizeof(constants.planes));
+        constants.viewDirection[2] = 1.0f;
+        constants.viewDirection[3] = app->drawnVariant.wireframe ? 0.0f : 1.0f;
+        constants.objectCount = app->objectCount;
+        constants.clusterCount = app->clusterCount;
+        constants.lodScale = lodScale(app);
+        constants.lodCount = app->lodEnabled ? app->lodCount : 1;
+        
+        uint32_t cullScope = profilerGpuBegin(&app->profiler, app->commandBuffers[slot], "cull");
+        cullingRecord(&app->culling, app->commandBuffers[slot], slot, &constants, app->uniformOffsets[1]);
+        profilerGpuEnd(&app->profiler, app->commandBuffers[slot], cullScope);
+    }
     
-    vkCmdBeginRenderPass(app->commandBuffers[app->currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // The frame is cleared and presented while the mesh is still streaming in
+    uint32_t passScope = profilerGpuBegin(&app->profiler, app->commandBuffers[slot], "main pass");
+    if (gpuCulling) {
+        // One indirect draw covers every visible cluster, however many there are
+        beginMainPass(app, app->commandBuffers[slot], imageIndex, false);
+        
+        // The prepass draws the same clusters depth only, so shading then
+        // runs the fragment shader once per covered pixel
+        uint32_t drawSpan = profilerCpuBegin(&app->profiler, "draws");
+        if (depthPrepass) {
+            uint32_t prepassScope = profilerGpuBegin(&app->profiler, app->commandBuffers[slot], "depth prepass");
+            bindScene(app, app->commandBuffers[slot], true);
+            cullingDraw(&app->culling, app->commandBuffers[slot], slot);
+            profilerGpuEnd(&app->profiler, app->commandBuffers[slot], prepassScope);
+        }
+        uint32_t shadingScope = profilerGpuBegin(&app->profiler, app->commandBuffers[slot], "shading");
+        bindScene(app, app->commandBuffers[slot], false);
+        cullingDraw(&app->culling, app->commandBuffers[slot], slot);
+        profilerGpuEnd(&app->profiler, app->commandBuffers[slot], shadingScope);
+        profilerCpuEnd(&app->profiler, drawSpan);
+    } else if (app->meshReady) {
+        // Objects are recorded into secondary command buffers on the job system
+        beginMainPass(app, app->commandBuffers[slot], imageIndex, true);
+        
+        VkCommandBufferInheritanceInfo inheritance;
+        VkCommandBufferInheritanceRenderingInfoKHR inheritanceRendering;
+        describeMainPass(app, imageIndex, &inheritance, &inheritanceRendering);
+        
+        // The prepass secondaries are executed before the shading ones are
+        // recorded, which reuses the array they are returned in
+        uint32_t drawSpan = profilerCpuBegin(&app->profiler, "draws");
+        memset(&app->cpuStats, 0, sizeof(app->cpuStats));
+        const VkCommandBuffer* secondaries;
+        uint32_t secondaryCount;
+        if (depthPrepass) {
+            secondaryCount = commandRecorderRecord(&app->recorder, &inheritance, app->objectCount, 0,
+                                                   recordPrepassObjects, app, &secondaries);
+            vkCmdExecuteCommands(app->commandBuffers[slot], secondaryCount, secondaries);
+        }
+        secondaryCount = commandRecorderRecord(&app->recorder, &inheritance, app->objectCount, 0, recordObjects, app,
+                                               &secondaries);
+        vkCmdExecuteCommands(app->commandBuffers[slot], secondaryCount, secondaries);
+        profilerCpuEnd(&app->profiler, drawSpan);
+    } else {
+        beginMainPass(app, app->commandBuffers[slot], imageIndex, false);
+    }
     
-    // Bind graphics pipeline
-    vkCmdBindPipeline(app->commandBuffers[app->currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, app->graphicsPipeline);
+    endMainPass(app, app->commandBuffers[slot], imageIndex);
+    profilerGpuEnd(&app->profiler, app->commandBuffers[slot], passScope);
     
-    // Draw triangle (3 vertices, 1 instance)
-    vkCmdDraw(app->commandBuffers[app->currentFrame], 3, 1, 0, 0);
+    if (app->readbackBuffers[slot] != VK_NULL_HANDLE) {
+        uint32_t readbackScope = profilerGpuBegin(&app->profiler, app->commandBuffers[slot], "readback");
+        
+        // The main pass left the image in TRANSFER_SRC_OPTIMAL; copy it out for the dump
+        VkMemoryBarrier renderToCopy = {0};
+        renderToCopy.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        renderToCopy.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        renderToCopy.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(app->commandBuffers[slot], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &renderToCopy, 0, NULL, 0, NULL);
+        
+        VkBufferImageCopy region = {0};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent.width = app->swapchainExtent.width;
+        region.imageExtent.height = app->swapchainExtent.height;
+        region.imageExtent.depth = 1;
+        vkCmdCopyImageToBuffer(app->commandBuffers[slot], app->swapchainImages[imageIndex],
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, app->readbackBuffers[slot], 1, &region);
+        
+        VkMemoryBarrier copyToHost = {0};
+        copyToHost.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        copyToHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        copyToHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(app->commandBuffers[slot], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 1, &copyToHost, 0, NULL, 0, NULL);
+        
+        profilerGpuEnd(&app->profiler, app->commandBuffers[slot], readbackScope);
+    }
     
-    // End render pass
-    vkCmdEndRenderPass(app->commandBuffers[app->currentFrame]);
+    profilerGpuEnd(&app->profiler, app->commandBuffers[slot], frameScope);
     
-    if (vkEndCommandBuffer(app->commandBuffers[app->currentFrame]) != VK_SUCCESS) {
+    if (vkEndCommandBuffer(app->commandBuffers[slot]) != VK_SUCCESS) {
         fprintf(stderr, "Failed to record command buffer!\n");
         exit(EXIT_FAILURE);
     }
+    profilerCpuEnd(&app->profiler, recordSpan);
     
     // Submit command buffer
     VkSubmitInfo submitInfo = {0};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     
-    VkSemaphore waitSemaphores[] = {app->imageAvailableSemaphores[app->currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.waitSemaphoreCount = waitCount;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &app->commandBuffers[app->currentFrame];
+    submitInfo.pCommandBuffers = &app->commandBuffers[slot];
     
-    VkSemaphore signalSemaphores[] = {app->renderFinishedSemaphores[app->currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
+    // The timeline value frees the slot again; the binary semaphore is for present
+    VkSemaphore signalSemaphores[] = {app->frames.timeline, app->frames.renderFinished[slot]};
+    uint64_t signalValues[] = {frameSchedulerSignalValue(&app->frames), 0};
+    submitInfo.signalSemaphoreCount = app->options.headless ? 1 : 2;
     submitInfo.pSignalSemaphores = signalSemaphores;
     
-    if (vkQueueSubmit(app->graphicsQueue, 1, &submitInfo, app->inFlightFences[app->currentFrame]) != VK_SUCCESS) {
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {0};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    submitInfo.pNext = &timelineInfo;
+    
+    uint32_t submitSpan = profilerCpuBegin(&app->profiler, "submit");
+    if (vkQueueSubmit(app->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
         fprintf(stderr, "Failed to submit draw command buffer!\n");
         exit(EXIT_FAILURE);
     }
+    profilerCpuEnd(&app->profiler, submitSpan);
+    profilerSubmitted(&app->profiler);
+    frameSchedulerSubmitted(&app->frames);
+    
+    // Only frames showing the mesh count towards --frames and get reported
+    app->slotFrames[slot] = app->meshReady && app->options.frameCount > 0 ? app->frameNumber : NO_FRAME;
+    app->slotDrewScene[slot] = app->meshReady;
+    app->slotStats[slot] = app->cpuStats;
+    if (app->meshReady) {
+        app->frameNumber++;
+    }
+    
+    if (app->options.headless) {
+        if (!app->firstFramePresented && app->meshReady) {
+            app->firstFramePresented = true;
+            printf("First frame submitted after %.1f ms\n", getTimeMs() - app->startTime);
+        }
+        return;
+    }
     
     // Present
     VkPresentInfoKHR presentInfo = {0};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &app->frames.renderFinished[slot];
     
     VkSwapchainKHR swapchains[] = {app->swapchain};
     presentInfo.swapchainCount = 1;
@@ -732,20 +1821,184 @@ void drawFrame(VulkanApp* app) {
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = NULL;
     
+    VkFence presentFence = VK_NULL_HANDLE;
+    VkSwapchainPresentFenceInfoEXT presentFenceInfo = {0};
+    if (app->renderFeatures.presentFences) {
+        presentFence = takePresentFence(app);
+        presentFenceInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+        presentFenceInfo.swapchainCount = 1;
+        presentFenceInfo.pFences = &presentFence;
+        presentInfo.pNext = &presentFenceInfo;
+    }
+    
+    uint32_t presentSpan = profilerCpuBegin(&app->profiler, "present");
     result = vkQueuePresentKHR(app->presentQueue, &presentInfo);
+    profilerCpuEnd(&app->profiler, presentSpan);
+    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+        app->imagePresents[imageIndex] = ++app->presentCount;
+    }
     
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || app->framebufferResized) {
-        app->framebufferResized = false;
-        recreateSwapchain(app);
+    // Only an out of date swapchain can't be presented to again; the other
+    // rebuilds stay pending while they are put off
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || app->framebufferResized ||
+        app->swapchainChanged) {
+        if (recreateSwapchain(app, result == VK_ERROR_OUT_OF_DATE_KHR)) {
+            app->framebufferResized = false;
+            app->swapchainChanged = false;
+        }
     } else if (result != VK_SUCCESS) {
         fprintf(stderr, "Failed to present swap chain image!\n");
         exit(EXIT_FAILURE);
     }
     
-    app->currentFrame = (app->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    if (!app->firstFramePresented && app->meshReady) {
+        static const char* sourceNames[] = {"built-in", "cache hit", "cache miss", "cache off"};
+        app->firstFramePresented = true;
+        printf("First frame presented after %.1f ms (%s)\n", getTimeMs() - app->startTime, sourceNames[app->meshSource]);
+    }
+    
+    // Rolling averages land in the title twice a second
+    char averages[512];
+    if (profilerFormatAverages(&app->profiler, averages, sizeof(averages))) {
+        char title[640];
+        snprintf(title, sizeof(title), "%s | %s | %u/%u draws | LOD %s", WINDOW_TITLE, averages,
+                 app->lastStats.drawCount, app->objectCount * app->clusterCount, app->lodEnabled ? "on" : "off");
+        glfwSetWindowTitle(app->window, title);
+    }
+}
+
+void beginMainPass(VulkanApp* app, VkCommandBuffer commandBuffer, uint32_t imageIndex, bool secondaries) {
+    // Reverse-Z clears depth to the far value, 0
+    VkClearValue clearValues[2] = {0};
+    clearValues[0].color.float32[3] = 1.0f;
+    clearValues[1].depthStencil.depth = 0.0f;
+    VkRect2D renderArea = {{0, 0}, app->swapchainExtent};
+    
+    if (!app->renderFeatures.dynamicRendering) {
+        VkRenderPassBeginInfo renderPassInfo = {0};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = app->renderPass;
+        renderPassInfo.framebuffer = app->swapchainFramebuffers[imageIndex];
+        renderPassInfo.renderArea = renderArea;
+        renderPassInfo.clearValueCount = 2;
+        renderPassInfo.pClearValues = clearValues;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                                                         : VK_SUBPASS_CONTENTS_INLINE);
+        return;
+    }
+    
+    // The transitions the render pass did on its own, with the same
+    // dependency: after the acquire, and after the previous frame's depth writes
+    VkImageMemoryBarrier toAttachment[2] = {{0}};
+    toAttachment[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toAttachment[0].srcAccessMask = 0;
+    toAttachment[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toAttachment[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toAttachment[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    toAttachment[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toAttachment[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toAttachment[0].image = app->swapchainImages[imageIndex];
+    toAttachment[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    toAttachment[0].subresourceRange.levelCount = 1;
+    toAttachment[0].subresourceRange.layerCount = 1;
+    toAttachment[1] = toAttachment[0];
+    toAttachment[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    toAttachment[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    toAttachment[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    toAttachment[1].image = app->depthImage;
+    toAttachment[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                         0, 0, NULL, 0, NULL, 2, toAttachment);
+    
+    VkRenderingAttachmentInfoKHR colorAttachment = {0};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.imageView = app->swapchainImageViews[imageIndex];
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearValues[0];
+    
+    VkRenderingAttachmentInfoKHR depthAttachment = {0};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depthAttachment.imageView = app->depthImageView;
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.clearValue = clearValues[1];
+    
+    VkRenderingInfoKHR renderingInfo = {0};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.flags = secondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+    renderingInfo.renderArea = renderArea;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+    app->cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void endMainPass(VulkanApp* app, VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    if (!app->renderFeatures.dynamicRendering) {
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+    }
+    app->cmdEndRendering(commandBuffer);
+    
+    // Same final layouts as the render pass: presented, or copied out headless
+    VkImageMemoryBarrier toFinal = {0};
+    toFinal.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toFinal.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toFinal.dstAccessMask = app->options.headless ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+    toFinal.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    toFinal.newLayout = app->options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    toFinal.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toFinal.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toFinal.image = app->swapchainImages[imageIndex];
+    toFinal.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    toFinal.subresourceRange.levelCount = 1;
+    toFinal.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         app->options.headless ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0, 0, NULL, 0, NULL, 1, &toFinal);
+}
+
+void describeMainPass(const VulkanApp* app, uint32_t imageIndex, VkCommandBufferInheritanceInfo* inheritance,
+                      VkCommandBufferInheritanceRenderingInfoKHR* rendering) {
+    memset(inheritance, 0, sizeof(*inheritance));
+    inheritance->sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    
+    if (!app->renderFeatures.dynamicRendering) {
+        inheritance->renderPass = app->renderPass;
+        inheritance->subpass = 0;
+        inheritance->framebuffer = app->swapchainFramebuffers[imageIndex];
+        return;
+    }
+    
+    // Secondaries see the attachment formats instead of a render pass
+    memset(rendering, 0, sizeof(*rendering));
+    rendering->sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+    rendering->colorAttachmentCount = 1;
+    rendering->pColorAttachmentFormats = &app->swapchainImageFormat;
+    rendering->depthAttachmentFormat = app->depthFormat;
+    rendering->rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    inheritance->pNext = rendering;
 }
 
-void recreateSwapchain(VulkanApp* app) {
+bool recreateSwapchain(VulkanApp* app, bool required) {
+    // Rebuilding faster than old swapchains retire; waiting for one here would
+    // stall the loop, so a rebuild the current swapchain can do without waits
+    // for a later frame instead
+    if (!required && app->retiredSwapchainCount >= MAX_RETIRED_SWAPCHAINS) {
+        destroyRetiredSwapchains(app, false);
+        if (app->retiredSwapchainCount >= MAX_RETIRED_SWAPCHAINS) {
+            app->deferredRebuilds++;
+            return false;
+        }
+    }
+    
     int width = 0, height = 0;
     glfwGetFramebufferSize(app->window, &width, &height);
     while (width == 0 || height == 0) {
@@ -753,29 +2006,1181 @@ void recreateSwapchain(VulkanApp* app) {
         glfwWaitEvents();
     }
     
-    vkDeviceWaitIdle(app->device);
-    
-    cleanupSwapchain(app);
-    
+    // Frames still in flight keep drawing to the old images; nothing waits
+    // for them here, their objects are destroyed once they have finished
+    double start = getTimeMs();
+    retireSwapchain(app);
     createSwapchain(app);
     createImageViews(app);
+    createDepthResources(app);
     createFramebuffers(app);
+    
+    double rebuildMs = getTimeMs() - start;
+    app->swapchainRebuilds++;
+    app->rebuildTotalMs += rebuildMs;
+    app->rebuildMaxMs = rebuildMs > app->rebuildMaxMs ? rebuildMs : app->rebuildMaxMs;
+    return true;
+}
+
+void retireSwapchain(VulkanApp* app) {
+    if (app->retiredSwapchainCount == app->retiredSwapchainCapacity) {
+        app->retiredSwapchainCapacity = app->retiredSwapchainCapacity ? app->retiredSwapchainCapacity * 2
+                                                                      : MAX_RETIRED_SWAPCHAINS;
+        app->retiredSwapchains = realloc(app->retiredSwapchains,
+                                         app->retiredSwapchainCapacity * sizeof(RetiredSwapchain));
+    }
+    
+    RetiredSwapchain* retired = &app->retiredSwapchains[app->retiredSwapchainCount++];
+    retired->swapchain = app->swapchain;
+    retired->imageViews = app->swapchainImageViews;
+    retired->framebuffers = app->swapchainFramebuffers;
+    retired->imageCount = app->swapchainImageCount;
+    retired->depthImage = app->depthImage;
+    retired->depthImageView = app->depthImageView;
+    retired->depthAllocation = app->depthAllocation;
+    retired->retireValue = frameSchedulerLastSubmitted(&app->frames);
+    retired->lastPresent = app->presentCount;
+    
+    // The images belong to the old swapchain; only their handle array goes now
+    free(app->swapchainImages);
+    free(app->imagePresents);
+    app->swapchainImages = NULL;
+    app->imagePresents = NULL;
+    app->swapchainImageViews = NULL;
+    app->swapchainFramebuffers = NULL;
+}
+
+void destroyRetiredSwapchains(VulkanApp* app, bool all) {
+    uint64_t completed = all ? UINT64_MAX : frameSchedulerCompletedValue(&app->frames);
+    
+    // Without present fences, a finished frame that waited on an acquire
+    // semaphore proves the image's previous present was processed. That
+    // covers the presents before it only if the engine processes presents in
+    // order, across swapchains too, which present fences don't rely on
+    if (app->renderFeatures.presentFences) {
+        updatePresentFences(app);
+    } else {
+        for (uint32_t i = 0; i < app->frames.framesInFlight; i++) {
+            if (app->slotAcquireValues[i] != 0 && app->slotAcquireValues[i] <= completed) {
+                uint64_t released = app->slotAcquiredPresents[i];
+                app->presentsReleased = released > app->presentsReleased ? released : app->presentsReleased;
+                app->slotAcquireValues[i] = 0;
+            }
+        }
+    }
+    
+    // Retired in submission order, so the finished ones are at the front. The GPU finishing its
+    // frames isn't enough: presents still queued on the old swapchain read its images
+    uint32_t destroyed = 0;
+    while (destroyed < app->retiredSwapchainCount && app->retiredSwapchains[destroyed].retireValue <= completed) {
+        RetiredSwapchain* retired = &app->retiredSwapchains[destroyed];
+        bool presented = all || (app->renderFeatures.presentFences ? !hasPendingPresents(app, retired->swapchain)
+                                                                   : retired->lastPresent <= app->presentsReleased);
+        if (!presented) {
+            break;
+        }
+        destroyed++;
+        
+        for (uint32_t i = 0; i < retired->imageCount; i++) {
+            if (retired->framebuffers != NULL) {
+                vkDestroyFramebuffer(app->device, retired->framebuffers[i], NULL);
+            }
+            vkDestroyImageView(app->device, retired->imageViews[i], NULL);
+        }
+        free(retired->framebuffers);
+        free(retired->imageViews);
+        vkDestroyImageView(app->device, retired->depthImageView, NULL);
+        gpuDestroyImage(&app->allocator, retired->depthImage, &retired->depthAllocation);
+        vkDestroySwapchainKHR(app->device, retired->swapchain, NULL);
+    }
+    
+    app->retiredSwapchainCount -= destroyed;
+    memmove(app->retiredSwapchains, app->retiredSwapchains + destroyed,
+            app->retiredSwapchainCount * sizeof(RetiredSwapchain));
+}
+
+VkFence takePresentFence(VulkanApp* app) {
+    PresentFence* entry = NULL;
+    for (uint32_t i = 0; i < app->presentFenceCount && entry == NULL; i++) {
+        if (app->presentFences[i].swapchain == VK_NULL_HANDLE) {
+            entry = &app->presentFences[i];
+        }
+    }
+    
+    // Every fence is on a present still in the engine; add one
+    if (entry == NULL) {
+        if (app->presentFenceCount == app->presentFenceCapacity) {
+            app->presentFenceCapacity = app->presentFenceCapacity ? app->presentFenceCapacity * 2 : 16;
+            app->presentFences = realloc(app->presentFences, app->presentFenceCapacity * sizeof(PresentFence));
+        }
+        entry = &app->presentFences[app->presentFenceCount++];
+        
+        VkFenceCreateInfo fenceInfo = {0};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(app->device, &fenceInfo, NULL, &entry->fence) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create present fence!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    
+    entry->swapchain = app->swapchain;
+    return entry->fence;
+}
+
+void updatePresentFences(VulkanApp* app) {
+    for (uint32_t i = 0; i < app->presentFenceCount; i++) {
+        PresentFence* entry = &app->presentFences[i];
+        if (entry->swapchain != VK_NULL_HANDLE && vkGetFenceStatus(app->device, entry->fence) == VK_SUCCESS) {
+            vkResetFences(app->device, 1, &entry->fence);
+            entry->swapchain = VK_NULL_HANDLE;
+        }
+    }
+}
+
+bool hasPendingPresents(const VulkanApp* app, VkSwapchainKHR swapchain) {
+    for (uint32_t i = 0; i < app->presentFenceCount; i++) {
+        if (app->presentFences[i].swapchain == swapchain) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void destroyPresentFences(VulkanApp* app) {
+    // An idle device says nothing of the presentation engine; the swapchains
+    // go right after, so their presents must be done with first
+    for (uint32_t i = 0; i < app->presentFenceCount; i++) {
+        if (app->presentFences[i].swapchain != VK_NULL_HANDLE) {
+            vkWaitForFences(app->device, 1, &app->presentFences[i].fence, VK_TRUE, UINT64_MAX);
+        }
+        vkDestroyFence(app->device, app->presentFences[i].fence, NULL);
+    }
+    free(app->presentFences);
+    app->presentFences = NULL;
+    app->presentFenceCount = 0;
 }
 
 void cleanupSwapchain(VulkanApp* app) {
-    for (uint32_t i = 0; i < app->swapchainImageCount; i++) {
-        vkDestroyFramebuffer(app->device, app->swapchainFramebuffers[i], NULL);
+    if (app->swapchainFramebuffers != NULL) {
+        for (uint32_t i = 0; i < app->swapchainImageCount; i++) {
+            vkDestroyFramebuffer(app->device, app->swapchainFramebuffers[i], NULL);
+        }
+        free(app->swapchainFramebuffers);
     }
-    free(app->swapchainFramebuffers);
     
     for (uint32_t i = 0; i < app->swapchainImageCount; i++) {
         vkDestroyImageView(app->device, app->swapchainImageViews[i], NULL);
     }
     free(app->swapchainImageViews);
+    vkDestroyImageView(app->device, app->depthImageView, NULL);
+    gpuDestroyImage(&app->allocator, app->depthImage, &app->depthAllocation);
+    
+    if (app->options.headless) {
+        for (uint32_t i = 0; i < app->swapchainImageCount; i++) {
+            gpuDestroyImage(&app->allocator, app->swapchainImages[i], &app->offscreenAllocations[i]);
+        }
+        free(app->offscreenAllocations);
+    } else {
+        vkDestroySwapchainKHR(app->device, app->swapchain, NULL);
+    }
     
     free(app->swapchainImages);
+    free(app->imagePresents);
+}
+
+bool parseArguments(AppOptions* options, int argc, char** argv) {
+    options->optimization = MESH_OPTIMIZE_OVERDRAW;
+    options->framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    options->presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+    options->textureCompression = TEXTURE_COMPRESSION_BC;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options->threadCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--bench-obj") == 0) {
+            options->benchmarkLoader = true;
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            options->disableMeshCache = true;
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            options->headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options->frameCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            options->dumpDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--shading") == 0 && i + 1 < argc) {
+            const char* shading = argv[++i];
+            if (strcmp(shading, "lit") == 0) {
+                options->pipelineVariant.shading = PIPELINE_SHADING_LIT;
+            } else if (strcmp(shading, "normals") == 0) {
+                options->pipelineVariant.shading = PIPELINE_SHADING_NORMALS;
+            } else if (strcmp(shading, "uv") == 0) {
+                options->pipelineVariant.shading = PIPELINE_SHADING_UV;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--wireframe") == 0) {
+            options->pipelineVariant.wireframe = true;
+        } else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+            options->stressObjects = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--bench-record") == 0) {
+            options->benchmarkRecording = true;
+        } else if (strcmp(argv[i], "--cull") == 0 && i + 1 < argc) {
+            const char* culling = argv[++i];
+            if (strcmp(culling, "gpu") == 0) {
+                options->cpuCulling = false;
+            } else if (strcmp(culling, "cpu") == 0) {
+                options->cpuCulling = true;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--zoom") == 0 && i + 1 < argc) {
+            options->zoom = strtof(argv[++i], NULL);
+            if (!(options->zoom > 0.0f)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--no-meshlets") == 0) {
+            options->disableMeshlets = true;
+        } else if (strcmp(argv[i], "--optimize") == 0 && i + 1 < argc) {
+            const char* optimization = argv[++i];
+            if (strcmp(optimization, "none") == 0) {
+                options->optimization = MESH_OPTIMIZE_NONE;
+            } else if (strcmp(optimization, "cache") == 0) {
+                options->optimization = MESH_OPTIMIZE_VERTEX_CACHE;
+            } else if (strcmp(optimization, "overdraw") == 0) {
+                options->optimization = MESH_OPTIMIZE_OVERDRAW;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc) {
+            const char* format = argv[++i];
+            if (strcmp(format, "float") == 0) {
+                options->vertexFormat = VERTEX_FORMAT_FLOAT;
+            } else if (strcmp(format, "packed") == 0) {
+                options->vertexFormat = VERTEX_FORMAT_PACKED;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            options->framesInFlight = (uint32_t)strtoul(argv[++i], NULL, 10);
+            if (options->framesInFlight < 1 || options->framesInFlight > FRAME_SCHEDULER_MAX_FRAMES) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc) {
+            const char* pacing = argv[++i];
+            if (strcmp(pacing, "throughput") == 0) {
+                options->pacing = FRAME_PACING_THROUGHPUT;
+            } else if (strcmp(pacing, "latency") == 0) {
+                options->pacing = FRAME_PACING_LATENCY;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "immediate") == 0) {
+                options->presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            } else if (strcmp(mode, "mailbox") == 0) {
+                options->presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            } else if (strcmp(mode, "fifo") == 0) {
+                options->presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            } else if (strcmp(mode, "fifo-relaxed") == 0) {
+                options->presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--swapchain-images") == 0 && i + 1 < argc) {
+            options->swapchainImages = (uint32_t)strtoul(argv[++i], NULL, 10);
+            if (options->swapchainImages == 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--fps-limit") == 0 && i + 1 < argc) {
+            options->fpsLimit = strtod(argv[++i], NULL);
+            if (!(options->fpsLimit > 0.0)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--benchmark") == 0) {
+            options->benchmark = true;
+        } else if (strcmp(argv[i], "--no-dynamic-rendering") == 0) {
+            options->disableDynamicRendering = true;
+        } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            options->depthPrepass = true;
+        } else if (strcmp(argv[i], "--spin") == 0 && i + 1 < argc) {
+            options->spinSpeed = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--no-bindless") == 0) {
+            options->disableBindless = true;
+        } else if (strcmp(argv[i], "--texture-compression") == 0 && i + 1 < argc) {
+            const char* compression = argv[++i];
+            if (strcmp(compression, "none") == 0) {
+                options->textureCompression = TEXTURE_COMPRESSION_NONE;
+            } else if (strcmp(compression, "bc") == 0) {
+                options->textureCompression = TEXTURE_COMPRESSION_BC;
+            } else if (strcmp(compression, "bc7") == 0) {
+                options->textureCompression = TEXTURE_COMPRESSION_BC7;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--watch-shaders") == 0) {
+            options->shaderDirectory = SCOP_SHADER_DIRECTORY;
+        } else if (strcmp(argv[i], "--shader-dir") == 0 && i + 1 < argc) {
+            options->shaderDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--no-lod") == 0) {
+            options->disableLod = true;
+        } else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc) {
+            options->lodError = strtof(argv[++i], NULL);
+            if (!(options->lodError > 0.0f)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc) {
+            options->profileCsvPath = argv[++i];
+        } else if (strcmp(argv[i], "--profile-trace") == 0 && i + 1 < argc) {
+            options->profileTracePath = argv[++i];
+        } else if (argv[i][0] != '-' && !options->modelPath) {
+            options->modelPath = argv[i];
+        } else {
+            return false;
+        }
+    }
+    
+    // Benchmarks present as fast as the surface allows, with nothing capping them
+    if (options->benchmark) {
+        if (options->presentMode == VK_PRESENT_MODE_MAX_ENUM_KHR) {
+            options->presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        }
+        options->fpsLimit = 0.0;
+        if (options->frameCount == 0) {
+            options->frameCount = DEFAULT_BENCHMARK_FRAMES;
+        }
+    }
+    if (options->headless && options->frameCount == 0) {
+        options->frameCount = DEFAULT_HEADLESS_FRAMES;
+    }
+    if (options->zoom == 0.0f) {
+        options->zoom = 1.0f;
+    }
+    if (options->lodError == 0.0f) {
+        options->lodError = DEFAULT_LOD_ERROR;
+    }
+    
+    return (!options->benchmarkLoader || options->modelPath) && (!options->dumpDirectory || options->headless);
+}
+
+void benchmarkObjLoader(const AppOptions* options) {
+    struct stat st;
+    if (stat(options->modelPath, &st) != 0) {
+        fprintf(stderr, "Failed to open OBJ file: %s\n", options->modelPath);
+        exit(EXIT_FAILURE);
+    }
+    double megabytes = (double)st.st_size / (1024.0 * 1024.0);
+    
+    uint32_t maxThreads = options->threadCount ? options->threadCount : jobSystemDefaultThreadCount() + 1;
+    
+    // Serial reference every parallel run must match bit for bit
+    Mesh reference;
+    if (!objLoadMesh(options->modelPath, &reference, NULL)) {
+        exit(EXIT_FAILURE);
+    }
+    
+    printf("OBJ parse benchmark: %s (%.1f MB, %u vertices, %u triangles)\n", options->modelPath, megabytes,
+           reference.vertexCount, reference.indexCount / 3);
+    printf("%8s %12s %10s %10s\n", "threads", "best ms", "MB/s", "output");
+    
+    // Powers of two up to, and always including, the maximum thread count
+    uint32_t threads = 1;
+    while (true) {
+        JobSystem jobs;
+        jobSystemInit(&jobs, threads - 1);
+        
+        double best = 0.0;
+        bool identical = true;
+        for (int run = 0; run < 3; run++) {
+            Mesh mesh;
+            double start = getTimeMs();
+            if (!objLoadMesh(options->modelPath, &mesh, threads > 1 ? &jobs : NULL)) {
+                exit(EXIT_FAILURE);
+            }
+            double elapsed = getTimeMs() - start;
+            best = run == 0 || elapsed < best ? elapsed : best;
+            identical = identical && meshEqual(&mesh, &reference);
+            meshFree(&mesh);
+        }
+        
+        jobSystemShutdown(&jobs);
+        printf("%8u %12.1f %10.1f %10s\n", threads, best, megabytes / (best / 1000.0), identical ? "identical" : "MISMATCH");
+        
+        if (threads >= maxThreads) {
+            break;
+        }
+        threads = threads * 2 < maxThreads ? threads * 2 : maxThreads;
+    }
+    
+    meshFree(&reference);
+}
+
+void collectFrame(VulkanApp* app, uint32_t slot) {
+    const ProfilerFrame* profile = profilerCollect(&app->profiler, slot);
+    
+    // GPU culling left its counts in host memory, CPU culling counted while recording
+    if (app->slotDrewScene[slot]) {
+        app->slotDrewScene[slot] = false;
+        app->lastStats = app->culling.mode == CULLING_MODE_CPU ? app->slotStats[slot]
+                                                               : cullingGetStats(&app->culling, slot);
+    }
+    
+    uint32_t frame = app->slotFrames[slot];
+    if (frame == NO_FRAME) {
+        return;
+    }
+    app->slotFrames[slot] = NO_FRAME;
+    
+    double cpuMs = profile ? profile->cpuMs : 0.0;
+    double gpuMs = profile ? profile->gpuMs : 0.0;
+    double cullMs = profile ? profilerScopeMs(profile, "cull") : 0.0;
+    double mainPassMs = profile ? profilerScopeMs(profile, "main pass") : 0.0;
+    double prepassMs = profile ? profilerScopeMs(profile, "depth prepass") : 0.0;
+    double shadingMs = profile ? profilerScopeMs(profile, "shading") : 0.0;
+    
+    // From the input sample to the GPU finishing the image; presenting it and
+    // the display come on top and aren't measured
+    FrameTiming timing = frameSchedulerTiming(&app->frames, slot);
+    double inputToGpuMs = timing.completedMs - timing.inputMs;
+    double intervalMs = app->reportedFrames > 0 ? timing.completedMs - app->lastCompletedMs : 0.0;
+    if (app->reportedFrames == 0) {
+        app->firstCompletedMs = timing.completedMs;
+    }
+    app->lastCompletedMs = timing.completedMs;
+    
+    if (app->reportedFrames < app->options.frameCount) {
+        app->frameCpuMs[app->reportedFrames] = cpuMs;
+        app->frameGpuMs[app->reportedFrames] = gpuMs;
+        app->frameCullMs[app->reportedFrames] = cullMs;
+        app->frameMainPassMs[app->reportedFrames] = mainPassMs;
+        app->framePrepassMs[app->reportedFrames] = prepassMs;
+        app->frameShadingMs[app->reportedFrames] = shadingMs;
+        app->frameTexturesLoaded[app->reportedFrames] = app->slotTexturesLoaded[slot];
+        app->frameInputToGpuMs[app->reportedFrames] = inputToGpuMs;
+        app->frameIntervalMs[app->reportedFrames] = intervalMs;
+        app->frameStats[app->reportedFrames] = app->lastStats;
+        app->reportedFrames++;
+    }
+    printf("frame %5u  cpu %8.3f ms  gpu %8.3f ms  draws %u/%u  triangles %u/%llu  cull %6.3f ms  "
+           "input-to-gpu %7.3f ms\n",
+           frame, cpuMs, gpuMs, app->lastStats.drawCount, app->objectCount * app->clusterCount,
+           app->lastStats.triangleCount, (unsigned long long)app->objectCount * (app->indexCount / 3), cullMs,
+           inputToGpuMs);
+    
+    if (app->readbackBuffers[slot] != VK_NULL_HANDLE) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/frame_%05u.ppm", app->options.dumpDirectory, frame);
+        if (!writePpm(path, app->readbackAllocations[slot].mapped, app->swapchainExtent.width,
+                      app->swapchainExtent.height)) {
+            fprintf(stderr, "Failed to write frame dump: %s\n", path);
+        }
+    }
+}
+
+static int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void printFrameSummary(VulkanApp* app) {
+    uint32_t count = app->reportedFrames;
+    if (count == 0) {
+        return;
+    }
+    
+    const double* series[3] = {app->frameCpuMs, app->frameGpuMs, app->frameInputToGpuMs};
+    const char* names[3] = {"cpu", "gpu", "input-to-gpu"};
+    for (int s = 0; s < 3; s++) {
+        double total = 0.0, best = series[s][0], worst = series[s][0];
+        for (uint32_t i = 0; i < count; i++) {
+            total += series[s][i];
+            best = series[s][i] < best ? series[s][i] : best;
+            worst = series[s][i] > worst ? series[s][i] : worst;
+        }
+        printf("%s ms over %u frames: avg %.3f  min %.3f  max %.3f\n", names[s], count, total / count, best, worst);
+    }
+    
+    // Every object submits all of its triangles; culling decides how many get drawn
+    double draws = 0.0, triangles = 0.0, cullMs = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        draws += app->frameStats[i].drawCount;
+        triangles += app->frameStats[i].triangleCount;
+        cullMs += app->frameCullMs[i];
+    }
+    double clusterCount = (double)app->objectCount * app->clusterCount;
+    double submitted = (double)app->objectCount * (app->indexCount / 3);
+    printf("culling (%s): %.1f%% of %.0f clusters culled on average, cull pass avg %.3f ms\n",
+           cullingModeName(app->culling.mode), 100.0 * (1.0 - draws / count / clusterCount), clusterCount,
+           cullMs / count);
+    printf("triangles: %.0f submitted, %.0f drawn on average (%.1f%%), level of detail %s\n", submitted,
+           triangles / count, 100.0 * triangles / count / submitted, app->lodEnabled ? "on" : "off");
+    
+    // Throughput counts frames by when the GPU finished them, so the
+    // startup and the final drain don't dilute it
+    double elapsedMs = app->lastCompletedMs - app->firstCompletedMs;
+    printf("pacing (%s, %u frames in flight): %.1f frames/s, %.1f ms blocked on frame slots\n",
+           framePacingName(app->frames.pacing), app->frames.framesInFlight,
+           count > 1 && elapsedMs > 0.0 ? (count - 1) * 1000.0 / elapsedMs : 0.0, app->frames.waitMs);
+    
+    // Frame times are the gaps between frames finishing; the first frame has none
+    if (count > 1) {
+        uint32_t intervals = count - 1;
+        double* sorted = malloc(intervals * sizeof(double));
+        memcpy(sorted, app->frameIntervalMs + 1, intervals * sizeof(double));
+        qsort(sorted, intervals, sizeof(double), compareDoubles);
+        uint32_t p99 = (uint32_t)ceil(0.99 * intervals) - 1;
+        printf("frame time over %u frames (%s%s): min %.3f  avg %.3f  p99 %.3f  max %.3f ms\n", intervals,
+               app->options.headless ? "headless" : presentModeName(app->presentMode),
+               app->frames.limitIntervalMs > 0.0 ? ", limited" : "", sorted[0], elapsedMs / intervals,
+               sorted[p99], sorted[intervals - 1]);
+        free(sorted);
+    }
+    printf("vertices: %s, %zu bytes per vertex, %.2f MB vertex buffer\n", vertexFormatName(app->options.vertexFormat),
+           vertexFormatStride(app->options.vertexFormat), app->vertexBufferSize / (1024.0 * 1024.0));
+    
+    // Compare the shading time of runs with and without --depth-prepass to
+    // see the fragment work the prepass saves
+    double mainPassMs = 0.0, prepassMs = 0.0, shadingMs = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        mainPassMs += app->frameMainPassMs[i];
+        prepassMs += app->framePrepassMs[i];
+        shadingMs += app->frameShadingMs[i];
+    }
+    printf("depth (%s, prepass %s): main pass avg %.3f ms", depthFormatName(app->depthFormat),
+           app->options.depthPrepass ? "on" : "off", mainPassMs / count);
+    if (shadingMs > 0.0) {
+        printf(", depth prepass %.3f ms, shading %.3f ms", prepassMs / count, shadingMs / count);
+    }
+    printf("\n");
+    
+    // The sampling cost of a format: run once per --texture-compression and
+    // compare the main pass over the frames that sampled every texture
+    const TextureLoader* loader = &app->textureLoader;
+    double loadedMs = 0.0;
+    uint32_t loadedFrames = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (app->frameTexturesLoaded[i]) {
+            loadedMs += app->frameMainPassMs[i];
+            loadedFrames++;
+        }
+    }
+    if (loader->count > 0) {
+        printf("textures (%s, %u of %u block-compressed): main pass avg %.3f ms over the %u frames after they "
+               "loaded\n", textureCompressionName(loader->compression), loader->compressedCount, loader->count,
+               loadedFrames > 0 ? loadedMs / loadedFrames : 0.0, loadedFrames);
+    }
+}
+
+bool writePpm(const char* path, const uint8_t* rgba, uint32_t width, uint32_t height) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    
+    // Drop the alpha channel row by row
+    uint8_t* row = malloc((size_t)width * 3);
+    bool written = true;
+    for (uint32_t y = 0; y < height && written; y++) {
+        const uint8_t* src = rgba + (size_t)y * width * 4;
+        for (uint32_t x = 0; x < width; x++) {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        written = fwrite(row, 3, width, file) == width;
+    }
+    free(row);
+    
+    return fclose(file) == 0 && written;
+}
+
+void loadModel(VulkanApp* app) {
+    if (app->options.modelPath) {
+        double start = getTimeMs();
+        char cachePath[PATH_MAX];
+        bool cacheEnabled = !app->options.disableMeshCache && meshCachePath(app->options.modelPath, cachePath, sizeof(cachePath));
+        
+        if (cacheEnabled && meshCacheLoad(cachePath, app->options.modelPath, app->options.optimization, &app->mesh,
+                                          &app->meshMapping)) {
+            app->meshSource = MESH_SOURCE_CACHE_HIT;
+            printf("Loaded %s from cache: %u vertices, %u triangles in %.1f ms\n", app->options.modelPath,
+                   app->mesh.vertexCount, app->mesh.indexCount / 3, getTimeMs() - start);
+        } else {
+            if (!objLoadMesh(app->options.modelPath, &app->mesh, &app->jobs)) {
+                exit(EXIT_FAILURE);
+            }
+            printf("Loaded %s: %u vertices, %u triangles in %.1f ms (%u threads)\n", app->options.modelPath,
+                   app->mesh.vertexCount, app->mesh.indexCount / 3, getTimeMs() - start, app->jobs.threadCount + 1);
+            
+            // Cached already reordered, so later launches skip this too
+            optimizeMesh(app);
+            
+            app->meshSource = cacheEnabled ? MESH_SOURCE_CACHE_MISS : MESH_SOURCE_CACHE_OFF;
+            if (cacheEnabled && !meshCacheWrite(cachePath, app->options.modelPath, app->options.optimization,
+                                                &app->mesh)) {
+                fprintf(stderr, "Failed to write mesh cache: %s\n", cachePath);
+            }
+        }
+    } else {
+        // No model given: fall back to the classic triangle
+        static const Vertex triangle[3] = {
+            {{ 0.0f,  0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.5f, 0.0f}},
+            {{-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+            {{ 0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}}
+        };
+        app->mesh.vertexCount = 3;
+        app->mesh.indexCount = 3;
+        app->mesh.vertices = malloc(sizeof(triangle));
+        app->mesh.indices = malloc(3 * sizeof(uint32_t));
+        memcpy(app->mesh.vertices, triangle, sizeof(triangle));
+        for (uint32_t i = 0; i < 3; i++) {
+            app->mesh.indices[i] = i;
+        }
+        meshSingleSubset(&app->mesh);
+        meshComputeBounds(&app->mesh);
+    }
+    
+    // Center the model and scale its largest extent to 90% of clip space
+    float extent = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        app->meshCenter[axis] = 0.5f * (app->mesh.boundsMin[axis] + app->mesh.boundsMax[axis]);
+        float axisExtent = app->mesh.boundsMax[axis] - app->mesh.boundsMin[axis];
+        extent = axisExtent > extent ? axisExtent : extent;
+    }
+    app->meshScale = extent > 0.0f ? 1.8f / extent : 1.0f;
+    app->indexCount = app->mesh.indexCount;
+    
+    createMaterials(app);
+    createScene(app);
+    createLods(app);
+    createClusters(app);
+    
+    // Start decoding now, so the files load while Vulkan is set up
+    textureLoaderDecode(&app->textureLoader);
+}
+
+void createMaterials(VulkanApp* app) {
+    if (app->mesh.subsetCount > MAX_MATERIALS) {
+        fprintf(stderr, "Model has %u materials, at most %u are supported!\n", app->mesh.subsetCount, MAX_MATERIALS);
+        exit(EXIT_FAILURE);
+    }
+    
+    MtlLibrary library = {0};
+    if (app->options.modelPath) {
+        mtlLoadLibraries(app->options.modelPath, app->mesh.materialLibraries, &library);
+    }
+    
+    // Materials take Kd and d from their library and sample white until
+    // their map_Kd streams in. Named materials missing from every library
+    // get a color of their own so the subsets can be told apart; unnamed
+    // faces stay white.
+    app->materialCount = app->mesh.subsetCount;
+    app->materials = calloc(app->materialCount, sizeof(Material));
+    app->materialTextures = malloc(app->materialCount * sizeof(uint32_t));
+    uint32_t textured = 0;
+    for (uint32_t i = 0; i < app->materialCount; i++) {
+        const char* name = app->mesh.subsets[i].material;
+        const MtlMaterial* source = name[0] ? mtlFind(&library, name) : NULL;
+        uint64_t hash = hashBytes(name, strlen(name), 0);
+        Material* material = &app->materials[i];
+        for (int channel = 0; channel < 3; channel++) {
+            if (source) {
+                material->baseColor[channel] = source->diffuse[channel];
+            } else {
+                material->baseColor[channel] = name[0] ? 0.4f + 0.6f * (float)((hash >> (channel * 8)) & 0xff) / 255.0f
+                                                       : 1.0f;
+            }
+        }
+        material->baseColor[3] = source ? source->opacity : 1.0f;
+        material->texture = TEXTURE_TABLE_DEFAULT_SLOT;
+        
+        app->materialTextures[i] = TEXTURE_LOADER_NONE;
+        if (source && source->diffuseMap) {
+            app->materialTextures[i] = textureLoaderRequest(&app->textureLoader, source->diffuseMap);
+            textured++;
+        }
+    }
+    mtlFree(&library);
+    
+    if (app->materialCount > 1) {
+        printf("Materials: %u, drawn through one descriptor bind\n", app->materialCount);
+    }
+    if (textured > 0) {
+        printf("Streaming %u textures for %u materials\n", app->textureLoader.count, textured);
+    }
+}
+
+void createScene(VulkanApp* app) {
+    uint32_t count = app->options.stressObjects;
+    if (count == 0) {
+        count = app->options.benchmarkRecording ? DEFAULT_BENCHMARK_OBJECTS : 1;
+    }
+    if (count > MAX_OBJECTS) {
+        fprintf(stderr, "At most %u objects are supported!\n", MAX_OBJECTS);
+        exit(EXIT_FAILURE);
+    }
+    app->objectCount = count;
+    app->objects = calloc(count, sizeof(SceneObject));
+    app->viewZoom = app->options.zoom;
+    app->spinning = app->options.spinSpeed != 0.0f;
+    
+    // Aligned for the SSE stores of mat4.c; filled every frame
+    if (posix_memalign((void**)&app->transforms, sizeof(Mat4), count * sizeof(Mat4)) != 0) {
+        fprintf(stderr, "Failed to allocate object transforms!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    // Shrink the copies to grid cells and place each one's center in its cell
+    uint32_t side = (uint32_t)ceil(sqrt((double)count));
+    float cellSize = 2.0f / (float)side;
+    float scale = app->meshScale / (float)side;
+    for (uint32_t i = 0; i < count; i++) {
+        SceneObject* object = &app->objects[i];
+        object->position[0] = side > 1 ? -1.0f + ((float)(i % side) + 0.5f) * cellSize : 0.0f;
+        object->position[1] = side > 1 ? -1.0f + ((float)(i / side) + 0.5f) * cellSize : 0.0f;
+        object->position[2] = 0.0f;
+        object->position[3] = 0.0f;
+        object->scale = scale;
+    }
     
-    vkDestroySwapchainKHR(app->device, app->swapchain, NULL);
+    if (count > 1) {
+        printf("Stress scene: %u objects, %u triangles\n", count, count * (app->indexCount / 3));
+    }
+}
+
+void optimizeMesh(VulkanApp* app) {
+    if (app->options.optimization == MESH_OPTIMIZE_NONE) {
+        return;
+    }
+    
+    double start = getTimeMs();
+    VertexCacheStats before = meshAnalyzeVertexCache(app->mesh.indices, app->mesh.indexCount, app->mesh.vertexCount,
+                                                     MESH_OPTIMIZER_CACHE_SIZE);
+    meshOptimize(&app->mesh, app->options.optimization);
+    VertexCacheStats after = meshAnalyzeVertexCache(app->mesh.indices, app->mesh.indexCount, app->mesh.vertexCount,
+                                                    MESH_OPTIMIZER_CACHE_SIZE);
+    printf("Optimized for %s in %.1f ms: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%u-entry FIFO)\n",
+           meshOptimizationName(app->options.optimization), getTimeMs() - start, before.acmr, after.acmr,
+           before.atvr, after.atvr, MESH_OPTIMIZER_CACHE_SIZE);
+}
+
+void createLods(VulkanApp* app) {
+    double start = getTimeMs();
+    lodBuild(&app->mesh, app->options.disableLod ? 1 : LOD_MAX_LEVELS, &app->lods);
+    app->lodEnabled = app->lods.levelCount > 1;
+    if (!app->lodEnabled) {
+        return;
+    }
+    
+    // Collapses leave the full mesh's order behind; every level gets its own,
+    // subset by subset so materials stay grouped
+    for (uint32_t i = 1; i < app->lods.levelCount && app->options.optimization != MESH_OPTIMIZE_NONE; i++) {
+        uint32_t* indices = app->lods.indices + (app->lods.levels[i].firstIndex - app->mesh.indexCount);
+        for (uint32_t subset = 0; subset < app->lods.subsetCount; subset++) {
+            uint32_t indexCount = app->lods.subsetIndexCounts[i * app->lods.subsetCount + subset];
+            meshOptimizeVertexCache(indices, indexCount, app->mesh.vertexCount);
+            if (app->options.optimization == MESH_OPTIMIZE_OVERDRAW) {
+                meshOptimizeOverdraw(indices, indexCount, app->mesh.vertices, app->mesh.vertexCount);
+            }
+            indices += indexCount;
+        }
+    }
+    
+    printf("Built %u levels of detail in %.1f ms:", app->lods.levelCount, getTimeMs() - start);
+    for (uint32_t i = 0; i < app->lods.levelCount; i++) {
+        printf(" %u", app->lods.levels[i].indexCount / 3);
+    }
+    printf(" triangles, error up to %g model units\n", app->lods.levels[app->lods.levelCount - 1].error);
+}
+
+void createClusters(VulkanApp* app) {
+    double start = getTimeMs();
+    bool meshlets = !app->options.disableMeshlets;
+    app->clusterCount = createAllClusters(app, meshlets);
+    
+    // Every object may draw every cluster of its level, and the draw buffers
+    // have a limit; whole objects past it are culled on the CPU instead (see
+    // createLogicalDevice)
+    if (meshlets && (uint64_t)app->objectCount * app->clusterCount > CULLING_MAX_DRAWS) {
+        printf("%u objects of %u meshlets exceed %u draws, culling whole objects\n", app->objectCount,
+               app->clusterCount, CULLING_MAX_DRAWS);
+        meshlets = false;
+        app->clusters.count = 0;
+        app->clusterCount = createAllClusters(app, false);
+    }
+    app->lodCount = app->lods.levelCount;
+    
+    if (meshlets) {
+        uint32_t fullDetail = app->lodLevels[0].clusterCount;
+        uint32_t vertices = 0, cones = 0;
+        for (uint32_t i = 0; i < fullDetail; i++) {
+            vertices += app->clusters.meshlets[i].vertexCount;
+            cones += app->clusters.meshlets[i].cone[3] < MESHLET_NO_CONE;
+        }
+        printf("Built meshlets in %.1f ms: %u at full detail, %.1f vertices and %.1f triangles each, "
+               "%.0f%% back-face cullable\n", getTimeMs() - start, fullDetail, (double)vertices / fullDetail,
+               (double)app->indexCount / 3 / fullDetail, 100.0 * cones / fullDetail);
+    }
+}
+
+// Builds every level's clusters and returns the most any level has; a
+// coarser level may be cut into more meshlets than the full mesh
+uint32_t createAllClusters(VulkanApp* app, bool meshlets) {
+    uint32_t most = 0;
+    for (uint32_t level = 0; level < app->lods.levelCount; level++) {
+        uint32_t count = createLevelClusters(app, level, meshlets);
+        most = count > most ? count : most;
+    }
+    return most;
+}
+
+uint32_t createLevelClusters(VulkanApp* app, uint32_t level, bool meshlets) {
+    // Every level draws from the one vertex buffer, through its own range of
+    // indices; clusters are cut subset by subset, so each has one material
+    const LodLevel* lod = &app->lods.levels[level];
+    uint32_t* levelIndices = level == 0 ? app->mesh.indices
+                                        : app->lods.indices + (lod->firstIndex - app->mesh.indexCount);
+    CullingLod* levelClusters = &app->lodLevels[level];
+    levelClusters->firstCluster = app->clusters.count;
+    levelClusters->error = lod->error;
+    
+    uint32_t subsetFirst = 0;
+    for (uint32_t subset = 0; subset < app->lods.subsetCount; subset++) {
+        Mesh view = app->mesh;
+        view.indices = levelIndices + subsetFirst;
+        view.indexCount = app->lods.subsetIndexCounts[level * app->lods.subsetCount + subset];
+        if (view.indexCount == 0) {
+            continue;
+        }
+        
+        // Without meshlets a subset is one cluster, bounded by the mesh's box
+        MeshletList list;
+        if (meshlets) {
+            meshletBuild(&view, &app->jobs, &list);
+        } else {
+            meshletWholeMesh(&view, &list);
+        }
+        
+        app->clusters.meshlets = realloc(app->clusters.meshlets, (app->clusters.count + list.count) * sizeof(Meshlet));
+        for (uint32_t i = 0; i < list.count; i++) {
+            Meshlet* cluster = &app->clusters.meshlets[app->clusters.count + i];
+            *cluster = list.meshlets[i];
+            cluster->firstIndex += lod->firstIndex + subsetFirst;
+            cluster->material = subset;
+        }
+        app->clusters.count += list.count;
+        subsetFirst += view.indexCount;
+        meshletFree(&list);
+    }
+    
+    levelClusters->clusterCount = app->clusters.count - levelClusters->firstCluster;
+    return levelClusters->clusterCount;
+}
+
+void computeFrustum(VulkanApp* app) {
+    // The view-projection of updateFrameUniforms maps scene point p to
+    // x = (p.x - pan.x) * zoom * aspect, y = (p.y - pan.y) * zoom and depth
+    // 0.5 + 0.5 * p.z / SCENE_DEPTH; every plane keeps one of those inside
+    // [-1, 1] (depth inside [0, 1])
+    float aspect = (float)app->swapchainExtent.height / (float)app->swapchainExtent.width;
+    float scaleX = app->viewZoom * aspect;
+    float scaleY = app->viewZoom;
+    float planes[6][4] = {
+        { scaleX, 0.0f, 0.0f, 1.0f - app->viewPan[0] * scaleX},   // left
+        {-scaleX, 0.0f, 0.0f, 1.0f + app->viewPan[0] * scaleX},   // right
+        {0.0f,  scaleY, 0.0f, 1.0f - app->viewPan[1] * scaleY},   // bottom
+        {0.0f, -scaleY, 0.0f, 1.0f + app->viewPan[1] * scaleY},   // top
+        {0.0f, 0.0f,  1.0f, SCENE_DEPTH},                         // far
+        {0.0f, 0.0f, -1.0f, SCENE_DEPTH}                          // near
+    };
+    
+    // Unit normals turn plane values into distances, comparable to radii
+    for (int i = 0; i < 6; i++) {
+        float length = sqrtf(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+        for (int j = 0; j < 4; j++) {
+            app->frustum[i][j] = planes[i][j] / length;
+        }
+    }
+}
+
+void updateFrameUniforms(VulkanApp* app, uint32_t slot) {
+    // Headless frames advance a fixed step, so dumps are reproducible
+    double now = getTimeMs();
+    if (app->spinning && app->lastSpinMs > 0.0) {
+        double elapsedMs = app->options.headless ? HEADLESS_FRAME_MS : now - app->lastSpinMs;
+        float speed = app->options.spinSpeed != 0.0f ? app->options.spinSpeed : DEFAULT_SPIN_SPEED;
+        app->spinAngle = fmodf(app->spinAngle + speed * (float)(M_PI / 180.0) * (float)(elapsedMs / 1000.0),
+                               2.0f * (float)M_PI);
+    }
+    app->lastSpinMs = now;
+    
+    // Every object turns the mesh about its center, then is scaled into and
+    // moved to its cell; only the last two steps differ between objects
+    Mat4 recenter, rotation, spin;
+    mat4Translation(&recenter, -app->meshCenter[0], -app->meshCenter[1], -app->meshCenter[2]);
+    mat4Rotation(&rotation, app->spinAngle, 0.0f, 1.0f, 0.0f);
+    mat4Multiply(&spin, &rotation, &recenter);
+    for (uint32_t i = 0; i < app->objectCount; i++) {
+        mat4ScaleTranslate(&app->transforms[i], &spin, app->objects[i].scale, app->objects[i].position);
+    }
+    
+    // The view box of computeFrustum, looking down -z
+    float aspect = (float)app->swapchainExtent.height / (float)app->swapchainExtent.width;
+    float halfWidth = 1.0f / (app->viewZoom * aspect);
+    float halfHeight = 1.0f / app->viewZoom;
+    FrameUniforms uniforms;
+    mat4OrthographicReverseZ(&uniforms.viewProjection, app->viewPan[0] - halfWidth, app->viewPan[0] + halfWidth,
+                             app->viewPan[1] - halfHeight, app->viewPan[1] + halfHeight, SCENE_DEPTH, -SCENE_DEPTH);
+    float light[3] = {0.3f, 0.5f, 1.0f};
+    float length = sqrtf(light[0] * light[0] + light[1] * light[1] + light[2] * light[2]);
+    for (int axis = 0; axis < 3; axis++) {
+        uniforms.lightDirection[axis] = light[axis] / length;
+    }
+    uniforms.lightDirection[3] = 0.0f;
+    
+    // The slot's region is free since its last frame finished; the mapping
+    // is write-combined on most devices, so it only ever sees one sequential copy
+    uniformRingBeginFrame(&app->uniforms, slot);
+    memcpy(uniformRingAllocate(&app->uniforms, sizeof(uniforms), &app->uniformOffsets[0]), &uniforms,
+           sizeof(uniforms));
+    memcpy(uniformRingAllocate(&app->uniforms, app->objectCount * sizeof(Mat4), &app->uniformOffsets[1]),
+           app->transforms, app->objectCount * sizeof(Mat4));
+    memcpy(uniformRingAllocate(&app->uniforms, materialRangeSize(app), &app->uniformOffsets[2]), app->materials,
+           app->materialCount * sizeof(Material));
+}
+
+bool sphereInFrustum(const float planes[6][4], const float center[3], float radius) {
+    for (int i = 0; i < 6; i++) {
+        float distance = planes[i][0] * center[0] + planes[i][1] * center[1] + planes[i][2] * center[2] + planes[i][3];
+        if (distance < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float lodScale(const VulkanApp* app) {
+    // Scene units become pixels through the zoom and half the viewport
+    // height (clip space spans 2); levels may be off by options.lodError
+    return app->viewZoom * 0.5f * (float)app->swapchainExtent.height / app->options.lodError;
+}
+
+uint32_t selectLod(const VulkanApp* app, const SceneObject* object, float scale) {
+    // Same choice as cull.comp: the coarsest level within the allowed error
+    uint32_t lod = 0;
+    uint32_t lodCount = app->lodEnabled ? app->lodCount : 1;
+    for (uint32_t i = 1; i < lodCount; i++) {
+        if (app->lodLevels[i].error * object->scale * scale <= 1.0f) {
+            lod = i;
+        }
+    }
+    return lod;
+}
+
+void bindScene(const VulkanApp* app, VkCommandBuffer commandBuffer, bool prepass) {
+    // Bind graphics pipeline, then the objects, materials and textures of
+    // every draw at once; the prepass pipeline only writes depth
+    VkPipeline pipeline = prepass ? app->pipelines.prepass : app->currentPipeline;
+    VkDescriptorSet sets[2] = {app->sceneSet, app->textureSet};
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app->pipelineLayout, 0, 2, sets, 3,
+                            app->uniformOffsets);
+    
+    // Dynamic state isn't inherited, so every command buffer sets its own
+    VkViewport viewport = {0.0f, 0.0f, (float)app->swapchainExtent.width, (float)app->swapchainExtent.height,
+                           0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, app->swapchainExtent};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    if (app->renderFeatures.dynamicFillMode && !prepass) {
+        // Wireframes show back faces too, and never follow a depth prepass
+        bool wireframe = app->drawnVariant.wireframe;
+        bool prepassed = app->options.depthPrepass && !wireframe;
+        app->cmdSetPolygonMode(commandBuffer, wireframe ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL);
+        app->cmdSetCullMode(commandBuffer, wireframe ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT);
+        app->cmdSetDepthWriteEnable(commandBuffer, prepassed ? VK_FALSE : VK_TRUE);
+        app->cmdSetDepthCompareOp(commandBuffer, prepassed ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_GREATER_OR_EQUAL);
+    }
+    
+    // Bind mesh buffers
+    VkBuffer vertexBuffers[] = {app->vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, app->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    
+    DrawPushConstants pushConstants = {0};
+    memcpy(pushConstants.positionMin, app->positionMin, sizeof(pushConstants.positionMin));
+    memcpy(pushConstants.positionExtent, app->positionExtent, sizeof(pushConstants.positionExtent));
+    vkCmdPushConstants(commandBuffer, app->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants),
+                       &pushConstants);
+}
+
+void recordObjectRange(VulkanApp* app, VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, bool prepass) {
+    bindScene(app, commandBuffer, prepass);
+    
+    // Same level choice, cone and sphere tests as cull.comp, through the
+    // same transforms; the view looks down -z, and wireframes draw back faces
+    bool coneCulling = prepass || !app->drawnVariant.wireframe;
+    float scale = lodScale(app);
+    uint32_t draws = 0, triangles = 0;
+    for (uint32_t i = first; i < first + count; i++) {
+        const SceneObject* object = &app->objects[i];
+        const Mat4* transform = &app->transforms[i];
+        const CullingLod* level = &app->lodLevels[selectLod(app, object, scale)];
+        for (uint32_t c = 0; c < level->clusterCount; c++) {
+            const Meshlet* cluster = &app->clusters.meshlets[level->firstCluster + c];
+            if (coneCulling) {
+                float axis[3];
+                mat4TransformDirection(transform, cluster->cone, axis);
+                if (axis[2] / object->scale < -cluster->cone[3]) {
+                    continue;
+                }
+            }
+            
+            float center[3];
+            mat4TransformPoint(transform, cluster->sphere, center);
+            if (!sphereInFrustum(app->frustum, center, cluster->sphere[3] * object->scale)) {
+                continue;
+            }
+            
+            // The instance index selects the object and the cluster's material
+            vkCmdDrawIndexed(commandBuffer, cluster->indexCount, 1, cluster->firstIndex, 0,
+                             i | cluster->material << DRAW_OBJECT_BITS);
+            draws++;
+            triangles += cluster->indexCount / 3;
+        }
+    }
+    
+    // The prepass repeats the shading pass's draws; count them once
+    if (!prepass) {
+        __atomic_fetch_add(&app->cpuStats.drawCount, draws, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&app->cpuStats.triangleCount, triangles, __ATOMIC_RELAXED);
+    }
+}
+
+void recordObjects(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, void* data) {
+    recordObjectRange(data, commandBuffer, first, count, false);
+}
+
+void recordPrepassObjects(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, void* data) {
+    recordObjectRange(data, commandBuffer, first, count, true);
+}
+
+void benchmarkRecording(VulkanApp* app) {
+    vkDeviceWaitIdle(app->device);
+    
+    VkCommandBufferInheritanceInfo inheritance;
+    VkCommandBufferInheritanceRenderingInfoKHR inheritanceRendering;
+    describeMainPass(app, 0, &inheritance, &inheritanceRendering);
+    app->currentPipeline = pipelineRegistryGet(&app->pipelines, app->pipelineVariant, &app->drawnVariant);
+    computeFrustum(app);
+    updateFrameUniforms(app, 0);
+    app->textureSet = textureTableBeginFrame(&app->textures, 0, 0);
+    
+    printf("Recording %u objects of %u clusters, %u iterations per thread count\n", app->objectCount,
+           app->clusterCount, BENCHMARK_RECORD_ITERATIONS);
+    
+    // Nothing is submitted, so the pools of frame 0 can be reset at will
+    double singleThreadMs = 0.0;
+    uint32_t maxThreads = app->recorder.threadCount;
+    for (uint32_t threads = 1; ; threads = threads * 2 < maxThreads ? threads * 2 : maxThreads) {
+        const VkCommandBuffer* secondaries;
+        double best = 0.0;
+        for (uint32_t i = 0; i < BENCHMARK_RECORD_ITERATIONS; i++) {
+            commandRecorderBeginFrame(&app->recorder, 0);
+            double start = getTimeMs();
+            commandRecorderRecord(&app->recorder, &inheritance, app->objectCount, threads, recordObjects, app,
+                                  &secondaries);
+            double elapsed = getTimeMs() - start;
+            best = i == 0 || elapsed < best ? elapsed : best;
+        }
+        
+        if (threads == 1) {
+            singleThreadMs = best;
+        }
+        printf("%3u threads: %8.3f ms per frame (best of %u)  %5.2fx\n", threads, best, BENCHMARK_RECORD_ITERATIONS,
+               singleThreadMs / best);
+        
+        if (threads == maxThreads) {
+            break;
+        }
+    }
+}
+
+void releaseMesh(VulkanApp* app) {
+    if (app->meshMapping.data) {
+        // Vertices and indices live inside the cache mapping
+        meshCacheUnmap(&app->meshMapping);
+        memset(&app->mesh, 0, sizeof(app->mesh));
+    } else {
+        meshFree(&app->mesh);
+    }
+    lodFree(&app->lods);
+    free(app->packedVertices);
+    app->packedVertices = NULL;
+}
+
+void createMeshBuffers(VulkanApp* app) {
+    VkDeviceSize floatSize = sizeof(Vertex) * app->mesh.vertexCount;
+    VkDeviceSize vertexSize = vertexFormatStride(app->options.vertexFormat) * app->mesh.vertexCount;
+    VkDeviceSize meshIndexSize = sizeof(uint32_t) * app->mesh.indexCount;
+    VkDeviceSize lodIndexSize = sizeof(uint32_t) * app->lods.indexCount;
+    VkDeviceSize indexSize = meshIndexSize + lodIndexSize;
+    
+    gpuCreateBuffer(&app->allocator, vertexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &app->vertexBuffer, &app->vertexAllocation);
+    gpuCreateBuffer(&app->allocator, indexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &app->indexBuffer, &app->indexAllocation);
+    
+    // The host mesh keeps full precision for culling; only the upload is packed
+    const void* vertexData = app->mesh.vertices;
+    if (app->options.vertexFormat == VERTEX_FORMAT_PACKED) {
+        app->packedVertices = malloc(vertexSize);
+        if (!app->packedVertices && vertexSize > 0) {
+            fprintf(stderr, "Failed to allocate packed vertices!\n");
+            exit(EXIT_FAILURE);
+        }
+        meshPackVertices(&app->mesh, app->packedVertices);
+        vertexData = app->packedVertices;
+        
+        for (int axis = 0; axis < 3; axis++) {
+            app->positionMin[axis] = app->mesh.boundsMin[axis];
+            app->positionExtent[axis] = app->mesh.boundsMax[axis] - app->mesh.boundsMin[axis];
+        }
+    }
+    app->vertexBufferSize = vertexSize;
+    printf("Vertex buffer: %s, %.2f MB (%.2f MB as float, %.0f%% saved)\n",
+           vertexFormatName(app->options.vertexFormat), vertexSize / (1024.0 * 1024.0),
+           floatSize / (1024.0 * 1024.0), floatSize > 0 ? 100.0 * (1.0 - (double)vertexSize / floatSize) : 0.0);
+    
+    // Streamed through the staging ring over the first frames; drawFrame
+    // starts drawing the mesh once the last request is ready
+    uploadBuffer(&app->upload, app->vertexBuffer, 0, vertexData, vertexSize, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    uploadBuffer(&app->upload, app->indexBuffer, 0, app->mesh.indices, meshIndexSize, VK_ACCESS_INDEX_READ_BIT);
+    
+    // Simplified levels follow the full mesh
+    if (lodIndexSize > 0) {
+        uploadBuffer(&app->upload, app->indexBuffer, meshIndexSize, app->lods.indices, lodIndexSize,
+                     VK_ACCESS_INDEX_READ_BIT);
+    }
+}
+
+void createSceneBuffers(VulkanApp* app) {
+    VkDeviceSize clusterSize = sizeof(Meshlet) * app->clusters.count;
+    VkDeviceSize objectSize = sizeof(SceneObject) * app->objectCount;
+    
+    gpuCreateBuffer(&app->allocator, clusterSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &app->clusterBuffer, &app->clusterAllocation);
+    gpuCreateBuffer(&app->allocator, objectSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &app->objectBuffer, &app->objectAllocation);
+    
+    // Read by cull.comp; the host copy stays for CPU culling
+    uploadBuffer(&app->upload, app->clusterBuffer, 0, app->clusters.meshlets, clusterSize, VK_ACCESS_SHADER_READ_BIT);
+    
+    // Queued after the mesh and clusters, so once this is ready the whole scene is
+    app->sceneUploadTicket = uploadBuffer(&app->upload, app->objectBuffer, 0, app->objects, objectSize,
+                                          VK_ACCESS_SHADER_READ_BIT);
 }
 
 // Helper function implementations
@@ -816,21 +3221,31 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies);
     
     for (uint32_t i = 0; i < queueFamilyCount; i++) {
-        if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        
+        if (!indices.hasGraphicsFamily && (flags & VK_QUEUE_GRAPHICS_BIT)) {
             indices.graphicsFamily = i;
             indices.hasGraphicsFamily = true;
         }
         
+        // Without a surface (headless) nothing is presented; the graphics queue stands in
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        if (surface != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        } else {
+            presentSupport = (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        }
         
-        if (presentSupport) {
+        if (!indices.hasPresentFamily && presentSupport) {
             indices.presentFamily = i;
             indices.hasPresentFamily = true;
         }
         
-        if (indices.hasGraphicsFamily && indices.hasPresentFamily) {
-            break;
+        // Transfer-only families map to the DMA engines and copy alongside rendering
+        if (!indices.hasTransferFamily && (flags & VK_QUEUE_TRANSFER_BIT) &&
+            !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            indices.transferFamily = i;
+            indices.hasTransferFamily = true;
         }
     }
     
@@ -838,9 +3253,21 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
     return indices;
 }
 
-bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface) {
+bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface, RenderFeatures* features) {
     QueueFamilyIndices indices = findQueueFamilies(device, surface);
     
+    // Timeline semaphores pace the frames
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+    *features = queryRenderFeatures(device);
+    
+    if (surface == VK_NULL_HANDLE) {
+        return indices.hasGraphicsFamily;
+    }
+    
     bool extensionsSupported = checkDeviceExtensionSupport(device);
     
     bool swapchainAdequate = false;
@@ -854,29 +3281,102 @@ bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface) {
     return indices.hasGraphicsFamily && indices.hasPresentFamily && extensionsSupported && swapchainAdequate;
 }
 
+RenderFeatures queryRenderFeatures(VkPhysicalDevice device) {
+    bool dynamicRendering = hasDeviceExtension(device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    bool dynamicState = hasDeviceExtension(device, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME) &&
+                        hasDeviceExtension(device, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+    bool swapchainMaintenance = hasDeviceExtension(device, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+    
+    // Only the structures of extensions the device has are chained; the
+    // Vulkan 1.2 features always are, since the device must support 1.2
+    VkPhysicalDeviceFeatures2 features = {0};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {0};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features.pNext = &vulkan12Features;
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {0};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {0};
+    dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features = {0};
+    dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenanceFeatures = {0};
+    swapchainMaintenanceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+    if (dynamicRendering) {
+        dynamicRenderingFeatures.pNext = features.pNext;
+        features.pNext = &dynamicRenderingFeatures;
+    }
+    if (dynamicState) {
+        dynamicStateFeatures.pNext = &dynamicState3Features;
+        dynamicState3Features.pNext = features.pNext;
+        features.pNext = &dynamicStateFeatures;
+    }
+    if (swapchainMaintenance) {
+        swapchainMaintenanceFeatures.pNext = features.pNext;
+        features.pNext = &swapchainMaintenanceFeatures;
+    }
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    
+    // A dynamic fill mode only pays off when wireframes can be drawn at all
+    RenderFeatures renderFeatures = {0};
+    renderFeatures.dynamicRendering = dynamicRendering && dynamicRenderingFeatures.dynamicRendering;
+    renderFeatures.dynamicFillMode = dynamicState && dynamicStateFeatures.extendedDynamicState &&
+                                     dynamicState3Features.extendedDynamicState3PolygonMode &&
+                                     features.features.fillModeNonSolid;
+    
+    // Textures are indexed by a per-draw slot, and may be added while frames
+    // using the other slots are in flight
+    renderFeatures.descriptorIndexing = vulkan12Features.descriptorIndexing &&
+                                        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+                                        vulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+                                        vulkan12Features.descriptorBindingPartiallyBound &&
+                                        features.features.shaderSampledImageArrayDynamicIndexing;
+    
+    // Present fences say when an old swapchain's images are free; the
+    // instance half is checked once the device is picked
+    renderFeatures.presentFences = swapchainMaintenance && swapchainMaintenanceFeatures.swapchainMaintenance1;
+    return renderFeatures;
+}
+
 bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
+    for (size_t i = 0; i < sizeof(deviceExtensions) / sizeof(deviceExtensions[0]); i++) {
+        if (!hasDeviceExtension(device, deviceExtensions[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool hasDeviceExtension(VkPhysicalDevice device, const char* extension) {
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
     
     VkExtensionProperties* availableExtensions = malloc(extensionCount * sizeof(VkExtensionProperties));
     vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, availableExtensions);
     
-    for (size_t i = 0; i < sizeof(deviceExtensions) / sizeof(deviceExtensions[0]); i++) {
-        bool found = false;
-        for (uint32_t j = 0; j < extensionCount; j++) {
-            if (strcmp(deviceExtensions[i], availableExtensions[j].extensionName) == 0) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            free(availableExtensions);
-            return false;
-        }
+    bool found = false;
+    for (uint32_t i = 0; i < extensionCount && !found; i++) {
+        found = strcmp(extension, availableExtensions[i].extensionName) == 0;
     }
     
     free(availableExtensions);
-    return true;
+    return found;
+}
+
+bool hasInstanceExtension(const char* extension) {
+    uint32_t extensionCount;
+    vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
+    
+    VkExtensionProperties* availableExtensions = malloc(extensionCount * sizeof(VkExtensionProperties));
+    vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, availableExtensions);
+    
+    bool found = false;
+    for (uint32_t i = 0; i < extensionCount && !found; i++) {
+        found = strcmp(extension, availableExtensions[i].extensionName) == 0;
+    }
+    
+    free(availableExtensions);
+    return found;
 }
 
 SwapchainSupportDetails querySwapchainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
@@ -899,6 +3399,27 @@ SwapchainSupportDetails querySwapchainSupport(VkPhysicalDevice device, VkSurface
     return details;
 }
 
+VkFormat chooseDepthFormat(VkPhysicalDevice device) {
+    // D32 first for the most precision; D16 is always supported
+    VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM};
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(device, candidates[i], &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return candidates[i];
+        }
+    }
+    return VK_FORMAT_D16_UNORM;
+}
+
+const char* depthFormatName(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D32_SFLOAT: return "D32";
+        case VK_FORMAT_X8_D24_UNORM_PACK32: return "D24";
+        default: return "D16";
+    }
+}
+
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const VkSurfaceFormatKHR* formats, uint32_t formatCount) {
     for (uint32_t i = 0; i < formatCount; i++) {
         if (formats[i].format == VK_FORMAT_B8G8R8A8_SRGB && formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
@@ -909,9 +3430,12 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(const VkSurfaceFormatKHR* formats, ui
     return formats[0];
 }
 
-VkPresentModeKHR chooseSwapPresentMode(const VkPresentModeKHR* presentModes, uint32_t presentModeCount) {
+VkPresentModeKHR chooseSwapPresentMode(const VkPresentModeKHR* presentModes, uint32_t presentModeCount,
+                                       VkPresentModeKHR requested) {
+    // Without a request, prefer MAILBOX; FIFO is the one mode every surface has
+    VkPresentModeKHR wanted = requested == VK_PRESENT_MODE_MAX_ENUM_KHR ? VK_PRESENT_MODE_MAILBOX_KHR : requested;
     for (uint32_t i = 0; i < presentModeCount; i++) {
-        if (presentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
+        if (presentModes[i] == wanted) {
             return presentModes[i];
         }
     }
@@ -919,6 +3443,27 @@ VkPresentModeKHR chooseSwapPresentMode(const VkPresentModeKHR* presentModes, uin
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+uint32_t chooseSwapImageCount(const VkSurfaceCapabilitiesKHR* capabilities, uint32_t requested) {
+    uint32_t imageCount = requested > 0 ? requested : capabilities->minImageCount + 1;
+    if (imageCount < capabilities->minImageCount) {
+        imageCount = capabilities->minImageCount;
+    }
+    if (capabilities->maxImageCount > 0 && imageCount > capabilities->maxImageCount) {
+        imageCount = capabilities->maxImageCount;
+    }
+    return imageCount;
+}
+
+const char* presentModeName(VkPresentModeKHR presentMode) {
+    switch (presentMode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+        default: return "unknown";
+    }
+}
+
 VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR* capabilities, GLFWwindow* window) {
     if (capabilities->currentExtent.width != UINT32_MAX) {
         return capabilities->currentExtent;
@@ -950,19 +3495,26 @@ VkShaderModule createShaderModule(VkDevice device, const char* filename) {
         exit(EXIT_FAILURE);
     }
     
+    VkShaderModule shaderModule = createShaderModuleFromCode(device, (const uint32_t*)code, codeSize);
+    free(code);
+    if (shaderModule == VK_NULL_HANDLE) {
+        fprintf(stderr, "Failed to create shader module!\n");
+        exit(EXIT_FAILURE);
+    }
+    return shaderModule;
+}
+
+// VK_NULL_HANDLE when the device rejects the code
+VkShaderModule createShaderModuleFromCode(VkDevice device, const uint32_t* code, size_t size) {
     VkShaderModuleCreateInfo createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = codeSize;
-    createInfo.pCode = (const uint32_t*)code;
+    createInfo.codeSize = size;
+    createInfo.pCode = code;
     
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(device, &createInfo, NULL, &shaderModule) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create shader module!\n");
-        free(code);
-        exit(EXIT_FAILURE);
+        return VK_NULL_HANDLE;
     }
-    
-    free(code);
     return shaderModule;
 }
 
@@ -998,4 +3550,71 @@ static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
     (void)height;  // Suppress unused parameter warning
     VulkanApp* app = glfwGetWindowUserPointer(window);
     app->framebufferResized = true;
-}
\ No newline at end of file
+}
+
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    (void)scancode;  // Suppress unused parameter warning
+    (void)mods;      // Suppress unused parameter warning
+    if (action == GLFW_RELEASE) {
+        return;
+    }
+    
+    // Arrows pan and +/- zoom, repeating while held; 0 shows the whole scene again
+    VulkanApp* app = glfwGetWindowUserPointer(window);
+    float panStep = VIEW_PAN_STEP / app->viewZoom;
+    if (key == GLFW_KEY_LEFT) {
+        app->viewPan[0] -= panStep;
+    } else if (key == GLFW_KEY_RIGHT) {
+        app->viewPan[0] += panStep;
+    } else if (key == GLFW_KEY_UP) {
+        app->viewPan[1] += panStep;
+    } else if (key == GLFW_KEY_DOWN) {
+        app->viewPan[1] -= panStep;
+    } else if (key == GLFW_KEY_EQUAL) {
+        app->viewZoom *= VIEW_ZOOM_STEP;
+    } else if (key == GLFW_KEY_MINUS) {
+        app->viewZoom /= VIEW_ZOOM_STEP;
+    } else if (key == GLFW_KEY_0) {
+        app->viewPan[0] = 0.0f;
+        app->viewPan[1] = 0.0f;
+        app->viewZoom = 1.0f;
+    }
+    if (action != GLFW_PRESS) {
+        return;
+    }
+    
+    // 1-3 pick the shading mode, W toggles wireframe, L level of detail, R
+    // spinning, T reloads textures, P cycles present modes; new variants
+    // compile in the background
+    if (key >= GLFW_KEY_1 && key < GLFW_KEY_1 + PIPELINE_SHADING_COUNT) {
+        app->pipelineVariant.shading = (PipelineShading)(key - GLFW_KEY_1);
+    } else if (key == GLFW_KEY_W) {
+        app->pipelineVariant.wireframe = !app->pipelineVariant.wireframe;
+    } else if (key == GLFW_KEY_L && app->lodCount > 1) {
+        app->lodEnabled = !app->lodEnabled;
+        printf("Level of detail %s\n", app->lodEnabled ? "on" : "off");
+        return;
+    } else if (key == GLFW_KEY_R) {
+        app->spinning = !app->spinning;
+        return;
+    } else if (key == GLFW_KEY_T) {
+        app->reloadTextures = true;
+        return;
+    } else if (key == GLFW_KEY_P) {
+        // Next mode the surface supports; the swapchain is rebuilt after this frame's present
+        SwapchainSupportDetails support = querySwapchainSupport(app->physicalDevice, app->surface);
+        for (uint32_t i = 0; i < support.presentModeCount; i++) {
+            if (support.presentModes[i] == app->presentMode) {
+                app->presentModeRequest = support.presentModes[(i + 1) % support.presentModeCount];
+                break;
+            }
+        }
+        free(support.formats);
+        free(support.presentModes);
+        app->swapchainChanged = true;
+        return;
+    } else {
+        return;
+    }
+    printf("Showing %s shading\n", pipelineVariantName(app->pipelineVariant));
+}
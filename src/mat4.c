@@ -0,0 +1,124 @@
+#include "mat4.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define MAT4_SSE 1
+#endif
+
+void mat4Identity(Mat4* out) {
+    memset(out, 0, sizeof(*out));
+    out->m[0] = 1.0f;
+    out->m[5] = 1.0f;
+    out->m[10] = 1.0f;
+    out->m[15] = 1.0f;
+}
+
+void mat4Multiply(Mat4* out, const Mat4* a, const Mat4* b) {
+    // Every column of the result mixes a's columns by one column of b
+    Mat4 result;
+#ifdef MAT4_SSE
+    __m128 a0 = _mm_load_ps(&a->m[0]);
+    __m128 a1 = _mm_load_ps(&a->m[4]);
+    __m128 a2 = _mm_load_ps(&a->m[8]);
+    __m128 a3 = _mm_load_ps(&a->m[12]);
+    for (int c = 0; c < 4; c++) {
+        const float* column = &b->m[c * 4];
+        __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+        _mm_store_ps(&result.m[c * 4], sum);
+    }
+#else
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            result.m[c * 4 + r] = a->m[r] * b->m[c * 4] + a->m[4 + r] * b->m[c * 4 + 1] +
+                                  a->m[8 + r] * b->m[c * 4 + 2] + a->m[12 + r] * b->m[c * 4 + 3];
+        }
+    }
+#endif
+    *out = result;
+}
+
+void mat4Translation(Mat4* out, float x, float y, float z) {
+    mat4Identity(out);
+    out->m[12] = x;
+    out->m[13] = y;
+    out->m[14] = z;
+}
+
+void mat4Scaling(Mat4* out, float x, float y, float z) {
+    mat4Identity(out);
+    out->m[0] = x;
+    out->m[5] = y;
+    out->m[10] = z;
+}
+
+void mat4Rotation(Mat4* out, float angle, float x, float y, float z) {
+    // Rodrigues' formula, written out column by column
+    float c = cosf(angle);
+    float s = sinf(angle);
+    float t = 1.0f - c;
+
+    mat4Identity(out);
+    out->m[0] = t * x * x + c;
+    out->m[1] = t * x * y + s * z;
+    out->m[2] = t * x * z - s * y;
+    out->m[4] = t * x * y - s * z;
+    out->m[5] = t * y * y + c;
+    out->m[6] = t * y * z + s * x;
+    out->m[8] = t * x * z + s * y;
+    out->m[9] = t * y * z - s * x;
+    out->m[10] = t * z * z + c;
+}
+
+void mat4OrthographicReverseZ(Mat4* out, float left, float right, float bottom, float top, float zNear, float zFar) {
+    mat4Identity(out);
+    out->m[0] = 2.0f / (right - left);
+    out->m[5] = -2.0f / (top - bottom);
+    out->m[10] = 1.0f / (zNear - zFar);
+    out->m[12] = -(right + left) / (right - left);
+    out->m[13] = (top + bottom) / (top - bottom);
+    out->m[14] = -zFar / (zNear - zFar);
+}
+
+void mat4ScaleTranslate(Mat4* out, const Mat4* m, float scale, const float offset[3]) {
+    // Each column is scaled in xyz, and picks up the offset in proportion to
+    // its w: 0 for the axes and 1 for the translation of an affine m
+#ifdef MAT4_SSE
+    __m128 scales = _mm_set_ps(1.0f, scale, scale, scale);
+    __m128 offsets = _mm_set_ps(0.0f, offset[2], offset[1], offset[0]);
+    for (int c = 0; c < 4; c++) {
+        __m128 column = _mm_load_ps(&m->m[c * 4]);
+        __m128 w = _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3));
+        _mm_store_ps(&out->m[c * 4], _mm_add_ps(_mm_mul_ps(column, scales), _mm_mul_ps(offsets, w)));
+    }
+#else
+    for (int c = 0; c < 4; c++) {
+        float w = m->m[c * 4 + 3];
+        for (int r = 0; r < 3; r++) {
+            out->m[c * 4 + r] = m->m[c * 4 + r] * scale + offset[r] * w;
+        }
+        out->m[c * 4 + 3] = w;
+    }
+#endif
+}
+
+void mat4TransformPoint(const Mat4* m, const float point[3], float out[3]) {
+    float result[3];
+    for (int r = 0; r < 3; r++) {
+        result[r] = m->m[r] * point[0] + m->m[4 + r] * point[1] + m->m[8 + r] * point[2] + m->m[12 + r];
+    }
+    memcpy(out, result, sizeof(result));
+}
+
+void mat4TransformDirection(const Mat4* m, const float direction[3], float out[3]) {
+    float result[3];
+    for (int r = 0; r < 3; r++) {
+        result[r] = m->m[r] * direction[0] + m->m[4 + r] * direction[1] + m->m[8 + r] * direction[2];
+    }
+    memcpy(out, result, sizeof(result));
+}
@@ -0,0 +1,36 @@
+#ifndef SCOP_MAT4_H
+#define SCOP_MAT4_H
+
+// Column-major 4x4 matrix laid out like a GLSL mat4 in std140 and std430:
+// row r of column c is m[c * 4 + r]. Columns are 16-byte aligned so the SSE
+// paths load and store them whole; elsewhere the same loops are left for the
+// compiler to vectorize.
+typedef struct {
+    float m[16];
+} __attribute__((aligned(16))) Mat4;
+
+void mat4Identity(Mat4* out);
+
+// out = a * b, so b applies first; out may alias either
+void mat4Multiply(Mat4* out, const Mat4* a, const Mat4* b);
+
+void mat4Translation(Mat4* out, float x, float y, float z);
+void mat4Scaling(Mat4* out, float x, float y, float z);
+
+// Rotation by angle radians about the unit axis (x, y, z), counter-clockwise
+// when the axis points at the viewer
+void mat4Rotation(Mat4* out, float angle, float x, float y, float z);
+
+// Maps the box to Vulkan clip space: x right, y down, and depth reversed,
+// 1 at z = zNear and 0 at z = zFar. The view looks down -z, so zNear > zFar.
+void mat4OrthographicReverseZ(Mat4* out, float left, float right, float bottom, float top, float zNear, float zFar);
+
+// out = translation(offset) * scaling(scale) * m: places a copy of whatever m
+// transforms, at a fraction of a full multiply; out may alias m
+void mat4ScaleTranslate(Mat4* out, const Mat4* m, float scale, const float offset[3]);
+
+// m * (point, 1) and m * (direction, 0)
+void mat4TransformPoint(const Mat4* m, const float point[3], float out[3]);
+void mat4TransformDirection(const Mat4* m, const float direction[3], float out[3]);
+
+#endif
@@ -0,0 +1,143 @@
+#include "mesh.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+void meshComputeBounds(Mesh* mesh) {
+    if (mesh->vertexCount == 0) {
+        memset(mesh->boundsMin, 0, sizeof(mesh->boundsMin));
+        memset(mesh->boundsMax, 0, sizeof(mesh->boundsMax));
+        return;
+    }
+
+    memcpy(mesh->boundsMin, mesh->vertices[0].position, sizeof(mesh->boundsMin));
+    memcpy(mesh->boundsMax, mesh->vertices[0].position, sizeof(mesh->boundsMax));
+
+    for (uint32_t i = 1; i < mesh->vertexCount; i++) {
+        const float* p = mesh->vertices[i].position;
+        for (int axis = 0; axis < 3; axis++) {
+            if (p[axis] < mesh->boundsMin[axis]) mesh->boundsMin[axis] = p[axis];
+            if (p[axis] > mesh->boundsMax[axis]) mesh->boundsMax[axis] = p[axis];
+        }
+    }
+}
+
+void meshSingleSubset(Mesh* mesh) {
+    free(mesh->subsets);
+    mesh->subsets = calloc(1, sizeof(MeshSubset));
+    mesh->subsets[0].indexCount = mesh->indexCount;
+    mesh->subsetCount = 1;
+}
+
+void meshFree(Mesh* mesh) {
+    free(mesh->vertices);
+    free(mesh->indices);
+    free(mesh->subsets);
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+bool meshEqual(const Mesh* a, const Mesh* b) {
+    return a->vertexCount == b->vertexCount &&
+           a->indexCount == b->indexCount &&
+           a->subsetCount == b->subsetCount &&
+           memcmp(a->vertices, b->vertices, (size_t)a->vertexCount * sizeof(Vertex)) == 0 &&
+           memcmp(a->indices, b->indices, (size_t)a->indexCount * sizeof(uint32_t)) == 0 &&
+           memcmp(a->subsets, b->subsets, (size_t)a->subsetCount * sizeof(MeshSubset)) == 0 &&
+           strcmp(a->materialLibraries, b->materialLibraries) == 0 &&
+           memcmp(a->boundsMin, b->boundsMin, sizeof(a->boundsMin)) == 0 &&
+           memcmp(a->boundsMax, b->boundsMax, sizeof(a->boundsMax)) == 0;
+}
+
+// Round to nearest even, flushing values below the half range to zero
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    uint32_t magnitude = bits & 0x7fffffff;
+
+    if (magnitude >= 0x7f800000) {
+        // Infinity stays infinity, NaN stays NaN
+        return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0);
+    }
+    if (magnitude >= 0x477ff000) {
+        // Rounds past the largest half
+        return sign | 0x7c00;
+    }
+    if (magnitude < 0x33000000) {
+        return sign;
+    }
+
+    int exponent = (int)(magnitude >> 23) - 127 + 15;
+    uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+    int shift = exponent > 0 ? 13 : 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) {
+        half++;
+    }
+    if (exponent > 0) {
+        // The implicit bit lands in the exponent; a carry out of the
+        // mantissa bumps it, as it should
+        half = ((uint32_t)exponent << 10) + half - 0x400;
+    }
+    return sign | (uint16_t)half;
+}
+
+static int16_t toSnorm16(float value) {
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (int16_t)lrintf(value * 32767.0f);
+}
+
+// Projects the unit normal onto the octahedron |x| + |y| + |z| = 1 and folds
+// the lower half over the upper one
+static void octahedralEncode(const float normal[3], int16_t encoded[2]) {
+    float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    if (length == 0.0f) {
+        encoded[0] = 0;
+        encoded[1] = 0;
+        return;
+    }
+
+    float x = normal[0] / length;
+    float y = normal[1] / length;
+    if (normal[2] < 0.0f) {
+        float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = toSnorm16(x);
+    encoded[1] = toSnorm16(y);
+}
+
+void meshPackVertices(const Mesh* mesh, PackedVertex* packed) {
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = mesh->boundsMax[axis] - mesh->boundsMin[axis];
+        scale[axis] = extent > 0.0f ? 65535.0f / extent : 0.0f;
+    }
+
+    for (uint32_t i = 0; i < mesh->vertexCount; i++) {
+        const Vertex* v = &mesh->vertices[i];
+        PackedVertex* p = &packed[i];
+        for (int axis = 0; axis < 3; axis++) {
+            float q = (v->position[axis] - mesh->boundsMin[axis]) * scale[axis];
+            q = q < 0.0f ? 0.0f : (q > 65535.0f ? 65535.0f : q);
+            p->position[axis] = (uint16_t)lrintf(q);
+        }
+        p->position[3] = 0;
+        octahedralEncode(v->normal, p->normal);
+        p->texCoord[0] = floatToHalf(v->texCoord[0]);
+        p->texCoord[1] = floatToHalf(v->texCoord[1]);
+    }
+}
+
+size_t vertexFormatStride(VertexFormat format) {
+    return format == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+const char* vertexFormatName(VertexFormat format) {
+    return format == VERTEX_FORMAT_PACKED ? "packed" : "float";
+}
@@ -0,0 +1,71 @@
+#ifndef SCOP_MESH_H
+#define SCOP_MESH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Interleaved vertex layout consumed by shader.vert (binding 0)
+typedef struct {
+    float position[3];
+    float normal[3];
+    float texCoord[2];
+} Vertex;
+
+// Vertex buffer layouts shader.vert can decode
+typedef enum {
+    VERTEX_FORMAT_FLOAT,    // Vertex as is, 32 bytes
+    VERTEX_FORMAT_PACKED    // PackedVertex, 16 bytes
+} VertexFormat;
+
+// Compact layout decoded by shader.vert when PACKED_VERTICES is set
+typedef struct {
+    uint16_t position[4];   // UNORM within the mesh bounds, w unused
+    int16_t normal[2];      // octahedral projection, SNORM
+    uint16_t texCoord[2];   // half floats
+} PackedVertex;
+
+// Material names longer than this, terminator included, are cut short
+#define MESH_MATERIAL_NAME_SIZE 64
+
+// "mtllib" names of one OBJ, newlines included, that fit; longer lists are cut short
+#define MESH_LIBRARIES_SIZE 256
+
+// Run of the index buffer drawn with one material
+typedef struct {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    char material[MESH_MATERIAL_NAME_SIZE];   // usemtl name, empty for faces before any
+} MeshSubset;
+
+// Indexed triangle mesh living in host memory. Its triangles are grouped by
+// material: the subsets follow each other through the whole index buffer,
+// one per material.
+typedef struct {
+    Vertex* vertices;
+    uint32_t vertexCount;
+    uint32_t* indices;
+    uint32_t indexCount;
+    MeshSubset* subsets;
+    uint32_t subsetCount;
+    char materialLibraries[MESH_LIBRARIES_SIZE];    // "mtllib" names relative to the OBJ, one per line
+    float boundsMin[3];
+    float boundsMax[3];
+} Mesh;
+
+// Mesh helpers
+void meshComputeBounds(Mesh* mesh);
+
+// Replaces the subsets with one unnamed subset covering every index
+void meshSingleSubset(Mesh* mesh);
+void meshFree(Mesh* mesh);
+bool meshEqual(const Mesh* a, const Mesh* b);
+
+// Quantizes every vertex against the mesh bounds, which must be up to date;
+// positions decode as boundsMin + unorm * (boundsMax - boundsMin)
+void meshPackVertices(const Mesh* mesh, PackedVertex* packed);
+
+size_t vertexFormatStride(VertexFormat format);
+const char* vertexFormatName(VertexFormat format);
+
+#endif
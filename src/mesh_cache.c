@@ -0,0 +1,238 @@
+#include "mesh_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util.h"
+
+#define MESH_CACHE_MAGIC "SCOPMESH"
+#define MESH_CACHE_ALIGNMENT 16
+
+// On-disk header; vertex, index and subset arrays follow at the given offsets
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexStride;      // sizeof(Vertex) when the cache was written
+    uint64_t sourceSize;
+    int64_t sourceMtimeNs;
+    uint64_t sourceHash;        // content hash of the OBJ file
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t optimization;      // MeshOptimization applied before writing
+    uint32_t subsetCount;
+    uint64_t subsetOffset;
+    char materialLibraries[MESH_LIBRARIES_SIZE];
+} MeshCacheHeader;
+
+static inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline int64_t mtimeNs(const struct stat* st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+bool meshCachePath(const char* sourcePath, char* path, size_t size) {
+    char directory[PATH_MAX];
+    char absolute[PATH_MAX];
+
+    if (!getCacheDirectory(directory, sizeof(directory)) || !realpath(sourcePath, absolute)) {
+        return false;
+    }
+
+    const char* name = strrchr(absolute, '/');
+    name = name ? name + 1 : absolute;
+
+    // Key on the absolute path so same-named models in different folders don't collide
+    uint64_t key = hashBytes(absolute, strlen(absolute), 0);
+    int written = snprintf(path, size, "%s/%s-%016llx.mesh", directory, name, (unsigned long long)key);
+    return written > 0 && (size_t)written < size;
+}
+
+// What the header's offsets point at must be usable as-is: every index
+// names a vertex, the subsets tile the index buffer in order, and material
+// names are terminated. Reads the whole index array.
+static bool validContents(const MeshCacheHeader* header, const char* data) {
+    const uint32_t* indices = (const uint32_t*)(data + header->indexOffset);
+    for (uint32_t i = 0; i < header->indexCount; i++) {
+        if (indices[i] >= header->vertexCount) {
+            return false;
+        }
+    }
+
+    const MeshSubset* subsets = (const MeshSubset*)(data + header->subsetOffset);
+    uint64_t nextIndex = 0;
+    for (uint32_t i = 0; i < header->subsetCount; i++) {
+        if (subsets[i].firstIndex != nextIndex ||
+            memchr(subsets[i].material, '\0', sizeof(subsets[i].material)) == NULL) {
+            return false;
+        }
+        nextIndex += subsets[i].indexCount;
+    }
+    return nextIndex == header->indexCount;
+}
+
+// Best effort: a read-only cache still loads, it is only hashed again
+static void refreshMtime(const char* cachePath, int64_t sourceMtime) {
+    int fd = open(cachePath, O_WRONLY);
+    if (fd < 0) {
+        return;
+    }
+    if (pwrite(fd, &sourceMtime, sizeof(sourceMtime), offsetof(MeshCacheHeader, sourceMtimeNs)) !=
+        sizeof(sourceMtime)) {
+        fprintf(stderr, "Failed to refresh mesh cache timestamp: %s\n", cachePath);
+    }
+    close(fd);
+}
+
+bool meshCacheLoad(const char* cachePath, const char* sourcePath, uint32_t optimization, Mesh* mesh,
+                   MeshCacheMapping* mapping) {
+    struct stat sourceStat;
+    if (stat(sourcePath, &sourceStat) != 0) {
+        return false;
+    }
+
+    int fd = open(cachePath, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat cacheStat;
+    if (fstat(fd, &cacheStat) != 0 || (size_t)cacheStat.st_size < sizeof(MeshCacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)cacheStat.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    const MeshCacheHeader* header = data;
+    uint64_t vertexBytes = (uint64_t)header->vertexCount * sizeof(Vertex);
+    uint64_t indexBytes = (uint64_t)header->indexCount * sizeof(uint32_t);
+    uint64_t subsetBytes = (uint64_t)header->subsetCount * sizeof(MeshSubset);
+
+    bool valid = memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == MESH_CACHE_VERSION &&
+                 header->vertexStride == sizeof(Vertex) &&
+                 header->optimization == optimization &&
+                 header->vertexOffset >= sizeof(MeshCacheHeader) &&
+                 header->vertexOffset % MESH_CACHE_ALIGNMENT == 0 &&
+                 header->indexOffset % MESH_CACHE_ALIGNMENT == 0 &&
+                 header->subsetOffset % MESH_CACHE_ALIGNMENT == 0 &&
+                 header->subsetCount > 0 &&
+                 memchr(header->materialLibraries, '\0', sizeof(header->materialLibraries)) != NULL &&
+                 header->vertexOffset <= size && vertexBytes <= size - header->vertexOffset &&
+                 header->indexOffset <= size && indexBytes <= size - header->indexOffset &&
+                 header->subsetOffset <= size && subsetBytes <= size - header->subsetOffset &&
+                 header->sourceSize == (uint64_t)sourceStat.st_size;
+    close(fd);
+    valid = valid && validContents(header, data);
+
+    if (valid && header->sourceMtimeNs != mtimeNs(&sourceStat)) {
+        // Touched but possibly unchanged: compare content before rebuilding
+        uint64_t hash;
+        valid = hashFile(sourcePath, &hash) && hash == header->sourceHash;
+        if (valid) {
+            refreshMtime(cachePath, mtimeNs(&sourceStat));
+        }
+    }
+
+    if (!valid) {
+        munmap(data, size);
+        return false;
+    }
+
+    madvise(data, size, MADV_WILLNEED);
+
+    memset(mesh, 0, sizeof(*mesh));
+    mesh->vertices = (Vertex*)((char*)data + header->vertexOffset);
+    mesh->vertexCount = header->vertexCount;
+    mesh->indices = (uint32_t*)((char*)data + header->indexOffset);
+    mesh->indexCount = header->indexCount;
+    mesh->subsets = (MeshSubset*)((char*)data + header->subsetOffset);
+    mesh->subsetCount = header->subsetCount;
+    memcpy(mesh->materialLibraries, header->materialLibraries, sizeof(mesh->materialLibraries));
+    memcpy(mesh->boundsMin, header->boundsMin, sizeof(mesh->boundsMin));
+    memcpy(mesh->boundsMax, header->boundsMax, sizeof(mesh->boundsMax));
+
+    mapping->data = data;
+    mapping->size = size;
+    return true;
+}
+
+bool meshCacheWrite(const char* cachePath, const char* sourcePath, uint32_t optimization, const Mesh* mesh) {
+    struct stat sourceStat;
+    MeshCacheHeader header = {0};
+
+    if (stat(sourcePath, &sourceStat) != 0 || !hashFile(sourcePath, &header.sourceHash)) {
+        return false;
+    }
+
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.vertexStride = sizeof(Vertex);
+    header.optimization = optimization;
+    header.sourceSize = (uint64_t)sourceStat.st_size;
+    header.sourceMtimeNs = mtimeNs(&sourceStat);
+    header.vertexCount = mesh->vertexCount;
+    header.indexCount = mesh->indexCount;
+    header.vertexOffset = alignUp(sizeof(MeshCacheHeader), MESH_CACHE_ALIGNMENT);
+    header.indexOffset = alignUp(header.vertexOffset + (uint64_t)mesh->vertexCount * sizeof(Vertex), MESH_CACHE_ALIGNMENT);
+    header.subsetCount = mesh->subsetCount;
+    header.subsetOffset = alignUp(header.indexOffset + (uint64_t)mesh->indexCount * sizeof(uint32_t), MESH_CACHE_ALIGNMENT);
+    memcpy(header.materialLibraries, mesh->materialLibraries, sizeof(header.materialLibraries));
+    memcpy(header.boundsMin, mesh->boundsMin, sizeof(header.boundsMin));
+    memcpy(header.boundsMax, mesh->boundsMax, sizeof(header.boundsMax));
+
+    // Write to a temporary file and rename so readers never see a partial cache
+    char tempPath[PATH_MAX + 8];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", cachePath);
+
+    FILE* file = fopen(tempPath, "wb");
+    if (!file) {
+        return false;
+    }
+
+    static const uint8_t padding[MESH_CACHE_ALIGNMENT] = {0};
+    uint64_t vertexEnd = header.vertexOffset + (uint64_t)mesh->vertexCount * sizeof(Vertex);
+    uint64_t indexEnd = header.indexOffset + (uint64_t)mesh->indexCount * sizeof(uint32_t);
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(padding, 1, header.vertexOffset - sizeof(header), file) == header.vertexOffset - sizeof(header) &&
+                   fwrite(mesh->vertices, sizeof(Vertex), mesh->vertexCount, file) == mesh->vertexCount &&
+                   fwrite(padding, 1, header.indexOffset - vertexEnd, file) == header.indexOffset - vertexEnd &&
+                   fwrite(mesh->indices, sizeof(uint32_t), mesh->indexCount, file) == mesh->indexCount &&
+                   fwrite(padding, 1, header.subsetOffset - indexEnd, file) == header.subsetOffset - indexEnd &&
+                   fwrite(mesh->subsets, sizeof(MeshSubset), mesh->subsetCount, file) == mesh->subsetCount;
+
+    written = fclose(file) == 0 && written;
+    if (!written || rename(tempPath, cachePath) != 0) {
+        unlink(tempPath);
+        return false;
+    }
+
+    return true;
+}
+
+void meshCacheUnmap(MeshCacheMapping* mapping) {
+    if (mapping->data) {
+        munmap(mapping->data, mapping->size);
+    }
+    mapping->data = NULL;
+    mapping->size = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef SCOP_MESH_CACHE_H
+#define SCOP_MESH_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mesh.h"
+
+// Bump whenever the file layout or the Vertex struct changes
+#define MESH_CACHE_VERSION 4
+
+// Read-only mapping of a cache file; a Mesh loaded from it points inside
+typedef struct {
+    void* data;
+    size_t size;
+} MeshCacheMapping;
+
+// Builds the cache file path for a model in the user's cache directory
+bool meshCachePath(const char* sourcePath, char* path, size_t size);
+
+// Maps a cache file and checks it against the source OBJ. The cache is used
+// as-is when the source size and mtime match; if only the mtime moved, the
+// source is hashed and the cache kept when the content is unchanged.
+// A cache written with a different optimization (a MeshOptimization) is
+// stale too. Indices, subset ranges and material names are checked, so a
+// corrupt file is rejected rather than read out of bounds; a read-only file
+// or directory still loads. On success mesh->vertices/indices/subsets point
+// into the mapping.
+bool meshCacheLoad(const char* cachePath, const char* sourcePath, uint32_t optimization, Mesh* mesh,
+                   MeshCacheMapping* mapping);
+
+// Writes header, interleaved vertices, indices, subsets, material library
+// names and bounds atomically;
+// optimization records how the mesh was reordered
+bool meshCacheWrite(const char* cachePath, const char* sourcePath, uint32_t optimization, const Mesh* mesh);
+
+void meshCacheUnmap(MeshCacheMapping* mapping);
+
+#endif
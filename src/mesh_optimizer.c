@@ -0,0 +1,315 @@
+#include "mesh_optimizer.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_VERTEX UINT32_MAX
+
+// Overdraw ordering may raise the ACMR by this factor at most
+#define MESH_OPTIMIZER_OVERDRAW_THRESHOLD 1.05f
+
+const char* meshOptimizationName(MeshOptimization optimization) {
+    static const char* names[] = {"none", "vertex cache", "vertex cache and overdraw"};
+    return names[optimization];
+}
+
+VertexCacheStats meshAnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount,
+                                        uint32_t cacheSize) {
+    VertexCacheStats stats = {0};
+    if (indexCount == 0) {
+        return stats;
+    }
+
+    // A vertex is cached while fewer than cacheSize misses came after its own
+    uint32_t* insertedAt = calloc(vertexCount, sizeof(uint32_t));
+    uint8_t* used = calloc(vertexCount, 1);
+    uint32_t misses = 0;
+    uint32_t usedCount = 0;
+    for (uint32_t i = 0; i < indexCount; i++) {
+        uint32_t v = indices[i];
+        if (!used[v] || misses - insertedAt[v] >= cacheSize) {
+            insertedAt[v] = misses++;
+            usedCount += !used[v];
+            used[v] = 1;
+        }
+    }
+    free(used);
+    free(insertedAt);
+
+    stats.acmr = (float)misses / (float)(indexCount / 3);
+    stats.atvr = (float)misses / (float)usedCount;
+    return stats;
+}
+
+// Triangles around every vertex, as offsets into a flat list
+static void buildAdjacency(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t* offsets,
+                           uint32_t* triangles) {
+    memset(offsets, 0, (vertexCount + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < indexCount; i++) {
+        offsets[indices[i] + 1]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+
+    uint32_t* fill = malloc(vertexCount * sizeof(uint32_t));
+    memcpy(fill, offsets, vertexCount * sizeof(uint32_t));
+    for (uint32_t i = 0; i < indexCount; i++) {
+        triangles[fill[indices[i]]++] = i / 3;
+    }
+    free(fill);
+}
+
+// Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality
+// and Reduced Overdraw" (2007): fan out around one vertex at a time, then
+// move to the neighbor that stays cached the longest while it still has
+// triangles left
+void meshOptimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount) {
+    uint32_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    uint32_t* offsets = malloc((vertexCount + 1) * sizeof(uint32_t));
+    uint32_t* adjacency = malloc((size_t)indexCount * sizeof(uint32_t));
+    buildAdjacency(indices, indexCount, vertexCount, offsets, adjacency);
+
+    uint32_t* live = malloc(vertexCount * sizeof(uint32_t));
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        live[v] = offsets[v + 1] - offsets[v];
+    }
+    uint32_t* cachedAt = calloc(vertexCount, sizeof(uint32_t));
+    uint8_t* emitted = calloc(triangleCount, 1);
+    uint32_t* deadEnds = malloc((size_t)indexCount * sizeof(uint32_t));
+    uint32_t* candidates = malloc((size_t)indexCount * sizeof(uint32_t));
+    uint32_t* output = malloc((size_t)indexCount * sizeof(uint32_t));
+    uint32_t deadEndCount = 0;
+    uint32_t outputCount = 0;
+    uint32_t time = MESH_OPTIMIZER_CACHE_SIZE + 1;
+    uint32_t cursor = 0;
+    uint32_t fan = indices[0];
+
+    while (fan != NO_VERTEX) {
+        // Emit every remaining triangle around the fanning vertex
+        uint32_t candidateCount = 0;
+        for (uint32_t i = offsets[fan]; i < offsets[fan + 1]; i++) {
+            uint32_t t = adjacency[i];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = 1;
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                output[outputCount++] = v;
+                deadEnds[deadEndCount++] = v;
+                candidates[candidateCount++] = v;
+                live[v]--;
+                if (time - cachedAt[v] > MESH_OPTIMIZER_CACHE_SIZE) {
+                    cachedAt[v] = time++;
+                }
+            }
+        }
+
+        // Prefer a neighbor whose remaining fan still fits in the cache,
+        // the one cached the longest ago
+        fan = NO_VERTEX;
+        int64_t bestPriority = -1;
+        for (uint32_t i = 0; i < candidateCount; i++) {
+            uint32_t v = candidates[i];
+            if (live[v] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            if (time - cachedAt[v] + 2 * live[v] <= MESH_OPTIMIZER_CACHE_SIZE) {
+                priority = time - cachedAt[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fan = v;
+            }
+        }
+
+        // Dead end: back up to a recent vertex with triangles left, or scan on
+        while (fan == NO_VERTEX && deadEndCount > 0) {
+            uint32_t v = deadEnds[--deadEndCount];
+            if (live[v] > 0) {
+                fan = v;
+            }
+        }
+        while (fan == NO_VERTEX && cursor < vertexCount) {
+            if (live[cursor] > 0) {
+                fan = cursor;
+            }
+            cursor++;
+        }
+    }
+
+    memcpy(indices, output, (size_t)outputCount * sizeof(uint32_t));
+    free(output);
+    free(candidates);
+    free(deadEnds);
+    free(emitted);
+    free(cachedAt);
+    free(live);
+    free(adjacency);
+    free(offsets);
+}
+
+typedef struct {
+    uint32_t firstTriangle;
+    uint32_t triangleCount;
+    float sortKey;
+} TriangleCluster;
+
+static int compareClusters(const void* a, const void* b) {
+    const TriangleCluster* x = a;
+    const TriangleCluster* y = b;
+    if (x->sortKey != y->sortKey) {
+        return x->sortKey > y->sortKey ? -1 : 1;
+    }
+    return (x->firstTriangle > y->firstTriangle) - (x->firstTriangle < y->firstTriangle);
+}
+
+void meshOptimizeOverdraw(uint32_t* indices, uint32_t indexCount, const Vertex* vertices, uint32_t vertexCount) {
+    uint32_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Clusters are as short as they can be while their own ACMR, starting
+    // from an empty cache, stays within MESH_OPTIMIZER_OVERDRAW_THRESHOLD of
+    // the whole order's; then moving them around costs little vertex work
+    float limit = MESH_OPTIMIZER_OVERDRAW_THRESHOLD *
+                  meshAnalyzeVertexCache(indices, indexCount, vertexCount, MESH_OPTIMIZER_CACHE_SIZE).acmr;
+    TriangleCluster* clusters = malloc(triangleCount * sizeof(TriangleCluster));
+    uint32_t clusterCount = 0;
+    uint32_t* insertedAt = calloc(vertexCount, sizeof(uint32_t));
+    uint8_t* used = calloc(vertexCount, 1);
+    uint32_t misses = 0;
+    uint32_t clusterMisses = 0;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        if (t == 0 || (float)clusterMisses <= limit * (float)clusters[clusterCount - 1].triangleCount) {
+            if (t > 0) {
+                // Everything cached so far is evicted for the next cluster
+                misses += MESH_OPTIMIZER_CACHE_SIZE;
+            }
+            clusters[clusterCount].firstTriangle = t;
+            clusters[clusterCount].triangleCount = 0;
+            clusterCount++;
+            clusterMisses = 0;
+        }
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[t * 3 + k];
+            if (!used[v] || misses - insertedAt[v] >= MESH_OPTIMIZER_CACHE_SIZE) {
+                insertedAt[v] = misses++;
+                used[v] = 1;
+                clusterMisses++;
+            }
+        }
+        clusters[clusterCount - 1].triangleCount++;
+    }
+    free(used);
+    free(insertedAt);
+
+    // Area-weighted mesh centroid
+    double meshCenter[3] = {0.0, 0.0, 0.0};
+    double meshArea = 0.0;
+    float* areas = malloc(triangleCount * sizeof(float));
+    float (*normals)[3] = malloc(triangleCount * sizeof(*normals));
+    float (*centers)[3] = malloc(triangleCount * sizeof(*centers));
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const float* a = vertices[indices[t * 3]].position;
+        const float* b = vertices[indices[t * 3 + 1]].position;
+        const float* c = vertices[indices[t * 3 + 2]].position;
+        float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        normals[t][0] = e1[1] * e2[2] - e1[2] * e2[1];
+        normals[t][1] = e1[2] * e2[0] - e1[0] * e2[2];
+        normals[t][2] = e1[0] * e2[1] - e1[1] * e2[0];
+        areas[t] = 0.5f * sqrtf(normals[t][0] * normals[t][0] + normals[t][1] * normals[t][1] +
+                                normals[t][2] * normals[t][2]);
+        for (int k = 0; k < 3; k++) {
+            centers[t][k] = (a[k] + b[k] + c[k]) / 3.0f;
+            meshCenter[k] += centers[t][k] * areas[t];
+        }
+        meshArea += areas[t];
+    }
+    for (int k = 0; k < 3; k++) {
+        meshCenter[k] = meshArea > 0.0 ? meshCenter[k] / meshArea : 0.0;
+    }
+
+    // Clusters facing away from the center are drawn first
+    for (uint32_t i = 0; i < clusterCount; i++) {
+        TriangleCluster* cluster = &clusters[i];
+        double center[3] = {0.0, 0.0, 0.0}, normal[3] = {0.0, 0.0, 0.0}, area = 0.0;
+        for (uint32_t t = cluster->firstTriangle; t < cluster->firstTriangle + cluster->triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                center[k] += centers[t][k] * areas[t];
+                normal[k] += normals[t][k];
+            }
+            area += areas[t];
+        }
+        double normalLength = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        double key = 0.0;
+        if (area > 0.0 && normalLength > 0.0) {
+            for (int k = 0; k < 3; k++) {
+                key += (center[k] / area - meshCenter[k]) * normal[k] / normalLength;
+            }
+        }
+        cluster->sortKey = (float)key;
+    }
+    free(centers);
+    free(normals);
+    free(areas);
+    qsort(clusters, clusterCount, sizeof(TriangleCluster), compareClusters);
+
+    uint32_t* output = malloc((size_t)indexCount * sizeof(uint32_t));
+    uint32_t outputCount = 0;
+    for (uint32_t i = 0; i < clusterCount; i++) {
+        uint32_t count = clusters[i].triangleCount * 3;
+        memcpy(output + outputCount, indices + clusters[i].firstTriangle * 3, count * sizeof(uint32_t));
+        outputCount += count;
+    }
+    memcpy(indices, output, (size_t)outputCount * sizeof(uint32_t));
+    free(output);
+    free(clusters);
+}
+
+void meshOptimizeVertexFetch(Mesh* mesh) {
+    uint32_t* remap = malloc(mesh->vertexCount * sizeof(uint32_t));
+    memset(remap, 0xff, mesh->vertexCount * sizeof(uint32_t));
+    Vertex* vertices = malloc(mesh->vertexCount * sizeof(Vertex));
+
+    uint32_t vertexCount = 0;
+    for (uint32_t i = 0; i < mesh->indexCount; i++) {
+        uint32_t v = mesh->indices[i];
+        if (remap[v] == NO_VERTEX) {
+            remap[v] = vertexCount;
+            vertices[vertexCount++] = mesh->vertices[v];
+        }
+        mesh->indices[i] = remap[v];
+    }
+
+    free(mesh->vertices);
+    free(remap);
+    mesh->vertices = vertices;
+    mesh->vertexCount = vertexCount;
+    meshComputeBounds(mesh);
+}
+
+void meshOptimize(Mesh* mesh, MeshOptimization optimization) {
+    if (optimization == MESH_OPTIMIZE_NONE) {
+        return;
+    }
+
+    // Triangles only move within their subset, so materials stay grouped
+    for (uint32_t i = 0; i < mesh->subsetCount; i++) {
+        uint32_t* indices = mesh->indices + mesh->subsets[i].firstIndex;
+        meshOptimizeVertexCache(indices, mesh->subsets[i].indexCount, mesh->vertexCount);
+        if (optimization == MESH_OPTIMIZE_OVERDRAW) {
+            meshOptimizeOverdraw(indices, mesh->subsets[i].indexCount, mesh->vertices, mesh->vertexCount);
+        }
+    }
+    meshOptimizeVertexFetch(mesh);
+}
@@ -0,0 +1,46 @@
+#ifndef SCOP_MESH_OPTIMIZER_H
+#define SCOP_MESH_OPTIMIZER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mesh.h"
+
+// Post-transform cache entries the reordering targets and the statistics
+// simulate, as a FIFO; small enough to suit any GPU
+#define MESH_OPTIMIZER_CACHE_SIZE 16
+
+// Orderings applied by meshOptimize, each including the ones before
+typedef enum {
+    MESH_OPTIMIZE_NONE,
+    MESH_OPTIMIZE_VERTEX_CACHE,     // Tipsify triangle order, then vertices in first-use order
+    MESH_OPTIMIZE_OVERDRAW          // also draws outward-facing clusters of triangles first
+} MeshOptimization;
+
+typedef struct {
+    float acmr;     // transformed vertices per triangle, 0.5 at best and 3 at worst
+    float atvr;     // transformed vertices per vertex, 1 at best
+} VertexCacheStats;
+
+// Simulates a FIFO post-transform cache of cacheSize entries over the indices
+VertexCacheStats meshAnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount,
+                                        uint32_t cacheSize);
+
+// Reorders triangles in place for vertex cache reuse (Tipsify); winding is kept
+void meshOptimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount);
+
+// Reorders runs of triangles that start with a cold cache so the ones facing
+// out from the mesh's center come first and hide what lies behind them
+void meshOptimizeOverdraw(uint32_t* indices, uint32_t indexCount, const Vertex* vertices, uint32_t vertexCount);
+
+// Renumbers vertices in the order the indices first use them and drops the
+// unused ones, so vertex fetches walk memory forward
+void meshOptimizeVertexFetch(Mesh* mesh);
+
+// Applies the orderings of the given level to a mesh in host memory, each
+// subset on its own
+void meshOptimize(Mesh* mesh, MeshOptimization optimization);
+
+const char* meshOptimizationName(MeshOptimization optimization);
+
+#endif
@@ -0,0 +1,208 @@
+#include "meshlet.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const Mesh* mesh;
+    Meshlet* meshlets;
+    uint32_t first;
+    uint32_t count;
+} MeshletBoundsJob;
+
+// Cuts the index buffer wherever the next triangle would overflow a limit.
+// Triangles keep their order, so a meshlet is just a range of indices.
+static uint32_t partition(const Mesh* mesh, Meshlet** meshlets) {
+    uint32_t triangleCount = mesh->indexCount / 3;
+    uint32_t capacity = triangleCount / MESHLET_MAX_TRIANGLES + 16;
+    Meshlet* list = malloc(capacity * sizeof(Meshlet));
+
+    // stamps[v] == count + 1 when vertex v is already in the open meshlet
+    uint32_t* stamps = calloc(mesh->vertexCount, sizeof(uint32_t));
+    uint32_t count = 0;
+    uint32_t vertices = 0;
+    uint32_t triangles = 0;
+    uint32_t first = 0;
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const uint32_t* corners = &mesh->indices[t * 3];
+        uint32_t stamp = count + 1;
+        uint32_t added = (stamps[corners[0]] != stamp) +
+                         (stamps[corners[1]] != stamp && corners[1] != corners[0]) +
+                         (stamps[corners[2]] != stamp && corners[2] != corners[0] && corners[2] != corners[1]);
+
+        if (vertices + added > MESHLET_MAX_VERTICES || triangles == MESHLET_MAX_TRIANGLES) {
+            if (count == capacity) {
+                capacity *= 2;
+                list = realloc(list, capacity * sizeof(Meshlet));
+            }
+            memset(&list[count], 0, sizeof(Meshlet));
+            list[count].firstIndex = first;
+            list[count].indexCount = triangles * 3;
+            list[count].vertexCount = vertices;
+            count++;
+
+            // Every corner is new to the next meshlet
+            stamp = count + 1;
+            first = t * 3;
+            vertices = 0;
+            triangles = 0;
+            added = 1 + (corners[1] != corners[0]) + (corners[2] != corners[0] && corners[2] != corners[1]);
+        }
+
+        stamps[corners[0]] = stamp;
+        stamps[corners[1]] = stamp;
+        stamps[corners[2]] = stamp;
+        vertices += added;
+        triangles++;
+    }
+
+    if (triangles > 0) {
+        if (count == capacity) {
+            list = realloc(list, (capacity + 1) * sizeof(Meshlet));
+        }
+        memset(&list[count], 0, sizeof(Meshlet));
+        list[count].firstIndex = first;
+        list[count].indexCount = triangles * 3;
+        list[count].vertexCount = vertices;
+        count++;
+    }
+
+    free(stamps);
+    *meshlets = list;
+    return count;
+}
+
+static void computeBounds(const Mesh* mesh, Meshlet* meshlet) {
+    const uint32_t* indices = mesh->indices + meshlet->firstIndex;
+
+    // Sphere around the center of the meshlet's box
+    float boundsMin[3], boundsMax[3];
+    memcpy(boundsMin, mesh->vertices[indices[0]].position, sizeof(boundsMin));
+    memcpy(boundsMax, mesh->vertices[indices[0]].position, sizeof(boundsMax));
+    for (uint32_t i = 1; i < meshlet->indexCount; i++) {
+        const float* p = mesh->vertices[indices[i]].position;
+        for (int axis = 0; axis < 3; axis++) {
+            if (p[axis] < boundsMin[axis]) boundsMin[axis] = p[axis];
+            if (p[axis] > boundsMax[axis]) boundsMax[axis] = p[axis];
+        }
+    }
+
+    float radiusSquared = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        meshlet->sphere[axis] = 0.5f * (boundsMin[axis] + boundsMax[axis]);
+    }
+    for (uint32_t i = 0; i < meshlet->indexCount; i++) {
+        const float* p = mesh->vertices[indices[i]].position;
+        float dx = p[0] - meshlet->sphere[0], dy = p[1] - meshlet->sphere[1], dz = p[2] - meshlet->sphere[2];
+        float distanceSquared = dx * dx + dy * dy + dz * dz;
+        radiusSquared = distanceSquared > radiusSquared ? distanceSquared : radiusSquared;
+    }
+    meshlet->sphere[3] = sqrtf(radiusSquared);
+
+    // Cone around the mean of the geometric normals, the ones the rasterizer
+    // culls by; degenerate triangles have none and are skipped
+    float normals[MESHLET_MAX_TRIANGLES][3];
+    uint32_t normalCount = 0;
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+    for (uint32_t i = 0; i + 2 < meshlet->indexCount; i += 3) {
+        const float* a = mesh->vertices[indices[i]].position;
+        const float* b = mesh->vertices[indices[i + 1]].position;
+        const float* c = mesh->vertices[indices[i + 2]].position;
+
+        float e1[3], e2[3], n[3];
+        for (int k = 0; k < 3; k++) {
+            e1[k] = b[k] - a[k];
+            e2[k] = c[k] - a[k];
+        }
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0f) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            normals[normalCount][k] = n[k] / length;
+            axis[k] += normals[normalCount][k];
+        }
+        normalCount++;
+    }
+
+    float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    meshlet->cone[3] = MESHLET_NO_CONE;
+    if (axisLength == 0.0f) {
+        return;
+    }
+
+    float minDot = 1.0f;
+    for (int k = 0; k < 3; k++) {
+        meshlet->cone[k] = axis[k] / axisLength;
+    }
+    for (uint32_t i = 0; i < normalCount; i++) {
+        float d = normals[i][0] * meshlet->cone[0] + normals[i][1] * meshlet->cone[1] + normals[i][2] * meshlet->cone[2];
+        minDot = d < minDot ? d : minDot;
+    }
+    if (minDot > 0.0f) {
+        meshlet->cone[3] = sqrtf(1.0f - minDot * minDot);
+    }
+}
+
+static void boundsJob(void* data, uint32_t threadIndex) {
+    (void)threadIndex;
+    MeshletBoundsJob* job = data;
+    for (uint32_t i = job->first; i < job->first + job->count; i++) {
+        computeBounds(job->mesh, &job->meshlets[i]);
+    }
+}
+
+void meshletBuild(const Mesh* mesh, JobSystem* jobs, MeshletList* list) {
+    list->count = partition(mesh, &list->meshlets);
+
+    uint32_t jobCount = (list->count + MESHLET_BOUNDS_PER_JOB - 1) / MESHLET_BOUNDS_PER_JOB;
+    MeshletBoundsJob* jobData = calloc(jobCount > 0 ? jobCount : 1, sizeof(MeshletBoundsJob));
+    for (uint32_t i = 0; i < jobCount; i++) {
+        jobData[i].mesh = mesh;
+        jobData[i].meshlets = list->meshlets;
+        jobData[i].first = i * MESHLET_BOUNDS_PER_JOB;
+        jobData[i].count = list->count - jobData[i].first < MESHLET_BOUNDS_PER_JOB ? list->count - jobData[i].first
+                                                                                 : MESHLET_BOUNDS_PER_JOB;
+    }
+
+    if (!jobs || jobCount <= 1) {
+        for (uint32_t i = 0; i < jobCount; i++) {
+            boundsJob(&jobData[i], 0);
+        }
+    } else {
+        JobCounter counter = {0};
+        for (uint32_t i = 0; i < jobCount; i++) {
+            jobSystemSubmit(jobs, boundsJob, &jobData[i], &counter);
+        }
+        jobSystemWait(jobs, &counter);
+    }
+    free(jobData);
+}
+
+void meshletWholeMesh(const Mesh* mesh, MeshletList* list) {
+    list->count = 1;
+    list->meshlets = calloc(1, sizeof(Meshlet));
+
+    Meshlet* meshlet = &list->meshlets[0];
+    float radiusSquared = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = mesh->boundsMax[axis] - mesh->boundsMin[axis];
+        meshlet->sphere[axis] = 0.5f * (mesh->boundsMin[axis] + mesh->boundsMax[axis]);
+        radiusSquared += 0.25f * extent * extent;
+    }
+    meshlet->sphere[3] = sqrtf(radiusSquared);
+    meshlet->cone[3] = MESHLET_NO_CONE;
+    meshlet->indexCount = mesh->indexCount;
+    meshlet->vertexCount = mesh->vertexCount;
+}
+
+void meshletFree(MeshletList* list) {
+    free(list->meshlets);
+    memset(list, 0, sizeof(*list));
+}
@@ -0,0 +1,47 @@
+#ifndef SCOP_MESHLET_H
+#define SCOP_MESHLET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "job_system.h"
+#include "mesh.h"
+
+// Cluster size limits, the usual mesh shader sizes so clusters stay small
+// enough to cull finely
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// Meshlets whose bounds are computed by one job
+#define MESHLET_BOUNDS_PER_JOB 4096
+
+// Run of consecutive triangles of the index buffer, laid out as the std430
+// Cluster of cull.comp. Drawn with the mesh's own index buffer, so no mesh
+// shader support is needed.
+typedef struct {
+    float sphere[4];        // xyz = center, w = radius, model space
+    float cone[4];          // xyz = mean triangle normal, w = sine of the widest normal's angle to it
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexCount;   // distinct vertices referenced
+    uint32_t material;      // every triangle's, clusters never span two
+} Meshlet;
+
+// w of a cone that never allows back-face rejection (normals span 90 degrees or more)
+#define MESHLET_NO_CONE 1.0f
+
+typedef struct {
+    Meshlet* meshlets;
+    uint32_t count;
+} MeshletList;
+
+// Splits the mesh into meshlets, greedily in index order, then computes their
+// bounding spheres and normal cones on the job system (jobs may be NULL)
+void meshletBuild(const Mesh* mesh, JobSystem* jobs, MeshletList* list);
+
+// Single cluster covering the whole mesh, without a cone
+void meshletWholeMesh(const Mesh* mesh, MeshletList* list);
+
+void meshletFree(MeshletList* list);
+
+#endif
@@ -0,0 +1,212 @@
+#include "mtl_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// End of the token at p
+static const char* tokenEnd(const char* p, const char* end) {
+    while (p < end && !isBlank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// True when the line at p starts with the keyword followed by a blank
+static bool isKeyword(const char* p, const char* end, const char* keyword) {
+    size_t length = strlen(keyword);
+    return (size_t)(end - p) > length && memcmp(p, keyword, length) == 0 && isBlank(p[length]);
+}
+
+// Reads up to count floats; a single value fills every component, as Kd allows
+static void parseFloats(const char* p, const char* end, float* out, int count) {
+    char buffer[128];
+    size_t length = (size_t)(end - p) < sizeof(buffer) - 1 ? (size_t)(end - p) : sizeof(buffer) - 1;
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+
+    char* cursor = buffer;
+    int parsed = 0;
+    for (; parsed < count; parsed++) {
+        char* next;
+        float value = strtof(cursor, &next);
+        if (next == cursor) {
+            break;
+        }
+        out[parsed] = value;
+        cursor = next;
+    }
+    for (int i = parsed; i > 0 && i < count; i++) {
+        out[i] = out[0];
+    }
+}
+
+static bool isNumber(const char* p, const char* end) {
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    return p < end && ((*p >= '0' && *p <= '9') || *p == '.');
+}
+
+// Skips the options of a map statement and returns where the file name starts
+static const char* skipMapOptions(const char* p, const char* end) {
+    p = skipBlanks(p, end);
+    while (p < end && *p == '-' && !isNumber(p, end)) {
+        const char* option = p;
+        size_t optionLength = (size_t)(tokenEnd(p, end) - p);
+        p = skipBlanks(option + optionLength, end);
+
+        // -o, -s and -t take up to three numbers, -mm two, everything else one value
+        bool vector = optionLength == 2 && (option[1] == 'o' || option[1] == 's' || option[1] == 't');
+        int arguments = vector ? 3 : (optionLength == 3 && memcmp(option, "-mm", 3) == 0) ? 2 : 1;
+        for (int i = 0; i < arguments && p < end; i++) {
+            if (vector && !isNumber(p, end)) {
+                break;
+            }
+            p = skipBlanks(tokenEnd(p, end), end);
+        }
+    }
+    return p;
+}
+
+// Joins a path from a file, relative to the folder of base unless it is absolute
+static char* resolvePath(const char* base, const char* name, size_t nameLength) {
+    const char* slash = strrchr(base, '/');
+    size_t directoryLength = name[0] == '/' || !slash ? 0 : (size_t)(slash - base) + 1;
+
+    char* path = malloc(directoryLength + nameLength + 1);
+    memcpy(path, base, directoryLength);
+    for (size_t i = 0; i < nameLength; i++) {
+        path[directoryLength + i] = name[i] == '\\' ? '/' : name[i];
+    }
+    path[directoryLength + nameLength] = '\0';
+    return path;
+}
+
+static MtlMaterial* addMaterial(MtlLibrary* library, const char* name, size_t length) {
+    if (library->count == library->capacity) {
+        library->capacity = library->capacity ? library->capacity * 2 : 16;
+        library->materials = realloc(library->materials, library->capacity * sizeof(MtlMaterial));
+    }
+
+    // Untextured white until the block says otherwise
+    MtlMaterial* material = &library->materials[library->count++];
+    memset(material, 0, sizeof(*material));
+    length = length < MESH_MATERIAL_NAME_SIZE ? length : MESH_MATERIAL_NAME_SIZE - 1;
+    memcpy(material->name, name, length);
+    material->diffuse[0] = material->diffuse[1] = material->diffuse[2] = 1.0f;
+    material->opacity = 1.0f;
+    return material;
+}
+
+bool mtlLoad(const char* path, MtlLibrary* library) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = size > 0 ? malloc((size_t)size) : NULL;
+    bool read = size >= 0 && (size == 0 || fread(text, 1, (size_t)size, file) == (size_t)size);
+    fclose(file);
+    if (!read) {
+        free(text);
+        return false;
+    }
+
+    // Statements before the first newmtl have nothing to apply to
+    MtlMaterial* material = NULL;
+    const char* p = text;
+    const char* end = text + size;
+    while (p < end) {
+        const char* lineEnd = memchr(p, '\n', (size_t)(end - p));
+        lineEnd = lineEnd ? lineEnd : end;
+        const char* valueEnd = lineEnd;
+        p = skipBlanks(p, lineEnd);
+        while (valueEnd > p && isBlank(valueEnd[-1])) {
+            valueEnd--;
+        }
+
+        if (isKeyword(p, valueEnd, "newmtl")) {
+            const char* name = skipBlanks(p + 6, valueEnd);
+            material = addMaterial(library, name, (size_t)(valueEnd - name));
+        } else if (material && isKeyword(p, valueEnd, "Kd")) {
+            parseFloats(p + 2, valueEnd, material->diffuse, 3);
+        } else if (material && isKeyword(p, valueEnd, "d")) {
+            parseFloats(p + 1, valueEnd, &material->opacity, 1);
+        } else if (material && isKeyword(p, valueEnd, "Tr")) {
+            float transparency = 0.0f;
+            parseFloats(p + 2, valueEnd, &transparency, 1);
+            material->opacity = 1.0f - transparency;
+        } else if (material && isKeyword(p, valueEnd, "map_Kd")) {
+            const char* name = skipMapOptions(p + 6, valueEnd);
+            if (name < valueEnd) {
+                free(material->diffuseMap);
+                material->diffuseMap = resolvePath(path, name, (size_t)(valueEnd - name));
+            }
+        }
+        p = lineEnd + (lineEnd < end);
+    }
+
+    free(text);
+    return true;
+}
+
+void mtlLoadLibraries(const char* objPath, const char* libraries, MtlLibrary* library) {
+    const char* p = libraries;
+    while (*p) {
+        const char* lineEnd = strchr(p, '\n');
+        lineEnd = lineEnd ? lineEnd : p + strlen(p);
+
+        // The line is one name that may hold spaces, unless no such file exists
+        // and it lists several names instead
+        char* path = resolvePath(objPath, p, (size_t)(lineEnd - p));
+        bool loaded = mtlLoad(path, library);
+        free(path);
+        for (const char* name = p; !loaded && name < lineEnd;) {
+            const char* nameEnd = tokenEnd(name, lineEnd);
+            if (nameEnd - name != lineEnd - p) {
+                char* part = resolvePath(objPath, name, (size_t)(nameEnd - name));
+                if (!mtlLoad(part, library)) {
+                    fprintf(stderr, "Failed to read material library: %s\n", part);
+                }
+                free(part);
+            } else {
+                fprintf(stderr, "Failed to read material library: %.*s\n", (int)(lineEnd - p), p);
+                break;
+            }
+            name = skipBlanks(nameEnd, lineEnd);
+        }
+        p = *lineEnd ? lineEnd + 1 : lineEnd;
+    }
+}
+
+const MtlMaterial* mtlFind(const MtlLibrary* library, const char* name) {
+    for (uint32_t i = library->count; i > 0; i--) {
+        if (strcmp(library->materials[i - 1].name, name) == 0) {
+            return &library->materials[i - 1];
+        }
+    }
+    return NULL;
+}
+
+void mtlFree(MtlLibrary* library) {
+    for (uint32_t i = 0; i < library->count; i++) {
+        free(library->materials[i].diffuseMap);
+    }
+    free(library->materials);
+    memset(library, 0, sizeof(*library));
+}
@@ -0,0 +1,37 @@
+#ifndef SCOP_MTL_LOADER_H
+#define SCOP_MTL_LOADER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mesh.h"
+
+// One "newmtl" block; only what the renderer draws is kept
+typedef struct {
+    char name[MESH_MATERIAL_NAME_SIZE];
+    float diffuse[3];               // Kd
+    float opacity;                  // d, or 1 - Tr
+    char* diffuseMap;               // map_Kd resolved against the library's folder, NULL when none
+} MtlMaterial;
+
+typedef struct {
+    MtlMaterial* materials;
+    uint32_t count;
+    uint32_t capacity;
+} MtlLibrary;
+
+// Parses a Wavefront MTL file and appends its materials to the library.
+// Texture options (-s, -o, -bm, ...) are skipped and backslashes in paths
+// read as slashes.
+bool mtlLoad(const char* path, MtlLibrary* library);
+
+// Loads every "mtllib" of an OBJ: libraries holds their names relative to
+// the OBJ, one per line, as Mesh.materialLibraries does
+void mtlLoadLibraries(const char* objPath, const char* libraries, MtlLibrary* library);
+
+// Last material of that name, so a later library overrides an earlier one
+const MtlMaterial* mtlFind(const MtlLibrary* library, const char* name);
+
+void mtlFree(MtlLibrary* library);
+
+#endif
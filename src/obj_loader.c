@@ -0,0 +1,995 @@
+#include "obj_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Marks a missing vt/vn reference in a face corner
+#define OBJ_INDEX_NONE UINT32_MAX
+
+// Set on negative (relative) references resolved against the counts of the
+// chunk being parsed; the merge rebases them onto the global counts
+#define OBJ_INDEX_LOCAL 0x80000000u
+
+// Chunks smaller than this are not worth a job of their own
+#define OBJ_MIN_CHUNK_SIZE (4u << 20)
+
+// Face corner as written in the file, resolved to 0-based attribute indices
+typedef struct {
+    uint32_t v;
+    uint32_t vt;
+    uint32_t vn;
+} ObjCorner;
+
+// Relative reference pointing before the start of its chunk (rare); it can
+// only be resolved once the counts of the preceding chunks are known
+typedef struct {
+    size_t corner;          // index into the chunk's corner array
+    uint32_t attribute;     // 0 = v, 1 = vt, 2 = vn
+    long offset;            // chunk-local index, negative
+} ObjBackReference;
+
+// "usemtl" line: every corner from corner on uses the material, until the next one
+typedef struct {
+    size_t corner;          // corners the chunk had before the line
+    char name[MESH_MATERIAL_NAME_SIZE];
+} ObjMaterialSwitch;
+
+// Raw attribute pools and triangulated corners collected while parsing
+typedef struct {
+    float* positions;       // xyz per "v"
+    size_t positionCount;
+    size_t positionCapacity;
+    float* texCoords;       // uv per "vt"
+    size_t texCoordCount;
+    size_t texCoordCapacity;
+    float* normals;         // xyz per "vn"
+    size_t normalCount;
+    size_t normalCapacity;
+    ObjCorner* corners;     // 3 per triangle
+    size_t cornerCount;
+    size_t cornerCapacity;
+    ObjBackReference* backReferences;
+    size_t backReferenceCount;
+    size_t backReferenceCapacity;
+    ObjMaterialSwitch* materialSwitches;
+    size_t materialSwitchCount;
+    size_t materialSwitchCapacity;
+    char materialLibraries[MESH_LIBRARIES_SIZE];    // "mtllib" names, one per line
+} ObjData;
+
+// Corner -> vertex slot of a deduplication table
+typedef struct {
+    ObjCorner key;
+    uint32_t vertex;        // UINT32_MAX when the slot is empty
+} ObjVertexSlot;
+
+// Open-addressing hash table mapping corners to vertex indices
+typedef struct {
+    ObjVertexSlot* slots;
+    size_t capacity;
+    size_t count;
+} ObjVertexTable;
+
+// One newline-aligned slice of the file, parsed and deduplicated by one job
+typedef struct {
+    const char* begin;
+    const char* end;
+    ObjData data;           // chunk-local pools (the job's arena)
+    size_t positionBase;    // global index of the chunk's first "v"
+    size_t texCoordBase;
+    size_t normalBase;
+    size_t cornerBase;      // global index of the chunk's first corner
+    ObjCorner* uniqueCorners;   // chunk-local vertices in first-use order
+    uint32_t uniqueCount;
+    uint32_t* globalVertices;   // uniqueCorners -> mesh vertex index
+} ObjChunk;
+
+// Shared state of one load, handed to every chunk job
+typedef struct {
+    ObjChunk* chunks;
+    size_t chunkCount;
+    ObjData pools;          // merged global attribute pools
+    Mesh* mesh;
+    bool invalid;           // set by a job that found a bad reference
+} ObjLoad;
+
+typedef struct {
+    ObjLoad* load;
+    size_t chunk;
+} ObjChunkJob;
+
+// Grows an array geometrically so parsing never allocates per line
+static void reserveArray(void** data, size_t* capacity, size_t needed, size_t elemSize) {
+    if (needed <= *capacity) {
+        return;
+    }
+
+    size_t newCapacity = *capacity ? *capacity : 1024;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+
+    void* grown = realloc(*data, newCapacity * elemSize);
+    if (!grown) {
+        fprintf(stderr, "Out of memory while loading OBJ file!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *data = grown;
+    *capacity = newCapacity;
+}
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static inline const char* skipLine(const char* p, const char* end) {
+    const char* newline = memchr(p, '\n', (size_t)(end - p));
+    return newline ? newline + 1 : end;
+}
+
+// Bounded float parser; the mapping is not NUL-terminated so strtod can't be used.
+// Leaves *out untouched and returns p when no number is present.
+static const char* parseFloat(const char* p, const char* end, float* out) {
+    static const double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int significantDigits = 0;
+    bool anyDigits = false;
+
+    while (p < end && isDigit(*p)) {
+        if (significantDigits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            if (mantissa) significantDigits++;
+        } else {
+            exponent++;
+        }
+        anyDigits = true;
+        p++;
+    }
+
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && isDigit(*p)) {
+            if (significantDigits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                if (mantissa) significantDigits++;
+                exponent--;
+            }
+            anyDigits = true;
+            p++;
+        }
+    }
+
+    if (!anyDigits) {
+        return start;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            negativeExponent = *q == '-';
+            q++;
+        }
+        if (q < end && isDigit(*q)) {
+            int value = 0;
+            while (q < end && isDigit(*q)) {
+                if (value < 10000) value = value * 10 + (*q - '0');
+                q++;
+            }
+            exponent += negativeExponent ? -value : value;
+            p = q;
+        }
+    }
+
+    double value = (double)mantissa;
+    if (exponent < 0) {
+        value = -exponent <= 22 ? value / powersOf10[-exponent] : value * pow(10.0, exponent);
+    } else if (exponent > 0) {
+        value = exponent <= 22 ? value * powersOf10[exponent] : value * pow(10.0, exponent);
+    }
+
+    *out = (float)(negative ? -value : value);
+    return p;
+}
+
+// Parses a signed decimal integer; returns p when no digits are present
+static const char* parseInt(const char* p, const char* end, long* out) {
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    if (p >= end || !isDigit(*p)) {
+        return start;
+    }
+
+    // Saturates instead of overflowing; anything that large is past every
+    // index range, so the index checks reject it
+    long value = 0;
+    while (p < end && isDigit(*p)) {
+        value = value <= (LONG_MAX - 9) / 10 ? value * 10 + (*p - '0') : LONG_MAX;
+        p++;
+    }
+
+    *out = negative ? -value : value;
+    return p;
+}
+
+// Turns a 1-based (or negative, relative) OBJ index into a 0-based one.
+// Relative references that reach before the chunk start are returned through
+// backOffset and resolved during the merge.
+static inline uint32_t resolveIndex(long index, size_t count, long* backOffset) {
+    if (index > 0) {
+        return index - 1 < (long)OBJ_INDEX_LOCAL ? (uint32_t)(index - 1) : OBJ_INDEX_LOCAL - 1;
+    }
+    if (index < 0) {
+        if ((size_t)(-index) <= count) {
+            return (uint32_t)((long)count + index) | OBJ_INDEX_LOCAL;
+        }
+        *backOffset = (long)count + index;
+        return 0;
+    }
+    return OBJ_INDEX_LOCAL - 1;
+}
+
+// Parses "v", "v/vt", "v//vn" or "v/vt/vn"; returns p if no corner is present
+static const char* parseCorner(const char* p, const char* end, const ObjData* obj, ObjCorner* corner, long backOffsets[3]) {
+    long index = 0;
+    const char* next = parseInt(p, end, &index);
+    if (next == p) {
+        return p;
+    }
+
+    backOffsets[0] = backOffsets[1] = backOffsets[2] = 0;
+    corner->v = resolveIndex(index, obj->positionCount, &backOffsets[0]);
+    corner->vt = OBJ_INDEX_NONE;
+    corner->vn = OBJ_INDEX_NONE;
+    p = next;
+
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/') {
+            index = 0;
+            next = parseInt(p, end, &index);
+            if (next != p) {
+                corner->vt = resolveIndex(index, obj->texCoordCount, &backOffsets[1]);
+            }
+            p = next;
+        }
+        if (p < end && *p == '/') {
+            p++;
+            index = 0;
+            next = parseInt(p, end, &index);
+            if (next != p) {
+                corner->vn = resolveIndex(index, obj->normalCount, &backOffsets[2]);
+            }
+            p = next;
+        }
+    }
+
+    // Skip anything unexpected up to the next separator
+    while (p < end && !isBlank(*p) && *p != '\n') {
+        p++;
+    }
+    return p;
+}
+
+static const char* parseVec(const char* p, const char* end, float* out, int count) {
+    for (int i = 0; i < count; i++) {
+        p = skipBlanks(p, end);
+        p = parseFloat(p, end, &out[i]);
+    }
+    return p;
+}
+
+static void emitCorner(ObjData* obj, const ObjCorner* corner, const long backOffsets[3]) {
+    for (uint32_t attribute = 0; attribute < 3; attribute++) {
+        if (backOffsets[attribute] < 0) {
+            reserveArray((void**)&obj->backReferences, &obj->backReferenceCapacity,
+                         obj->backReferenceCount + 1, sizeof(ObjBackReference));
+            ObjBackReference* ref = &obj->backReferences[obj->backReferenceCount++];
+            ref->corner = obj->cornerCount;
+            ref->attribute = attribute;
+            ref->offset = backOffsets[attribute];
+        }
+    }
+    obj->corners[obj->cornerCount++] = *corner;
+}
+
+// Fan-triangulates one "f" line straight into the corner array
+static void parseFace(const char* p, const char* end, ObjData* obj) {
+    ObjCorner first = {0}, previous = {0}, current = {0};
+    long firstBack[3] = {0}, previousBack[3] = {0}, currentBack[3] = {0};
+    int cornerCount = 0;
+
+    while (true) {
+        p = skipBlanks(p, end);
+        if (p >= end || *p == '\n' || *p == '#') {
+            break;
+        }
+
+        const char* next = parseCorner(p, end, obj, &current, currentBack);
+        if (next == p) {
+            break;
+        }
+        p = next;
+
+        if (cornerCount == 0) {
+            first = current;
+            memcpy(firstBack, currentBack, sizeof(firstBack));
+        } else if (cornerCount >= 2) {
+            reserveArray((void**)&obj->corners, &obj->cornerCapacity, obj->cornerCount + 3, sizeof(ObjCorner));
+            emitCorner(obj, &first, firstBack);
+            emitCorner(obj, &previous, previousBack);
+            emitCorner(obj, &current, currentBack);
+        }
+        previous = current;
+        memcpy(previousBack, currentBack, sizeof(previousBack));
+        cornerCount++;
+    }
+}
+
+// End of the name that runs from p to the end of the line, trailing blanks left out
+static const char* nameEnd(const char* p, const char* end) {
+    const char* last = p;
+    while (last < end && *last != '\n') {
+        last++;
+    }
+    while (last > p && isBlank(last[-1])) {
+        last--;
+    }
+    return last;
+}
+
+// Appends name as one more line of a library list, when it fits whole
+static void appendLibrary(char* libraries, const char* name, size_t length) {
+    size_t used = strlen(libraries);
+    size_t needed = length + (used > 0);
+    if (length == 0 || used + needed >= MESH_LIBRARIES_SIZE) {
+        return;
+    }
+    if (used > 0) {
+        libraries[used++] = '\n';
+    }
+    memcpy(libraries + used, name, length);
+    libraries[used + length] = '\0';
+}
+
+// Records the name of a "usemtl" line, which runs to the end of the line
+static void parseMaterialSwitch(const char* p, const char* end, ObjData* obj) {
+    p = skipBlanks(p, end);
+    const char* last = nameEnd(p, end);
+
+    reserveArray((void**)&obj->materialSwitches, &obj->materialSwitchCapacity, obj->materialSwitchCount + 1,
+                 sizeof(ObjMaterialSwitch));
+    ObjMaterialSwitch* materialSwitch = &obj->materialSwitches[obj->materialSwitchCount++];
+    size_t length = (size_t)(last - p) < MESH_MATERIAL_NAME_SIZE ? (size_t)(last - p) : MESH_MATERIAL_NAME_SIZE - 1;
+    memset(materialSwitch->name, 0, sizeof(materialSwitch->name));
+    memcpy(materialSwitch->name, p, length);
+    materialSwitch->corner = obj->cornerCount;
+}
+
+static void parseObjText(const char* p, const char* end, ObjData* obj) {
+    while (p < end) {
+        p = skipBlanks(p, end);
+        if (p + 1 >= end) {
+            break;
+        }
+
+        if (p[0] == 'v') {
+            if (isBlank(p[1])) {
+                reserveArray((void**)&obj->positions, &obj->positionCapacity, (obj->positionCount + 1) * 3, sizeof(float));
+                float* v = &obj->positions[obj->positionCount * 3];
+                v[0] = v[1] = v[2] = 0.0f;
+                p = parseVec(p + 1, end, v, 3);
+                obj->positionCount++;
+            } else if (p[1] == 't' && p + 2 < end && isBlank(p[2])) {
+                reserveArray((void**)&obj->texCoords, &obj->texCoordCapacity, (obj->texCoordCount + 1) * 2, sizeof(float));
+                float* vt = &obj->texCoords[obj->texCoordCount * 2];
+                vt[0] = vt[1] = 0.0f;
+                p = parseVec(p + 2, end, vt, 2);
+                obj->texCoordCount++;
+            } else if (p[1] == 'n' && p + 2 < end && isBlank(p[2])) {
+                reserveArray((void**)&obj->normals, &obj->normalCapacity, (obj->normalCount + 1) * 3, sizeof(float));
+                float* vn = &obj->normals[obj->normalCount * 3];
+                vn[0] = vn[1] = vn[2] = 0.0f;
+                p = parseVec(p + 2, end, vn, 3);
+                obj->normalCount++;
+            }
+        } else if (p[0] == 'f' && isBlank(p[1])) {
+            parseFace(p + 1, end, obj);
+        } else if (p[0] == 'u' && end - p > 6 && memcmp(p, "usemtl", 6) == 0 && (isBlank(p[6]) || p[6] == '\n')) {
+            parseMaterialSwitch(p + 6, end, obj);
+        } else if (p[0] == 'm' && end - p > 6 && memcmp(p, "mtllib", 6) == 0 && isBlank(p[6])) {
+            const char* name = skipBlanks(p + 6, end);
+            appendLibrary(obj->materialLibraries, name, (size_t)(nameEnd(name, end) - name));
+        }
+
+        // Everything else (comments, o/g/s) is skipped
+        p = skipLine(p, end);
+    }
+}
+
+static void freeObjData(ObjData* obj) {
+    free(obj->positions);
+    free(obj->texCoords);
+    free(obj->normals);
+    free(obj->corners);
+    free(obj->backReferences);
+    free(obj->materialSwitches);
+    memset(obj, 0, sizeof(*obj));
+}
+
+static inline uint32_t hashCorner(const ObjCorner* corner) {
+    uint32_t h = corner->v * 0x9E3779B1u;
+    h ^= corner->vt * 0x85EBCA77u + (h << 6) + (h >> 2);
+    h ^= corner->vn * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    return h;
+}
+
+static void vertexTableInit(ObjVertexTable* table, size_t expectedCount) {
+    table->capacity = 1024;
+    while (table->capacity < expectedCount * 2) {
+        table->capacity *= 2;
+    }
+    table->count = 0;
+    table->slots = malloc(table->capacity * sizeof(ObjVertexSlot));
+    if (!table->slots) {
+        fprintf(stderr, "Out of memory while loading OBJ file!\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < table->capacity; i++) {
+        table->slots[i].vertex = UINT32_MAX;
+    }
+}
+
+// Returns the vertex already stored for key, or stores and returns newVertex
+static uint32_t vertexTableFindOrInsert(ObjVertexTable* table, const ObjCorner* key, uint32_t newVertex) {
+    size_t mask = table->capacity - 1;
+    size_t i = hashCorner(key) & mask;
+    while (table->slots[i].vertex != UINT32_MAX) {
+        const ObjCorner* slotKey = &table->slots[i].key;
+        if (slotKey->v == key->v && slotKey->vt == key->vt && slotKey->vn == key->vn) {
+            return table->slots[i].vertex;
+        }
+        i = (i + 1) & mask;
+    }
+
+    table->slots[i].key = *key;
+    table->slots[i].vertex = newVertex;
+    table->count++;
+
+    // Keep the load factor under 1/2
+    if (table->count * 2 > table->capacity) {
+        ObjVertexTable grown;
+        vertexTableInit(&grown, table->capacity);
+        size_t grownMask = grown.capacity - 1;
+        for (size_t s = 0; s < table->capacity; s++) {
+            if (table->slots[s].vertex == UINT32_MAX) {
+                continue;
+            }
+            size_t j = hashCorner(&table->slots[s].key) & grownMask;
+            while (grown.slots[j].vertex != UINT32_MAX) {
+                j = (j + 1) & grownMask;
+            }
+            grown.slots[j] = table->slots[s];
+        }
+        grown.count = table->count;
+        free(table->slots);
+        *table = grown;
+    }
+
+    return newVertex;
+}
+
+static inline uint32_t rebaseIndex(uint32_t index, size_t base) {
+    if (index != OBJ_INDEX_NONE && (index & OBJ_INDEX_LOCAL)) {
+        return (uint32_t)((index & ~OBJ_INDEX_LOCAL) + base);
+    }
+    return index;
+}
+
+static inline bool cornerInRange(const ObjCorner* corner, const ObjData* pools) {
+    return corner->v < pools->positionCount &&
+           (corner->vt == OBJ_INDEX_NONE || corner->vt < pools->texCoordCount) &&
+           (corner->vn == OBJ_INDEX_NONE || corner->vn < pools->normalCount);
+}
+
+static void parseChunkJob(void* data, uint32_t threadIndex) {
+    (void)threadIndex;
+    ObjChunkJob* job = data;
+    ObjChunk* chunk = &job->load->chunks[job->chunk];
+    size_t size = (size_t)(chunk->end - chunk->begin);
+
+    // Pre-size the chunk pools from its size to avoid most regrowth
+    reserveArray((void**)&chunk->data.positions, &chunk->data.positionCapacity, size / 32 * 3 / 2, sizeof(float));
+    reserveArray((void**)&chunk->data.corners, &chunk->data.cornerCapacity, size / 16, sizeof(ObjCorner));
+
+    parseObjText(chunk->begin, chunk->end, &chunk->data);
+}
+
+// Moves the chunk's attributes into the global pools, rebases its corners and
+// deduplicates them locally; the index buffer receives chunk-local vertex ids
+static void mergeChunkJob(void* data, uint32_t threadIndex) {
+    (void)threadIndex;
+    ObjChunkJob* job = data;
+    ObjLoad* load = job->load;
+    ObjChunk* chunk = &load->chunks[job->chunk];
+    ObjData* local = &chunk->data;
+
+    if (load->chunkCount > 1) {
+        memcpy(load->pools.positions + chunk->positionBase * 3, local->positions, local->positionCount * 3 * sizeof(float));
+        memcpy(load->pools.texCoords + chunk->texCoordBase * 2, local->texCoords, local->texCoordCount * 2 * sizeof(float));
+        memcpy(load->pools.normals + chunk->normalBase * 3, local->normals, local->normalCount * 3 * sizeof(float));
+        free(local->positions);
+        free(local->texCoords);
+        free(local->normals);
+        local->positions = local->texCoords = local->normals = NULL;
+    }
+
+    for (size_t i = 0; i < local->cornerCount; i++) {
+        ObjCorner* corner = &local->corners[i];
+        corner->v = rebaseIndex(corner->v, chunk->positionBase);
+        corner->vt = rebaseIndex(corner->vt, chunk->texCoordBase);
+        corner->vn = rebaseIndex(corner->vn, chunk->normalBase);
+    }
+
+    for (size_t i = 0; i < local->backReferenceCount; i++) {
+        const ObjBackReference* ref = &local->backReferences[i];
+        ObjCorner* corner = &local->corners[ref->corner];
+        size_t bases[3] = {chunk->positionBase, chunk->texCoordBase, chunk->normalBase};
+        long resolved = (long)bases[ref->attribute] + ref->offset;
+        uint32_t value = resolved >= 0 ? (uint32_t)resolved : OBJ_INDEX_LOCAL - 1;
+        if (ref->attribute == 0) corner->v = value;
+        else if (ref->attribute == 1) corner->vt = value;
+        else corner->vn = value;
+    }
+
+    ObjVertexTable table;
+    vertexTableInit(&table, local->cornerCount / 4);
+    size_t uniqueCapacity = 0;
+    uint32_t* indices = load->mesh->indices + chunk->cornerBase;
+
+    for (size_t i = 0; i < local->cornerCount; i++) {
+        const ObjCorner* corner = &local->corners[i];
+        uint32_t vertex = vertexTableFindOrInsert(&table, corner, chunk->uniqueCount);
+        if (vertex == chunk->uniqueCount) {
+            if (!cornerInRange(corner, &load->pools)) {
+                __atomic_store_n(&load->invalid, true, __ATOMIC_RELAXED);
+                break;
+            }
+            reserveArray((void**)&chunk->uniqueCorners, &uniqueCapacity, chunk->uniqueCount + 1, sizeof(ObjCorner));
+            chunk->uniqueCorners[chunk->uniqueCount++] = *corner;
+        }
+        indices[i] = vertex;
+    }
+
+    free(table.slots);
+    free(local->corners);
+    free(local->backReferences);
+    local->corners = NULL;
+    local->backReferences = NULL;
+}
+
+// Rewrites chunk-local vertex ids into mesh vertex indices
+static void remapChunkJob(void* data, uint32_t threadIndex) {
+    (void)threadIndex;
+    ObjChunkJob* job = data;
+    ObjChunk* chunk = &job->load->chunks[job->chunk];
+    uint32_t* indices = job->load->mesh->indices + chunk->cornerBase;
+
+    for (size_t i = 0; i < chunk->data.cornerCount; i++) {
+        indices[i] = chunk->globalVertices[indices[i]];
+    }
+}
+
+static void runChunkJobs(JobSystem* jobs, JobFunction function, ObjLoad* load, ObjChunkJob* jobData) {
+    if (!jobs || load->chunkCount == 1) {
+        for (size_t i = 0; i < load->chunkCount; i++) {
+            function(&jobData[i], 0);
+        }
+        return;
+    }
+
+    JobCounter counter = {0};
+    for (size_t i = 0; i < load->chunkCount; i++) {
+        jobSystemSubmit(jobs, function, &jobData[i], &counter);
+    }
+    jobSystemWait(jobs, &counter);
+}
+
+// Accumulates area-weighted face normals into vertices that came without one
+static void generateMissingNormals(Mesh* mesh, const uint8_t* missing) {
+    for (uint32_t i = 0; i + 2 < mesh->indexCount; i += 3) {
+        Vertex* a = &mesh->vertices[mesh->indices[i]];
+        Vertex* b = &mesh->vertices[mesh->indices[i + 1]];
+        Vertex* c = &mesh->vertices[mesh->indices[i + 2]];
+
+        float e1[3], e2[3], n[3];
+        for (int axis = 0; axis < 3; axis++) {
+            e1[axis] = b->position[axis] - a->position[axis];
+            e2[axis] = c->position[axis] - a->position[axis];
+        }
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+        for (int corner = 0; corner < 3; corner++) {
+            uint32_t index = mesh->indices[i + corner];
+            if (missing[index]) {
+                for (int axis = 0; axis < 3; axis++) {
+                    mesh->vertices[index].normal[axis] += n[axis];
+                }
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < mesh->vertexCount; i++) {
+        if (!missing[i]) {
+            continue;
+        }
+        float* n = mesh->vertices[i].normal;
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0f) {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        } else {
+            n[2] = 1.0f;
+        }
+    }
+}
+
+// Expands the unique corners into interleaved vertices
+static void buildVertices(Mesh* mesh, const ObjData* pools, const ObjCorner* corners) {
+    mesh->vertices = malloc((size_t)mesh->vertexCount * sizeof(Vertex));
+    uint8_t* missingNormal = malloc(mesh->vertexCount ? mesh->vertexCount : 1);
+    bool anyMissingNormal = false;
+
+    if (!mesh->vertices || !missingNormal) {
+        fprintf(stderr, "Out of memory while loading OBJ file!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0; i < mesh->vertexCount; i++) {
+        const ObjCorner* corner = &corners[i];
+        Vertex* vertex = &mesh->vertices[i];
+
+        memcpy(vertex->position, &pools->positions[(size_t)corner->v * 3], sizeof(vertex->position));
+        if (corner->vt != OBJ_INDEX_NONE) {
+            memcpy(vertex->texCoord, &pools->texCoords[(size_t)corner->vt * 2], sizeof(vertex->texCoord));
+        } else {
+            vertex->texCoord[0] = vertex->texCoord[1] = 0.0f;
+        }
+        if (corner->vn != OBJ_INDEX_NONE) {
+            memcpy(vertex->normal, &pools->normals[(size_t)corner->vn * 3], sizeof(vertex->normal));
+            missingNormal[i] = 0;
+        } else {
+            vertex->normal[0] = vertex->normal[1] = vertex->normal[2] = 0.0f;
+            missingNormal[i] = 1;
+            anyMissingNormal = true;
+        }
+    }
+
+    if (anyMissingNormal) {
+        generateMissingNormals(mesh, missingNormal);
+    }
+    free(missingNormal);
+}
+
+// Splits the text into chunkCount slices that each end on a newline
+static size_t splitChunks(const char* text, size_t size, size_t chunkCount, ObjChunk* chunks) {
+    const char* end = text + size;
+    const char* begin = text;
+    size_t count = 0;
+
+    for (size_t i = 0; i < chunkCount && begin < end; i++) {
+        const char* split = end;
+        if (i + 1 < chunkCount) {
+            split = text + size / chunkCount * (i + 1);
+            if (split < begin) {
+                split = begin;
+            }
+            const char* newline = memchr(split, '\n', (size_t)(end - split));
+            split = newline ? newline + 1 : end;
+        }
+
+        memset(&chunks[count], 0, sizeof(ObjChunk));
+        chunks[count].begin = begin;
+        chunks[count].end = split;
+        count++;
+        begin = split;
+    }
+
+    return count;
+}
+
+static bool mergeChunks(ObjLoad* load, JobSystem* jobs, ObjChunkJob* jobData, const char* filename) {
+    Mesh* mesh = load->mesh;
+    size_t positionCount = 0, texCoordCount = 0, normalCount = 0, cornerCount = 0;
+
+    // Global bases of every chunk, in file order
+    for (size_t i = 0; i < load->chunkCount; i++) {
+        ObjChunk* chunk = &load->chunks[i];
+        chunk->positionBase = positionCount;
+        chunk->texCoordBase = texCoordCount;
+        chunk->normalBase = normalCount;
+        chunk->cornerBase = cornerCount;
+        positionCount += chunk->data.positionCount;
+        texCoordCount += chunk->data.texCoordCount;
+        normalCount += chunk->data.normalCount;
+        cornerCount += chunk->data.cornerCount;
+    }
+
+    if (cornerCount == 0) {
+        fprintf(stderr, "OBJ file has no faces: %s\n", filename);
+        return false;
+    }
+    if (cornerCount > UINT32_MAX || positionCount >= OBJ_INDEX_LOCAL ||
+        texCoordCount >= OBJ_INDEX_LOCAL || normalCount >= OBJ_INDEX_LOCAL) {
+        fprintf(stderr, "OBJ file is too large: %s\n", filename);
+        return false;
+    }
+
+    if (load->chunkCount == 1) {
+        load->pools = load->chunks[0].data;
+    } else {
+        load->pools.positions = malloc((positionCount * 3 + 1) * sizeof(float));
+        load->pools.texCoords = malloc((texCoordCount * 2 + 1) * sizeof(float));
+        load->pools.normals = malloc((normalCount * 3 + 1) * sizeof(float));
+        if (!load->pools.positions || !load->pools.texCoords || !load->pools.normals) {
+            fprintf(stderr, "Out of memory while loading OBJ file!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    load->pools.positionCount = positionCount;
+    load->pools.texCoordCount = texCoordCount;
+    load->pools.normalCount = normalCount;
+
+    mesh->indexCount = (uint32_t)cornerCount;
+    mesh->indices = malloc(cornerCount * sizeof(uint32_t));
+    if (!mesh->indices) {
+        fprintf(stderr, "Out of memory while loading OBJ file!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    runChunkJobs(jobs, mergeChunkJob, load, jobData);
+    if (load->invalid) {
+        fprintf(stderr, "OBJ face references a missing vertex attribute: %s\n", filename);
+        return false;
+    }
+
+    if (load->chunkCount == 1) {
+        // Chunk-local ids already are the final vertex indices
+        mesh->vertexCount = load->chunks[0].uniqueCount;
+        buildVertices(mesh, &load->pools, load->chunks[0].uniqueCorners);
+        return true;
+    }
+
+    // Assign global vertex ids in chunk order, which reproduces the
+    // first-use order of a serial parse exactly
+    size_t uniqueTotal = 0;
+    for (size_t i = 0; i < load->chunkCount; i++) {
+        uniqueTotal += load->chunks[i].uniqueCount;
+    }
+
+    ObjVertexTable table;
+    vertexTableInit(&table, uniqueTotal);
+    ObjCorner* vertexCorners = malloc((uniqueTotal + 1) * sizeof(ObjCorner));
+    uint32_t vertexCount = 0;
+
+    for (size_t i = 0; i < load->chunkCount; i++) {
+        ObjChunk* chunk = &load->chunks[i];
+        chunk->globalVertices = malloc(((size_t)chunk->uniqueCount + 1) * sizeof(uint32_t));
+        for (uint32_t u = 0; u < chunk->uniqueCount; u++) {
+            uint32_t vertex = vertexTableFindOrInsert(&table, &chunk->uniqueCorners[u], vertexCount);
+            if (vertex == vertexCount) {
+                vertexCorners[vertexCount++] = chunk->uniqueCorners[u];
+            }
+            chunk->globalVertices[u] = vertex;
+        }
+    }
+    free(table.slots);
+
+    runChunkJobs(jobs, remapChunkJob, load, jobData);
+
+    mesh->vertexCount = vertexCount;
+    buildVertices(mesh, &load->pools, vertexCorners);
+    free(vertexCorners);
+    return true;
+}
+
+// Subset of the named material, appended when the material is new
+static uint32_t findSubset(Mesh* mesh, size_t* capacity, const char* name) {
+    for (uint32_t i = 0; i < mesh->subsetCount; i++) {
+        if (strcmp(mesh->subsets[i].material, name) == 0) {
+            return i;
+        }
+    }
+
+    reserveArray((void**)&mesh->subsets, capacity, mesh->subsetCount + 1, sizeof(MeshSubset));
+    MeshSubset* subset = &mesh->subsets[mesh->subsetCount];
+    memset(subset, 0, sizeof(*subset));
+    memcpy(subset->material, name, strlen(name) + 1);
+    return mesh->subsetCount++;
+}
+
+// Sorts the triangles by material, materials in order of first use and
+// triangles in file order within each, and records a subset per material.
+// Switches only depend on the global corner index, so a parallel load
+// groups exactly like a serial one.
+static void groupMaterials(ObjLoad* load) {
+    Mesh* mesh = load->mesh;
+    uint32_t triangleCount = mesh->indexCount / 3;
+    uint32_t* triangleSubsets = malloc(((size_t)triangleCount + 1) * sizeof(uint32_t));
+    size_t subsetCapacity = 0;
+
+    // Every run of triangles between two switches gets the material of the
+    // first; a material only becomes a subset once it has a triangle
+    const char* current = "";
+    uint32_t triangle = 0;
+    for (size_t i = 0; i <= load->chunkCount; i++) {
+        const ObjChunk* chunk = i < load->chunkCount ? &load->chunks[i] : NULL;
+        size_t switchCount = chunk ? chunk->data.materialSwitchCount : 1;
+        for (size_t j = 0; j < switchCount; j++) {
+            const ObjMaterialSwitch* materialSwitch = chunk ? &chunk->data.materialSwitches[j] : NULL;
+            uint32_t runEnd = chunk ? (uint32_t)((chunk->cornerBase + materialSwitch->corner) / 3) : triangleCount;
+            if (runEnd > triangle) {
+                uint32_t subset = findSubset(mesh, &subsetCapacity, current);
+                for (; triangle < runEnd; triangle++) {
+                    triangleSubsets[triangle] = subset;
+                }
+            }
+            if (materialSwitch) {
+                current = materialSwitch->name;
+            }
+        }
+    }
+
+    // Stable counting sort of the triangles by subset
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        mesh->subsets[triangleSubsets[t]].indexCount += 3;
+    }
+    uint32_t next = 0;
+    for (uint32_t s = 0; s < mesh->subsetCount; s++) {
+        mesh->subsets[s].firstIndex = next;
+        next += mesh->subsets[s].indexCount;
+    }
+    if (mesh->subsetCount > 1) {
+        uint32_t* sorted = malloc((size_t)mesh->indexCount * sizeof(uint32_t));
+        uint32_t* fill = malloc(mesh->subsetCount * sizeof(uint32_t));
+        if (!sorted || !fill) {
+            fprintf(stderr, "Out of memory while loading OBJ file!\n");
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t s = 0; s < mesh->subsetCount; s++) {
+            fill[s] = mesh->subsets[s].firstIndex;
+        }
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            memcpy(&sorted[fill[triangleSubsets[t]]], &mesh->indices[t * 3], 3 * sizeof(uint32_t));
+            fill[triangleSubsets[t]] += 3;
+        }
+        free(fill);
+        free(mesh->indices);
+        mesh->indices = sorted;
+    }
+    free(triangleSubsets);
+}
+
+bool objLoadMesh(const char* filename, Mesh* mesh, JobSystem* jobs) {
+    memset(mesh, 0, sizeof(*mesh));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open OBJ file: %s\n", filename);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "OBJ file is empty or unreadable: %s\n", filename);
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const char* text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED) {
+        fprintf(stderr, "Failed to map OBJ file: %s\n", filename);
+        return false;
+    }
+    madvise((void*)text, size, MADV_SEQUENTIAL);
+
+    // A few chunks per thread keeps workers busy when line density varies
+    size_t chunkCount = 1;
+    if (jobs) {
+        chunkCount = ((size_t)jobs->threadCount + 1) * 4;
+        if (chunkCount > size / OBJ_MIN_CHUNK_SIZE) {
+            chunkCount = size / OBJ_MIN_CHUNK_SIZE;
+        }
+        if (chunkCount == 0) {
+            chunkCount = 1;
+        }
+    }
+
+    ObjLoad load = {0};
+    load.mesh = mesh;
+    load.chunks = malloc(chunkCount * sizeof(ObjChunk));
+    load.chunkCount = splitChunks(text, size, chunkCount, load.chunks);
+
+    ObjChunkJob* jobData = malloc(load.chunkCount * sizeof(ObjChunkJob));
+    for (size_t i = 0; i < load.chunkCount; i++) {
+        jobData[i].load = &load;
+        jobData[i].chunk = i;
+    }
+
+    runChunkJobs(jobs, parseChunkJob, &load, jobData);
+    munmap((void*)text, size);
+
+    bool merged = mergeChunks(&load, jobs, jobData, filename);
+    if (merged) {
+        for (size_t i = 0; i < load.chunkCount; i++) {
+            const char* libraries = load.chunks[i].data.materialLibraries;
+            for (const char* line = libraries; *line;) {
+                const char* lineEnd = strchr(line, '\n');
+                lineEnd = lineEnd ? lineEnd : line + strlen(line);
+                appendLibrary(mesh->materialLibraries, line, (size_t)(lineEnd - line));
+                line = *lineEnd ? lineEnd + 1 : lineEnd;
+            }
+        }
+        groupMaterials(&load);
+        meshComputeBounds(mesh);
+    } else {
+        meshFree(mesh);
+    }
+
+    for (size_t i = 0; i < load.chunkCount; i++) {
+        freeObjData(&load.chunks[i].data);
+        free(load.chunks[i].uniqueCorners);
+        free(load.chunks[i].globalVertices);
+    }
+    if (load.chunkCount > 1) {
+        freeObjData(&load.pools);
+    }
+    free(load.chunks);
+    free(jobData);
+    return merged;
+}
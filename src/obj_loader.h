@@ -0,0 +1,21 @@
+#ifndef SCOP_OBJ_LOADER_H
+#define SCOP_OBJ_LOADER_H
+
+#include <stdbool.h>
+
+#include "job_system.h"
+#include "mesh.h"
+
+// Loads a Wavefront OBJ file into an indexed triangle mesh.
+// The file is memory-mapped and parsed in a single pass; identical
+// v/vt/vn corners are merged into one vertex and polygons are fan-triangulated.
+// Vertices without a normal get a smooth normal generated from their faces.
+// Triangles are grouped by their usemtl material into the mesh's subsets,
+// and the mtllib names are kept for the caller to load.
+// With a job system the file is split at newlines and the chunks are parsed
+// in parallel; the merge keeps the output bit-identical to a serial parse.
+// jobs may be NULL for a single-threaded load.
+// Returns false (after printing the reason) if the file can't be used.
+bool objLoadMesh(const char* filename, Mesh* mesh, JobSystem* jobs);
+
+#endif
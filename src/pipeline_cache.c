@@ -0,0 +1,144 @@
+#include "pipeline_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+
+// Header every pipeline cache blob starts with (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+typedef struct {
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+} PipelineCacheHeader;
+
+static void* readCacheFile(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    void* data = NULL;
+    long length = 0;
+    if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0) {
+        // No memory for the blob just means starting cold, like a missing file
+        data = malloc((size_t)length);
+        if (data && fread(data, 1, (size_t)length, file) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+
+    *size = data ? (size_t)length : 0;
+    return data;
+}
+
+static bool headerMatches(const void* data, size_t size, const VkPhysicalDeviceProperties* properties) {
+    PipelineCacheHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    return header.headerSize >= sizeof(header) && header.headerSize <= size &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties->vendorID &&
+           header.deviceID == properties->deviceID &&
+           memcmp(header.pipelineCacheUUID, properties->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void pipelineCacheInit(PipelineCache* pipelineCache, VkPhysicalDevice physicalDevice, VkDevice device) {
+    memset(pipelineCache, 0, sizeof(*pipelineCache));
+    pipelineCache->device = device;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    char directory[PATH_MAX];
+    void* data = NULL;
+    size_t size = 0;
+    if (getCacheDirectory(directory, sizeof(directory))) {
+        int written = snprintf(pipelineCache->path, sizeof(pipelineCache->path), "%s/pipelines-%04x-%04x.bin",
+                               directory, properties.vendorID, properties.deviceID);
+        if (written < 0 || (size_t)written >= sizeof(pipelineCache->path)) {
+            pipelineCache->path[0] = '\0';
+        } else {
+            data = readCacheFile(pipelineCache->path, &size);
+        }
+    }
+
+    // A blob from another driver version is useless and may not be safe to pass on
+    if (data && !headerMatches(data, size, &properties)) {
+        printf("Pipeline cache was written by a different driver or device, starting cold\n");
+        free(data);
+        data = NULL;
+        size = 0;
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = {0};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data ? size : 0;
+    cacheInfo.pInitialData = data;
+
+    if (vkCreatePipelineCache(device, &cacheInfo, NULL, &pipelineCache->cache) != VK_SUCCESS) {
+        // Drivers may still reject data whose header looked fine
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = NULL;
+        free(data);
+        data = NULL;
+        if (vkCreatePipelineCache(device, &cacheInfo, NULL, &pipelineCache->cache) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create pipeline cache!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pipelineCache->warm = data != NULL;
+    if (data) {
+        pipelineCache->loadedHash = hashBytes(data, size, 0);
+        pipelineCache->loadedSize = size;
+    }
+    free(data);
+}
+
+void pipelineCacheShutdown(PipelineCache* pipelineCache) {
+    if (pipelineCache->cache == VK_NULL_HANDLE) {
+        return;
+    }
+
+    size_t size = 0;
+    void* data = NULL;
+    if (pipelineCache->path[0] &&
+        vkGetPipelineCacheData(pipelineCache->device, pipelineCache->cache, &size, NULL) == VK_SUCCESS && size > 0) {
+        // Without memory for the blob the old file is kept; the next run just
+        // misses what this one compiled
+        data = malloc(size);
+        if (!data || vkGetPipelineCacheData(pipelineCache->device, pipelineCache->cache, &size, data) != VK_SUCCESS) {
+            size = 0;
+        }
+    }
+
+    bool changed = size > 0 &&
+                   (size != pipelineCache->loadedSize || hashBytes(data, size, 0) != pipelineCache->loadedHash);
+    if (changed) {
+        // Write to a temporary file and rename so a crash never leaves a torn cache
+        char tempPath[PATH_MAX + 8];
+        snprintf(tempPath, sizeof(tempPath), "%s.tmp", pipelineCache->path);
+
+        FILE* file = fopen(tempPath, "wb");
+        bool written = file && fwrite(data, 1, size, file) == size;
+        written = file && fclose(file) == 0 && written;
+        if (!written || rename(tempPath, pipelineCache->path) != 0) {
+            fprintf(stderr, "Failed to write pipeline cache: %s\n", pipelineCache->path);
+            unlink(tempPath);
+        }
+    }
+    free(data);
+
+    vkDestroyPipelineCache(pipelineCache->device, pipelineCache->cache, NULL);
+    pipelineCache->cache = VK_NULL_HANDLE;
+}
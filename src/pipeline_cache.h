@@ -0,0 +1,28 @@
+#ifndef SCOP_PIPELINE_CACHE_H
+#define SCOP_PIPELINE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <vulkan/vulkan.h>
+
+// VkPipelineCache backed by a file in the user's cache directory, one per
+// GPU. The driver's blob is stored as-is; its header is checked against the
+// device before the data is handed back to the driver.
+typedef struct {
+    VkDevice device;
+    VkPipelineCache cache;
+    char path[PATH_MAX];        // empty when there is no cache directory
+    bool warm;                  // created from data written by an earlier run
+    uint64_t loadedHash;        // skips the write-back when nothing was added
+    size_t loadedSize;
+} PipelineCache;
+
+// Creates the cache, seeded from disk when the stored header matches the
+// device's vendor ID, device ID and pipeline cache UUID
+void pipelineCacheInit(PipelineCache* pipelineCache, VkPhysicalDevice physicalDevice, VkDevice device);
+
+// Writes the cache back atomically when it changed, then destroys it
+void pipelineCacheShutdown(PipelineCache* pipelineCache);
+
+#endif
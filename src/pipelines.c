@@ -0,0 +1,502 @@
+#include "pipelines.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "mesh.h"
+#include "util.h"
+
+static inline uint32_t variantIndex(PipelineVariant variant) {
+    return (uint32_t)variant.shading * 2 + (variant.wireframe ? 1 : 0);
+}
+
+const char* pipelineVariantName(PipelineVariant variant) {
+    static const char* names[PIPELINE_VARIANT_COUNT] = {
+        "lit", "lit wireframe", "normals", "normals wireframe", "uv", "uv wireframe"
+    };
+    return names[variantIndex(variant)];
+}
+
+static PipelineEntry* variantEntry(PipelineRegistry* registry, PipelineVariant variant) {
+    if (registry->description.dynamicFillMode) {
+        variant.wireframe = false;
+    }
+    return &registry->entries[variantIndex(variant)];
+}
+
+// depthOnly builds the prepass pipeline: no fragment shader and no color writes
+static bool createVariant(PipelineRegistry* registry, const PipelineDescription* description, PipelineVariant variant,
+                          bool depthOnly, VkPipeline* pipeline) {
+    // The shading mode, vertex layout and texture array size are baked in
+    // through specialization constants; each stage only reads those it declares
+    typedef struct {
+        uint32_t shadingMode;
+        VkBool32 packedVertices;
+        uint32_t textureCapacity;
+    } Specialization;
+    Specialization specialization = {(uint32_t)variant.shading, description->vertexFormat == VERTEX_FORMAT_PACKED,
+                                     description->textureCapacity};
+
+    VkSpecializationMapEntry specializationEntries[3] = {{0}};
+    specializationEntries[0].constantID = 0;
+    specializationEntries[0].offset = offsetof(Specialization, shadingMode);
+    specializationEntries[0].size = sizeof(specialization.shadingMode);
+    specializationEntries[1].constantID = 1;
+    specializationEntries[1].offset = offsetof(Specialization, packedVertices);
+    specializationEntries[1].size = sizeof(specialization.packedVertices);
+    specializationEntries[2].constantID = 2;
+    specializationEntries[2].offset = offsetof(Specialization, textureCapacity);
+    specializationEntries[2].size = sizeof(specialization.textureCapacity);
+
+    VkSpecializationInfo specializationInfo = {0};
+    specializationInfo.mapEntryCount = 3;
+    specializationInfo.pMapEntries = specializationEntries;
+    specializationInfo.dataSize = sizeof(specialization);
+    specializationInfo.pData = &specialization;
+
+    // Vertex shader stage
+    VkPipelineShaderStageCreateInfo shaderStages[2] = {{0}};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = description->vertexShader;
+    shaderStages[0].pName = "main";
+    shaderStages[0].pSpecializationInfo = &specializationInfo;
+
+    // Fragment shader stage
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = description->fragmentShader;
+    shaderStages[1].pName = "main";
+    shaderStages[1].pSpecializationInfo = &specializationInfo;
+
+    // Vertex input (interleaved Vertex or PackedVertex structs in binding 0)
+    bool packed = description->vertexFormat == VERTEX_FORMAT_PACKED;
+    VkVertexInputBindingDescription bindingDescription = {0};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = (uint32_t)vertexFormatStride(description->vertexFormat);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    // The packed formats are all mandatory for vertex buffers
+    VkVertexInputAttributeDescription attributeDescriptions[3] = {{0}};
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = packed ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset = packed ? offsetof(PackedVertex, position) : offsetof(Vertex, position);
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = packed ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[1].offset = packed ? offsetof(PackedVertex, normal) : offsetof(Vertex, normal);
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = packed ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[2].offset = packed ? offsetof(PackedVertex, texCoord) : offsetof(Vertex, texCoord);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {0};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = 3;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+
+    // Input assembly
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {0};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport and scissor are set while recording
+    VkPipelineViewportStateCreateInfo viewportState = {0};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkDynamicState dynamicStates[6] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR,
+                                       VK_DYNAMIC_STATE_POLYGON_MODE_EXT, VK_DYNAMIC_STATE_CULL_MODE_EXT,
+                                       VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT};
+    VkPipelineDynamicStateCreateInfo dynamicState = {0};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = description->dynamicFillMode && !depthOnly ? 6 : 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    // Rasterizer; wireframes show back faces too. Overridden while recording
+    // with a dynamic fill mode.
+    VkPipelineRasterizationStateCreateInfo rasterizer = {0};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = variant.wireframe ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = variant.wireframe ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    // Multisampling
+    VkPipelineMultisampleStateCreateInfo multisampling = {0};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Reverse-Z: nearer is greater. After a prepass the filled variants
+    // only shade fragments matching its depth; wireframes never get one.
+    bool prepassed = description->depthPrepass && !depthOnly && !variant.wireframe;
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {0};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = prepassed ? VK_FALSE : VK_TRUE;
+    depthStencil.depthCompareOp = prepassed ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_GREATER_OR_EQUAL;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    // Color blending
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {0};
+    colorBlendAttachment.colorWriteMask = depthOnly ? 0
+                                                    : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                                      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {0};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    // Without a render pass the attachment formats come through the pNext chain
+    VkPipelineRenderingCreateInfoKHR renderingInfo = {0};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &description->colorFormat;
+    renderingInfo.depthAttachmentFormat = description->depthFormat;
+
+    // Graphics pipeline
+    VkGraphicsPipelineCreateInfo pipelineInfo = {0};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = description->renderPass == VK_NULL_HANDLE ? &renderingInfo : NULL;
+    pipelineInfo.stageCount = depthOnly ? 1 : 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = description->layout;
+    pipelineInfo.renderPass = description->renderPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    // VkPipelineCache is internally synchronized, so workers share it freely
+    return vkCreateGraphicsPipelines(registry->device, registry->cache, 1, &pipelineInfo, NULL, pipeline) == VK_SUCCESS;
+}
+
+static const char* entryName(const PipelineEntry* entry) {
+    return entry->depthOnly ? "depth prepass" : pipelineVariantName(entry->variant);
+}
+
+static void compileEntry(PipelineEntry* entry) {
+    double start = getTimeMs();
+    bool created = createVariant(entry->registry, entry->description, entry->variant, entry->depthOnly,
+                                 &entry->pipeline);
+    entry->compileMs = getTimeMs() - start;
+
+    if (!created) {
+        fprintf(stderr, "Failed to create pipeline \"%s\"!\n", entryName(entry));
+    }
+
+    // Release so a reader seeing READY also sees the pipeline handle
+    __atomic_store_n(&entry->state, created ? PIPELINE_STATE_READY : PIPELINE_STATE_FAILED, __ATOMIC_RELEASE);
+}
+
+static void compileJob(void* data, uint32_t threadIndex) {
+    PipelineEntry* entry = data;
+    compileEntry(entry);
+    if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) == PIPELINE_STATE_READY) {
+        printf("Pipeline \"%s\" compiled in %.2f ms on worker %u\n", entryName(entry), entry->compileMs,
+               threadIndex);
+    }
+}
+
+static void submitCompile(PipelineRegistry* registry, PipelineEntry* entry) {
+    // Without workers a queued job would only run at shutdown
+    if (registry->jobs->threadCount == 0) {
+        compileJob(entry, 0);
+        return;
+    }
+    jobSystemSubmit(registry->jobs, compileJob, entry, &registry->pending);
+}
+
+void pipelineRegistryInit(PipelineRegistry* registry, VkDevice device, VkPipelineCache cache, JobSystem* jobs,
+                          const PipelineDescription* description) {
+    memset(registry, 0, sizeof(*registry));
+    registry->device = device;
+    registry->cache = cache;
+    registry->jobs = jobs;
+    registry->description = *description;
+
+    for (uint32_t i = 0; i < PIPELINE_VARIANT_COUNT; i++) {
+        PipelineEntry* entry = &registry->entries[i];
+        entry->registry = registry;
+        entry->description = &registry->description;
+        entry->variant.shading = (PipelineShading)(i / 2);
+        entry->variant.wireframe = (i % 2) != 0;
+        entry->state = PIPELINE_STATE_IDLE;
+
+        registry->nextEntries[i] = *entry;
+        registry->nextEntries[i].description = &registry->nextDescription;
+    }
+    registry->nextPrepass = registry->nextEntries[0];
+    registry->nextPrepass.depthOnly = true;
+
+    // The fallback has to exist before the first frame
+    PipelineEntry* fallback = &registry->entries[0];
+    fallback->state = PIPELINE_STATE_COMPILING;
+    compileEntry(fallback);
+    if (fallback->state != PIPELINE_STATE_READY) {
+        exit(EXIT_FAILURE);
+    }
+
+    // Shared by every filled variant, so it can't wait for one to be asked for
+    if (description->depthPrepass &&
+        !createVariant(registry, &registry->description, fallback->variant, true, &registry->prepass)) {
+        fprintf(stderr, "Failed to create depth prepass pipeline!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Destroys the modules of released that kept doesn't share
+static void releaseModules(VkDevice device, const PipelineDescription* released, const PipelineDescription* kept) {
+    if (released->vertexShader != kept->vertexShader) {
+        vkDestroyShaderModule(device, released->vertexShader, NULL);
+    }
+    if (released->fragmentShader != kept->fragmentShader) {
+        vkDestroyShaderModule(device, released->fragmentShader, NULL);
+    }
+}
+
+// Destroys the pipelines a reload built; none of them was ever drawn with
+static void discardReload(PipelineRegistry* registry) {
+    for (uint32_t i = 0; i < PIPELINE_VARIANT_COUNT; i++) {
+        if (registry->nextEntries[i].state == PIPELINE_STATE_READY) {
+            vkDestroyPipeline(registry->device, registry->nextEntries[i].pipeline, NULL);
+        }
+    }
+    if (registry->nextPrepass.state == PIPELINE_STATE_READY) {
+        vkDestroyPipeline(registry->device, registry->nextPrepass.pipeline, NULL);
+    }
+    releaseModules(registry->device, &registry->nextDescription, &registry->description);
+}
+
+void pipelineRegistryShutdown(PipelineRegistry* registry) {
+    jobSystemWait(registry->jobs, &registry->pending);
+
+    for (uint32_t i = 0; i < PIPELINE_VARIANT_COUNT; i++) {
+        if (registry->entries[i].state == PIPELINE_STATE_READY) {
+            vkDestroyPipeline(registry->device, registry->entries[i].pipeline, NULL);
+        }
+    }
+    vkDestroyPipeline(registry->device, registry->prepass, NULL);
+    if (registry->reloading) {
+        discardReload(registry);
+    }
+    vkDestroyShaderModule(registry->device, registry->queuedVertexShader, NULL);
+    vkDestroyShaderModule(registry->device, registry->queuedFragmentShader, NULL);
+    for (uint32_t i = 0; i < registry->retiredCount; i++) {
+        vkDestroyPipeline(registry->device, registry->retired[i].pipeline, NULL);
+    }
+    free(registry->retired);
+    vkDestroyShaderModule(registry->device, registry->description.fragmentShader, NULL);
+    vkDestroyShaderModule(registry->device, registry->description.vertexShader, NULL);
+    memset(registry, 0, sizeof(*registry));
+}
+
+void pipelineRegistryRequest(PipelineRegistry* registry, PipelineVariant variant) {
+    PipelineEntry* entry = variantEntry(registry, variant);
+
+    uint32_t expected = PIPELINE_STATE_IDLE;
+    if (!__atomic_compare_exchange_n(&entry->state, &expected, PIPELINE_STATE_COMPILING, false, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    if (entry->variant.wireframe && !registry->description.wireframeSupported) {
+        fprintf(stderr, "Pipeline \"%s\" needs fillModeNonSolid, which the device lacks\n",
+                pipelineVariantName(entry->variant));
+        __atomic_store_n(&entry->state, PIPELINE_STATE_FAILED, __ATOMIC_RELEASE);
+        return;
+    }
+    submitCompile(registry, entry);
+}
+
+VkPipeline pipelineRegistryGet(PipelineRegistry* registry, PipelineVariant variant, PipelineVariant* drawn) {
+    PipelineEntry* entry = variantEntry(registry, variant);
+    if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) == PIPELINE_STATE_READY) {
+        if (drawn) {
+            *drawn = variant;
+        }
+        return entry->pipeline;
+    }
+
+    // A dynamic fill mode still draws the default variant as a wireframe
+    pipelineRegistryRequest(registry, variant);
+    if (drawn) {
+        *drawn = registry->entries[0].variant;
+        drawn->wireframe = registry->description.dynamicFillMode && variant.wireframe;
+    }
+    return registry->entries[0].pipeline;
+}
+
+static void startReload(PipelineRegistry* registry, VkShaderModule vertexShader, VkShaderModule fragmentShader) {
+    registry->reloading = true;
+    registry->reloadStartMs = getTimeMs();
+    registry->nextDescription = registry->description;
+    if (vertexShader != VK_NULL_HANDLE) {
+        registry->nextDescription.vertexShader = vertexShader;
+    }
+    if (fragmentShader != VK_NULL_HANDLE) {
+        registry->nextDescription.fragmentShader = fragmentShader;
+    }
+
+    // Variants nobody asked for yet compile from the new shaders on demand
+    for (uint32_t i = 0; i < PIPELINE_VARIANT_COUNT; i++) {
+        uint32_t state = __atomic_load_n(&registry->entries[i].state, __ATOMIC_ACQUIRE);
+        PipelineEntry* next = &registry->nextEntries[i];
+        next->pipeline = VK_NULL_HANDLE;
+        next->state = PIPELINE_STATE_IDLE;
+        if (state == PIPELINE_STATE_READY || state == PIPELINE_STATE_COMPILING) {
+            next->state = PIPELINE_STATE_COMPILING;
+            submitCompile(registry, next);
+        }
+    }
+
+    registry->nextPrepass.pipeline = VK_NULL_HANDLE;
+    registry->nextPrepass.state = PIPELINE_STATE_IDLE;
+    if (registry->prepass != VK_NULL_HANDLE) {
+        registry->nextPrepass.state = PIPELINE_STATE_COMPILING;
+        submitCompile(registry, &registry->nextPrepass);
+    }
+}
+
+void pipelineRegistryReload(PipelineRegistry* registry, VkShaderModule vertexShader, VkShaderModule fragmentShader) {
+    if (!registry->reloading) {
+        startReload(registry, vertexShader, fragmentShader);
+        return;
+    }
+
+    // Only the newest module of each stage is worth building
+    if (vertexShader != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(registry->device, registry->queuedVertexShader, NULL);
+        registry->queuedVertexShader = vertexShader;
+    }
+    if (fragmentShader != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(registry->device, registry->queuedFragmentShader, NULL);
+        registry->queuedFragmentShader = fragmentShader;
+    }
+}
+
+// Every new pipeline is built, and no variant is still compiling from the
+// old shaders, so the swap replaces them all at once
+static bool reloadFinished(PipelineRegistry* registry) {
+    if (__atomic_load_n(&registry->nextPrepass.state, __ATOMIC_ACQUIRE) == PIPELINE_STATE_COMPILING) {
+        return false;
+    }
+    for (uint32_t i = 0; i < PIPELINE_VARIANT_COUNT; i++) {
+        if (__atomic_load_n(&registry->nextEntries[i].state, __ATOMIC_ACQUIRE) == PIPELINE_STATE_COMPILING ||
+            __atomic_load_n(&registry->entries[i].state, __ATOMIC_ACQUIRE) == PIPELINE_STATE_COMPILING) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool swapReload(PipelineRegistry* registry, uint64_t retireValue) {
+    bool failed = registry->nextPrepass.state == PIPELINE_STATE_FAILED;
+    for (uint32_t i = 0; i < PIPELINE_VARIANT_COUNT; i++) {
+        failed = failed || registry->nextEntries[i].state == PIPELINE_STATE_FAILED;
+    }
+    if (failed) {
+        fprintf(stderr, "Shader reload failed, keeping the running pipelines\n");
+        discardReload(registry);
+        return false;
+    }
+
+    // No job touches either generation any more
+    uint32_t rebuilt = 0;
+    for (uint32_t i = 0; i < PIPELINE_VARIANT_COUNT; i++) {
+        PipelineEntry* entry = &registry->entries[i];
+        PipelineEntry* next = &registry->nextEntries[i];
+        if (entry->state == PIPELINE_STATE_READY) {
+            pipelineRegistryRetire(registry, entry->pipeline, retireValue);
+        }
+
+        // Variants first asked for during the reload were built from the
+        // old shaders; they compile again when next asked for
+        if (next->state == PIPELINE_STATE_READY) {
+            entry->pipeline = next->pipeline;
+            entry->compileMs = next->compileMs;
+            entry->state = PIPELINE_STATE_READY;
+            rebuilt++;
+        } else if (entry->state != PIPELINE_STATE_FAILED) {
+            entry->pipeline = VK_NULL_HANDLE;
+            entry->state = PIPELINE_STATE_IDLE;
+        }
+    }
+    if (registry->prepass != VK_NULL_HANDLE) {
+        pipelineRegistryRetire(registry, registry->prepass, retireValue);
+        registry->prepass = registry->nextPrepass.pipeline;
+        rebuilt++;
+    }
+
+    releaseModules(registry->device, &registry->description, &registry->nextDescription);
+    registry->description = registry->nextDescription;
+    printf("Shader reload: %u pipelines rebuilt in %.2f ms\n", rebuilt, getTimeMs() - registry->reloadStartMs);
+    return true;
+}
+
+bool pipelineRegistryUpdate(PipelineRegistry* registry, uint64_t lastSubmitted, uint64_t completed) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < registry->retiredCount; i++) {
+        if (registry->retired[i].retireValue <= completed) {
+            vkDestroyPipeline(registry->device, registry->retired[i].pipeline, NULL);
+        } else {
+            registry->retired[kept++] = registry->retired[i];
+        }
+    }
+    registry->retiredCount = kept;
+
+    if (!registry->reloading || !reloadFinished(registry)) {
+        return false;
+    }
+
+    // The frame about to be recorded is the first to draw with the new
+    // pipelines; everything submitted so far may still use the old ones
+    bool swapped = swapReload(registry, lastSubmitted);
+    registry->reloading = false;
+    if (registry->queuedVertexShader != VK_NULL_HANDLE || registry->queuedFragmentShader != VK_NULL_HANDLE) {
+        startReload(registry, registry->queuedVertexShader, registry->queuedFragmentShader);
+        registry->queuedVertexShader = VK_NULL_HANDLE;
+        registry->queuedFragmentShader = VK_NULL_HANDLE;
+    }
+    return swapped;
+}
+
+void pipelineRegistryRetire(PipelineRegistry* registry, VkPipeline pipeline, uint64_t retireValue) {
+    if (registry->retiredCount == registry->retiredCapacity) {
+        uint32_t capacity = registry->retiredCapacity ? registry->retiredCapacity * 2 : 16;
+        RetiredPipeline* retired = realloc(registry->retired, capacity * sizeof(RetiredPipeline));
+        if (!retired) {
+            fprintf(stderr, "Failed to allocate retired pipelines!\n");
+            exit(EXIT_FAILURE);
+        }
+        registry->retired = retired;
+        registry->retiredCapacity = capacity;
+    }
+
+    RetiredPipeline* entry = &registry->retired[registry->retiredCount++];
+    entry->pipeline = pipeline;
+    entry->retireValue = retireValue;
+}
@@ -0,0 +1,131 @@
+#ifndef SCOP_PIPELINES_H
+#define SCOP_PIPELINES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <vulkan/vulkan.h>
+
+#include "job_system.h"
+#include "mesh.h"
+
+// Fragment shading selected through specialization constant 0 of shader.frag
+typedef enum {
+    PIPELINE_SHADING_LIT,       // directional light
+    PIPELINE_SHADING_NORMALS,   // world normals as colors
+    PIPELINE_SHADING_UV,        // texture coordinates as a checkerboard
+    PIPELINE_SHADING_COUNT
+} PipelineShading;
+
+typedef struct {
+    PipelineShading shading;
+    bool wireframe;
+} PipelineVariant;
+
+#define PIPELINE_VARIANT_COUNT (PIPELINE_SHADING_COUNT * 2)
+
+typedef enum {
+    PIPELINE_STATE_IDLE,
+    PIPELINE_STATE_COMPILING,
+    PIPELINE_STATE_READY,
+    PIPELINE_STATE_FAILED
+} PipelineState;
+
+// State shared by every variant; the shader modules are owned by the registry.
+// Viewport and scissor are always dynamic, so a resize never needs a new pipeline.
+typedef struct {
+    VkRenderPass renderPass;    // VK_NULL_HANDLE to draw with dynamic rendering
+    VkFormat colorFormat;       // color attachment format for dynamic rendering
+    VkFormat depthFormat;       // depth attachment format for dynamic rendering
+    VkPipelineLayout layout;
+    VkShaderModule vertexShader;
+    VkShaderModule fragmentShader;
+    bool wireframeSupported;    // fillModeNonSolid was enabled on the device
+    bool dynamicFillMode;       // polygon, cull mode and depth write and compare are set while recording
+    bool depthPrepass;          // filled variants only shade what a depth-only pass left visible
+    VertexFormat vertexFormat;  // layout of the vertex buffer, decoded by shader.vert
+    uint32_t textureCapacity;   // size of the texture array of shader.frag
+} PipelineDescription;
+
+struct PipelineRegistry;
+
+typedef struct {
+    struct PipelineRegistry* registry;
+    const PipelineDescription* description;     // layout and shaders it is built from
+    PipelineVariant variant;
+    bool depthOnly;             // the depth prepass pipeline rather than a variant
+    VkPipeline pipeline;
+    uint32_t state;             // PipelineState, accessed atomically
+    double compileMs;
+} PipelineEntry;
+
+// Pipeline replaced by a shader reload, kept until the frames that may
+// still draw with it have finished on the GPU
+typedef struct {
+    VkPipeline pipeline;
+    uint64_t retireValue;       // frame timeline value of the last frame that could use it
+} RetiredPipeline;
+
+// Every shader permutation of the mesh pipeline. Variants are compiled on
+// the job system the first time they are asked for, all through one
+// VkPipelineCache; until then the default variant is drawn instead. With a
+// dynamic fill mode a wireframe variant is its filled one.
+typedef struct PipelineRegistry {
+    VkDevice device;
+    VkPipelineCache cache;
+    JobSystem* jobs;
+    PipelineDescription description;
+    PipelineEntry entries[PIPELINE_VARIANT_COUNT];
+    VkPipeline prepass;         // depth-only pipeline, VK_NULL_HANDLE without depthPrepass
+    JobCounter pending;
+
+    // Shader reload: the variants asked for so far and the prepass are
+    // rebuilt from new modules and swapped in together once all are ready
+    bool reloading;
+    PipelineDescription nextDescription;
+    PipelineEntry nextEntries[PIPELINE_VARIANT_COUNT];
+    PipelineEntry nextPrepass;
+    double reloadStartMs;
+    VkShaderModule queuedVertexShader;      // modules of a reload asked for while one is in flight
+    VkShaderModule queuedFragmentShader;
+    RetiredPipeline* retired;
+    uint32_t retiredCount;
+    uint32_t retiredCapacity;
+} PipelineRegistry;
+
+// Compiles the default variant (lit, filled) right away so there is always
+// something to draw, and the depth prepass pipeline when asked for
+void pipelineRegistryInit(PipelineRegistry* registry, VkDevice device, VkPipelineCache cache, JobSystem* jobs,
+                          const PipelineDescription* description);
+
+// Waits for compilations still in flight, then destroys every pipeline,
+// retired ones included; the device must be idle
+void pipelineRegistryShutdown(PipelineRegistry* registry);
+
+// Starts compiling the variant in the background if nobody asked for it yet
+void pipelineRegistryRequest(PipelineRegistry* registry, PipelineVariant variant);
+
+// Returns the variant when it's ready, otherwise requests it and returns
+// the default variant. Never blocks. drawn, when not NULL, receives the
+// variant the returned pipeline draws.
+VkPipeline pipelineRegistryGet(PipelineRegistry* registry, PipelineVariant variant, PipelineVariant* drawn);
+
+// Rebuilds every variant compiled or compiling so far, and the prepass, from
+// new shader modules in the background; VK_NULL_HANDLE keeps a stage's
+// module. Takes ownership of the modules. The running pipelines keep
+// drawing until pipelineRegistryUpdate swaps in the new ones; a reload asked
+// for while one is in flight starts after it with the newest modules.
+void pipelineRegistryReload(PipelineRegistry* registry, VkShaderModule vertexShader, VkShaderModule fragmentShader);
+
+// Once per frame, before pipelineRegistryGet: destroys retired pipelines the
+// GPU is done with (completed) and swaps in a finished reload, retiring the
+// pipelines it replaces until lastSubmitted is reached. A reload any of whose
+// pipelines failed is dropped and the running ones stay. Returns true when
+// new pipelines were swapped in. Never blocks.
+bool pipelineRegistryUpdate(PipelineRegistry* registry, uint64_t lastSubmitted, uint64_t completed);
+
+// Destroys pipeline, of any kind, once the frame timeline reaches retireValue
+void pipelineRegistryRetire(PipelineRegistry* registry, VkPipeline pipeline, uint64_t retireValue);
+
+const char* pipelineVariantName(PipelineVariant variant);
+
+#endif
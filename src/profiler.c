@@ -0,0 +1,317 @@
+#include "profiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+// Returned for spans and scopes that didn't fit; ending them is a no-op
+#define PROFILER_DROPPED UINT32_MAX
+
+void profilerInit(Profiler* profiler, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
+                  uint32_t frameSlots) {
+    memset(profiler, 0, sizeof(*profiler));
+    profiler->device = device;
+    profiler->frameSlots = frameSlots < PROFILER_MAX_FRAMES ? frameSlots : PROFILER_MAX_FRAMES;
+    profiler->epochMs = getTimeMs();
+    profiler->windowStartMs = profiler->epochMs;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
+    VkQueueFamilyProperties* queueFamilies = malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies);
+    uint32_t validBits = queueFamilies[queueFamily].timestampValidBits;
+    free(queueFamilies);
+
+    if (validBits == 0) {
+        printf("Queue family %u has no timestamps, GPU scopes are disabled\n", queueFamily);
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    profiler->timestampPeriodMs = properties.limits.timestampPeriod / 1e6;
+    profiler->timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo queryPoolInfo = {0};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = PROFILER_MAX_SCOPES * 2;
+
+    for (uint32_t i = 0; i < profiler->frameSlots; i++) {
+        if (vkCreateQueryPool(device, &queryPoolInfo, NULL, &profiler->pools[i]) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create timestamp query pool!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void profilerShutdown(Profiler* profiler) {
+    for (uint32_t i = 0; i < profiler->frameSlots; i++) {
+        if (profiler->pools[i] != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(profiler->device, profiler->pools[i], NULL);
+        }
+    }
+
+    if (profiler->csv) {
+        fclose(profiler->csv);
+    }
+    if (profiler->trace) {
+        fprintf(profiler->trace, "\n]}\n");
+        fclose(profiler->trace);
+    }
+    memset(profiler, 0, sizeof(*profiler));
+}
+
+bool profilerOpenCsv(Profiler* profiler, const char* path) {
+    profiler->csv = fopen(path, "w");
+    if (!profiler->csv) {
+        return false;
+    }
+    fprintf(profiler->csv, "frame,timeline,name,depth,start_ms,duration_ms\n");
+    return true;
+}
+
+bool profilerOpenTrace(Profiler* profiler, const char* path) {
+    profiler->trace = fopen(path, "w");
+    if (!profiler->trace) {
+        return false;
+    }
+    fprintf(profiler->trace, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n"
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    return true;
+}
+
+static void addToStats(Profiler* profiler, const ProfilerSpan* span, bool gpu) {
+    ProfilerStat* stat = NULL;
+    for (uint32_t i = 0; i < profiler->statCount; i++) {
+        // Names are literals, so identical scopes usually share a pointer
+        if (profiler->stats[i].gpu == gpu &&
+            (profiler->stats[i].name == span->name || strcmp(profiler->stats[i].name, span->name) == 0)) {
+            stat = &profiler->stats[i];
+            break;
+        }
+    }
+
+    if (!stat) {
+        if (profiler->statCount == PROFILER_MAX_STATS) {
+            return;
+        }
+        stat = &profiler->stats[profiler->statCount++];
+        stat->name = span->name;
+        stat->gpu = gpu;
+    }
+    stat->totalMs += span->endMs - span->startMs;
+}
+
+static void writeSpans(Profiler* profiler, const ProfilerFrame* frame, const ProfilerSpan* spans, uint32_t count,
+                       bool gpu) {
+    // CSV starts are relative to the frame, trace events to the profiler epoch
+    double frameStart = gpu ? 0.0 : (count > 0 ? spans[0].startMs : 0.0);
+    double traceBase = gpu ? frame->submitMs - profiler->epochMs : -profiler->epochMs;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const ProfilerSpan* span = &spans[i];
+        double duration = span->endMs - span->startMs;
+
+        if (profiler->csv) {
+            fprintf(profiler->csv, "%llu,%s,%s,%u,%.4f,%.4f\n", (unsigned long long)frame->frameNumber,
+                    gpu ? "gpu" : "cpu", span->name, span->depth, span->startMs - frameStart, duration);
+        }
+        if (profiler->trace) {
+            fprintf(profiler->trace, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}", span->name, gpu ? "gpu" : "cpu",
+                    gpu ? 2 : 1, (traceBase + span->startMs) * 1000.0, duration * 1000.0,
+                    (unsigned long long)frame->frameNumber);
+        }
+    }
+}
+
+// Reads the frame's timestamps and converts its scopes to milliseconds
+static bool resolveGpuScopes(Profiler* profiler, uint32_t slot, ProfilerFrame* frame) {
+    if (profiler->pools[slot] == VK_NULL_HANDLE || frame->gpuCount == 0 || frame->gpuDepth != 0) {
+        return false;
+    }
+
+    uint64_t timestamps[PROFILER_MAX_SCOPES * 2];
+    VkResult result = vkGetQueryPoolResults(profiler->device, profiler->pools[slot], 0, frame->gpuCount * 2,
+                                            sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return false;
+    }
+
+    uint64_t origin = timestamps[0] & profiler->timestampMask;
+    for (uint32_t i = 0; i < frame->gpuCount; i++) {
+        // Masked subtraction keeps deltas right across a counter wrap
+        uint64_t begin = ((timestamps[i * 2] & profiler->timestampMask) - origin) & profiler->timestampMask;
+        uint64_t end = ((timestamps[i * 2 + 1] & profiler->timestampMask) - origin) & profiler->timestampMask;
+        frame->gpu[i].startMs = (double)begin * profiler->timestampPeriodMs;
+        frame->gpu[i].endMs = (double)(end > begin ? end : begin) * profiler->timestampPeriodMs;
+
+        if (frame->gpu[i].depth == 0 && frame->gpu[i].endMs > frame->gpuMs) {
+            frame->gpuMs = frame->gpu[i].endMs;
+        }
+    }
+    return true;
+}
+
+const ProfilerFrame* profilerCollect(Profiler* profiler, uint32_t slot) {
+    ProfilerFrame* frame = &profiler->frames[slot];
+    if (!frame->recording) {
+        return NULL;
+    }
+    frame->recording = false;
+
+    // Frames abandoned before submission (swapchain out of date) are dropped
+    if (!frame->submitted) {
+        return NULL;
+    }
+
+    frame->cpuMs = 0.0;
+    for (uint32_t i = 0; i < frame->cpuCount; i++) {
+        if (frame->cpu[i].depth == 0) {
+            frame->cpuMs += frame->cpu[i].endMs - frame->cpu[i].startMs;
+        }
+    }
+    if (!resolveGpuScopes(profiler, slot, frame)) {
+        frame->gpuCount = 0;
+    }
+
+    for (uint32_t i = 0; i < frame->cpuCount; i++) {
+        addToStats(profiler, &frame->cpu[i], false);
+    }
+    for (uint32_t i = 0; i < frame->gpuCount; i++) {
+        addToStats(profiler, &frame->gpu[i], true);
+    }
+    profiler->windowFrames++;
+
+    double now = getTimeMs();
+    if (now - profiler->windowStartMs >= PROFILER_AVERAGE_WINDOW_MS) {
+        for (uint32_t i = 0; i < profiler->statCount; i++) {
+            profiler->stats[i].averageMs = profiler->stats[i].totalMs / profiler->windowFrames;
+            profiler->stats[i].totalMs = 0.0;
+        }
+        profiler->windowStartMs = now;
+        profiler->windowFrames = 0;
+        profiler->averagesUpdated = true;
+    }
+
+    writeSpans(profiler, frame, frame->cpu, frame->cpuCount, false);
+    writeSpans(profiler, frame, frame->gpu, frame->gpuCount, true);
+    return frame;
+}
+
+double profilerScopeMs(const ProfilerFrame* frame, const char* name) {
+    double total = 0.0;
+    for (uint32_t i = 0; i < frame->gpuCount; i++) {
+        if (frame->gpu[i].name == name || strcmp(frame->gpu[i].name, name) == 0) {
+            total += frame->gpu[i].endMs - frame->gpu[i].startMs;
+        }
+    }
+    return total;
+}
+
+void profilerBeginFrame(Profiler* profiler, uint32_t slot) {
+    profilerCollect(profiler, slot);
+
+    ProfilerFrame* frame = &profiler->frames[slot];
+    frame->frameNumber = profiler->nextFrameNumber++;
+    frame->recording = true;
+    frame->submitted = false;
+    frame->submitMs = 0.0;
+    frame->cpuMs = 0.0;
+    frame->gpuMs = 0.0;
+    frame->cpuCount = 0;
+    frame->cpuDepth = 0;
+    frame->gpuCount = 0;
+    frame->gpuDepth = 0;
+    profiler->current = frame;
+}
+
+void profilerSubmitted(Profiler* profiler) {
+    profiler->current->submitted = true;
+    profiler->current->submitMs = getTimeMs();
+}
+
+uint32_t profilerCpuBegin(Profiler* profiler, const char* name) {
+    ProfilerFrame* frame = profiler->current;
+    if (frame->cpuCount == PROFILER_MAX_SPANS) {
+        return PROFILER_DROPPED;
+    }
+
+    ProfilerSpan* span = &frame->cpu[frame->cpuCount];
+    span->name = name;
+    span->depth = frame->cpuDepth++;
+    span->startMs = getTimeMs();
+    span->endMs = span->startMs;
+    return frame->cpuCount++;
+}
+
+void profilerCpuEnd(Profiler* profiler, uint32_t span) {
+    if (span == PROFILER_DROPPED) {
+        return;
+    }
+    profiler->current->cpu[span].endMs = getTimeMs();
+    profiler->current->cpuDepth--;
+}
+
+void profilerRecordStart(Profiler* profiler, VkCommandBuffer commandBuffer) {
+    uint32_t slot = (uint32_t)(profiler->current - profiler->frames);
+    if (profiler->pools[slot] != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, profiler->pools[slot], 0, PROFILER_MAX_SCOPES * 2);
+    }
+}
+
+uint32_t profilerGpuBegin(Profiler* profiler, VkCommandBuffer commandBuffer, const char* name) {
+    ProfilerFrame* frame = profiler->current;
+    uint32_t slot = (uint32_t)(frame - profiler->frames);
+    if (profiler->pools[slot] == VK_NULL_HANDLE || frame->gpuCount == PROFILER_MAX_SCOPES) {
+        return PROFILER_DROPPED;
+    }
+
+    ProfilerSpan* scope = &frame->gpu[frame->gpuCount];
+    scope->name = name;
+    scope->depth = frame->gpuDepth++;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->pools[slot], frame->gpuCount * 2);
+    return frame->gpuCount++;
+}
+
+void profilerGpuEnd(Profiler* profiler, VkCommandBuffer commandBuffer, uint32_t scope) {
+    if (scope == PROFILER_DROPPED) {
+        return;
+    }
+    ProfilerFrame* frame = profiler->current;
+    uint32_t slot = (uint32_t)(frame - profiler->frames);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->pools[slot], scope * 2 + 1);
+    frame->gpuDepth--;
+}
+
+bool profilerFormatAverages(Profiler* profiler, char* buffer, size_t size) {
+    if (!profiler->averagesUpdated || size == 0) {
+        return false;
+    }
+    profiler->averagesUpdated = false;
+
+    // CPU spans first, then GPU scopes, each in first-seen order
+    size_t length = 0;
+    buffer[0] = '\0';
+    for (int gpu = 0; gpu < 2; gpu++) {
+        bool first = true;
+        for (uint32_t i = 0; i < profiler->statCount && length < size; i++) {
+            const ProfilerStat* stat = &profiler->stats[i];
+            if (stat->gpu != (bool)gpu) {
+                continue;
+            }
+            int written = snprintf(buffer + length, size - length, "%s%s %.2f", first ? (gpu ? " | gpu " : "cpu ") : ", ",
+                                   stat->name, stat->averageMs);
+            if (written < 0) {
+                break;
+            }
+            length += (size_t)written;
+            first = false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+#ifndef SCOP_PROFILER_H
+#define SCOP_PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <vulkan/vulkan.h>
+
+// Frame slots the profiler can track, one query pool each
+#define PROFILER_MAX_FRAMES 4
+
+// Scopes and spans recorded per frame; extra ones are dropped
+#define PROFILER_MAX_SCOPES 32
+#define PROFILER_MAX_SPANS 32
+
+// Distinct scope names kept for the rolling averages
+#define PROFILER_MAX_STATS 64
+
+// Length of the window the rolling averages are taken over
+#define PROFILER_AVERAGE_WINDOW_MS 500.0
+
+// Timed region of a frame. CPU spans are in getTimeMs time, GPU scopes are
+// relative to the first timestamp of their frame.
+typedef struct {
+    const char* name;       // must outlive the profiler, string literals in practice
+    uint32_t depth;
+    double startMs;
+    double endMs;
+} ProfilerSpan;
+
+typedef struct {
+    uint64_t frameNumber;
+    bool recording;             // between profilerBeginFrame and the slot being collected
+    bool submitted;             // GPU scopes were submitted and can be read back
+    double submitMs;            // CPU time of the submit, anchors GPU scopes in traces
+    double cpuMs;               // top-level CPU spans, filled in when collected
+    double gpuMs;               // first to last top-level GPU timestamp, 0 without timestamps
+    ProfilerSpan cpu[PROFILER_MAX_SPANS];
+    uint32_t cpuCount;
+    uint32_t cpuDepth;
+    ProfilerSpan gpu[PROFILER_MAX_SCOPES];
+    uint32_t gpuCount;
+    uint32_t gpuDepth;
+} ProfilerFrame;
+
+// Per-name totals over the current averaging window
+typedef struct {
+    const char* name;
+    bool gpu;
+    double totalMs;
+    double averageMs;           // per frame, over the last complete window
+} ProfilerStat;
+
+// Times CPU spans and GPU scopes of every frame. GPU scopes are timestamp
+// pairs in a query pool owned by the frame slot, read back without waiting
+// once the slot's frame has finished.
+typedef struct {
+    VkDevice device;
+    VkQueryPool pools[PROFILER_MAX_FRAMES];    // VK_NULL_HANDLE without timestamp support
+    uint32_t frameSlots;
+    double timestampPeriodMs;
+    uint64_t timestampMask;
+    uint64_t nextFrameNumber;
+
+    ProfilerFrame frames[PROFILER_MAX_FRAMES];
+    ProfilerFrame* current;
+
+    ProfilerStat stats[PROFILER_MAX_STATS];
+    uint32_t statCount;
+    double windowStartMs;
+    uint32_t windowFrames;
+    bool averagesUpdated;
+
+    double epochMs;             // trace timestamps are relative to this
+    FILE* csv;
+    FILE* trace;
+} Profiler;
+
+// Creates per-slot query pools when queueFamily supports timestamps; CPU
+// spans are recorded either way
+void profilerInit(Profiler* profiler, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
+                  uint32_t frameSlots);
+void profilerShutdown(Profiler* profiler);
+
+// Export every collected frame as CSV rows or Chrome trace events
+// (chrome://tracing, Perfetto). Return false when the file can't be created.
+bool profilerOpenCsv(Profiler* profiler, const char* path);
+bool profilerOpenTrace(Profiler* profiler, const char* path);
+
+// Reads back the frame last recorded in slot, which must no longer be in
+// use by the GPU. Returns NULL when there is nothing new to report.
+const ProfilerFrame* profilerCollect(Profiler* profiler, uint32_t slot);
+
+// Total time of the collected frame's GPU scopes called name
+double profilerScopeMs(const ProfilerFrame* frame, const char* name);
+
+// Starts recording into slot, collecting it first if that wasn't done yet
+void profilerBeginFrame(Profiler* profiler, uint32_t slot);
+
+// Marks the current frame's command buffer as submitted
+void profilerSubmitted(Profiler* profiler);
+
+uint32_t profilerCpuBegin(Profiler* profiler, const char* name);
+void profilerCpuEnd(Profiler* profiler, uint32_t span);
+
+// Resets the slot's queries; must be recorded before the first GPU scope
+void profilerRecordStart(Profiler* profiler, VkCommandBuffer commandBuffer);
+uint32_t profilerGpuBegin(Profiler* profiler, VkCommandBuffer commandBuffer, const char* name);
+void profilerGpuEnd(Profiler* profiler, VkCommandBuffer commandBuffer, uint32_t scope);
+
+// Writes "name avg" pairs of the last averaging window and returns true when
+// they changed since the previous call
+bool profilerFormatAverages(Profiler* profiler, char* buffer, size_t size);
+
+#endif
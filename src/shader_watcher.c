@@ -0,0 +1,199 @@
+#include "shader_watcher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+
+#include "util.h"
+
+// Editors save in several steps (truncate then write, or write a copy and
+// rename it over the source); compiling waits until the directory was quiet
+// this long
+#define SHADER_WATCHER_SETTLE_MS 30
+
+#define SPIRV_MAGIC 0x07230203u
+
+extern char** environ;
+
+static const char* shaderFiles[WATCHED_SHADER_COUNT] = {"shader.vert", "shader.frag", "cull.comp"};
+
+const char* watchedShaderName(WatchedShader shader) {
+    return shaderFiles[shader];
+}
+
+static bool readSpirv(const char* path, ShaderBinary* binary) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    // Whole words, at least the five of the module header
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    uint32_t* code = size >= 20 && size % 4 == 0 ? malloc((size_t)size) : NULL;
+    bool valid = code && fread(code, 1, (size_t)size, file) == (size_t)size && code[0] == SPIRV_MAGIC;
+    fclose(file);
+    if (!valid) {
+        free(code);
+        return false;
+    }
+
+    binary->code = code;
+    binary->size = (size_t)size;
+    return true;
+}
+
+// Runs the compiler into a temporary file; its diagnostics go straight to
+// the terminal
+static bool compileShader(ShaderWatcher* watcher, WatchedShader shader, ShaderBinary* binary) {
+    char sourcePath[PATH_MAX + 16];
+    snprintf(sourcePath, sizeof(sourcePath), "%s/%s", watcher->directory, shaderFiles[shader]);
+
+    const char* tempDirectory = getenv("TMPDIR");
+    char outputPath[PATH_MAX];
+    snprintf(outputPath, sizeof(outputPath), "%s/scop-shader-XXXXXX",
+             tempDirectory && tempDirectory[0] ? tempDirectory : "/tmp");
+    int outputFd = mkstemp(outputPath);
+    if (outputFd < 0) {
+        fprintf(stderr, "Failed to create a temporary file for %s: %s\n", shaderFiles[shader], strerror(errno));
+        return false;
+    }
+    close(outputFd);
+
+    char* argv[] = {(char*)watcher->compiler, "-V", sourcePath, "-o", outputPath, NULL};
+    pid_t pid;
+    int error = posix_spawnp(&pid, watcher->compiler, NULL, NULL, argv, environ);
+    int status = 0;
+    if (error != 0) {
+        fprintf(stderr, "Failed to run %s: %s\n", watcher->compiler, strerror(error));
+    } else {
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+
+    bool compiled = error == 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0 && readSpirv(outputPath, binary);
+    unlink(outputPath);
+    return compiled;
+}
+
+static void compileChanged(ShaderWatcher* watcher, uint32_t changed) {
+    for (uint32_t i = 0; i < WATCHED_SHADER_COUNT; i++) {
+        if (!(changed & (1u << i))) {
+            continue;
+        }
+
+        double start = getTimeMs();
+        ShaderBinary binary = {0};
+        if (!compileShader(watcher, (WatchedShader)i, &binary)) {
+            fprintf(stderr, "%s failed to compile, keeping the running version\n", shaderFiles[i]);
+            continue;
+        }
+        printf("Recompiled %s in %.1f ms\n", shaderFiles[i], getTimeMs() - start);
+
+        pthread_mutex_lock(&watcher->mutex);
+        free(watcher->ready[i].code);
+        watcher->ready[i] = binary;
+        pthread_mutex_unlock(&watcher->mutex);
+    }
+}
+
+static void* watchThread(void* data) {
+    ShaderWatcher* watcher = data;
+    uint32_t changed = 0;       // bit per WatchedShader saved since the last compile
+
+    // Events are variable length; the buffer must be aligned for them
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        struct pollfd fds[2] = {{watcher->inotifyFd, POLLIN, 0}, {watcher->wakeFds[0], POLLIN, 0}};
+        int ready = poll(fds, 2, changed ? SHADER_WATCHER_SETTLE_MS : -1);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready < 0 || fds[1].revents) {
+            break;
+        }
+
+        if (ready == 0) {
+            compileChanged(watcher, changed);
+            changed = 0;
+            continue;
+        }
+
+        ssize_t length;
+        while ((length = read(watcher->inotifyFd, events, sizeof(events))) > 0) {
+            for (char* cursor = events; cursor < events + length;) {
+                const struct inotify_event* event = (const struct inotify_event*)cursor;
+                cursor += sizeof(*event) + event->len;
+                for (uint32_t i = 0; i < WATCHED_SHADER_COUNT && event->len > 0; i++) {
+                    if (strcmp(event->name, shaderFiles[i]) == 0) {
+                        changed |= 1u << i;
+                    }
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+bool shaderWatcherInit(ShaderWatcher* watcher, const char* directory, const char* compiler) {
+    memset(watcher, 0, sizeof(*watcher));
+    snprintf(watcher->directory, sizeof(watcher->directory), "%s", directory);
+    watcher->compiler = compiler;
+
+    // Closed on exec, so compilers never inherit them
+    watcher->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->inotifyFd < 0) {
+        fprintf(stderr, "Failed to start watching shaders: %s\n", strerror(errno));
+        return false;
+    }
+    // Saved in place, or written elsewhere and renamed over the source
+    if (inotify_add_watch(watcher->inotifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "Failed to watch %s: %s\n", directory, strerror(errno));
+        close(watcher->inotifyFd);
+        return false;
+    }
+    if (pipe(watcher->wakeFds) != 0) {
+        fprintf(stderr, "Failed to create shader watcher pipe!\n");
+        exit(EXIT_FAILURE);
+    }
+    fcntl(watcher->wakeFds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(watcher->wakeFds[1], F_SETFD, FD_CLOEXEC);
+
+    pthread_mutex_init(&watcher->mutex, NULL);
+    if (pthread_create(&watcher->thread, NULL, watchThread, watcher) != 0) {
+        fprintf(stderr, "Failed to start shader watcher thread!\n");
+        exit(EXIT_FAILURE);
+    }
+    return true;
+}
+
+void shaderWatcherShutdown(ShaderWatcher* watcher) {
+    // Closing the write end wakes the thread; a compile in progress finishes first
+    close(watcher->wakeFds[1]);
+    pthread_join(watcher->thread, NULL);
+    close(watcher->wakeFds[0]);
+    close(watcher->inotifyFd);
+    pthread_mutex_destroy(&watcher->mutex);
+
+    for (uint32_t i = 0; i < WATCHED_SHADER_COUNT; i++) {
+        free(watcher->ready[i].code);
+    }
+    memset(watcher, 0, sizeof(*watcher));
+}
+
+bool shaderWatcherTake(ShaderWatcher* watcher, WatchedShader shader, ShaderBinary* binary) {
+    pthread_mutex_lock(&watcher->mutex);
+    *binary = watcher->ready[shader];
+    watcher->ready[shader].code = NULL;
+    watcher->ready[shader].size = 0;
+    pthread_mutex_unlock(&watcher->mutex);
+    return binary->code != NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef SCOP_SHADER_WATCHER_H
+#define SCOP_SHADER_WATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <pthread.h>
+
+// GLSL sources the renderer builds pipelines from, by file name in the
+// watched directory
+typedef enum {
+    WATCHED_SHADER_VERTEX,      // shader.vert
+    WATCHED_SHADER_FRAGMENT,    // shader.frag
+    WATCHED_SHADER_CULL,        // cull.comp
+    WATCHED_SHADER_COUNT
+} WatchedShader;
+
+// SPIR-V of a freshly compiled shader; code is malloc'd
+typedef struct {
+    uint32_t* code;
+    size_t size;
+} ShaderBinary;
+
+// Recompiles shaders as they are saved. A thread blocks on inotify for the
+// directory, lets a burst of writes settle, and runs the GLSL compiler on
+// each changed source; the render loop picks up the SPIR-V without waiting.
+// A source that fails to compile leaves nothing to pick up, so the running
+// version stays until the next save.
+typedef struct {
+    char directory[PATH_MAX];
+    const char* compiler;       // glslangValidator, a path or found on PATH
+    int inotifyFd;
+    int wakeFds[2];             // pipe that stops the thread
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    ShaderBinary ready[WATCHED_SHADER_COUNT];   // compiled since the last take, guarded by mutex
+} ShaderWatcher;
+
+const char* watchedShaderName(WatchedShader shader);
+
+// Starts watching directory; false, with the reason printed, when inotify or
+// the directory isn't available
+bool shaderWatcherInit(ShaderWatcher* watcher, const char* directory, const char* compiler);
+void shaderWatcherShutdown(ShaderWatcher* watcher);
+
+// Hands over the SPIR-V of shader if it was recompiled since the last call;
+// a newer compile replaces one nobody took yet
+bool shaderWatcherTake(ShaderWatcher* watcher, WatchedShader shader, ShaderBinary* binary);
+
+#endif
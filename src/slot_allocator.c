@@ -0,0 +1,53 @@
+#include "slot_allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void slotAllocatorInit(SlotAllocator* slots, uint32_t capacity, uint32_t firstSlot) {
+    memset(slots, 0, sizeof(*slots));
+
+    // Pushed highest first, so the lowest slot is on top
+    slots->freeSlots = malloc((capacity > firstSlot ? capacity - firstSlot : 1) * sizeof(uint32_t));
+    for (uint32_t slot = capacity; slot > firstSlot; slot--) {
+        slots->freeSlots[slots->freeCount++] = slot - 1;
+    }
+}
+
+void slotAllocatorShutdown(SlotAllocator* slots) {
+    free(slots->freeSlots);
+    free(slots->retired);
+    memset(slots, 0, sizeof(*slots));
+}
+
+bool slotAllocatorTake(SlotAllocator* slots, uint32_t* slot) {
+    if (slots->freeCount == 0) {
+        return false;
+    }
+    *slot = slots->freeSlots[--slots->freeCount];
+    return true;
+}
+
+void slotAllocatorRetire(SlotAllocator* slots, uint32_t slot, uint64_t retireValue) {
+    if (slots->retiredCount == slots->retiredCapacity) {
+        slots->retiredCapacity = slots->retiredCapacity ? slots->retiredCapacity * 2 : 16;
+        slots->retired = realloc(slots->retired, slots->retiredCapacity * sizeof(RetiredSlot));
+    }
+    slots->retired[slots->retiredCount].slot = slot;
+    slots->retired[slots->retiredCount].retireValue = retireValue;
+    slots->retiredCount++;
+}
+
+bool slotAllocatorReclaim(SlotAllocator* slots, uint64_t completedValue, uint32_t* slot) {
+    for (uint32_t i = 0; i < slots->retiredCount; i++) {
+        if (slots->retired[i].retireValue > completedValue) {
+            continue;
+        }
+
+        // Retired slots are reclaimed in any order, so the last one fills the gap
+        *slot = slots->retired[i].slot;
+        slots->retired[i] = slots->retired[--slots->retiredCount];
+        slots->freeSlots[slots->freeCount++] = *slot;
+        return true;
+    }
+    return false;
+}
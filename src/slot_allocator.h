@@ -0,0 +1,41 @@
+#ifndef SCOP_SLOT_ALLOCATOR_H
+#define SCOP_SLOT_ALLOCATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Slot given back while frames that may use it are in flight
+typedef struct {
+    uint32_t slot;
+    uint64_t retireValue;
+} RetiredSlot;
+
+// Hands out the slots of a fixed-size table, lowest first, and takes a
+// released slot back only once the frame timeline reaches the last frame
+// that may still use it. Knows nothing of what the slots hold, so the
+// bookkeeping is the same for any table indexed by frames in flight.
+typedef struct {
+    uint32_t* freeSlots;            // stack of slots ready to hand out
+    uint32_t freeCount;
+    RetiredSlot* retired;
+    uint32_t retiredCount;
+    uint32_t retiredCapacity;
+} SlotAllocator;
+
+// Slots below firstSlot are reserved and never handed out
+void slotAllocatorInit(SlotAllocator* slots, uint32_t capacity, uint32_t firstSlot);
+void slotAllocatorShutdown(SlotAllocator* slots);
+
+// Returns false when every slot is taken or still retired
+bool slotAllocatorTake(SlotAllocator* slots, uint32_t* slot);
+
+// Gives back a taken slot, to be handed out again once the frame timeline
+// reaches retireValue
+void slotAllocatorRetire(SlotAllocator* slots, uint32_t slot, uint64_t retireValue);
+
+// Frees one slot retired at or before completedValue and returns it, so the
+// caller can release what it held before the slot is taken again. Returns
+// false once no such slot is left.
+bool slotAllocatorReclaim(SlotAllocator* slots, uint64_t completedValue, uint32_t* slot);
+
+#endif
@@ -0,0 +1,110 @@
+#include "texture_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "util.h"
+
+#define TEXTURE_CACHE_MAGIC "SCOPBCTX"
+
+// On-disk header; the levels follow it back to back
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;            // BcFormat
+    uint64_t sourceHash;        // content hash of the source image
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t padding;
+    uint64_t size;              // bytes of every level together
+} TextureCacheHeader;
+
+bool textureCachePath(uint64_t sourceHash, const char* variant, char* path, size_t size) {
+    char directory[PATH_MAX];
+    if (!getCacheDirectory(directory, sizeof(directory))) {
+        return false;
+    }
+
+    int written = snprintf(path, size, "%s/%016llx-%s.tex", directory, (unsigned long long)sourceHash, variant);
+    return written > 0 && (size_t)written < size;
+}
+
+bool textureCacheLoad(const char* cachePath, uint64_t sourceHash, BcImage* encoded) {
+    FILE* file = fopen(cachePath, "rb");
+    if (!file) {
+        return false;
+    }
+
+    // The size must be what the header's format and extent imply, so a
+    // truncated or foreign file is never uploaded
+    TextureCacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == TEXTURE_CACHE_VERSION && header.sourceHash == sourceHash &&
+                 header.format < BC_FORMAT_COUNT && header.width > 0 && header.height > 0 &&
+                 header.width <= IMAGE_MAX_DIMENSION && header.height <= IMAGE_MAX_DIMENSION &&
+                 header.mipLevels == bcMipLevels(header.width, header.height);
+
+    size_t expected = 0;
+    for (uint32_t level = 0; valid && level < header.mipLevels; level++) {
+        uint32_t width = header.width >> level ? header.width >> level : 1;
+        uint32_t height = header.height >> level ? header.height >> level : 1;
+        expected += bcLevelSize((BcFormat)header.format, width, height);
+    }
+    valid = valid && header.size == expected;
+
+    uint8_t* data = valid ? malloc(expected) : NULL;
+    valid = valid && fread(data, 1, expected, file) == expected;
+    fclose(file);
+    if (!valid) {
+        free(data);
+        return false;
+    }
+
+    encoded->format = (BcFormat)header.format;
+    encoded->width = header.width;
+    encoded->height = header.height;
+    encoded->mipLevels = header.mipLevels;
+    encoded->data = data;
+    encoded->size = expected;
+    return true;
+}
+
+bool textureCacheWrite(const char* cachePath, uint64_t sourceHash, const BcImage* encoded) {
+    TextureCacheHeader header = {0};
+    memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = TEXTURE_CACHE_VERSION;
+    header.format = encoded->format;
+    header.sourceHash = sourceHash;
+    header.width = encoded->width;
+    header.height = encoded->height;
+    header.mipLevels = encoded->mipLevels;
+    header.size = encoded->size;
+
+    // Write to a temporary file and rename so readers never see a partial
+    // entry; the name is unique per write, as copies of one image share a key
+    static uint32_t writeCount;
+    char tempPath[PATH_MAX + 32];
+    snprintf(tempPath, sizeof(tempPath), "%s.%ld-%u.tmp", cachePath, (long)getpid(),
+             __atomic_fetch_add(&writeCount, 1, __ATOMIC_RELAXED));
+
+    FILE* file = fopen(tempPath, "wb");
+    if (!file) {
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(encoded->data, 1, encoded->size, file) == encoded->size;
+
+    written = fclose(file) == 0 && written;
+    if (!written || rename(tempPath, cachePath) != 0) {
+        unlink(tempPath);
+        return false;
+    }
+
+    return true;
+}
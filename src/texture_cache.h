@@ -0,0 +1,24 @@
+#ifndef SCOP_TEXTURE_CACHE_H
+#define SCOP_TEXTURE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bc_encoder.h"
+
+// Bump whenever the file layout or an encoder's output changes
+#define TEXTURE_CACHE_VERSION 1
+
+// Builds the cache file path of a texture in the user's cache directory.
+// Entries are keyed by the content hash of the source image, so a moved or
+// copied file still hits; variant tells encodings of one source apart.
+bool textureCachePath(uint64_t sourceHash, const char* variant, char* path, size_t size);
+
+// Reads a block-compressed mip chain written for the same source hash
+bool textureCacheLoad(const char* cachePath, uint64_t sourceHash, BcImage* encoded);
+
+// Writes header and levels atomically
+bool textureCacheWrite(const char* cachePath, uint64_t sourceHash, const BcImage* encoded);
+
+#endif
@@ -0,0 +1,578 @@
+#include "texture_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "texture_cache.h"
+#include "util.h"
+
+// Base color textures hold sRGB values; sampling returns them linear
+#define TEXTURE_FORMAT VK_FORMAT_R8G8B8A8_SRGB
+
+static const VkFormat bcFormats[BC_FORMAT_COUNT] = {
+    VK_FORMAT_BC1_RGB_SRGB_BLOCK,
+    VK_FORMAT_BC3_SRGB_BLOCK,
+    VK_FORMAT_BC7_SRGB_BLOCK
+};
+
+// Cache entries of one source differ by compression mode
+static const char* cacheVariants[] = {"rgba", "bc", "bc7"};
+
+static inline uint32_t stateOf(const Texture* texture) {
+    return __atomic_load_n(&texture->state, __ATOMIC_ACQUIRE);
+}
+
+static inline void setState(Texture* texture, TextureState state) {
+    __atomic_store_n(&texture->state, state, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t pixelBytes(const Texture* texture) {
+    return (uint64_t)texture->width * texture->height * 4;
+}
+
+// Host memory a texture holds until its upload is recorded
+static inline uint64_t hostBytes(const Texture* texture) {
+    return texture->encoded.data ? texture->encoded.size : pixelBytes(texture);
+}
+
+// RGBA8 bytes of the first levels of a texture
+static uint64_t rgbaChainBytes(uint32_t width, uint32_t height, uint32_t levels) {
+    uint64_t bytes = 0;
+    for (uint32_t level = 0; level < levels; level++) {
+        uint64_t levelWidth = width >> level ? width >> level : 1;
+        uint64_t levelHeight = height >> level ? height >> level : 1;
+        bytes += levelWidth * levelHeight * 4;
+    }
+    return bytes;
+}
+
+// The last of the upload and the encoder to finish with the pixels frees them
+static void releasePixels(Texture* texture) {
+    if (__atomic_sub_fetch(&texture->pixelUsers, 1, __ATOMIC_ACQ_REL) == 0) {
+        imageFree(&texture->image);
+    }
+}
+
+static void decodeTexture(Texture* texture) {
+    // A cached chain replaces both the decode and the mip blits
+    if (texture->compression != TEXTURE_COMPRESSION_NONE && !texture->skipCache &&
+        hashFile(texture->path, &texture->sourceHash)) {
+        texture->hashed = true;
+        char cachePath[PATH_MAX];
+        if (textureCachePath(texture->sourceHash, cacheVariants[texture->compression], cachePath, sizeof(cachePath)) &&
+            textureCacheLoad(cachePath, texture->sourceHash, &texture->encoded)) {
+            texture->width = texture->encoded.width;
+            texture->height = texture->encoded.height;
+            setState(texture, TEXTURE_STATE_DECODED);
+            return;
+        }
+    }
+
+    if (!imageLoad(texture->path, &texture->image)) {
+        fprintf(stderr, "Failed to load texture: %s\n", texture->path);
+        setState(texture, TEXTURE_STATE_FAILED);
+        return;
+    }
+    texture->width = texture->image.width;
+    texture->height = texture->image.height;
+
+    // Release so the main thread sees the pixels along with the state
+    setState(texture, TEXTURE_STATE_DECODED);
+}
+
+static void decodeJob(void* data, uint32_t threadIndex) {
+    (void)threadIndex;
+    decodeTexture(data);
+}
+
+// Encodes the pixels the upload already used and stores the chain for later runs
+static void encodeJob(void* data, uint32_t threadIndex) {
+    (void)threadIndex;
+    Texture* texture = data;
+    BcFormat format = texture->encodeFormat == BC_FORMAT_COUNT ? bcChooseFormat(&texture->image)
+                                                               : texture->encodeFormat;
+
+    BcImage encoded;
+    bcEncodeImage(&texture->image, format, &encoded);
+    releasePixels(texture);
+
+    char cachePath[PATH_MAX];
+    if (!textureCachePath(texture->sourceHash, cacheVariants[texture->compression], cachePath, sizeof(cachePath)) ||
+        !textureCacheWrite(cachePath, texture->sourceHash, &encoded)) {
+        fprintf(stderr, "Failed to write texture cache for %s\n", texture->path);
+    }
+    texture->encodedSize = encoded.size;
+    bcImageFree(&encoded);
+    __atomic_store_n(&texture->encode, TEXTURE_ENCODE_DONE, __ATOMIC_RELEASE);
+}
+
+void textureLoaderInit(TextureLoader* loader, JobSystem* jobs, TextureCompression compression) {
+    memset(loader, 0, sizeof(*loader));
+    loader->jobs = jobs;
+    loader->maxDecodes = jobs->threadCount > 1 ? jobs->threadCount / 2 : 1;
+    loader->compression = compression;
+    loader->startTime = getTimeMs();
+    loader->settled = true;
+}
+
+void textureLoaderShutdown(TextureLoader* loader) {
+    jobSystemWait(loader->jobs, &loader->pending);
+
+    // READY textures belong to the table; the rest are destroyed here, the
+    // device being idle
+    for (uint32_t i = 0; i < loader->count; i++) {
+        Texture* texture = loader->textures[i];
+        if (texture->vkImage != VK_NULL_HANDLE && stateOf(texture) != TEXTURE_STATE_READY) {
+            vkDestroyImageView(loader->device, texture->view, NULL);
+            gpuDestroyImage(loader->allocator, texture->vkImage, &texture->allocation);
+        }
+        imageFree(&texture->image);
+        bcImageFree(&texture->encoded);
+        free(texture->path);
+        free(texture);
+    }
+    free(loader->textures);
+    memset(loader, 0, sizeof(*loader));
+}
+
+uint32_t textureLoaderRequest(TextureLoader* loader, const char* path) {
+    for (uint32_t i = 0; i < loader->count; i++) {
+        Texture* texture = loader->textures[i];
+        if (strcmp(texture->path, path) != 0) {
+            continue;
+        }
+
+        // An unloaded texture streams in again, from the cache when it has one
+        if (stateOf(texture) == TEXTURE_STATE_UNLOADED) {
+            setState(texture, TEXTURE_STATE_QUEUED);
+            loader->nextQueued = i < loader->nextQueued ? i : loader->nextQueued;
+            if (loader->settled) {
+                loader->startTime = getTimeMs();
+                loader->settled = false;
+            }
+        }
+        return i;
+    }
+
+    if (loader->count == loader->capacity) {
+        loader->capacity = loader->capacity ? loader->capacity * 2 : 16;
+        loader->textures = realloc(loader->textures, loader->capacity * sizeof(Texture*));
+    }
+
+    Texture* texture = calloc(1, sizeof(Texture));
+    texture->path = strdup(path);
+    texture->state = TEXTURE_STATE_QUEUED;
+    texture->compression = loader->compression;
+    texture->slot = TEXTURE_TABLE_DEFAULT_SLOT;
+    loader->textures[loader->count] = texture;
+    loader->settled = false;
+    return loader->count++;
+}
+
+void textureLoaderDecode(TextureLoader* loader) {
+    // Texels waiting for the staging ring or an encoder count against the
+    // budget, as do decodes in flight, whose size is not known yet
+    uint32_t decoding = 0;
+    uint64_t waitingBytes = 0;
+    for (uint32_t i = 0; i < loader->count; i++) {
+        const Texture* texture = loader->textures[i];
+        uint32_t state = stateOf(texture);
+        if (state == TEXTURE_STATE_DECODING) {
+            decoding++;
+        } else if (state == TEXTURE_STATE_DECODED || state == TEXTURE_STATE_UPLOADING) {
+            waitingBytes += hostBytes(texture);
+        }
+
+        // Pixels kept for an encoder count until it is done with them
+        uint32_t encode = __atomic_load_n(&texture->encode, __ATOMIC_ACQUIRE);
+        if (encode == TEXTURE_ENCODE_WANTED || encode == TEXTURE_ENCODE_RUNNING) {
+            waitingBytes += pixelBytes(texture);
+        }
+        decoding += encode == TEXTURE_ENCODE_RUNNING;
+    }
+
+    while (loader->nextQueued < loader->count &&
+           stateOf(loader->textures[loader->nextQueued]) != TEXTURE_STATE_QUEUED) {
+        loader->nextQueued++;
+    }
+    for (uint32_t i = loader->nextQueued; i < loader->count; i++) {
+        if (decoding >= loader->maxDecodes || waitingBytes >= TEXTURE_LOADER_PENDING_BYTES) {
+            break;
+        }
+
+        Texture* texture = loader->textures[i];
+        if (stateOf(texture) != TEXTURE_STATE_QUEUED) {
+            continue;
+        }
+
+        // Without workers a queued job would only run at shutdown
+        setState(texture, TEXTURE_STATE_DECODING);
+        if (loader->jobs->threadCount == 0) {
+            decodeTexture(texture);
+            break;
+        }
+        jobSystemSubmit(loader->jobs, decodeJob, texture, &loader->pending);
+        decoding++;
+    }
+
+    // Encodes wait until nothing is left to decode, so the first run shows
+    // every texture as soon as it would have without the cache, unless the
+    // pixels they hold are what keeps decoding paused
+    bool encodesFirst = waitingBytes >= TEXTURE_LOADER_PENDING_BYTES;
+    for (uint32_t i = 0; i < loader->count && loader->encodesLeft > 0; i++) {
+        if (decoding >= loader->maxDecodes || (loader->nextQueued < loader->count && !encodesFirst)) {
+            break;
+        }
+
+        Texture* texture = loader->textures[i];
+        if (__atomic_load_n(&texture->encode, __ATOMIC_RELAXED) != TEXTURE_ENCODE_WANTED) {
+            continue;
+        }
+
+        bool bc7 = texture->compression == TEXTURE_COMPRESSION_BC7 && loader->bcSampled[BC_FORMAT_BC7];
+        texture->encodeFormat = bc7 ? BC_FORMAT_BC7 : BC_FORMAT_COUNT;
+        texture->encode = TEXTURE_ENCODE_RUNNING;
+        if (loader->encodeStartTime == 0.0) {
+            loader->encodeStartTime = getTimeMs();
+        }
+        jobSystemSubmit(loader->jobs, encodeJob, texture, &loader->pending);
+        decoding++;
+    }
+}
+
+void textureLoaderAttach(TextureLoader* loader, GpuAllocator* allocator, VkPhysicalDevice physicalDevice,
+                         bool textureCompressionBC, UploadContext* upload, TextureTable* table) {
+    loader->device = allocator->device;
+    loader->allocator = allocator;
+    loader->upload = upload;
+    loader->table = table;
+
+    // Mandatory for this format, but a single level still draws where it isn't
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, TEXTURE_FORMAT, &properties);
+    loader->blitMips = (properties.optimalTilingFeatures & needed) == needed;
+
+    // Cached chains are only used in formats the device samples; the feature
+    // must also have been enabled on the device
+    needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    for (uint32_t i = 0; i < BC_FORMAT_COUNT && textureCompressionBC; i++) {
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, bcFormats[i], &properties);
+        loader->bcSampled[i] = (properties.optimalTilingFeatures & needed) == needed;
+    }
+    if (loader->compression != TEXTURE_COMPRESSION_NONE && !loader->bcSampled[BC_FORMAT_BC1]) {
+        printf("Block-compressed textures can't be sampled, textures stay RGBA8\n");
+    }
+}
+
+// Creates the image and view of a decoded texture and queues its upload:
+// every level of a cached chain, otherwise level 0 for the blits to build on
+static void startUpload(TextureLoader* loader, Texture* texture) {
+    bool compressed = texture->encoded.data != NULL;
+    VkFormat format = compressed ? bcFormats[texture->encoded.format] : TEXTURE_FORMAT;
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    texture->compressed = compressed;
+    if (compressed) {
+        texture->mipLevels = texture->encoded.mipLevels;
+        texture->videoBytes = texture->encoded.size;
+    } else {
+        texture->mipLevels = loader->blitMips ? bcMipLevels(texture->width, texture->height) : 1;
+        texture->videoBytes = rgbaChainBytes(texture->width, texture->height, texture->mipLevels);
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    VkImageCreateInfo imageInfo = {0};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent.width = texture->width;
+    imageInfo.extent.height = texture->height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = texture->mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    gpuCreateImage(loader->allocator, &imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->vkImage,
+                   &texture->allocation);
+
+    VkImageViewCreateInfo viewInfo = {0};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = texture->vkImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = texture->mipLevels;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(loader->device, &viewInfo, NULL, &texture->view) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create texture image view!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkAccessFlags dstAccess = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    if (compressed) {
+        texture->uploadTicket = uploadImage(loader->upload, texture->vkImage, format, texture->width,
+                                            texture->height, texture->mipLevels, texture->mipLevels,
+                                            texture->encoded.data, dstAccess);
+    } else {
+        texture->uploadTicket = uploadImage(loader->upload, texture->vkImage, format, texture->width,
+                                            texture->height, 1, texture->mipLevels, texture->image.pixels,
+                                            dstAccess);
+
+        // A cache miss is encoded for later runs, on workers only: one
+        // encode on the render thread would be a long stall
+        bool encodable = loader->bcSampled[BC_FORMAT_BC1] && loader->bcSampled[BC_FORMAT_BC3];
+        texture->pixelUsers = 1;
+        if (texture->hashed && encodable && loader->jobs->threadCount > 0) {
+            texture->pixelUsers = 2;
+            texture->encode = TEXTURE_ENCODE_WANTED;
+            loader->encodesLeft++;
+        }
+    }
+    setState(texture, TEXTURE_STATE_UPLOADING);
+}
+
+// Frees a cached chain that can't be sampled here and queues the texture
+// again, to be decoded from its source
+static void skipCache(TextureLoader* loader, Texture* texture, uint32_t index) {
+    bcImageFree(&texture->encoded);
+    texture->skipCache = true;
+    setState(texture, TEXTURE_STATE_QUEUED);
+    loader->nextQueued = index < loader->nextQueued ? index : loader->nextQueued;
+}
+
+bool textureLoaderUpdate(TextureLoader* loader) {
+    if ((loader->settled && loader->encodesLeft == 0) || !loader->upload) {
+        return false;
+    }
+
+    // Mip chains recorded last frame or earlier come before this frame on
+    // the queue, so the textures can be sampled from now on
+    bool published = false;
+    bool busy = false;
+    uint32_t ready = 0;
+    for (uint32_t i = 0; i < loader->count; i++) {
+        Texture* texture = loader->textures[i];
+        uint32_t state = stateOf(texture);
+        if (state == TEXTURE_STATE_MIPPED) {
+            if (textureTableAdd(loader->table, texture->vkImage, texture->view, &texture->allocation, &texture->slot)) {
+                setState(texture, TEXTURE_STATE_READY);
+                published = true;
+                loader->compressedCount += texture->compressed;
+                loader->videoBytes += texture->videoBytes;
+                loader->rgbaBytes += rgbaChainBytes(texture->width, texture->height, texture->mipLevels);
+            } else {
+                // The image may still be in use by a frame; it goes at shutdown
+                if (!loader->tableFull) {
+                    fprintf(stderr, "Texture table is full (%u slots), %s and later textures stay untextured\n",
+                            loader->table->capacity, texture->path);
+                    loader->tableFull = true;
+                }
+                setState(texture, TEXTURE_STATE_FAILED);
+            }
+        } else if (state == TEXTURE_STATE_DECODED) {
+            if (texture->encoded.data && !loader->bcSampled[texture->encoded.format]) {
+                skipCache(loader, texture, i);
+            } else {
+                startUpload(loader, texture);
+            }
+        }
+
+        state = stateOf(texture);
+        ready += state == TEXTURE_STATE_READY;
+        busy = busy || (state != TEXTURE_STATE_READY && state != TEXTURE_STATE_FAILED &&
+                        state != TEXTURE_STATE_UNLOADED);
+
+        // Counted once: the encoder is gone, so the state goes back to NONE
+        if (__atomic_load_n(&texture->encode, __ATOMIC_ACQUIRE) == TEXTURE_ENCODE_DONE) {
+            texture->encode = TEXTURE_ENCODE_NONE;
+            loader->encodedCount++;
+            loader->encodesLeft--;
+            loader->encodedBytes += texture->encodedSize;
+            loader->encodedRgbaBytes += rgbaChainBytes(texture->width, texture->height,
+                                                       bcMipLevels(texture->width, texture->height));
+        }
+    }
+
+    textureLoaderDecode(loader);
+
+    if (!busy && !loader->settled) {
+        printf("Loaded %u of %u textures in %.1f ms, %u block-compressed: %.1f MB of video memory, "
+               "%.1f MB as RGBA8\n", ready, loader->count, getTimeMs() - loader->startTime,
+               loader->compressedCount, loader->videoBytes / (1024.0 * 1024.0),
+               loader->rgbaBytes / (1024.0 * 1024.0));
+        loader->settled = true;
+    }
+    if (loader->settled && loader->encodesLeft == 0 && loader->encodedCount > 0) {
+        printf("Block-compressed %u textures for later runs in %.1f ms: %.1f MB instead of %.1f MB as RGBA8\n",
+               loader->encodedCount, getTimeMs() - loader->encodeStartTime,
+               loader->encodedBytes / (1024.0 * 1024.0), loader->encodedRgbaBytes / (1024.0 * 1024.0));
+        loader->encodedCount = 0;
+    }
+    return published;
+}
+
+// Halves level by level down to 1x1, each level leaving for the fragment
+// shader once the next is blitted from it
+static void recordMips(const Texture* texture, VkCommandBuffer commandBuffer) {
+    VkImageMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = texture->vkImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+
+    int32_t width = (int32_t)texture->width;
+    int32_t height = (int32_t)texture->height;
+    for (uint32_t level = 1; level < texture->mipLevels; level++) {
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, NULL, 0, NULL, 1, &barrier);
+
+        int32_t nextWidth = width > 1 ? width / 2 : 1;
+        int32_t nextHeight = height > 1 ? height / 2 : 1;
+        VkImageBlit blit = {0};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.layerCount = 1;
+        blit.srcOffsets[1].x = width;
+        blit.srcOffsets[1].y = height;
+        blit.srcOffsets[1].z = 1;
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.layerCount = 1;
+        blit.dstOffsets[1].x = nextWidth;
+        blit.dstOffsets[1].y = nextHeight;
+        blit.dstOffsets[1].z = 1;
+        vkCmdBlitImage(commandBuffer, texture->vkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->vkImage,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             0, NULL, 0, NULL, 1, &barrier);
+        width = nextWidth;
+        height = nextHeight;
+    }
+
+    // The last level was only ever written
+    barrier.subresourceRange.baseMipLevel = texture->mipLevels - 1;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, NULL, 0, NULL, 1, &barrier);
+}
+
+// Every level of an uploaded chain goes to the fragment shader at once
+static void recordCompressed(const Texture* texture, VkCommandBuffer commandBuffer) {
+    VkImageMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = texture->vkImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = texture->mipLevels;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, NULL, 0, NULL, 1, &barrier);
+}
+
+void textureLoaderRecord(TextureLoader* loader, VkCommandBuffer commandBuffer) {
+    if (loader->settled || !loader->upload) {
+        return;
+    }
+
+    // At least one texture per frame, so a huge one can't stall the rest
+    uint64_t budget = TEXTURE_LOADER_MIP_BUDGET;
+    bool first = true;
+    for (uint32_t i = 0; i < loader->count; i++) {
+        Texture* texture = loader->textures[i];
+        if (stateOf(texture) != TEXTURE_STATE_UPLOADING || !uploadIsReady(loader->upload, texture->uploadTicket)) {
+            continue;
+        }
+
+        // Cached chains arrive whole and only change layout, at no cost
+        if (texture->compressed) {
+            recordCompressed(texture, commandBuffer);
+            bcImageFree(&texture->encoded);
+            setState(texture, TEXTURE_STATE_MIPPED);
+            continue;
+        }
+
+        uint64_t bytes = pixelBytes(texture);
+        if (!first && bytes > budget) {
+            break;
+        }
+        budget -= bytes < budget ? bytes : budget;
+        first = false;
+
+        // Level 0 is in the staging ring or on the GPU, the host copy can go
+        // unless an encoder still needs it
+        recordMips(texture, commandBuffer);
+        releasePixels(texture);
+        setState(texture, TEXTURE_STATE_MIPPED);
+    }
+}
+
+bool textureLoaderSlot(const TextureLoader* loader, uint32_t texture, uint32_t* slot) {
+    if (texture >= loader->count || stateOf(loader->textures[texture]) != TEXTURE_STATE_READY) {
+        return false;
+    }
+    *slot = loader->textures[texture]->slot;
+    return true;
+}
+
+bool textureLoaderUnload(TextureLoader* loader, uint32_t texture, uint64_t retireValue) {
+    if (texture >= loader->count || stateOf(loader->textures[texture]) != TEXTURE_STATE_READY) {
+        return false;
+    }
+
+    // A running encode still reads the pixels a new decode would replace,
+    // and a finished one is counted by the next update; a wanted one is
+    // dropped along with the pixels it kept
+    Texture* entry = loader->textures[texture];
+    uint32_t encode = __atomic_load_n(&entry->encode, __ATOMIC_ACQUIRE);
+    if (encode == TEXTURE_ENCODE_RUNNING || encode == TEXTURE_ENCODE_DONE) {
+        return false;
+    }
+    if (encode == TEXTURE_ENCODE_WANTED) {
+        entry->encode = TEXTURE_ENCODE_NONE;
+        loader->encodesLeft--;
+        releasePixels(entry);
+    }
+
+    // The image belongs to the table, which destroys it once no frame samples it
+    textureTableRemove(loader->table, entry->slot, retireValue);
+    loader->compressedCount -= entry->compressed;
+    loader->videoBytes -= entry->videoBytes;
+    loader->rgbaBytes -= rgbaChainBytes(entry->width, entry->height, entry->mipLevels);
+    entry->vkImage = VK_NULL_HANDLE;
+    entry->view = VK_NULL_HANDLE;
+    memset(&entry->allocation, 0, sizeof(entry->allocation));
+    entry->slot = TEXTURE_TABLE_DEFAULT_SLOT;
+    setState(entry, TEXTURE_STATE_UNLOADED);
+    return true;
+}
+
+const char* textureCompressionName(TextureCompression compression) {
+    return compression == TEXTURE_COMPRESSION_NONE ? "none" : compression == TEXTURE_COMPRESSION_BC ? "bc" : "bc7";
+}
@@ -0,0 +1,158 @@
+#ifndef SCOP_TEXTURE_LOADER_H
+#define SCOP_TEXTURE_LOADER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <vulkan/vulkan.h>
+
+#include "bc_encoder.h"
+#include "gpu_allocator.h"
+#include "image_loader.h"
+#include "job_system.h"
+#include "texture_table.h"
+#include "upload.h"
+
+// Decoded bytes allowed to wait for the staging ring; decoding pauses above it
+#define TEXTURE_LOADER_PENDING_BYTES (256u * 1024u * 1024u)
+
+// Level 0 bytes whose mip chains one frame may blit, past the first texture
+#define TEXTURE_LOADER_MIP_BUDGET (32u * 1024u * 1024u)
+
+#define TEXTURE_LOADER_NONE UINT32_MAX
+
+// Block compression applied through the texture cache
+typedef enum {
+    TEXTURE_COMPRESSION_NONE,   // always RGBA8 with blitted mips
+    TEXTURE_COMPRESSION_BC,     // BC1 for opaque textures, BC3 for the rest
+    TEXTURE_COMPRESSION_BC7     // BC7 for every texture, BC1/BC3 where BC7 can't be sampled
+} TextureCompression;
+
+typedef enum {
+    TEXTURE_STATE_QUEUED,       // waiting for a worker
+    TEXTURE_STATE_DECODING,     // being decoded on a worker
+    TEXTURE_STATE_DECODED,      // pixels in host memory
+    TEXTURE_STATE_UPLOADING,    // level 0 on its way through the upload engine
+    TEXTURE_STATE_MIPPED,       // mip chain recorded into a submitted frame
+    TEXTURE_STATE_READY,        // in the texture table
+    TEXTURE_STATE_FAILED,
+    TEXTURE_STATE_UNLOADED      // taken out of the table, queued again by the next request
+} TextureState;
+
+// Background encode of an uncompressed texture into the cache
+typedef enum {
+    TEXTURE_ENCODE_NONE,
+    TEXTURE_ENCODE_WANTED,      // cache missed; waits until nothing is left to decode
+    TEXTURE_ENCODE_RUNNING,     // on a worker
+    TEXTURE_ENCODE_DONE         // set by the worker, accessed atomically
+} TextureEncode;
+
+typedef struct {
+    char* path;
+    uint32_t state;             // TextureState, accessed atomically while decoding
+    TextureCompression compression;
+    bool skipCache;             // the cached encoding can't be sampled here, decode the source
+    bool hashed;                // sourceHash is the content hash of the file
+    uint64_t sourceHash;
+    uint32_t width;
+    uint32_t height;
+    Image image;                // decoded pixels, shared with the encoder
+    uint32_t pixelUsers;        // upload and encode holding the pixels, accessed atomically
+    BcImage encoded;            // mip chain read from the cache, uploaded instead of image
+    bool compressed;            // the GPU image holds the cached chain
+    uint32_t encode;            // TextureEncode, accessed atomically while running
+    BcFormat encodeFormat;      // picked at submit; BC_FORMAT_COUNT lets the encoder choose BC1 or BC3
+    size_t encodedSize;         // bytes the encoder cached
+    VkImage vkImage;
+    VkImageView view;
+    GpuAllocation allocation;
+    uint32_t mipLevels;
+    VkDeviceSize videoBytes;    // texel bytes of every level on the GPU
+    uint64_t uploadTicket;
+    uint32_t slot;              // texture table slot once READY
+} Texture;
+
+// Streams textures in without ever waiting: files are decoded on the job
+// system, level 0 goes through the upload engine, the graphics queue blits
+// the mip chain, and the texture joins the table the frame after. A frame
+// never waits for any of it, so textures pop in as they arrive.
+//
+// With compression on, a texture whose block-compressed chain is in the
+// texture cache is read from there instead, every level uploaded as is.
+// On a miss the texture is shown uncompressed and, once nothing is left to
+// decode, encoded on a worker so later runs find it.
+//
+// Requests can be made before the device exists, so decoding overlaps
+// Vulkan setup; the GPU half starts with textureLoaderAttach.
+typedef struct {
+    JobSystem* jobs;
+    JobCounter pending;         // decode and encode jobs in flight
+    uint32_t maxDecodes;        // decodes and encodes in flight at once, so workers stay free for recording
+    TextureCompression compression;
+    Texture** textures;         // allocated one by one, since workers hold on to them
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t nextQueued;        // first texture that may still be QUEUED
+    double startTime;
+    bool settled;               // every texture READY or FAILED, and reported
+    uint32_t compressedCount;   // READY textures sampled block-compressed
+    uint64_t videoBytes;        // texel bytes of the READY textures
+    uint64_t rgbaBytes;         // what they would take as RGBA8 with the same levels
+    uint32_t encodesLeft;       // encodes wanted or running
+    uint32_t encodedCount;      // finished encodes not reported yet
+    uint64_t encodedBytes;      // what they cached
+    uint64_t encodedRgbaBytes;  // their full chains as RGBA8
+    double encodeStartTime;
+
+    // Set by textureLoaderAttach
+    VkDevice device;
+    GpuAllocator* allocator;
+    UploadContext* upload;
+    TextureTable* table;
+    bool blitMips;              // the format can be blitted with linear filtering
+    bool bcSampled[BC_FORMAT_COUNT];    // block formats the device samples with linear filtering
+    bool tableFull;
+} TextureLoader;
+
+void textureLoaderInit(TextureLoader* loader, JobSystem* jobs, TextureCompression compression);
+
+// Waits for decodes and encodes in flight, then destroys every image the
+// table does not own
+void textureLoaderShutdown(TextureLoader* loader);
+
+// Returns the texture of path, queueing it the first time the path is seen
+// and again after it was unloaded
+uint32_t textureLoaderRequest(TextureLoader* loader, const char* path);
+
+// Hands queued textures to the workers, as many as the limits allow, and
+// then wanted encodes. Without workers one texture is decoded on the calling
+// thread and nothing is encoded.
+void textureLoaderDecode(TextureLoader* loader);
+
+// Starts the GPU half: decoded textures get images and uploads from now on.
+// textureCompressionBC tells whether the device was created with the feature.
+void textureLoaderAttach(TextureLoader* loader, GpuAllocator* allocator, VkPhysicalDevice physicalDevice,
+                         bool textureCompressionBC, UploadContext* upload, TextureTable* table);
+
+// Once per frame before the frame's materials are written: adds the textures
+// mipped by earlier frames to the table, queues uploads of decoded ones and
+// keeps the decoders and encoders busy. Returns true when a texture became READY.
+bool textureLoaderUpdate(TextureLoader* loader);
+
+// Records the mip chains of uploaded textures after uploadAcquire, outside
+// any render pass, within TEXTURE_LOADER_MIP_BUDGET; uploaded compressed
+// chains only change layout
+void textureLoaderRecord(TextureLoader* loader, VkCommandBuffer commandBuffer);
+
+// Table slot of a READY texture
+bool textureLoaderSlot(const TextureLoader* loader, uint32_t texture, uint32_t* slot);
+
+// Takes a READY texture out of the table. Materials must stop sampling its
+// slot from the next frame on; the table destroys the image and recycles the
+// slot once the frame timeline reaches retireValue. Returns false, leaving
+// the texture as it is, when it isn't READY or its encode hasn't been
+// counted yet.
+bool textureLoaderUnload(TextureLoader* loader, uint32_t texture, uint64_t retireValue);
+
+const char* textureCompressionName(TextureCompression compression);
+
+#endif
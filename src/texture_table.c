@@ -0,0 +1,350 @@
+#include "texture_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint32_t minimum(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+// Largest array the device lets one stage sample; a combined image sampler
+// counts against both the sampler and the sampled image limits
+static uint32_t chooseCapacity(VkPhysicalDevice physicalDevice, bool bindless, bool dynamicIndexing) {
+    VkPhysicalDeviceVulkan12Properties properties12 = {0};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties = {0};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    if (bindless) {
+        uint32_t capacity = minimum(TEXTURE_TABLE_BINDLESS_CAPACITY,
+                                    properties12.maxPerStageDescriptorUpdateAfterBindSamplers);
+        capacity = minimum(capacity, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages);
+        capacity = minimum(capacity, properties12.maxDescriptorSetUpdateAfterBindSamplers);
+        return minimum(capacity, properties12.maxDescriptorSetUpdateAfterBindSampledImages);
+    }
+
+    // Without dynamic indexing the shader may only read a constant element
+    const VkPhysicalDeviceLimits* limits = &properties.properties.limits;
+    uint32_t capacity = dynamicIndexing ? TEXTURE_TABLE_FALLBACK_CAPACITY : 1;
+    capacity = minimum(capacity, limits->maxPerStageDescriptorSamplers);
+    return minimum(capacity, limits->maxPerStageDescriptorSampledImages);
+}
+
+static VkDescriptorImageInfo slotImageInfo(const TextureTable* table, uint32_t slot) {
+    const TextureSlot* entry = &table->slots[table->slots[slot].used ? slot : TEXTURE_TABLE_DEFAULT_SLOT];
+    VkDescriptorImageInfo imageInfo = {0};
+    imageInfo.sampler = table->sampler;
+    imageInfo.imageView = entry->view;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    return imageInfo;
+}
+
+// Points one element of the bindless set at the slot's texture
+static void writeSlot(TextureTable* table, uint32_t slot) {
+    VkDescriptorImageInfo imageInfo = slotImageInfo(table, slot);
+    VkWriteDescriptorSet write = {0};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = table->sets[0];
+    write.dstBinding = 0;
+    write.dstArrayElement = slot;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(table->device, 1, &write, 0, NULL);
+}
+
+// Rewrites every element of a fallback set; empty slots show the default texture
+static void writeSet(TextureTable* table, VkDescriptorSet set) {
+    VkDescriptorImageInfo* imageInfos = malloc(table->capacity * sizeof(VkDescriptorImageInfo));
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        imageInfos[i] = slotImageInfo(table, i);
+    }
+
+    VkWriteDescriptorSet write = {0};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = 0;
+    write.descriptorCount = table->capacity;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = imageInfos;
+    vkUpdateDescriptorSets(table->device, 1, &write, 0, NULL);
+    free(imageInfos);
+}
+
+static void createDescriptors(TextureTable* table) {
+    // Update-after-bind lets slots change while other slots are in use;
+    // partially bound lets the slots nothing was loaded into stay empty
+    VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+                                            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {0};
+    flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flagsInfo.bindingCount = 1;
+    flagsInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutBinding binding = {0};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = table->capacity;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = table->bindless ? &flagsInfo : NULL;
+    layoutInfo.flags = table->bindless ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+
+    if (vkCreateDescriptorSetLayout(table->device, &layoutInfo, NULL, &table->setLayout) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create texture table layout!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t setCount = table->bindless ? 1 : table->frameCount;
+    VkDescriptorPoolSize poolSize = {0};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = table->capacity * setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {0};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = table->bindless ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
+    poolInfo.maxSets = setCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    if (vkCreateDescriptorPool(table->device, &poolInfo, NULL, &table->descriptorPool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create texture table pool!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkDescriptorSetLayout layouts[TEXTURE_TABLE_MAX_FRAMES];
+    for (uint32_t i = 0; i < setCount; i++) {
+        layouts[i] = table->setLayout;
+    }
+    VkDescriptorSetAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = table->descriptorPool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts;
+
+    if (vkAllocateDescriptorSets(table->device, &allocInfo, table->sets) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate texture table sets!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// 1x1 white image for materials without a texture, cleared with a one-off
+// submission since nothing else uses the queue yet
+static void createDefaultTexture(TextureTable* table, VkQueue queue, uint32_t queueFamily) {
+    TextureSlot* slot = &table->slots[TEXTURE_TABLE_DEFAULT_SLOT];
+
+    VkImageCreateInfo imageInfo = {0};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent.width = 1;
+    imageInfo.extent.height = 1;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    gpuCreateImage(table->allocator, &imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &slot->image, &slot->allocation);
+
+    VkImageViewCreateInfo viewInfo = {0};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = slot->image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = imageInfo.format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(table->device, &viewInfo, NULL, &slot->view) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create default texture view!\n");
+        exit(EXIT_FAILURE);
+    }
+    slot->used = true;
+
+    VkCommandPoolCreateInfo poolInfo = {0};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+    VkCommandPool pool;
+    if (vkCreateCommandPool(table->device, &poolInfo, NULL, &pool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create default texture command pool!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(table->device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate default texture command buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {0};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    VkImageMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = slot->image;
+    barrier.subresourceRange = viewInfo.subresourceRange;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, NULL, 0, NULL, 1, &barrier);
+
+    VkClearColorValue white = {{1.0f, 1.0f, 1.0f, 1.0f}};
+    vkCmdClearColorImage(commandBuffer, slot->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &white, 1,
+                         &viewInfo.subresourceRange);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, NULL, 0, NULL, 1, &barrier);
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = {0};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to clear the default texture!\n");
+        exit(EXIT_FAILURE);
+    }
+    vkQueueWaitIdle(queue);
+    vkDestroyCommandPool(table->device, pool, NULL);
+}
+
+void textureTableInit(TextureTable* table, GpuAllocator* allocator, VkPhysicalDevice physicalDevice, VkQueue queue,
+                      uint32_t queueFamily, bool bindless, bool dynamicIndexing, uint32_t frameCount) {
+    memset(table, 0, sizeof(*table));
+    table->device = allocator->device;
+    table->allocator = allocator;
+    table->bindless = bindless;
+    table->capacity = chooseCapacity(physicalDevice, bindless, dynamicIndexing);
+    table->frameCount = frameCount < TEXTURE_TABLE_MAX_FRAMES ? frameCount : TEXTURE_TABLE_MAX_FRAMES;
+
+    VkSamplerCreateInfo samplerInfo = {0};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(table->device, &samplerInfo, NULL, &table->sampler) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create texture sampler!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    createDescriptors(table);
+
+    // Slot 0 is the default texture; the rest are handed out lowest first
+    table->slots = calloc(table->capacity, sizeof(TextureSlot));
+    slotAllocatorInit(&table->slotAllocator, table->capacity, TEXTURE_TABLE_DEFAULT_SLOT + 1);
+    createDefaultTexture(table, queue, queueFamily);
+
+    // Fallback sets are all written on their first frame
+    table->version = 1;
+    if (bindless) {
+        writeSlot(table, TEXTURE_TABLE_DEFAULT_SLOT);
+    }
+}
+
+void textureTableShutdown(TextureTable* table) {
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        TextureSlot* slot = &table->slots[i];
+        if (slot->image != VK_NULL_HANDLE) {
+            vkDestroyImageView(table->device, slot->view, NULL);
+            gpuDestroyImage(table->allocator, slot->image, &slot->allocation);
+        }
+    }
+    vkDestroyDescriptorPool(table->device, table->descriptorPool, NULL);
+    vkDestroyDescriptorSetLayout(table->device, table->setLayout, NULL);
+    vkDestroySampler(table->device, table->sampler, NULL);
+    free(table->slots);
+    slotAllocatorShutdown(&table->slotAllocator);
+    memset(table, 0, sizeof(*table));
+}
+
+bool textureTableAdd(TextureTable* table, VkImage image, VkImageView view, const GpuAllocation* allocation,
+                     uint32_t* slot) {
+    // A free slot is unused by every frame still in flight, so even the
+    // bindless set may be written right away
+    uint32_t index;
+    if (!slotAllocatorTake(&table->slotAllocator, &index)) {
+        return false;
+    }
+    TextureSlot* entry = &table->slots[index];
+    entry->image = image;
+    entry->view = view;
+    entry->allocation = *allocation;
+    entry->used = true;
+    table->version++;
+    if (table->bindless) {
+        writeSlot(table, index);
+    }
+
+    *slot = index;
+    return true;
+}
+
+void textureTableRemove(TextureTable* table, uint32_t slot, uint64_t retireValue) {
+    if (slot == TEXTURE_TABLE_DEFAULT_SLOT || slot >= table->capacity || !table->slots[slot].used) {
+        return;
+    }
+
+    // Fallback sets point the slot at the default texture when next
+    // rewritten; the bindless element is left alone until the slot is recycled
+    table->slots[slot].used = false;
+    table->version++;
+    slotAllocatorRetire(&table->slotAllocator, slot, retireValue);
+}
+
+VkDescriptorSet textureTableBeginFrame(TextureTable* table, uint32_t frameSlot, uint64_t completedValue) {
+    uint32_t recycled;
+    while (slotAllocatorReclaim(&table->slotAllocator, completedValue, &recycled)) {
+        TextureSlot* slot = &table->slots[recycled];
+        vkDestroyImageView(table->device, slot->view, NULL);
+        gpuDestroyImage(table->allocator, slot->image, &slot->allocation);
+        memset(slot, 0, sizeof(*slot));
+
+        // No pending frame reads the element any more; point it at the
+        // default texture rather than leave it naming a destroyed view
+        if (table->bindless) {
+            writeSlot(table, recycled);
+        }
+    }
+
+    if (table->bindless) {
+        return table->sets[0];
+    }
+
+    // The frame slot's previous frame has finished, so its set is free to rewrite
+    frameSlot %= table->frameCount;
+    if (table->setVersions[frameSlot] != table->version) {
+        writeSet(table, table->sets[frameSlot]);
+        table->setVersions[frameSlot] = table->version;
+    }
+    return table->sets[frameSlot];
+}
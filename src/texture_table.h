@@ -0,0 +1,81 @@
+#ifndef SCOP_TEXTURE_TABLE_H
+#define SCOP_TEXTURE_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <vulkan/vulkan.h>
+
+#include "gpu_allocator.h"
+#include "slot_allocator.h"
+
+// Frame slots the fallback keeps a descriptor set for
+#define TEXTURE_TABLE_MAX_FRAMES 4
+
+// Slots of the bindless array, lowered to the device's update-after-bind limits
+#define TEXTURE_TABLE_BINDLESS_CAPACITY 4096
+
+// Slots of the fallback array; 16 sampled images per stage are guaranteed
+#define TEXTURE_TABLE_FALLBACK_CAPACITY 16
+
+// Slot of the 1x1 white texture, sampled by materials without one and never removed
+#define TEXTURE_TABLE_DEFAULT_SLOT 0
+
+typedef struct {
+    VkImage image;
+    VkImageView view;
+    GpuAllocation allocation;
+    bool used;
+} TextureSlot;
+
+// Every texture the scene samples, in one array of combined image samplers
+// at set 1, binding 0 of shader.frag; materials pick theirs by slot, so any
+// number of materials draws with one descriptor bind.
+//
+// With descriptor indexing the array is one update-after-bind, partially
+// bound set: slots are written the moment a texture is added, even while
+// frames using other slots are in flight. Without it the array is small and
+// every slot must hold a valid image, so each frame slot has its own set,
+// filled with the default texture where nothing is loaded and rewritten
+// when the frame slot comes around after the table changed.
+typedef struct {
+    VkDevice device;
+    GpuAllocator* allocator;
+    bool bindless;
+    uint32_t capacity;              // size of the array, specialization constant 2 of shader.frag
+    uint32_t frameCount;
+    VkSampler sampler;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet sets[TEXTURE_TABLE_MAX_FRAMES];     // only the first when bindless
+    uint64_t setVersions[TEXTURE_TABLE_MAX_FRAMES];     // version each fallback set was written at
+    uint64_t version;               // bumped by every add and remove
+    TextureSlot* slots;
+    SlotAllocator slotAllocator;    // slots to hand out, removed ones once no frame samples them
+} TextureTable;
+
+// Creates the sampler, the set layout and sets, and the default texture,
+// cleared to white on the queue before returning. dynamicIndexing is
+// whether shaderSampledImageArrayDynamicIndexing is enabled; without it the
+// fallback array has the default slot only.
+void textureTableInit(TextureTable* table, GpuAllocator* allocator, VkPhysicalDevice physicalDevice, VkQueue queue,
+                      uint32_t queueFamily, bool bindless, bool dynamicIndexing, uint32_t frameCount);
+
+// Destroys every texture; the device must be idle
+void textureTableShutdown(TextureTable* table);
+
+// Takes ownership of the image and view, which must be in
+// SHADER_READ_ONLY_OPTIMAL before a frame samples them, and stores the slot
+// materials refer to them by. Returns false when the table is full.
+bool textureTableAdd(TextureTable* table, VkImage image, VkImageView view, const GpuAllocation* allocation,
+                     uint32_t* slot);
+
+// Unloads the texture of the slot. Materials must stop using the slot from
+// the next frame on; the image is destroyed and the slot recycled once the
+// frame timeline reaches retireValue, the last frame that may sample it.
+void textureTableRemove(TextureTable* table, uint32_t slot, uint64_t retireValue);
+
+// Recycles the slots retired at or before completedValue and returns the set
+// the frame slot binds, rewritten first if the table changed since its last use
+VkDescriptorSet textureTableBeginFrame(TextureTable* table, uint32_t frameSlot, uint64_t completedValue);
+
+#endif
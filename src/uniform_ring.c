@@ -0,0 +1,68 @@
+#include "uniform_ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void uniformRingInit(UniformRing* ring, GpuAllocator* allocator, VkPhysicalDevice physicalDevice,
+                     VkDeviceSize frameSize, uint32_t allocationCount, uint32_t frameCount) {
+    memset(ring, 0, sizeof(*ring));
+    ring->allocator = allocator;
+    ring->frameCount = frameCount < UNIFORM_RING_MAX_FRAMES ? frameCount : UNIFORM_RING_MAX_FRAMES;
+
+    // Dynamic offsets of either descriptor type must meet their own limit;
+    // both are powers of two, so the larger is a multiple of the smaller
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+    if (properties.limits.minStorageBufferOffsetAlignment > alignment) {
+        alignment = properties.limits.minStorageBufferOffsetAlignment;
+    }
+    ring->alignment = alignment;
+    ring->regionSize = (frameSize + allocationCount * (alignment - 1) + alignment - 1) & ~(alignment - 1);
+
+    VkBufferCreateInfo bufferInfo = {0};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = ring->regionSize * ring->frameCount;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(allocator->device, &bufferInfo, NULL, &ring->buffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create uniform ring buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The GPU reads every byte once per frame; device-local host-visible
+    // memory saves those reads a trip over the bus where it exists
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(allocator->device, ring->buffer, &requirements);
+    if (!gpuAllocate(allocator, &requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &ring->allocation)) {
+        fprintf(stderr, "Failed to allocate uniform ring memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    vkBindBufferMemory(allocator->device, ring->buffer, ring->allocation.memory, ring->allocation.offset);
+}
+
+void uniformRingShutdown(UniformRing* ring) {
+    gpuDestroyBuffer(ring->allocator, ring->buffer, &ring->allocation);
+    memset(ring, 0, sizeof(*ring));
+}
+
+void uniformRingBeginFrame(UniformRing* ring, uint32_t slot) {
+    ring->slot = slot;
+    ring->used = 0;
+}
+
+void* uniformRingAllocate(UniformRing* ring, VkDeviceSize size, uint32_t* offset) {
+    VkDeviceSize start = (ring->used + ring->alignment - 1) & ~(ring->alignment - 1);
+    if (start + size > ring->regionSize) {
+        fprintf(stderr, "Uniform ring region of %llu bytes is full!\n", (unsigned long long)ring->regionSize);
+        exit(EXIT_FAILURE);
+    }
+    ring->used = start + size;
+
+    VkDeviceSize bufferOffset = ring->slot * ring->regionSize + start;
+    *offset = (uint32_t)bufferOffset;
+    return (uint8_t*)ring->allocation.mapped + bufferOffset;
+}
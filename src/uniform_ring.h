@@ -0,0 +1,44 @@
+#ifndef SCOP_UNIFORM_RING_H
+#define SCOP_UNIFORM_RING_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "gpu_allocator.h"
+
+// Frame slots the ring keeps a region for
+#define UNIFORM_RING_MAX_FRAMES 4
+
+// Per-frame shader data: one host-visible buffer, mapped for its whole life
+// and split into a region per frame slot. A frame bump-allocates what it
+// writes from its slot's region and binds it through dynamic offsets into
+// descriptors written once, so updating it never allocates, maps or writes a
+// descriptor. A region is only reused once the slot's previous frame has
+// finished, which the frame scheduler already waits for.
+typedef struct {
+    GpuAllocator* allocator;
+    VkBuffer buffer;
+    GpuAllocation allocation;       // host-coherent, device-local when the device has such memory
+    VkDeviceSize alignment;         // every offset handed out is a multiple of this
+    VkDeviceSize regionSize;        // bytes per frame slot, a multiple of alignment
+    uint32_t frameCount;
+    uint32_t slot;                  // region being filled
+    VkDeviceSize used;              // bytes of it handed out so far
+} UniformRing;
+
+// Sizes every region for frameSize bytes split over up to allocationCount
+// allocations, each of which may need padding to the alignment. The buffer
+// can back both uniform and storage buffer descriptors.
+void uniformRingInit(UniformRing* ring, GpuAllocator* allocator, VkPhysicalDevice physicalDevice,
+                     VkDeviceSize frameSize, uint32_t allocationCount, uint32_t frameCount);
+void uniformRingShutdown(UniformRing* ring);
+
+// Starts filling the slot's region; its previous frame must be complete
+void uniformRingBeginFrame(UniformRing* ring, uint32_t slot);
+
+// Hands out size bytes of the current region: returns where to write them
+// and stores the dynamic offset to bind them at. Exits when the region is
+// full, which means frameSize was too small.
+void* uniformRingAllocate(UniformRing* ring, VkDeviceSize size, uint32_t* offset);
+
+#endif
@@ -0,0 +1,431 @@
+#include "upload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keeps every staging offset valid for buffer and image copies alike
+#define UPLOAD_ALIGNMENT 16
+
+static inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void uploadInit(UploadContext* upload, GpuAllocator* allocator, VkDevice device, uint32_t queueFamily,
+                uint32_t graphicsFamily) {
+    memset(upload, 0, sizeof(*upload));
+    upload->device = device;
+    upload->allocator = allocator;
+    upload->queueFamily = queueFamily;
+    upload->graphicsFamily = graphicsFamily;
+    upload->nextTicket = 1;
+    vkGetDeviceQueue(device, queueFamily, 0, &upload->queue);
+
+    VkCommandPoolCreateInfo poolInfo = {0};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+
+    if (vkCreateCommandPool(device, &poolInfo, NULL, &upload->commandPool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create upload command pool!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Host-visible blocks are mapped once by the allocator, so the ring stays mapped
+    gpuCreateBuffer(allocator, UPLOAD_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    &upload->stagingBuffer, &upload->stagingAllocation);
+    upload->stagingData = upload->stagingAllocation.mapped;
+    if (!upload->stagingData) {
+        fprintf(stderr, "Failed to map staging ring memory!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = upload->commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {0};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo = {0};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    for (uint32_t i = 0; i < UPLOAD_MAX_BATCHES; i++) {
+        UploadBatch* batch = &upload->batches[i];
+        if (vkAllocateCommandBuffers(device, &allocInfo, &batch->commandBuffer) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, NULL, &batch->semaphore) != VK_SUCCESS ||
+            vkCreateFence(device, &fenceInfo, NULL, &batch->fence) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create upload batch objects!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    upload->requestCapacity = 16;
+    upload->requests = malloc(upload->requestCapacity * sizeof(UploadRequest));
+}
+
+void uploadShutdown(UploadContext* upload) {
+    if (upload->queue != VK_NULL_HANDLE) {
+        vkQueueWaitIdle(upload->queue);
+    }
+
+    for (uint32_t i = 0; i < UPLOAD_MAX_BATCHES; i++) {
+        vkDestroySemaphore(upload->device, upload->batches[i].semaphore, NULL);
+        vkDestroyFence(upload->device, upload->batches[i].fence, NULL);
+        free(upload->batches[i].acquires);
+        free(upload->batches[i].imageAcquires);
+    }
+
+    vkDestroyCommandPool(upload->device, upload->commandPool, NULL);
+    gpuDestroyBuffer(upload->allocator, upload->stagingBuffer, &upload->stagingAllocation);
+    free(upload->requests);
+    memset(upload, 0, sizeof(*upload));
+}
+
+static UploadRequest* pushRequest(UploadContext* upload) {
+    if (upload->requestFirst + upload->requestCount == upload->requestCapacity) {
+        if (upload->requestFirst > 0) {
+            memmove(upload->requests, upload->requests + upload->requestFirst, upload->requestCount * sizeof(UploadRequest));
+            upload->requestFirst = 0;
+        } else {
+            upload->requestCapacity *= 2;
+            upload->requests = realloc(upload->requests, upload->requestCapacity * sizeof(UploadRequest));
+        }
+    }
+
+    UploadRequest* request = &upload->requests[upload->requestFirst + upload->requestCount++];
+    memset(request, 0, sizeof(*request));
+    request->ticket = upload->nextTicket++;
+    return request;
+}
+
+uint64_t uploadBuffer(UploadContext* upload, VkBuffer buffer, VkDeviceSize offset, const void* data,
+                      VkDeviceSize size, VkAccessFlags dstAccess) {
+    UploadRequest* request = pushRequest(upload);
+    request->buffer = buffer;
+    request->offset = offset;
+    request->data = data;
+    request->size = size;
+    request->dstAccess = dstAccess;
+    return request->ticket;
+}
+
+// Block edge and bytes per block of the formats images are uploaded in
+static void formatBlock(VkFormat format, uint32_t* blockSize, uint32_t* blockBytes) {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        *blockSize = 1;
+        *blockBytes = 4;
+        break;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        *blockSize = 4;
+        *blockBytes = 8;
+        break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        *blockSize = 4;
+        *blockBytes = 16;
+        break;
+    default:
+        fprintf(stderr, "Failed to upload image: unsupported format %d!\n", (int)format);
+        exit(EXIT_FAILURE);
+    }
+}
+
+uint64_t uploadImage(UploadContext* upload, VkImage image, VkFormat format, uint32_t width, uint32_t height,
+                     uint32_t levelCount, uint32_t mipLevels, const void* data, VkAccessFlags dstAccess) {
+    uint32_t blockSize, blockBytes;
+    formatBlock(format, &blockSize, &blockBytes);
+
+    // One request per level; they are served in order, so level 0 moves the
+    // image out of UNDEFINED first and the last one hands it over
+    const uint8_t* levelData = data;
+    uint64_t ticket = 0;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        UploadRequest* request = pushRequest(upload);
+        request->image = image;
+        request->level = level;
+        request->width = width >> level ? width >> level : 1;
+        request->height = height >> level ? height >> level : 1;
+        request->blockSize = blockSize;
+        request->rowSize = (request->width + blockSize - 1) / blockSize * blockBytes;
+        request->mipLevels = mipLevels;
+        request->lastLevel = level == levelCount - 1;
+        request->data = levelData;
+        request->size = (VkDeviceSize)request->rowSize * ((request->height + blockSize - 1) / blockSize);
+        request->dstAccess = dstAccess;
+        levelData += request->size;
+        ticket = request->ticket;
+    }
+    return ticket;
+}
+
+// Hands out up to wanted contiguous bytes of the ring, a multiple of granule;
+// 0 when it is full
+static VkDeviceSize ringAllocate(UploadContext* upload, VkDeviceSize wanted, VkDeviceSize granule,
+                                 VkDeviceSize* offset) {
+    VkDeviceSize available = UPLOAD_STAGING_SIZE - (upload->head - upload->tail);
+    VkDeviceSize position = upload->head % UPLOAD_STAGING_SIZE;
+    VkDeviceSize untilEnd = UPLOAD_STAGING_SIZE - position;
+
+    // Skip the tail end of the ring when more room is waiting at the start
+    if (wanted > untilEnd && available > 2 * untilEnd) {
+        upload->head += untilEnd;
+        available -= untilEnd;
+        position = 0;
+        untilEnd = UPLOAD_STAGING_SIZE;
+    }
+
+    VkDeviceSize granted = wanted;
+    if (granted > available) granted = available;
+    if (granted > untilEnd) granted = untilEnd;
+    granted -= granted % granule;
+
+    *offset = position;
+    upload->head += alignUp(granted, UPLOAD_ALIGNMENT);
+    return granted;
+}
+
+static void retireBatches(UploadContext* upload) {
+    // A batch is recycled once the GPU is done with its staging range and the
+    // graphics queue has consumed its semaphore
+    while (upload->batchCount > 0) {
+        UploadBatch* batch = &upload->batches[upload->batchFirst];
+        if (!batch->handedOff || vkGetFenceStatus(upload->device, batch->fence) != VK_SUCCESS) {
+            break;
+        }
+        upload->tail = batch->ringEnd;
+        upload->batchFirst = (upload->batchFirst + 1) % UPLOAD_MAX_BATCHES;
+        upload->batchCount--;
+    }
+}
+
+static VkImageMemoryBarrier imageBarrier(const UploadRequest* request) {
+    VkImageMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = request->image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = request->mipLevels;
+    barrier.subresourceRange.layerCount = 1;
+    return barrier;
+}
+
+// The whole image moves to the graphics queue once the last row of its last level is copied
+static void addImageOwnershipTransfer(UploadContext* upload, UploadBatch* batch, const UploadRequest* request) {
+    if (batch->imageAcquireCount == batch->imageAcquireCapacity) {
+        batch->imageAcquireCapacity = batch->imageAcquireCapacity ? batch->imageAcquireCapacity * 2 : 16;
+        batch->imageAcquires = realloc(batch->imageAcquires, batch->imageAcquireCapacity * sizeof(VkImageMemoryBarrier));
+    }
+
+    VkImageMemoryBarrier* barrier = &batch->imageAcquires[batch->imageAcquireCount++];
+    *barrier = imageBarrier(request);
+    barrier->srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier->dstAccessMask = request->dstAccess;
+    barrier->oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier->newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier->srcQueueFamilyIndex = upload->queueFamily;
+    barrier->dstQueueFamilyIndex = upload->graphicsFamily;
+}
+
+// Copies granted bytes of the request, whole block rows for an image, from the ring
+static void recordCopy(UploadContext* upload, UploadBatch* batch, const UploadRequest* request,
+                       VkDeviceSize stagingOffset, VkDeviceSize granted) {
+    if (request->image == VK_NULL_HANDLE) {
+        VkBufferCopy region = {0};
+        region.srcOffset = stagingOffset;
+        region.dstOffset = request->offset + request->copied;
+        region.size = granted;
+        vkCmdCopyBuffer(batch->commandBuffer, upload->stagingBuffer, request->buffer, 1, &region);
+        return;
+    }
+
+    // Every level leaves UNDEFINED before the first rows land
+    if (request->level == 0 && request->copied == 0) {
+        VkImageMemoryBarrier barrier = imageBarrier(request);
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, NULL, 0, NULL, 1, &barrier);
+    }
+
+    // The last block row may reach past the level's edge; the copy stops there
+    uint32_t firstRow = (uint32_t)(request->copied / request->rowSize) * request->blockSize;
+    uint32_t rows = (uint32_t)(granted / request->rowSize) * request->blockSize;
+    VkBufferImageCopy region = {0};
+    region.bufferOffset = stagingOffset;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = request->level;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset.y = (int32_t)firstRow;
+    region.imageExtent.width = request->width;
+    region.imageExtent.height = firstRow + rows < request->height ? rows : request->height - firstRow;
+    region.imageExtent.depth = 1;
+    vkCmdCopyBufferToImage(batch->commandBuffer, upload->stagingBuffer, request->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+static void addOwnershipTransfer(UploadContext* upload, UploadBatch* batch, const UploadRequest* request,
+                                 VkDeviceSize size) {
+    if (batch->acquireCount == batch->acquireCapacity) {
+        batch->acquireCapacity = batch->acquireCapacity ? batch->acquireCapacity * 2 : 16;
+        batch->acquires = realloc(batch->acquires, batch->acquireCapacity * sizeof(VkBufferMemoryBarrier));
+    }
+
+    // Release and acquire must describe the same range; each side ignores the
+    // other side's access mask
+    VkBufferMemoryBarrier* barrier = &batch->acquires[batch->acquireCount++];
+    memset(barrier, 0, sizeof(*barrier));
+    barrier->sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier->srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier->dstAccessMask = request->dstAccess;
+    barrier->srcQueueFamilyIndex = upload->queueFamily;
+    barrier->dstQueueFamilyIndex = upload->graphicsFamily;
+    barrier->buffer = request->buffer;
+    barrier->offset = request->offset + request->copied;
+    barrier->size = size;
+}
+
+void uploadFlush(UploadContext* upload) {
+    retireBatches(upload);
+
+    if (upload->requestCount == 0 || upload->batchCount == UPLOAD_MAX_BATCHES ||
+        upload->head - upload->tail == UPLOAD_STAGING_SIZE) {
+        return;
+    }
+
+    UploadBatch* batch = &upload->batches[(upload->batchFirst + upload->batchCount) % UPLOAD_MAX_BATCHES];
+    batch->acquireCount = 0;
+    batch->imageAcquireCount = 0;
+    batch->lastTicket = 0;
+    batch->handedOff = false;
+
+    VkCommandBufferBeginInfo beginInfo = {0};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkResetCommandBuffer(batch->commandBuffer, 0);
+    if (vkBeginCommandBuffer(batch->commandBuffer, &beginInfo) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to begin upload command buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bool transferOwnership = upload->queueFamily != upload->graphicsFamily;
+    VkDeviceSize budget = UPLOAD_FLUSH_BUDGET;
+    VkDeviceSize recorded = 0;
+
+    // Requests are served in order so tickets complete in order
+    while (upload->requestCount > 0 && budget > 0) {
+        // Images are copied a whole number of block rows at a time
+        UploadRequest* request = &upload->requests[upload->requestFirst];
+        VkDeviceSize granule = request->image != VK_NULL_HANDLE ? request->rowSize : 1;
+        VkDeviceSize wanted = request->size - request->copied;
+        if (wanted > budget) {
+            wanted = budget - budget % granule;
+            if (wanted == 0) {
+                break;
+            }
+        }
+
+        VkDeviceSize stagingOffset = 0;
+        VkDeviceSize granted = wanted ? ringAllocate(upload, wanted, granule, &stagingOffset) : 0;
+        if (wanted && !granted) {
+            break;
+        }
+
+        if (granted) {
+            memcpy(upload->stagingData + stagingOffset, request->data + request->copied, (size_t)granted);
+            recordCopy(upload, batch, request, stagingOffset, granted);
+
+            if (transferOwnership && request->image == VK_NULL_HANDLE) {
+                addOwnershipTransfer(upload, batch, request, granted);
+            }
+
+            request->copied += granted;
+            budget -= granted;
+            recorded += granted;
+        }
+
+        if (request->copied == request->size) {
+            if (transferOwnership && request->image != VK_NULL_HANDLE && request->lastLevel) {
+                addImageOwnershipTransfer(upload, batch, request);
+            }
+            batch->lastTicket = request->ticket;
+            upload->requestFirst++;
+            upload->requestCount--;
+        }
+    }
+
+    if (upload->requestCount == 0) {
+        upload->requestFirst = 0;
+    }
+
+    if (batch->acquireCount > 0 || batch->imageAcquireCount > 0) {
+        vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, NULL, batch->acquireCount, batch->acquires, batch->imageAcquireCount,
+                             batch->imageAcquires);
+    }
+
+    if (vkEndCommandBuffer(batch->commandBuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to record upload command buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (recorded == 0 && batch->lastTicket == 0) {
+        return;
+    }
+
+    VkSubmitInfo submitInfo = {0};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch->commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &batch->semaphore;
+
+    vkResetFences(upload->device, 1, &batch->fence);
+    if (vkQueueSubmit(upload->queue, 1, &submitInfo, batch->fence) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to submit upload batch!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    batch->ringEnd = upload->head;
+    upload->batchCount++;
+}
+
+uint32_t uploadAcquire(UploadContext* upload, VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStage,
+                       VkSemaphore* waitSemaphores) {
+    uint32_t waitCount = 0;
+
+    for (uint32_t i = 0; i < upload->batchCount; i++) {
+        UploadBatch* batch = &upload->batches[(upload->batchFirst + i) % UPLOAD_MAX_BATCHES];
+        if (batch->handedOff) {
+            continue;
+        }
+
+        if (batch->acquireCount > 0 || batch->imageAcquireCount > 0) {
+            vkCmdPipelineBarrier(commandBuffer, dstStage, dstStage, 0, 0, NULL, batch->acquireCount, batch->acquires,
+                                 batch->imageAcquireCount, batch->imageAcquires);
+        }
+
+        waitSemaphores[waitCount++] = batch->semaphore;
+        batch->handedOff = true;
+        if (batch->lastTicket > upload->readyTicket) {
+            upload->readyTicket = batch->lastTicket;
+        }
+    }
+
+    return waitCount;
+}
+
+bool uploadIsReady(const UploadContext* upload, uint64_t ticket) {
+    return ticket <= upload->readyTicket;
+}
@@ -0,0 +1,116 @@
+#ifndef SCOP_UPLOAD_H
+#define SCOP_UPLOAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <vulkan/vulkan.h>
+
+#include "gpu_allocator.h"
+
+// Persistently mapped staging ring shared by every upload
+#define UPLOAD_STAGING_SIZE (32u * 1024u * 1024u)
+
+// Bytes copied into the ring per uploadFlush, so one call never dominates a frame
+#define UPLOAD_FLUSH_BUDGET (UPLOAD_STAGING_SIZE / 2)
+
+// Submissions that may be in flight on the transfer queue at once
+#define UPLOAD_MAX_BATCHES 4
+
+// Pending buffer or image copy; data must stay valid until the upload is ready
+typedef struct {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkImage image;              // VK_NULL_HANDLE for a buffer copy
+    uint32_t level;             // mip level the image copy fills
+    uint32_t width;             // level extent in texels
+    uint32_t height;
+    uint32_t blockSize;         // texels per block edge, 1 when uncompressed
+    uint32_t rowSize;           // bytes per row of blocks
+    uint32_t mipLevels;         // image levels moved to TRANSFER_DST_OPTIMAL
+    bool lastLevel;             // the image changes queue family once this level is copied
+    const uint8_t* data;
+    VkDeviceSize size;
+    VkDeviceSize copied;
+    VkAccessFlags dstAccess;    // how the graphics queue will read the buffer or image
+    uint64_t ticket;
+} UploadRequest;
+
+// One submission on the transfer queue
+typedef struct {
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    VkSemaphore semaphore;              // waited on by the next graphics submit
+    VkDeviceSize ringEnd;               // ring head once this batch retires
+    uint64_t lastTicket;                // newest request fully copied by this batch
+    VkBufferMemoryBarrier* acquires;    // ownership acquires for the graphics queue
+    uint32_t acquireCount;
+    uint32_t acquireCapacity;
+    VkImageMemoryBarrier* imageAcquires;
+    uint32_t imageAcquireCount;
+    uint32_t imageAcquireCapacity;
+    bool handedOff;                     // semaphore consumed by a graphics submit
+} UploadBatch;
+
+// Streams buffer and image data to device-local memory on a transfer-only queue when
+// the device has one, otherwise on the graphics queue. Nothing here blocks:
+// uploadFlush copies what fits in the ring and the graphics side picks the
+// results up through uploadAcquire.
+typedef struct {
+    VkDevice device;
+    GpuAllocator* allocator;
+    VkQueue queue;
+    uint32_t queueFamily;
+    uint32_t graphicsFamily;
+    VkCommandPool commandPool;
+
+    VkBuffer stagingBuffer;
+    GpuAllocation stagingAllocation;
+    uint8_t* stagingData;
+    VkDeviceSize head;                  // ring write cursor, grows monotonically
+    VkDeviceSize tail;                  // oldest byte still read by the GPU
+
+    UploadRequest* requests;
+    uint32_t requestFirst;
+    uint32_t requestCount;
+    uint32_t requestCapacity;
+    uint64_t nextTicket;
+    uint64_t readyTicket;               // every ticket <= this is usable by graphics
+
+    UploadBatch batches[UPLOAD_MAX_BATCHES];
+    uint32_t batchFirst;                // oldest batch still in flight
+    uint32_t batchCount;
+} UploadContext;
+
+void uploadInit(UploadContext* upload, GpuAllocator* allocator, VkDevice device, uint32_t queueFamily,
+                uint32_t graphicsFamily);
+void uploadShutdown(UploadContext* upload);
+
+// Queues a copy into a buffer created with TRANSFER_DST usage and returns a
+// ticket for uploadIsReady
+uint64_t uploadBuffer(UploadContext* upload, VkBuffer buffer, VkDeviceSize offset, const void* data,
+                      VkDeviceSize size, VkAccessFlags dstAccess);
+
+// Queues copies into the first levelCount of mipLevels levels of an image
+// created with TRANSFER_DST usage. data holds the levels back to back, each
+// tightly packed in the format's texel blocks; RGBA8 and the BC1, BC3 and
+// BC7 formats are supported. Every level is left in TRANSFER_DST_OPTIMAL, so
+// the graphics queue can fill the rest by blits once the returned ticket is
+// ready; uploadAcquire's dstStage must include TRANSFER.
+uint64_t uploadImage(UploadContext* upload, VkImage image, VkFormat format, uint32_t width, uint32_t height,
+                     uint32_t levelCount, uint32_t mipLevels, const void* data, VkAccessFlags dstAccess);
+
+// Retires finished batches and submits one more with as much pending data as
+// the ring and the budget allow
+void uploadFlush(UploadContext* upload);
+
+// Called while recording a graphics command buffer, outside a render pass:
+// records ownership acquires for submitted batches and writes the semaphores
+// the submit must wait on at dstStage (at most UPLOAD_MAX_BATCHES). Returns
+// the number of semaphores written.
+uint32_t uploadAcquire(UploadContext* upload, VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStage,
+                       VkSemaphore* waitSemaphores);
+
+// True once the data of the ticket is visible to commands recorded after uploadAcquire
+bool uploadIsReady(const UploadContext* upload, uint64_t ticket);
+
+#endif
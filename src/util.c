@@ -0,0 +1,148 @@
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+double getTimeMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+// Sleeps shorter than the spin margin aren't worth handing to the scheduler
+#define SLEEP_SPIN_MS 1.0
+
+void sleepUntilMs(double deadlineMs) {
+    double sleepMs = deadlineMs - SLEEP_SPIN_MS;
+    if (sleepMs > getTimeMs()) {
+        struct timespec ts;
+        ts.tv_sec = (time_t)(sleepMs / 1000.0);
+        ts.tv_nsec = (long)((sleepMs - (double)ts.tv_sec * 1000.0) * 1e6);
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_nsec = 999999999L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+    }
+    while (getTimeMs() < deadlineMs) {
+    }
+}
+
+static bool makeDirectory(const char* path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+bool getCacheDirectory(char* path, size_t size) {
+    const char* xdgCache = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    int written;
+
+    if (xdgCache && xdgCache[0]) {
+        written = snprintf(path, size, "%s/scop", xdgCache);
+        if (written < 0 || (size_t)written >= size) {
+            return false;
+        }
+        makeDirectory(xdgCache);
+    } else if (home && home[0]) {
+        written = snprintf(path, size, "%s/.cache", home);
+        if (written < 0 || (size_t)written >= size || !makeDirectory(path)) {
+            return false;
+        }
+        written = snprintf(path, size, "%s/.cache/scop", home);
+        if (written < 0 || (size_t)written >= size) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    return makeDirectory(path);
+}
+
+static inline uint64_t readWord(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b) {
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    static const uint64_t k0 = 0xa0761d6478bd642full;
+    static const uint64_t k1 = 0xe7037ed1a0b428dbull;
+    static const uint64_t k2 = 0x8ebc6af09c88c6e3ull;
+    static const uint64_t k3 = 0x589965cc75374cc3ull;
+
+    const uint8_t* p = data;
+    size_t remaining = size;
+
+    // Four independent lanes keep the multipliers busy on large inputs. Each
+    // starts under a different key than the one it is mixed with, or a zero
+    // seed would zero the multiplier and drop the first block
+    uint64_t lanes[4] = {seed ^ k1, seed ^ k2, seed ^ k3, seed ^ k0};
+    while (remaining >= 32) {
+        lanes[0] = mix(readWord(p) ^ k1, lanes[0] ^ k0);
+        lanes[1] = mix(readWord(p + 8) ^ k2, lanes[1] ^ k1);
+        lanes[2] = mix(readWord(p + 16) ^ k3, lanes[2] ^ k2);
+        lanes[3] = mix(readWord(p + 24) ^ k0, lanes[3] ^ k3);
+        p += 32;
+        remaining -= 32;
+    }
+
+    uint64_t h = lanes[0] ^ mix(lanes[1], k1) ^ mix(lanes[2], k2) ^ mix(lanes[3], k3);
+    while (remaining >= 8) {
+        h = mix(readWord(p) ^ k1, h ^ k0);
+        p += 8;
+        remaining -= 8;
+    }
+
+    // An empty input may come with a NULL pointer, which memcpy must not see
+    uint64_t tail = 0;
+    if (remaining > 0) {
+        memcpy(&tail, p, remaining);
+    }
+    h = mix(tail ^ k2, h ^ k3);
+
+    return mix(h ^ (uint64_t)size, k1);
+}
+
+bool hashFile(const char* path, uint64_t* hash) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        *hash = hashBytes(NULL, 0, 0);
+        return true;
+    }
+
+    void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    *hash = hashBytes(data, size, 0);
+    munmap(data, size);
+    return true;
+}
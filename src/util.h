@@ -0,0 +1,25 @@
+#ifndef SCOP_UTIL_H
+#define SCOP_UTIL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Monotonic clock in milliseconds
+double getTimeMs(void);
+
+// Sleeps until deadlineMs on the getTimeMs clock. The OS sleep stops short
+// and the rest is spun, so scheduler wake-up jitter doesn't make it late.
+void sleepUntilMs(double deadlineMs);
+
+// Resolves the per-user cache directory ($XDG_CACHE_HOME/scop or
+// ~/.cache/scop), creating it when missing
+bool getCacheDirectory(char* path, size_t size);
+
+// Fast non-cryptographic 64-bit hash used for cache keys
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed);
+
+// hashBytes of a whole file, read through a mapping
+bool hashFile(const char* path, uint64_t* hash);
+
+#endif
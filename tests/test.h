@@ -0,0 +1,47 @@
+#ifndef SCOP_TEST_H
+#define SCOP_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+// Failed checks are counted and printed; a test program exits non-zero when
+// any failed, which is what ctest looks at
+static int testFailures = 0;
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            testFailures++;                                                               \
+        }                                                                                 \
+    } while (0)
+
+// Fresh directory for the files of one run, under $TMPDIR or /tmp
+static inline void testDirectory(char* path, size_t size) {
+    const char* temp = getenv("TMPDIR");
+    snprintf(path, size, "%s/scop-test-XXXXXX", temp && temp[0] ? temp : "/tmp");
+    if (!mkdtemp(path)) {
+        fprintf(stderr, "Failed to create a test directory!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static inline void testWriteFile(const char* path, const void* data, size_t size) {
+    FILE* file = fopen(path, "wb");
+    if (!file || fwrite(data, 1, size, file) != size || fclose(file) != 0) {
+        fprintf(stderr, "Failed to write %s!\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static inline int testResult(const char* name) {
+    if (testFailures > 0) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, testFailures);
+        return EXIT_FAILURE;
+    }
+    printf("%s: all checks passed\n", name);
+    return EXIT_SUCCESS;
+}
+
+#endif
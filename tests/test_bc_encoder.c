@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "../src/bc_encoder.h"
+#include "../src/image_loader.h"
+
+static void unpack565(uint16_t packed, int color[3]) {
+    int r = packed >> 11, g = (packed >> 5) & 0x3f, b = packed & 0x1f;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+static void decodeBc1(const uint8_t* block, uint8_t texels[16][4]) {
+    uint16_t packed0 = (uint16_t)(block[0] | block[1] << 8);
+    uint16_t packed1 = (uint16_t)(block[2] | block[3] << 8);
+    int palette[4][4];
+    unpack565(packed0, palette[0]);
+    unpack565(packed1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        if (packed0 > packed1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    for (int i = 0; i < 16; i++) {
+        int index = (block[4 + i / 4] >> (i % 4 * 2)) & 3;
+        for (int c = 0; c < 3; c++) {
+            texels[i][c] = (uint8_t)palette[index][c];
+        }
+        texels[i][3] = packed0 <= packed1 && index == 3 ? 0 : 255;
+    }
+}
+
+static void decodeBc4(const uint8_t* block, uint8_t texels[16][4]) {
+    int palette[8] = {block[0], block[1]};
+    for (int i = 2; i < 8; i++) {
+        if (block[0] > block[1]) {
+            palette[i] = ((8 - i) * block[0] + (i - 1) * block[1]) / 7;
+        } else if (i < 6) {
+            palette[i] = ((6 - i) * block[0] + (i - 1) * block[1]) / 5;
+        } else {
+            palette[i] = i == 6 ? 0 : 255;
+        }
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; i++) {
+        bits |= (uint64_t)block[2 + i] << (i * 8);
+    }
+    for (int i = 0; i < 16; i++) {
+        texels[i][3] = (uint8_t)palette[(bits >> (i * 3)) & 7];
+    }
+}
+
+static uint32_t readBits(const uint8_t* block, uint32_t* position, uint32_t count) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; i++, (*position)++) {
+        value |= (uint32_t)((block[*position / 8] >> (*position % 8)) & 1) << i;
+    }
+    return value;
+}
+
+// Mode 6 only, the one the encoder writes; any other mode decodes to magenta
+static void decodeBc7(const uint8_t* block, uint8_t texels[16][4]) {
+    static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+    uint32_t position = 0;
+    if (readBits(block, &position, 7) != 1u << 6) {
+        memset(texels, 0, 16 * 4);
+        for (int i = 0; i < 16; i++) {
+            texels[i][0] = texels[i][2] = 255;
+        }
+        return;
+    }
+    int endpoints[2][4];
+    for (int c = 0; c < 4; c++) {
+        endpoints[0][c] = (int)readBits(block, &position, 7) << 1;
+        endpoints[1][c] = (int)readBits(block, &position, 7) << 1;
+    }
+    uint32_t parity0 = readBits(block, &position, 1);
+    uint32_t parity1 = readBits(block, &position, 1);
+    for (int c = 0; c < 4; c++) {
+        endpoints[0][c] |= (int)parity0;
+        endpoints[1][c] |= (int)parity1;
+    }
+    for (int i = 0; i < 16; i++) {
+        int index = (int)readBits(block, &position, i == 0 ? 3 : 4);
+        for (int c = 0; c < 4; c++) {
+            texels[i][c] = (uint8_t)(((64 - weights[index]) * endpoints[0][c] + weights[index] * endpoints[1][c] + 32)
+                                     >> 6);
+        }
+    }
+}
+
+// Largest per-channel difference between the image and level 0 of its encoding
+static void levelError(const Image* image, const BcImage* encoded, int maxError[4]) {
+    memset(maxError, 0, 4 * sizeof(int));
+    uint32_t blocksX = (image->width + 3) / 4;
+    uint32_t blocksY = (image->height + 3) / 4;
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+            const uint8_t* block = encoded->data + (blockY * blocksX + blockX) * bcBlockBytes(encoded->format);
+            uint8_t texels[16][4];
+            if (encoded->format == BC_FORMAT_BC1) {
+                decodeBc1(block, texels);
+            } else if (encoded->format == BC_FORMAT_BC3) {
+                decodeBc1(block + 8, texels);
+                decodeBc4(block, texels);
+            } else {
+                decodeBc7(block, texels);
+            }
+
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = blockX * 4 + i % 4;
+                uint32_t y = blockY * 4 + i / 4;
+                if (x >= image->width || y >= image->height) {
+                    continue;
+                }
+                const uint8_t* source = image->pixels + ((size_t)y * image->width + x) * 4;
+                for (int c = 0; c < 4; c++) {
+                    int d = abs(texels[i][c] - source[c]);
+                    maxError[c] = d > maxError[c] ? d : maxError[c];
+                }
+            }
+        }
+    }
+}
+
+static void testBcRoundTrip(void) {
+    // A diagonal ramp, so every block's texels lie on a line through color
+    // space as the formats assume; 10x7 leaves partial blocks on both axes
+    Image image = {10, 7, malloc(10 * 7 * 4)};
+    for (uint32_t y = 0; y < image.height; y++) {
+        for (uint32_t x = 0; x < image.width; x++) {
+            uint32_t t = x * 18 + y * 7;
+            uint8_t* p = image.pixels + (y * image.width + x) * 4;
+            p[0] = (uint8_t)t;
+            p[1] = (uint8_t)(40 + t / 2);
+            p[2] = (uint8_t)(220 - t * 4 / 5);
+            p[3] = (uint8_t)(255 - t / 2);
+        }
+    }
+    CHECK(bcChooseFormat(&image) == BC_FORMAT_BC3);
+
+    // Tolerances sit a little above what the encoder reaches on this image
+    static const int tolerance[BC_FORMAT_COUNT][4] = {{16, 16, 16, 255}, {16, 16, 16, 6}, {6, 6, 6, 6}};
+    for (int format = 0; format < BC_FORMAT_COUNT; format++) {
+        BcImage encoded;
+        bcEncodeImage(&image, (BcFormat)format, &encoded);
+        CHECK(encoded.width == 10 && encoded.height == 7 && encoded.mipLevels == 4);
+        CHECK(encoded.size == bcLevelSize((BcFormat)format, 10, 7) + bcLevelSize((BcFormat)format, 5, 3) +
+                              bcLevelSize((BcFormat)format, 2, 1) + bcLevelSize((BcFormat)format, 1, 1));
+
+        int maxError[4];
+        levelError(&image, &encoded, maxError);
+        for (int c = 0; c < 4; c++) {
+            CHECK(maxError[c] <= tolerance[format][c]);
+        }
+        bcImageFree(&encoded);
+    }
+
+    // A flat opaque image is BC1, and every format reproduces it almost exactly
+    for (size_t i = 0; i < (size_t)image.width * image.height; i++) {
+        memcpy(image.pixels + i * 4, (const uint8_t[4]){80, 160, 240, 255}, 4);
+    }
+    CHECK(bcChooseFormat(&image) == BC_FORMAT_BC1);
+    for (int format = 0; format < BC_FORMAT_COUNT; format++) {
+        BcImage encoded;
+        bcEncodeImage(&image, (BcFormat)format, &encoded);
+        int maxError[4];
+        levelError(&image, &encoded, maxError);
+        for (int c = 0; c < 4; c++) {
+            CHECK(maxError[c] <= 4);
+        }
+        bcImageFree(&encoded);
+    }
+    imageFree(&image);
+}
+
+int main(void) {
+    testBcRoundTrip();
+    return testResult("test_bc_encoder");
+}
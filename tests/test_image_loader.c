@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "../src/image_loader.h"
+
+static void writeU16(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void writeU32(uint8_t* p, uint32_t value) {
+    writeU16(p, value);
+    writeU16(p + 2, value >> 16);
+}
+
+// Loads data written to a file of the test directory; the image is freed
+// by the caller when loading succeeded
+static bool loadBytes(const char* directory, const void* data, size_t size, Image* image) {
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/image", directory);
+    testWriteFile(path, data, size);
+    bool loaded = imageLoad(path, image);
+    unlink(path);
+    return loaded;
+}
+
+static bool pixelIs(const Image* image, uint32_t x, uint32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const uint8_t* p = image->pixels + ((size_t)y * image->width + x) * 4;
+    return p[0] == r && p[1] == g && p[2] == b && p[3] == a;
+}
+
+static void testTga(const char* directory) {
+    Image image;
+
+    // 2x2 BGR, bottom-up, with a 3-byte id field to skip
+    uint8_t plain[18 + 3 + 12] = {3, 0, 2};
+    writeU16(plain + 12, 2);
+    writeU16(plain + 14, 2);
+    plain[16] = 24;
+    static const uint8_t plainPixels[12] = {255, 0, 0, 0, 255, 0, 0, 0, 255, 10, 20, 30};
+    memcpy(plain + 21, plainPixels, sizeof(plainPixels));
+    CHECK(loadBytes(directory, plain, sizeof(plain), &image));
+    if (image.pixels) {
+        CHECK(image.width == 2 && image.height == 2);
+        CHECK(pixelIs(&image, 0, 1, 0, 0, 255, 255) && pixelIs(&image, 1, 1, 0, 255, 0, 255));
+        CHECK(pixelIs(&image, 0, 0, 255, 0, 0, 255) && pixelIs(&image, 1, 0, 30, 20, 10, 255));
+        imageFree(&image);
+    }
+
+    // One pixel short
+    CHECK(!loadBytes(directory, plain, sizeof(plain) - 1, &image));
+
+    // Empty and oversized extents
+    uint8_t sized[sizeof(plain)];
+    memcpy(sized, plain, sizeof(plain));
+    writeU16(sized + 12, 0);
+    CHECK(!loadBytes(directory, sized, sizeof(sized), &image));
+    writeU16(sized + 12, IMAGE_MAX_DIMENSION + 1);
+    CHECK(!loadBytes(directory, sized, sizeof(sized), &image));
+
+    // 3x1 RLE BGRA, top-down: a run of two, then a raw packet of one
+    uint8_t rle[18 + 5 + 5] = {0, 0, 10};
+    writeU16(rle + 12, 3);
+    writeU16(rle + 14, 1);
+    rle[16] = 32;
+    rle[17] = 0x28;
+    static const uint8_t packets[10] = {0x81, 1, 2, 3, 128, 0x00, 4, 5, 6, 7};
+    memcpy(rle + 18, packets, sizeof(packets));
+    CHECK(loadBytes(directory, rle, sizeof(rle), &image));
+    if (image.pixels) {
+        CHECK(pixelIs(&image, 0, 0, 3, 2, 1, 128) && pixelIs(&image, 1, 0, 3, 2, 1, 128));
+        CHECK(pixelIs(&image, 2, 0, 6, 5, 4, 7));
+        imageFree(&image);
+    }
+
+    // A run longer than the pixels left, and a packet cut off by the end of the file
+    uint8_t overrun[sizeof(rle)];
+    memcpy(overrun, rle, sizeof(rle));
+    overrun[18] = 0x83;
+    CHECK(!loadBytes(directory, overrun, sizeof(overrun), &image));
+    CHECK(!loadBytes(directory, rle, sizeof(rle) - 2, &image));
+}
+
+static void testPpm(const char* directory) {
+    Image image;
+
+    static const char binary[] = "P6\n# comment\n2 1\n255\n\x01\x02\x03\x04\x05\x06";
+    CHECK(loadBytes(directory, binary, sizeof(binary) - 1, &image));
+    if (image.pixels) {
+        CHECK(image.width == 2 && image.height == 1);
+        CHECK(pixelIs(&image, 0, 0, 1, 2, 3, 255) && pixelIs(&image, 1, 0, 4, 5, 6, 255));
+        imageFree(&image);
+    }
+    CHECK(!loadBytes(directory, binary, sizeof(binary) - 2, &image));
+
+    // Text samples are scaled by the maximum and clamped to it
+    static const char text[] = "P2 2 2 15\n0 15\n# mid\n30 5\n";
+    CHECK(loadBytes(directory, text, sizeof(text) - 1, &image));
+    if (image.pixels) {
+        CHECK(pixelIs(&image, 0, 0, 0, 0, 0, 255) && pixelIs(&image, 1, 0, 255, 255, 255, 255));
+        CHECK(pixelIs(&image, 0, 1, 255, 255, 255, 255) && pixelIs(&image, 1, 1, 85, 85, 85, 255));
+        imageFree(&image);
+    }
+    static const char shortText[] = "P3 1 1 255 1 2";
+    CHECK(!loadBytes(directory, shortText, sizeof(shortText) - 1, &image));
+
+    // Two-byte big-endian samples
+    static const char wide[] = "P5 1 1 65535\n\xff\xff";
+    CHECK(loadBytes(directory, wide, sizeof(wide) - 1, &image));
+    if (image.pixels) {
+        CHECK(pixelIs(&image, 0, 0, 255, 255, 255, 255));
+        imageFree(&image);
+    }
+    CHECK(!loadBytes(directory, wide, sizeof(wide) - 2, &image));
+
+    static const char zeroMax[] = "P5 1 1 0\n\x01";
+    static const char huge[] = "P5 20000 1 255\n\x01";
+    static const char overflow[] = "P5 99999999999 1 255\n\x01";
+    CHECK(!loadBytes(directory, zeroMax, sizeof(zeroMax) - 1, &image));
+    CHECK(!loadBytes(directory, huge, sizeof(huge) - 1, &image));
+    CHECK(!loadBytes(directory, overflow, sizeof(overflow) - 1, &image));
+}
+
+// BITMAPINFOHEADER file of the given layout; pixel data starts at 54 plus
+// the extra header bytes
+static void bmpHeader(uint8_t* data, uint32_t fileSize, uint32_t extra, int32_t width, int32_t height,
+                      uint32_t bitsPerPixel, uint32_t compression) {
+    memset(data, 0, 54);
+    data[0] = 'B';
+    data[1] = 'M';
+    writeU32(data + 2, fileSize);
+    writeU32(data + 10, 54 + extra);
+    writeU32(data + 14, 40);
+    writeU32(data + 18, (uint32_t)width);
+    writeU32(data + 22, (uint32_t)height);
+    writeU16(data + 26, 1);
+    writeU16(data + 28, bitsPerPixel);
+    writeU32(data + 30, compression);
+}
+
+static void testBmp(const char* directory) {
+    Image image;
+
+    // 3x2 BGR, bottom-up; rows of 9 bytes padded to 12
+    uint8_t rgb[54 + 24] = {0};
+    bmpHeader(rgb, sizeof(rgb), 0, 3, 2, 24, 0);
+    static const uint8_t bottom[9] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    static const uint8_t top[9] = {10, 11, 12, 13, 14, 15, 16, 17, 18};
+    memcpy(rgb + 54, bottom, sizeof(bottom));
+    memcpy(rgb + 66, top, sizeof(top));
+    CHECK(loadBytes(directory, rgb, sizeof(rgb), &image));
+    if (image.pixels) {
+        CHECK(image.width == 3 && image.height == 2);
+        CHECK(pixelIs(&image, 0, 0, 12, 11, 10, 255) && pixelIs(&image, 2, 0, 18, 17, 16, 255));
+        CHECK(pixelIs(&image, 0, 1, 3, 2, 1, 255) && pixelIs(&image, 2, 1, 9, 8, 7, 255));
+        imageFree(&image);
+    }
+
+    // The last row's padding is part of the row
+    CHECK(!loadBytes(directory, rgb, sizeof(rgb) - 1, &image));
+
+    uint8_t broken[sizeof(rgb)];
+    memcpy(broken, rgb, sizeof(rgb));
+    writeU32(broken + 10, sizeof(rgb) + 1);
+    CHECK(!loadBytes(directory, broken, sizeof(broken), &image));
+    bmpHeader(broken, sizeof(broken), 0, -3, 2, 24, 0);
+    CHECK(!loadBytes(directory, broken, sizeof(broken), &image));
+    bmpHeader(broken, sizeof(broken), 0, 3, 2, 24, 1);
+    CHECK(!loadBytes(directory, broken, sizeof(broken), &image));
+
+    // Wider than any device samples, with every byte of its row present
+    size_t wideSize = 54 + (((size_t)IMAGE_MAX_DIMENSION + 1) * 3 + 3) / 4 * 4;
+    uint8_t* wide = calloc(1, wideSize);
+    bmpHeader(wide, (uint32_t)wideSize, 0, IMAGE_MAX_DIMENSION + 1, 1, 24, 0);
+    CHECK(!loadBytes(directory, wide, wideSize, &image));
+    free(wide);
+
+    // 2x1 top-down with bit fields: RGBA in memory order
+    uint8_t fields[54 + 16 + 8] = {0};
+    bmpHeader(fields, sizeof(fields), 16, 2, -1, 32, 6);
+    writeU32(fields + 54, 0x000000ff);
+    writeU32(fields + 58, 0x0000ff00);
+    writeU32(fields + 62, 0x00ff0000);
+    writeU32(fields + 66, 0xff000000);
+    static const uint8_t fieldPixels[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    memcpy(fields + 70, fieldPixels, sizeof(fieldPixels));
+    CHECK(loadBytes(directory, fields, sizeof(fields), &image));
+    if (image.pixels) {
+        CHECK(pixelIs(&image, 0, 0, 1, 2, 3, 4) && pixelIs(&image, 1, 0, 5, 6, 7, 8));
+        imageFree(&image);
+    }
+    // Masks cut off by the end of the file
+    bmpHeader(broken, 60, 0, 1, 1, 32, 3);
+    CHECK(!loadBytes(directory, broken, 60, &image));
+
+    // 8 bits with a two-entry palette; indices past it read the first entry
+    uint8_t indexed[54 + 8 + 4] = {0};
+    bmpHeader(indexed, sizeof(indexed), 8, 3, 1, 8, 0);
+    writeU32(indexed + 46, 2);
+    static const uint8_t palette[8] = {10, 20, 30, 0, 40, 50, 60, 0};
+    memcpy(indexed + 54, palette, sizeof(palette));
+    indexed[62] = 1;
+    indexed[63] = 0;
+    indexed[64] = 200;
+    CHECK(loadBytes(directory, indexed, sizeof(indexed), &image));
+    if (image.pixels) {
+        CHECK(pixelIs(&image, 0, 0, 60, 50, 40, 255) && pixelIs(&image, 1, 0, 30, 20, 10, 255));
+        CHECK(pixelIs(&image, 2, 0, 30, 20, 10, 255));
+        imageFree(&image);
+    }
+    // A palette the file is too short to hold
+    writeU32(indexed + 46, 0);
+    CHECK(!loadBytes(directory, indexed, sizeof(indexed), &image));
+}
+
+int main(void) {
+    char directory[PATH_MAX];
+    testDirectory(directory, sizeof(directory));
+
+    testTga(directory);
+    testPpm(directory);
+    testBmp(directory);
+
+    rmdir(directory);
+    return testResult("test_image_loader");
+}
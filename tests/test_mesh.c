@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "test.h"
+#include "../src/mesh.h"
+
+// Inverse of the octahedral projection shader.vert applies
+static void octahedralDecode(const int16_t encoded[2], float normal[3]) {
+    float x = encoded[0] / 32767.0f;
+    float y = encoded[1] / 32767.0f;
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    if (z < 0.0f) {
+        float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    float length = sqrtf(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+static void testPackedVertices(void) {
+    static const float normals[][3] = {
+        {0, 0, 1}, {0, 0, -1}, {1, 0, 0}, {0, -1, 0}, {0.577350f, 0.577350f, 0.577350f},
+        {-0.267261f, 0.534522f, -0.801784f}, {0.707107f, -0.707107f, 0}, {-0.6f, -0.8f, -0.0001f},
+    };
+    // Half floats: exact values, round to nearest even, overflow, underflow and NaN
+    static const struct {
+        float value;
+        uint16_t half;
+    } halves[] = {
+        {0.0f, 0x0000}, {-0.0f, 0x8000}, {1.0f, 0x3c00}, {-2.0f, 0xc000}, {0.5f, 0x3800},
+        {1.0f / 3.0f, 0x3555}, {65504.0f, 0x7bff}, {65520.0f, 0x7c00}, {2049.0f, 0x6800},
+        {2051.0f, 0x6802}, {5.9604645e-8f, 0x0001}, {6.1035156e-5f, 0x0400}, {1e-9f, 0x0000},
+    };
+    uint32_t normalCount = sizeof(normals) / sizeof(normals[0]);
+    uint32_t halfCount = sizeof(halves) / sizeof(halves[0]);
+    uint32_t count = normalCount > halfCount ? normalCount : halfCount;
+
+    Mesh mesh = {0};
+    mesh.vertexCount = count + 1;
+    mesh.vertices = calloc(mesh.vertexCount, sizeof(Vertex));
+    for (uint32_t i = 0; i < count; i++) {
+        Vertex* v = &mesh.vertices[i];
+        v->position[0] = -1.0f + i;
+        v->position[1] = 2.0f * i;
+        v->position[2] = 0.5f;
+        memcpy(v->normal, normals[i % normalCount], sizeof(v->normal));
+        v->texCoord[0] = halves[i % halfCount].value;
+        v->texCoord[1] = -halves[i % halfCount].value;
+    }
+    // A degenerate normal packs to zero instead of dividing by it; NaN stays NaN
+    memcpy(mesh.vertices[count].position, mesh.vertices[0].position, sizeof(mesh.vertices[0].position));
+    mesh.vertices[count].texCoord[0] = NAN;
+    meshComputeBounds(&mesh);
+
+    PackedVertex* packed = malloc(mesh.vertexCount * sizeof(PackedVertex));
+    meshPackVertices(&mesh, packed);
+
+    for (uint32_t i = 0; i < normalCount; i++) {
+        float decoded[3];
+        octahedralDecode(packed[i].normal, decoded);
+        const float* n = normals[i];
+        float dot = decoded[0] * n[0] + decoded[1] * n[1] + decoded[2] * n[2];
+        CHECK(dot > 0.99999f);
+    }
+    CHECK(packed[count].normal[0] == 0 && packed[count].normal[1] == 0);
+
+    for (uint32_t i = 0; i < halfCount; i++) {
+        CHECK(packed[i].texCoord[0] == halves[i].half);
+        CHECK(packed[i].texCoord[1] == (uint16_t)(halves[i].half ^ 0x8000));
+    }
+    CHECK((packed[count].texCoord[0] & 0x7c00) == 0x7c00 && (packed[count].texCoord[0] & 0x3ff) != 0);
+
+    // Bounds map to the ends of the UNORM range, a flat axis to zero
+    CHECK(packed[0].position[0] == 0 && packed[count - 1].position[0] == 65535);
+    CHECK(packed[0].position[1] == 0 && packed[count - 1].position[1] == 65535);
+    CHECK(packed[0].position[2] == 0 && packed[count - 1].position[2] == 0);
+
+    free(packed);
+    free(mesh.vertices);
+}
+
+int main(void) {
+    testPackedVertices();
+    return testResult("test_mesh");
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "test.h"
+#include "../src/mesh.h"
+#include "../src/mesh_cache.h"
+#include "../src/obj_loader.h"
+
+static const char quadObj[] =
+    "mtllib quad.mtl\n"
+    "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+    "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+    "vn 0 0 1\n"
+    "usemtl red\nf 1/1/1 2/2/1 3/3/1\n"
+    "usemtl blue\nf 1/1/1 3/3/1 4/4/1\n";
+
+// Moves the mtime by whole seconds, as an editor saving the file would
+static void shiftMtime(const char* path, long seconds) {
+    struct stat st;
+    stat(path, &st);
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+    times[1].tv_sec += seconds;
+    utimensat(AT_FDCWD, path, times, 0);
+}
+
+static bool cacheMatches(const char* cachePath, const char* sourcePath, uint32_t optimization, const Mesh* expected) {
+    Mesh cached;
+    MeshCacheMapping mapping;
+    if (!meshCacheLoad(cachePath, sourcePath, optimization, &cached, &mapping)) {
+        return false;
+    }
+    bool equal = meshEqual(&cached, expected);
+    meshCacheUnmap(&mapping);
+    return equal;
+}
+
+static void testMeshCache(const char* directory) {
+    char sourcePath[PATH_MAX + 16];
+    char cachePath[PATH_MAX + 16];
+    snprintf(sourcePath, sizeof(sourcePath), "%s/quad.obj", directory);
+    snprintf(cachePath, sizeof(cachePath), "%s/quad.mesh", directory);
+    testWriteFile(sourcePath, quadObj, sizeof(quadObj) - 1);
+
+    Mesh mesh = {0};
+    CHECK(objLoadMesh(sourcePath, &mesh, NULL));
+    CHECK(mesh.subsetCount == 2);
+    CHECK(meshCacheWrite(cachePath, sourcePath, 0, &mesh));
+    CHECK(cacheMatches(cachePath, sourcePath, 0, &mesh));
+
+    // Built with another optimization
+    CHECK(!cacheMatches(cachePath, sourcePath, 1, &mesh));
+
+    // Touched but unchanged: the content hash keeps the cache, which is
+    // stamped with the new mtime
+    shiftMtime(sourcePath, 10);
+    CHECK(cacheMatches(cachePath, sourcePath, 0, &mesh));
+    CHECK(cacheMatches(cachePath, sourcePath, 0, &mesh));
+
+    // Same size, different content
+    char edited[sizeof(quadObj)];
+    memcpy(edited, quadObj, sizeof(quadObj));
+    edited[strlen("mtllib quad.mtl\nv ")] = '2';
+    testWriteFile(sourcePath, edited, sizeof(edited) - 1);
+    shiftMtime(sourcePath, 20);
+    CHECK(!cacheMatches(cachePath, sourcePath, 0, &mesh));
+
+    // Different size
+    testWriteFile(sourcePath, quadObj, sizeof(quadObj) - 1);
+    CHECK(meshCacheWrite(cachePath, sourcePath, 0, &mesh));
+    testWriteFile(sourcePath, quadObj, sizeof(quadObj) - 2);
+    CHECK(!cacheMatches(cachePath, sourcePath, 0, &mesh));
+    testWriteFile(sourcePath, quadObj, sizeof(quadObj) - 1);
+
+    // Truncated
+    CHECK(meshCacheWrite(cachePath, sourcePath, 0, &mesh));
+    struct stat st;
+    stat(cachePath, &st);
+    CHECK(truncate(cachePath, st.st_size - 1) == 0);
+    CHECK(!cacheMatches(cachePath, sourcePath, 0, &mesh));
+
+    // Contents that would be read out of bounds: an index past the vertices,
+    // subsets that don't cover the indices, an unterminated material name
+    mesh.indices[1] = mesh.vertexCount;
+    CHECK(meshCacheWrite(cachePath, sourcePath, 0, &mesh));
+    CHECK(!cacheMatches(cachePath, sourcePath, 0, &mesh));
+    mesh.indices[1] = 0;
+
+    mesh.subsets[1].indexCount++;
+    CHECK(meshCacheWrite(cachePath, sourcePath, 0, &mesh));
+    CHECK(!cacheMatches(cachePath, sourcePath, 0, &mesh));
+    mesh.subsets[1].indexCount--;
+
+    memset(mesh.subsets[0].material, 'x', sizeof(mesh.subsets[0].material));
+    CHECK(meshCacheWrite(cachePath, sourcePath, 0, &mesh));
+    CHECK(!cacheMatches(cachePath, sourcePath, 0, &mesh));
+
+    meshFree(&mesh);
+    unlink(sourcePath);
+    unlink(cachePath);
+}
+
+int main(void) {
+    char directory[PATH_MAX];
+    testDirectory(directory, sizeof(directory));
+
+    testMeshCache(directory);
+
+    rmdir(directory);
+    return testResult("test_mesh_cache");
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "../src/job_system.h"
+#include "../src/mesh.h"
+#include "../src/obj_loader.h"
+
+// Grid side of the generated OBJ; large enough that the parallel loader
+// splits it into several 4 MiB chunks
+#define GRID_SIZE 360
+
+// Writes a grid mixing every corner form the loader merges: absolute and
+// relative indices, corners with and without texture coordinates or
+// normals, material switches and quads to triangulate
+static void writeGridObj(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to write %s!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(file, "# generated by test_mesh\nmtllib grid.mtl\n");
+    for (int row = 0; row < GRID_SIZE; row++) {
+        for (int column = 0; column < GRID_SIZE; column++) {
+            float x = column * 0.01f;
+            float z = row * 0.01f;
+            fprintf(file, "v %.5f %.5f %.5f\n", x, sinf(x * 3.0f) * cosf(z * 2.0f), z);
+            fprintf(file, "vt %.4f %.4f\n", column / (float)GRID_SIZE, row / (float)GRID_SIZE);
+            fprintf(file, "vn 0 1 0\n");
+        }
+        if (row == 0) {
+            continue;
+        }
+
+        fprintf(file, "usemtl %s\n", row % 3 == 0 ? "stone" : row % 3 == 1 ? "grass" : "sand");
+        for (int column = 0; column + 1 < GRID_SIZE; column++) {
+            long a = (long)(row - 1) * GRID_SIZE + column + 1;
+            long b = a + 1;
+            long c = a + GRID_SIZE + 1;
+            long d = a + GRID_SIZE;
+            if (row % 4 == 0) {
+                // Relative to the end of the row just written
+                long base = (long)row * GRID_SIZE + GRID_SIZE + 1;
+                fprintf(file, "f %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld\n", a - base, a - base, a - base,
+                        b - base, b - base, b - base, c - base, c - base, c - base, d - base, d - base, d - base);
+            } else if (row % 4 == 1) {
+                fprintf(file, "f %ld//%ld %ld//%ld %ld//%ld\nf %ld//%ld %ld//%ld %ld//%ld\n", a, a, b, b, c, c, a,
+                        a, c, c, d, d);
+            } else if (row % 4 == 2) {
+                // No normals: the loader generates smooth ones
+                fprintf(file, "f %ld/%ld %ld/%ld %ld/%ld %ld/%ld\n", a, a, b, b, c, c, d, d);
+            } else {
+                fprintf(file, "f %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld\n", a, a, a, b, b, b, c, c, c, d, d,
+                        d);
+            }
+        }
+    }
+    fclose(file);
+}
+
+static void testParallelObjLoad(const char* directory) {
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/grid.obj", directory);
+    writeGridObj(path);
+
+    Mesh serial = {0};
+    Mesh parallel = {0};
+    JobSystem jobs;
+    jobSystemInit(&jobs, 3);
+    CHECK(objLoadMesh(path, &serial, NULL));
+    CHECK(objLoadMesh(path, &parallel, &jobs));
+    jobSystemShutdown(&jobs);
+
+    CHECK(serial.vertexCount > 0 && serial.indexCount == (GRID_SIZE - 1) * (GRID_SIZE - 1) * 6);
+    CHECK(serial.subsetCount == 3);
+    CHECK(meshEqual(&serial, &parallel));
+
+    meshFree(&serial);
+    meshFree(&parallel);
+    unlink(path);
+}
+
+// Indices too large for a long saturate and fail the load like any other
+// index past the attributes
+static void testHugeIndices(const char* directory) {
+    static const char* const faces[] = {
+        "f 1 2 99999999999999999999999999\n",
+        "f 1 2 -99999999999999999999999999\n",
+        "f 1/1 2/1 3/-4294967296\n",
+    };
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/huge.obj", directory);
+    for (size_t i = 0; i < sizeof(faces) / sizeof(faces[0]); i++) {
+        char contents[256];
+        int length = snprintf(contents, sizeof(contents), "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\n%s", faces[i]);
+        testWriteFile(path, contents, (size_t)length);
+        Mesh mesh = {0};
+        CHECK(!objLoadMesh(path, &mesh, NULL));
+    }
+    unlink(path);
+}
+
+int main(void) {
+    char directory[PATH_MAX];
+    testDirectory(directory, sizeof(directory));
+
+    testParallelObjLoad(directory);
+    testHugeIndices(directory);
+
+    rmdir(directory);
+    return testResult("test_obj_loader");
+}
@@ -0,0 +1,72 @@
+#include "test.h"
+#include "../src/slot_allocator.h"
+
+// Slots are handed out lowest first, never below the reserved ones, until
+// the table is full
+static void testTake(void) {
+    SlotAllocator slots;
+    slotAllocatorInit(&slots, 4, 1);
+    uint32_t slot = 0;
+    CHECK(slotAllocatorTake(&slots, &slot) && slot == 1);
+    CHECK(slotAllocatorTake(&slots, &slot) && slot == 2);
+    CHECK(slotAllocatorTake(&slots, &slot) && slot == 3);
+    CHECK(!slotAllocatorTake(&slots, &slot));
+    slotAllocatorShutdown(&slots);
+}
+
+// A retired slot stays out of reach until the timeline reaches the value it
+// was retired at, and is then handed out again
+static void testRecycle(void) {
+    SlotAllocator slots;
+    slotAllocatorInit(&slots, 3, 1);
+    uint32_t first = 0, second = 0, slot = 0;
+    CHECK(slotAllocatorTake(&slots, &first) && slotAllocatorTake(&slots, &second));
+
+    slotAllocatorRetire(&slots, first, 5);
+    CHECK(!slotAllocatorTake(&slots, &slot));
+    CHECK(!slotAllocatorReclaim(&slots, 4, &slot));
+    CHECK(!slotAllocatorTake(&slots, &slot));
+
+    CHECK(slotAllocatorReclaim(&slots, 5, &slot) && slot == first);
+    CHECK(!slotAllocatorReclaim(&slots, 5, &slot));
+    CHECK(slotAllocatorTake(&slots, &slot) && slot == first);
+    CHECK(!slotAllocatorTake(&slots, &slot));
+    slotAllocatorShutdown(&slots);
+}
+
+// Slots retired at different values come back as their frames complete,
+// past the first growth of the retired list
+static void testRecycleMany(void) {
+    enum { COUNT = 40 };
+    SlotAllocator slots;
+    slotAllocatorInit(&slots, COUNT, 0);
+    uint32_t slot = 0;
+    for (uint32_t i = 0; i < COUNT; i++) {
+        CHECK(slotAllocatorTake(&slots, &slot) && slot == i);
+        slotAllocatorRetire(&slots, slot, 100 + i / 2);
+    }
+
+    bool seen[COUNT] = {false};
+    uint32_t reclaimed = 0;
+    for (uint64_t completed = 99; completed < 100 + COUNT / 2; completed++) {
+        while (slotAllocatorReclaim(&slots, completed, &slot)) {
+            CHECK(slot < COUNT && !seen[slot] && 100 + slot / 2 <= completed);
+            seen[slot] = true;
+            reclaimed++;
+        }
+        CHECK(reclaimed == (completed - 99) * 2);
+    }
+
+    for (uint32_t i = 0; i < COUNT; i++) {
+        CHECK(slotAllocatorTake(&slots, &slot));
+    }
+    CHECK(!slotAllocatorTake(&slots, &slot));
+    slotAllocatorShutdown(&slots);
+}
+
+int main(void) {
+    testTake();
+    testRecycle();
+    testRecycleMany();
+    return testResult("test_slot_allocator");
+}
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "test.h"
+#include "../src/bc_encoder.h"
+#include "../src/image_loader.h"
+#include "../src/texture_cache.h"
+#include "../src/util.h"
+
+static bool textureMatches(const char* cachePath, uint64_t sourceHash, const BcImage* expected) {
+    BcImage cached;
+    if (!textureCacheLoad(cachePath, sourceHash, &cached)) {
+        return false;
+    }
+    bool equal = cached.format == expected->format && cached.width == expected->width &&
+                 cached.height == expected->height && cached.mipLevels == expected->mipLevels &&
+                 cached.size == expected->size && memcmp(cached.data, expected->data, cached.size) == 0;
+    bcImageFree(&cached);
+    return equal;
+}
+
+static void testTextureCache(const char* directory) {
+    char cachePath[PATH_MAX + 16];
+    snprintf(cachePath, sizeof(cachePath), "%s/texture.tex", directory);
+
+    Image image = {6, 5, malloc(6 * 5 * 4)};
+    for (size_t i = 0; i < 6 * 5 * 4; i++) {
+        image.pixels[i] = (uint8_t)(i * 37);
+    }
+    uint64_t sourceHash = hashBytes(image.pixels, 6 * 5 * 4, 0);
+
+    for (int format = 0; format < BC_FORMAT_COUNT; format++) {
+        BcImage encoded;
+        bcEncodeImage(&image, (BcFormat)format, &encoded);
+        CHECK(textureCacheWrite(cachePath, sourceHash, &encoded));
+        CHECK(textureMatches(cachePath, sourceHash, &encoded));
+
+        // Another source, or a file cut short
+        CHECK(!textureMatches(cachePath, sourceHash + 1, &encoded));
+        struct stat st;
+        stat(cachePath, &st);
+        CHECK(truncate(cachePath, st.st_size - 1) == 0);
+        CHECK(!textureMatches(cachePath, sourceHash, &encoded));
+
+        bcImageFree(&encoded);
+    }
+
+    imageFree(&image);
+    unlink(cachePath);
+}
+
+int main(void) {
+    char directory[PATH_MAX];
+    testDirectory(directory, sizeof(directory));
+
+    testTextureCache(directory);
+
+    rmdir(directory);
+    return testResult("test_texture_cache");
+}